@@ -0,0 +1,238 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ArraySwap.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "ArraySwap.h"
+#include "CpuFeatures.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>		// SSE2
+#include <tmmintrin.h>		// SSSE3
+#include <immintrin.h>		// AVX2
+#endif
+
+enum {
+	ARRAY_SWAP_AVX2		= 1,
+	ARRAY_SWAP_SSSE3	= 2,
+	ARRAY_SWAP_SCALAR	= 3,
+};
+
+//*********************************************************************************************************************
+//	Private helper. Returns ARRAY_SWAP_AVX2 if the CPU supports AVX2 and the OS saves the upper halves of the YMM
+//	registers, ARRAY_SWAP_SSSE3 if the CPU supports SSSE3, or ARRAY_SWAP_SCALAR if it doesn't.
+//*********************************************************************************************************************
+LONG CArraySwap::GetCpuMode(void)
+{
+	DWORD dwFlags = CCpuFeatures::GetFlags();
+
+	if (dwFlags & CCpuFeatures::CPU_HAS_AVX2)
+	{
+		return ARRAY_SWAP_AVX2;
+	}
+
+	if (dwFlags & CCpuFeatures::CPU_HAS_SSSE3)
+	{
+		return ARRAY_SWAP_SSSE3;
+	}
+
+	return ARRAY_SWAP_SCALAR;
+}
+
+//*********************************************************************************************************************
+//	Byte-swaps nElements 32-bit elements. That's one _mm256_shuffle_epi8() per eight elements, or one
+//	_mm_shuffle_epi8() per four elements.
+//*********************************************************************************************************************
+void CArraySwap::Swap32(__in const UINT32* pSrc, __in SIZE_T nElements, __out PUINT32 pDst)
+{
+	SIZE_T i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	LONG nMode = GetCpuMode();
+	if (nMode == ARRAY_SWAP_AVX2)
+	{
+		__m256i	yMask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12,
+										 3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12);
+		for (; i + 8 <= nElements; i += 8)
+		{
+			__m256i ySrc = _mm256_loadu_si256((const __m256i*)(pSrc + i));
+			_mm256_storeu_si256((__m256i*)(pDst + i), _mm256_shuffle_epi8(ySrc, yMask));
+		}
+
+		// Avoid the penalty for mixing AVX code with the SSE code that our caller is probably running.
+		_mm256_zeroupper();
+	}
+	else if (nMode == ARRAY_SWAP_SSSE3)
+	{
+		__m128i	xMask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12);
+		for (; i + 4 <= nElements; i += 4)
+		{
+			__m128i xSrc = _mm_loadu_si128((const __m128i*)(pSrc + i));
+			_mm_storeu_si128((__m128i*)(pDst + i), _mm_shuffle_epi8(xSrc, xMask));
+		}
+	}
+#endif
+
+	// Plain C++ for whatever is left over.
+	for (; i < nElements; i++)
+	{
+		pDst[i] = Endian32(pSrc[i]);
+	}
+}
+
+//*********************************************************************************************************************
+//	Byte-swaps nElements 64-bit elements. Same idea as Swap32().
+//*********************************************************************************************************************
+void CArraySwap::Swap64(__in const UINT64* pSrc, __in SIZE_T nElements, __out PUINT64 pDst)
+{
+	SIZE_T i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	LONG nMode = GetCpuMode();
+	if (nMode == ARRAY_SWAP_AVX2)
+	{
+		__m256i	yMask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15,14,13,12,11,10, 9, 8,
+										 7, 6, 5, 4, 3, 2, 1, 0, 15,14,13,12,11,10, 9, 8);
+		for (; i + 4 <= nElements; i += 4)
+		{
+			__m256i ySrc = _mm256_loadu_si256((const __m256i*)(pSrc + i));
+			_mm256_storeu_si256((__m256i*)(pDst + i), _mm256_shuffle_epi8(ySrc, yMask));
+		}
+
+		// Avoid the penalty for mixing AVX code with the SSE code that our caller is probably running.
+		_mm256_zeroupper();
+	}
+	else if (nMode == ARRAY_SWAP_SSSE3)
+	{
+		__m128i	xMask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15,14,13,12,11,10, 9, 8);
+		for (; i + 2 <= nElements; i += 2)
+		{
+			__m128i xSrc = _mm_loadu_si128((const __m128i*)(pSrc + i));
+			_mm_storeu_si128((__m128i*)(pDst + i), _mm_shuffle_epi8(xSrc, xMask));
+		}
+	}
+#endif
+
+	// Plain C++ for whatever is left over.
+	for (; i < nElements; i++)
+	{
+		pDst[i] = Endian64(pSrc[i]);
+	}
+}
+
+//*********************************************************************************************************************
+//	Zero-extends nElements 32-bit elements to 64 bits, and byte-swaps them first if fSwap is TRUE.
+//
+//	We work from the last element to the first, so pDst can be the same address as pSrc. Each block is loaded before
+//	any of it is stored, and a block of n results never reaches below the block of n sources that it came from. The
+//	AVX2 loop uses _mm256_cvtepu32_epi64() (vpmovzxdq) to widen four elements at a time. The SSSE3 loop does the
+//	swap and the widen with the same shuffle, because 0x80 in a shuffle mask makes a zero byte.
+//*********************************************************************************************************************
+void CArraySwap::Widen32(__in const UINT32* pSrc, __in SIZE_T nElements, __in BOOL fSwap, __out PUINT64 pDst)
+{
+	SIZE_T i = nElements;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	LONG nMode = GetCpuMode();
+	if (nMode == ARRAY_SWAP_AVX2)
+	{
+		__m128i	xMask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12);
+		for (; i >= 4; i -= 4)
+		{
+			__m128i xSrc = _mm_loadu_si128((const __m128i*)(pSrc + i - 4));
+			if (fSwap)
+			{
+				xSrc = _mm_shuffle_epi8(xSrc, xMask);
+			}
+			_mm256_storeu_si256((__m256i*)(pDst + i - 4), _mm256_cvtepu32_epi64(xSrc));
+		}
+
+		// Avoid the penalty for mixing AVX code with the SSE code that our caller is probably running.
+		_mm256_zeroupper();
+	}
+	else if (nMode == ARRAY_SWAP_SSSE3)
+	{
+		__m128i	xLo = fSwap	? _mm_setr_epi8(3, 2, 1, 0, -128,-128,-128,-128, 7, 6, 5, 4, -128,-128,-128,-128)
+							: _mm_setr_epi8(0, 1, 2, 3, -128,-128,-128,-128, 4, 5, 6, 7, -128,-128,-128,-128);
+		__m128i	xHi = fSwap	? _mm_setr_epi8(11,10, 9, 8, -128,-128,-128,-128, 15,14,13,12, -128,-128,-128,-128)
+							: _mm_setr_epi8(8, 9,10,11, -128,-128,-128,-128, 12,13,14,15, -128,-128,-128,-128);
+		for (; i >= 4; i -= 4)
+		{
+			__m128i xSrc = _mm_loadu_si128((const __m128i*)(pSrc + i - 4));
+			_mm_storeu_si128((__m128i*)(pDst + i - 2), _mm_shuffle_epi8(xSrc, xHi));
+			_mm_storeu_si128((__m128i*)(pDst + i - 4), _mm_shuffle_epi8(xSrc, xLo));
+		}
+	}
+#endif
+
+	// Plain C++ for whatever is left over. These are the first few elements, so we still go from back to front.
+	while (i > 0)
+	{
+		i--;
+		pDst[i] = fSwap ? Endian32(pSrc[i]) : pSrc[i];
+	}
+}
+
+//*********************************************************************************************************************
+//	Copies the first 32-bit half of each of nElements 64-bit elements, and byte-swaps it if fSwap is TRUE. This is
+//	how we pull the Bento object IDs out of an OMF1 ObjRefArray (see OMF1_OBJREF_ENTRY).
+//
+//	We work from the first element to the last, so pDst can be the same address as pSrc. Both loops use
+//	_mm_shuffle_ps() to pick the even 32-bit lanes from two loads. The AVX2 version picks them within each 128-bit
+//	lane, so it needs one _mm256_permute4x64_epi64() to put them back in order.
+//*********************************************************************************************************************
+void CArraySwap::Gather32(__in const UINT64* pSrc, __in SIZE_T nElements, __in BOOL fSwap, __out PUINT32 pDst)
+{
+	SIZE_T i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	LONG nMode = GetCpuMode();
+	if (nMode == ARRAY_SWAP_AVX2)
+	{
+		__m256i	yMask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12,
+										 3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12);
+		for (; i + 8 <= nElements; i += 8)
+		{
+			__m256	yA	= _mm256_loadu_ps((const float*)(pSrc + i));
+			__m256	yB	= _mm256_loadu_ps((const float*)(pSrc + i + 4));
+			__m256i	y	= _mm256_castps_si256(_mm256_shuffle_ps(yA, yB, _MM_SHUFFLE(2, 0, 2, 0)));
+
+			// Now the elements are in the order 0, 1, 4, 5, 2, 3, 6, 7.
+			y = _mm256_permute4x64_epi64(y, _MM_SHUFFLE(3, 1, 2, 0));
+			if (fSwap)
+			{
+				y = _mm256_shuffle_epi8(y, yMask);
+			}
+			_mm256_storeu_si256((__m256i*)(pDst + i), y);
+		}
+
+		// Avoid the penalty for mixing AVX code with the SSE code that our caller is probably running.
+		_mm256_zeroupper();
+	}
+	else if (nMode == ARRAY_SWAP_SSSE3)
+	{
+		__m128i	xMask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12);
+		for (; i + 4 <= nElements; i += 4)
+		{
+			__m128	xA	= _mm_loadu_ps((const float*)(pSrc + i));
+			__m128	xB	= _mm_loadu_ps((const float*)(pSrc + i + 2));
+			__m128i	x	= _mm_castps_si128(_mm_shuffle_ps(xA, xB, _MM_SHUFFLE(2, 0, 2, 0)));
+			if (fSwap)
+			{
+				x = _mm_shuffle_epi8(x, xMask);
+			}
+			_mm_storeu_si128((__m128i*)(pDst + i), x);
+		}
+	}
+#endif
+
+	// Plain C++ for whatever is left over.
+	for (; i < nElements; i++)
+	{
+		DWORD dwFirst = ((const DWORD*)(pSrc + i))[0];
+		pDst[i] = fSwap ? Endian32(dwFirst) : dwFirst;
+	}
+}
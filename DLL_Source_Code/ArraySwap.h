@@ -0,0 +1,32 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ArraySwap.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+
+//*********************************************************************************************************************
+//	CArraySwap.
+//	Static routines that byte-swap, widen, and gather the elements of the array properties that CContainerLayer01
+//	reads - omfi:Int32Array, omfi:Int64Array, omfi:Position32Array, omfi:Position64Array, omfi:ObjRefArray, and
+//	omfi:MobIndex. A frame index or an ObjRefArray can have hundreds of thousands of elements, so these use AVX2 when
+//	the CPU and the OS both support it, SSSE3 when they don't, and plain C++ for whatever is left over.
+//
+//	Every routine accepts the same address for its source and its destination, because our callers usually read a
+//	payload straight into the memory that they return, and then fix it up in place. Widen32() works from back to
+//	front so that its 64-bit results never overwrite 32-bit elements that it hasn't read yet. Gather32() works from
+//	front to back for the same reason.
+//*********************************************************************************************************************
+class CArraySwap
+{
+public:
+	static void		Swap32(__in const UINT32* pSrc, __in SIZE_T nElements, __out PUINT32 pDst);
+	static void		Swap64(__in const UINT64* pSrc, __in SIZE_T nElements, __out PUINT64 pDst);
+	static void		Widen32(__in const UINT32* pSrc, __in SIZE_T nElements, __in BOOL fSwap, __out PUINT64 pDst);
+	static void		Gather32(__in const UINT64* pSrc, __in SIZE_T nElements, __in BOOL fSwap, __out PUINT32 pDst);
+
+private:
+	static LONG		GetCpuMode(void);
+};
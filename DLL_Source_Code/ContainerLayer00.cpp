@@ -8,6 +8,7 @@
 #include "stdafx.h"
 #include "Omfoo_Alpha_Header.h"
 #include "ContainerLayer00.h"
+#include "SortByFilePos.h"
 #include "DllMain.h"
 #include <shlwapi.h>
 
@@ -77,6 +78,7 @@ HRESULT CContainerLayer00::Load(PCWSTR pwzFileName)
 		CHECK(DetectPlatform());			// was this file created on Windows? legacy Macintosh? or modern Mac?
 		CHECK(DetectCodePagePartTwo());		// detects other legacy ANSI code pages if DetectCodePagePartOne() failed.
 	//	CHECK(SurveyTimestamps());			// just for debugging
+		CHECK(PreloadSmallPayloads());		// read the small fixed-size payloads into the TOC.
 	}
 
 	return hr;
@@ -551,6 +553,168 @@ HRESULT CContainerLayer00::PopulateStringCache()
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Function object for SortByFilePos(). Returns the file position of the TOCX_ITEM at m_aToc[iToc].
+//*********************************************************************************************************************
+class CTocItemFilePos
+{
+public:
+	CTocItemFilePos(PTOCX_ITEM aToc) : m_aToc(aToc) {}
+	UINT64 operator()(ULONG iToc) const { return m_aToc[iToc].cbOffset64; }
+
+private:
+	PTOCX_ITEM	m_aToc;
+};
+
+//*********************************************************************************************************************
+//	Called once per lifetime from Load().
+//	Read every small out-of-line payload into its own TOCX_ITEM so that we never have to go back to the file for it.
+//	Only the fixed-size data types in aPreloadTypes[] qualify, and only when the payload is SM_OFFSET, eight bytes
+//	or less, and not fragmented. We leave everything else alone - omfi:UID and omfi:String already have their own
+//	caches, the arrays have their own element counts, and omfi:DataValue is only useful as a file offset.
+//	The payloads are read in file order, and neighbors are coalesced into as few SeekRead() calls as possible.
+//	We don't byte-swap anything here. The bytes in aPreloadedBytes[] are exactly what's in the file.
+//	This is strictly an optimization. If a burst can't be read then its items stay SM_OFFSET and get read on demand.
+//	Returns S_OK unless a memory allocation fails.
+//*********************************************************************************************************************
+HRESULT CContainerLayer00::PreloadSmallPayloads(void)
+{
+	// These are the data types whose payloads are always between five and eight bytes long.
+	// Anything four bytes or less is already SM_IMMEDIATE.
+	static const DataTypeOrdinal aPreloadTypes[] = {
+		eTypeDouble,			// omfi:Double
+		eTypeExactEditRate,		// omfi:ExactEditRate
+		eTypeInt64,				// omfi:Int64
+		eTypeLength64,			// omfi:Length64
+		eTypeObjRef,			// omfi:ObjRef (OMF1 only - it's an eight-byte OMF1_OBJREF_ENTRY)
+		eTypePosition64,		// omfi:Position64
+		eTypeRational,			// omfi:Rational
+		eTypeTimeStamp,			// omfi:TimeStamp
+		eTypeUInt64,			// omfi:UInt64
+		eTypeVersionType,		// omfi:VersionType (this is only two bytes, but some writers stored it as an offset)
+	};
+
+	HRESULT	hr			= S_OK;
+	PULONG	aIndices	= NULL;
+	PBYTE	pScratch	= NULL;
+	ULONG	nIndices	= 0;
+	DWORD	aTypeIDs[ELEMS(aPreloadTypes)];
+
+	// Look up the Bento IDs for each data type. Types that don't exist in this file will be zero.
+	for (ULONG i = 0; i < ELEMS(aPreloadTypes); i++)
+	{
+		aTypeIDs[i] = OrdinalToDataTypeID(aPreloadTypes[i]);
+	}
+
+	// Allocate the worst case. One ULONG per TOCX_ITEM.
+	aIndices = PULONG(MemAlloc(m_nTocItems * sizeof(ULONG)));
+	if (NULL == aIndices)
+	{
+		BREAK_IF_DEBUG
+		hr = E_OUTOFMEMORY;
+		goto L_Exit;
+	}
+
+	// Collect the m_aToc[] index of every TOCX_ITEM that qualifies.
+	for (ULONG iToc = 0; iToc < m_nTocItems; iToc++)
+	{
+		PTOCX_ITEM pCurItem = &m_aToc[iToc];
+
+		if ((pCurItem->bStorageMode != SM_OFFSET) ||
+			(pCurItem->cbLength64 == 0) ||
+			(pCurItem->cbLength64 > sizeof(pCurItem->aPreloadedBytes)) ||
+			(pCurItem->fContinued))
+		{
+			continue;
+		}
+
+		// Skip the final fragment of a fragmented property. It has fContinued == FALSE but it's not the whole story.
+		if ((iToc > 0) && (pCurItem[-1].fContinued))
+		{
+			continue;
+		}
+
+		for (ULONG i = 0; i < ELEMS(aTypeIDs); i++)
+		{
+			if ((aTypeIDs[i]) && (aTypeIDs[i] == pCurItem->dwDataType))
+			{
+				aIndices[nIndices++] = iToc;
+				break;
+			}
+		}
+	}
+
+	// Nothing to do?
+	if (0 == nIndices)
+	{
+		goto L_Exit;
+	}
+
+	// Put them in file order.
+	SortByFilePos(aIndices, nIndices, CTocItemFilePos(m_aToc));
+
+	pScratch = PBYTE(MemAlloc(PRELOAD_MAX_BURST));
+	if (NULL == pScratch)
+	{
+		BREAK_IF_DEBUG
+		hr = E_OUTOFMEMORY;
+		goto L_Exit;
+	}
+
+	// Sweep through the file from front to back.
+	for (ULONG i = 0; i < nIndices;)
+	{
+		UINT64	cbStart	= m_aToc[aIndices[i]].cbOffset64;
+		UINT64	cbEnd	= cbStart + m_aToc[aIndices[i]].cbLength64;
+		ULONG	j		= i + 1;
+
+		// Extend this burst as long as the next payload is close by and the burst still fits in pScratch.
+		while (j < nIndices)
+		{
+			UINT64 cbNextStart	= m_aToc[aIndices[j]].cbOffset64;
+			UINT64 cbNextEnd	= cbNextStart + m_aToc[aIndices[j]].cbLength64;
+
+			if ((cbNextStart > cbEnd + PRELOAD_MAX_GAP) || (cbNextEnd - cbStart > PRELOAD_MAX_BURST))
+			{
+				break;
+			}
+
+			if (cbEnd < cbNextEnd)
+			{
+				cbEnd = cbNextEnd;
+			}
+			j++;
+		}
+
+		if (FAILED(SeekRead(cbStart, pScratch, UINT32(cbEnd - cbStart))))
+		{
+			// A file system error occured in SeekRead() while preloading.
+			// This is not fatal. Skip this burst and leave its items alone so that they will be read lazily.
+			i = j;
+			continue;
+		}
+
+		// Copy each payload into its TOCX_ITEM. This clobbers cbOffset64 so we have to be done with it first.
+		for (; i < j; i++)
+		{
+			PTOCX_ITEM	pCurItem	= &m_aToc[aIndices[i]];
+			ULONG		cbPayload	= pCurItem->cbLengthLo;
+			PBYTE		pSrc		= &pScratch[ULONG(pCurItem->cbOffset64 - cbStart)];
+
+			pCurItem->cbOffset64 = 0;
+			CopyMemory(pCurItem->aPreloadedBytes, pSrc, cbPayload);
+
+			// Update the storage mode.
+			pCurItem->bStorageMode = SM_PRELOADED;
+		}
+	}
+
+L_Exit:
+	MemFree(pScratch);
+	MemFree(aIndices);
+	return hr;
+}
+
 //*********************************************************************************************************************
 //	Called once per lifetime from Load().
 //	Try to figure out if this OMF file was created on a Mac or a PC.
@@ -24,6 +24,11 @@ enum {
 	// The maximum length for any omfi:String property including the null-terminator.
 	// Avid's 2.1.2 omfToolkit.dll limited generic strings to no more than 255 characters plus a null-terminator.
 	OMFOO_STRMAX_STRING	= 256,
+
+	// PreloadSmallPayloads() coalesces payloads that are no more than PRELOAD_MAX_GAP bytes apart,
+	// as long as the whole burst fits in PRELOAD_MAX_BURST bytes.
+	PRELOAD_MAX_GAP		= 4096,
+	PRELOAD_MAX_BURST	= 65536,
 };
 
 //	These are the enumerated values for m_dwFirstOS.
@@ -58,6 +63,7 @@ private:
 	HRESULT	ScanNetlsForPlatform(void);
 	HRESULT	DetectPlatform(void);
 	HRESULT	DetectCodePagePartTwo(void);
+	HRESULT	PreloadSmallPayloads(void);
 
 protected:
 	HRESULT	m_hrFirewall;		// This is initialized to E_HANDLE in our constructor.
@@ -11,6 +11,7 @@
 #include "DllMain.h"
 #include "StreamOnReadableFile.h"
 #include "StreamOnRawBytes.h"
+#include "ArraySwap.h"
 #include <shlwapi.h>
 
 #include "MiscStatic.h"
@@ -380,6 +381,25 @@ L_PropExists:
 				goto L_CleanupExit;
 			}
 		}
+		else if (pItem->bStorageMode == SM_PRELOADED)
+		{
+			if (pItem->cbLength64 > sizeof(pItem->aPreloadedBytes))
+			{
+				BREAK_IF_DEBUG	// Has this ever happened?
+				hr =  OMF_E_STORAGE_SURPRISE;
+				goto L_CleanupExit;
+			}
+
+			if (pItem->cbLength64 > cbRemaining)
+			{
+				BREAK_IF_DEBUG	// Has this ever happened?
+				hr =  OMF_E_SIZE_SURPRISE;
+				goto L_CleanupExit;
+			}
+
+			// The payload was read from the file during Load(). Copy it from TOC memory to caller's buffer.
+			CopyMemory(&PBYTE(pBuffer)[cbConsumed], &pItem->aPreloadedBytes, pItem->cbLengthLo);
+		}
 		else
 		{
 			// We can't read the data because we don't know how it is stored ...
@@ -439,6 +459,117 @@ L_Exit:
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Internal read operation.
+//	Like CoreReadStrict(), except that it reads just cbBuffer bytes beginning cbSkip bytes into the payload, so caller's
+//	buffer doesn't have to hold the whole thing. The range must lie entirely inside the payload, or this routine will
+//	return OMF_E_SIZE_SURPRISE. Use (-1) as a wildcard for dwRequestedType.
+//	Note that this routine can and will read FRAGMENTED PAYLOADS.
+//*********************************************************************************************************************
+HRESULT CContainerLayer01::CoreReadPayloadRange(BENTO_BLOP& rBlop, DWORD dwProperty, DWORD dwRequestedType,
+												ULONG cbSkip, ULONG cbBuffer, PVOID pBuffer)
+{
+	PTOCX_ITEM	pItem			= NULL;	// dynamic pointer to the current TOCX_ITEM under scrutiny
+	ULONG		nItems			= 0;	// number of TOCX_ITEMs remaining in this blop's slice
+	DWORD		dwStoredType	= 0;	// the data type as it is stored in the first TOCX_ITEM
+	UINT64		cbPos			= 0;	// payload position of the current fragment
+	UINT64		cbStop			= UINT64(cbSkip) + cbBuffer;
+	HRESULT		hr				= S_OK;
+
+	// Validate caller's destination pointer.
+	if (IsBadWritePointer(pBuffer, cbBuffer))
+	{
+		return E_POINTER;
+	}
+
+	// Wipe caller's destination buffer.
+	ZeroMemory(pBuffer, cbBuffer);
+
+	// See CoreReadStrict().
+	if (0 == rBlop.dwObject)
+	{
+		return OMF_E_OOBJ_NOT_FOUND;
+	}
+
+	if (0 == dwProperty)
+	{
+		return OMF_E_PROP_NOT_DEFINED;
+	}
+
+	// Find the first TOCX_ITEM for this property. (Skip reference list IDs)
+	pItem	= &m_aToc[rBlop.iFirstItem];
+	nItems	= rBlop.wTotalItems;
+	while ((nItems) && ((pItem->dwProperty != dwProperty) || (pItem->bStorageMode == SM_REFLISTID)))
+	{
+		++pItem;
+		--nItems;
+	}
+
+	if (0 == nItems)
+	{
+		return OMF_E_PROP_NOT_FOUND;
+	}
+
+	// Compare stored type with caller's requested data type. Note that (-1) is a wildcard.
+	dwStoredType = pItem->dwDataType;
+	if ((0 == dwStoredType) || ((dwStoredType != dwRequestedType) && (dwRequestedType != DWORD(-1))))
+	{
+		return OMF_E_TYPE_SURPRISE;
+	}
+
+	// Walk the fragments, and copy or read the part of each one that overlaps caller's range.
+	for (;;)
+	{
+		UINT64 cbEnd = cbPos + pItem->cbLength64;
+
+		if ((cbEnd > cbSkip) && (cbPos < cbStop))
+		{
+			UINT64	cbFirst		= (cbPos > cbSkip) ? cbPos : cbSkip;
+			UINT64	cbLast		= (cbEnd < cbStop) ? cbEnd : cbStop;
+			ULONG	cbPart		= ULONG(cbLast - cbFirst);
+			ULONG	cbInItem	= ULONG(cbFirst - cbPos);
+			PBYTE	pDest		= &PBYTE(pBuffer)[ULONG(cbFirst - cbSkip)];
+
+			if ((pItem->bStorageMode == SM_IMMEDIATE) && (pItem->cbLength64 <= sizeof(pItem->aImmediateBytes)))
+			{
+				CopyMemory(pDest, &pItem->aImmediateBytes[cbInItem], cbPart);
+			}
+			else if ((pItem->bStorageMode == SM_PRELOADED) && (pItem->cbLength64 <= sizeof(pItem->aPreloadedBytes)))
+			{
+				CopyMemory(pDest, &pItem->aPreloadedBytes[cbInItem], cbPart);
+			}
+			else if (pItem->bStorageMode == SM_OFFSET)
+			{
+				if (FAILED(hr = SeekRead(pItem->cbOffset64 + cbInItem, pDest, cbPart)))
+				{
+					return hr;
+				}
+			}
+			else
+			{
+				BREAK_IF_DEBUG
+				return OMF_E_STORAGE_SURPRISE;
+			}
+		}
+
+		// Have we read all of caller's range?
+		cbPos = cbEnd;
+		if (cbPos >= cbStop)
+		{
+			return S_OK;
+		}
+
+		// We hit the end of the payload (or of the blop, or a different property) before the end of caller's range.
+		if ((!pItem->fContinued) ||
+			(0 == --nItems) ||
+			((++pItem)->dwProperty != dwProperty) ||
+			(pItem->dwDataType != dwStoredType))
+		{
+			return OMF_E_SIZE_SURPRISE;
+		}
+	}
+}
+
 //*********************************************************************************************************************
 //	Generic read routine. Retrieves raw, unprocessed bytes, as specified by dwProperty.
 //	The pBuffer and pcbRequired arguments are both optional, but you must provide at least one.
@@ -524,6 +655,342 @@ L_Exit:
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Batch read routine. Retrieves the raw payloads of several properties of the same blop in one call.
+//	Every request is resolved against this blop's own slice of m_aToc[]. Immediate payloads are copied right away.
+//	The SM_OFFSET fragments are collected, sorted by file position, and coalesced into as few SeekRead() calls as
+//	possible. So reading all of the properties of a typical SCLP or CPNT costs one short burst of I/O.
+//	Each request gets its own HRESULT. Returns S_OK if every request succeeded, or S_FALSE if at least one failed.
+//	A failing return code means that none of the requests were attempted.
+//*********************************************************************************************************************
+HRESULT CContainerLayer01::CoreReadProperties(BENTO_BLOP& rBlop, ULONG nRequests, POMFOO_PROPERTY_REQUEST aRequests)
+{
+	POMFOO_READ_EXTENT	aExtents	= NULL;
+	ULONG				nExtents	= 0;
+	ULONG				nFailures	= 0;
+	HRESULT				hr			= S_OK;
+
+	if (nRequests > RP_MAX_REQUESTS)
+	{
+		hr = E_INVALIDARG;
+		goto L_Exit;
+	}
+
+	if (IsBadWritePointer(aRequests, nRequests * sizeof(OMFOO_PROPERTY_REQUEST)))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	// Make sure caller's BENTO_BLOP is one of the ones in CReadOmf::m_aBlopTable[] and not CReadOmf::m_oEmptyBlop.
+	if (0 == rBlop.dwObject)
+	{
+		hr = OMF_E_OOBJ_NOT_FOUND;
+		goto L_Exit;
+	}
+
+	// Every TOCX_ITEM in this blop's slice could be a fragment, so this is enough extents for any set of distinct
+	// requests. Duplicate requests can ask for more, so PrepareReadRequest() never appends beyond this capacity.
+	aExtents = POMFOO_READ_EXTENT(m_oSmallBlockHeap.Alloc(rBlop.wTotalItems * sizeof(OMFOO_READ_EXTENT)));
+	if (NULL == aExtents)
+	{
+		hr = E_OUTOFMEMORY;
+		goto L_Exit;
+	}
+
+	// Pass one - resolve each request, copy the immediate payloads, and collect the extents.
+	for (ULONG i = 0; i < nRequests; i++)
+	{
+		aRequests[i].hr = PrepareReadRequest(rBlop, &aRequests[i], i, aExtents, rBlop.wTotalItems, nExtents);
+	}
+
+	// Pass two - read the extents.
+	if (FAILED(hr = ReadCoalescedExtents(aExtents, nExtents, aRequests)))
+	{
+		goto L_Exit;
+	}
+
+	for (ULONG i = 0; i < nRequests; i++)
+	{
+		if (FAILED(aRequests[i].hr))
+		{
+			nFailures++;
+		}
+	}
+
+	hr = nFailures ? S_FALSE : S_OK;
+
+L_Exit:
+	CSmallBlockHeap::Free(aExtents);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for CoreReadProperties().
+//	Finds the property in the blop's slice of m_aToc[], validates it, and wipes caller's buffer. Then it copies any
+//	immediate fragments directly into caller's buffer, and appends one OMFOO_READ_EXTENT to aExtents[] for each
+//	SM_OFFSET fragment. Nothing is appended unless the whole request is valid. Once aExtents[] holds cMaxExtents
+//	entries any further SM_OFFSET fragments are read immediately with their own SeekRead() instead.
+//	Returns the HRESULT for this one request.
+//*********************************************************************************************************************
+HRESULT CContainerLayer01::PrepareReadRequest(BENTO_BLOP& rBlop, POMFOO_PROPERTY_REQUEST pRequest, ULONG iRequest,
+													POMFOO_READ_EXTENT aExtents, ULONG cMaxExtents, ULONG& rnExtents)
+{
+	PTOCX_ITEM	pFirst			= NULL;	// the first TOCX_ITEM for this property
+	PTOCX_ITEM	pItem			= NULL;	// dynamic pointer to the current TOCX_ITEM under scrutiny
+	ULONG		nItems			= 0;	// number of TOCX_ITEMs remaining in this blop's slice
+	ULONG		nFragments		= 0;	// number of fragments that hold this property's payload
+	DWORD		dwProperty		= 0;
+	DWORD		dwRequestedType	= DWORD(-1);
+	UINT64		cbPayload		= 0;
+	ULONG		cbConsumed		= 0;
+
+	pRequest->cbRequired = 0;
+
+	// The pBuffer member is optional, but if our caller supplied one then make sure we can write to it.
+	if (pRequest->pBuffer)
+	{
+		if (IsBadWritePointer(pRequest->pBuffer, pRequest->cbBuffer))
+		{
+			return E_POINTER;
+		}
+
+		// Wipe it.
+		ZeroMemory(pRequest->pBuffer, pRequest->cbBuffer);
+	}
+
+	if (0 == (dwProperty = NameToPropertyID(pRequest->pszPropertyName)))
+	{
+		return OMF_E_PROP_NOT_DEFINED;
+	}
+
+	// The pszDataType member is optional. NULL means any data type.
+	if (pRequest->pszDataType)
+	{
+		if (0 == (dwRequestedType = NameToDataTypeID(pRequest->pszDataType)))
+		{
+			return OMF_E_TYPE_NOT_DEFINED;
+		}
+	}
+
+	// Find the first TOCX_ITEM for this property. (Skip reference list IDs)
+	pItem	= &m_aToc[rBlop.iFirstItem];
+	nItems	= rBlop.wTotalItems;
+	while (nItems)
+	{
+		if ((pItem->dwProperty == dwProperty) && (pItem->bStorageMode != SM_REFLISTID))
+		{
+			pFirst = pItem;
+			break;
+		}
+		++pItem;
+		--nItems;
+	}
+
+	if (NULL == pFirst)
+	{
+		return OMF_E_PROP_NOT_FOUND;
+	}
+
+	// Compare stored type with caller's requested data type. Note that (-1) is a wildcard.
+	if (0 == pFirst->dwDataType)
+	{
+		return OMF_E_TYPE_SURPRISE;
+	}
+
+	if ((pFirst->dwDataType != dwRequestedType) && (dwRequestedType != DWORD(-1)))
+	{
+		return OMF_E_TYPE_SURPRISE;
+	}
+
+	// Walk the fragments to get the total payload size.
+	// This uses the same continuation rules as CoreReadStrict().
+	for (;;)
+	{
+		if ((pItem->bStorageMode != SM_IMMEDIATE) &&
+			(pItem->bStorageMode != SM_OFFSET) &&
+			(pItem->bStorageMode != SM_PRELOADED))
+		{
+			return OMF_E_STORAGE_SURPRISE;
+		}
+
+		if ((pItem->bStorageMode == SM_IMMEDIATE) && (pItem->cbLength64 > 4))
+		{
+			return OMF_E_STORAGE_SURPRISE;
+		}
+
+		if ((pItem->bStorageMode == SM_PRELOADED) && (pItem->cbLength64 > sizeof(pItem->aPreloadedBytes)))
+		{
+			return OMF_E_STORAGE_SURPRISE;
+		}
+
+		cbPayload += pItem->cbLength64;
+		nFragments++;
+
+		// Is this the final (or the only) fragment?
+		if (!pItem->fContinued)
+		{
+			break;
+		}
+
+		// We hit the end of the blop (or a different property) before we hit the last fragment.
+		if ((0 == --nItems) || ((++pItem)->dwProperty != dwProperty) || (pItem->dwDataType != pFirst->dwDataType))
+		{
+			return OMF_E_SIZE_SURPRISE;
+		}
+	}
+
+	if (cbPayload > ULONG(-1))
+	{
+		return OMF_E_SIZE_SURPRISE;
+	}
+
+	pRequest->cbRequired = ULONG(cbPayload);
+
+	// Fail if cbPayload is larger than caller's destination buffer, or if pBuffer is NULL.
+	if ((NULL == pRequest->pBuffer) || (cbPayload > pRequest->cbBuffer))
+	{
+		return OMF_E_INSUFFICIENT_BUFFER;
+	}
+
+	// Now walk the fragments again. Copy the immediate and preloaded ones and queue up the others.
+	for (pItem = pFirst; nFragments; nFragments--, pItem++)
+	{
+		PBYTE pDest = &PBYTE(pRequest->pBuffer)[cbConsumed];
+
+		if (pItem->bStorageMode == SM_IMMEDIATE)
+		{
+			CopyMemory(pDest, &pItem->aImmediateBytes, pItem->cbLengthLo);
+		}
+		else if (pItem->bStorageMode == SM_PRELOADED)
+		{
+			CopyMemory(pDest, &pItem->aPreloadedBytes, pItem->cbLengthLo);
+		}
+		else if (pItem->cbLengthLo && (rnExtents >= cMaxExtents))
+		{
+			// No room left in aExtents[]. This only happens when caller asked for the same property twice.
+			HRESULT hrRead = SeekRead(pItem->cbOffset64, pDest, pItem->cbLengthLo);
+			if (FAILED(hrRead))
+			{
+				return hrRead;
+			}
+		}
+		else if (pItem->cbLengthLo)
+		{
+			POMFOO_READ_EXTENT pExtent = &aExtents[rnExtents++];
+			pExtent->cbOffset64	= pItem->cbOffset64;
+			pExtent->pDest		= pDest;
+			pExtent->cbLength	= pItem->cbLengthLo;
+			pExtent->iRequest	= iRequest;
+		}
+
+		cbConsumed += pItem->cbLengthLo;
+	}
+
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for CoreReadProperties().
+//	Sorts the extents by file position, and then reads neighboring extents with one SeekRead() into a scratch buffer
+//	and scatters them from there. Neighbors are coalesced when the gap between them is no larger than RP_MAX_GAP and
+//	the whole burst is no larger than RP_MAX_BURST. An extent that stands alone is read directly into caller's buffer.
+//	If a read fails then every request that owns an extent in that burst gets the error code.
+//	Returns a failure code only if we can't allocate our scratch buffer.
+//*********************************************************************************************************************
+HRESULT CContainerLayer01::ReadCoalescedExtents(POMFOO_READ_EXTENT aExtents, ULONG nExtents,
+																		POMFOO_PROPERTY_REQUEST aRequests)
+{
+	PBYTE	pScratch	= NULL;
+	HRESULT	hr			= S_OK;
+	ULONG	i			= 0;
+
+	// Sort them by file position.
+	// A simple insertion sort is fine here because one blop rarely has more than a few dozen fragments.
+	for (i = 1; i < nExtents; i++)
+	{
+		OMFOO_READ_EXTENT	sExtent	= aExtents[i];
+		ULONG				j		= i;
+
+		while ((j > 0) && (aExtents[j-1].cbOffset64 > sExtent.cbOffset64))
+		{
+			aExtents[j] = aExtents[j-1];
+			j--;
+		}
+		aExtents[j] = sExtent;
+	}
+
+	i = 0;
+	while (i < nExtents)
+	{
+		UINT64	cbStart	= aExtents[i].cbOffset64;
+		UINT64	cbEnd	= cbStart + aExtents[i].cbLength;
+		ULONG	j		= i + 1;
+
+		// Grow the burst for as long as the next extent is close enough.
+		while (j < nExtents)
+		{
+			UINT64 cbNextEnd = aExtents[j].cbOffset64 + aExtents[j].cbLength;
+			if (cbNextEnd < cbEnd)
+			{
+				cbNextEnd = cbEnd;
+			}
+
+			if ((aExtents[j].cbOffset64 > cbEnd + RP_MAX_GAP) || (cbNextEnd - cbStart > RP_MAX_BURST))
+			{
+				break;
+			}
+
+			cbEnd = cbNextEnd;
+			j++;
+		}
+
+		if (j == i + 1)
+		{
+			// This extent stands alone. Read it straight into caller's buffer.
+			HRESULT hrRead = SeekRead(aExtents[i].cbOffset64, aExtents[i].pDest, aExtents[i].cbLength);
+			if (FAILED(hrRead))
+			{
+				aRequests[aExtents[i].iRequest].hr = hrRead;
+			}
+		}
+		else
+		{
+			// Allocate the scratch buffer the first time we need it.
+			if (NULL == pScratch)
+			{
+				pScratch = PBYTE(m_oSmallBlockHeap.Alloc(RP_MAX_BURST));
+				if (NULL == pScratch)
+				{
+					hr = E_OUTOFMEMORY;
+					goto L_Exit;
+				}
+			}
+
+			HRESULT hrRead = SeekRead(cbStart, pScratch, ULONG(cbEnd - cbStart));
+			for (ULONG k = i; k < j; k++)
+			{
+				if (SUCCEEDED(hrRead))
+				{
+					CopyMemory(aExtents[k].pDest,
+								&pScratch[ULONG(aExtents[k].cbOffset64 - cbStart)],
+								aExtents[k].cbLength);
+				}
+				else
+				{
+					aRequests[aExtents[k].iRequest].hr = hrRead;
+				}
+			}
+		}
+
+		i = j;
+	}
+
+L_Exit:
+	CSmallBlockHeap::Free(pScratch);
+	return hr;
+}
+
 //*********************************************************************************************************************
 //	8-bit string read routine.
 //	The data type must be omfi:String, omfi:UniqueName, CM_StdObjID_7BitASCII, or CM_StdObjID_8BitASCII.
@@ -1275,10 +1742,7 @@ HRESULT CContainerLayer01::CoreReadInt32Array(BENTO_BLOP& rBlop, DWORD dwPropert
 		// Byteswap the elements if necessary.
 		if (m_fOmfBigEndian)
 		{
-			for (ULONG i = 0; i < nElementsCalculated; i++)
-			{
-				pBuffer[i] = Endian32(pBuffer[i]);
-			}
+			CArraySwap::Swap32(pBuffer, nElementsCalculated, pBuffer);
 		}
 	}
 
@@ -1357,26 +1821,8 @@ HRESULT CContainerLayer01::CoreReadInt64Array(BENTO_BLOP& rBlop, DWORD dwPropert
 		// Read the entire array directly into caller's buffer.
 		if (SUCCEEDED(hr = CoreReadStrict(rBlop, dwProperty, dwStoredType, cbArrayData, pBuffer)))
 		{
-			PUINT32 pSrc = PUINT32(pBuffer);
-			ULONG i = nElementsCalculated;
-
-			// Byteswap the elements if necessary.
-			if (m_fOmfBigEndian)
-			{
-				while (i > 0)
-				{
-					i--;
-					pBuffer[i] = Endian32(pSrc[i]);
-				}
-			}
-			else
-			{	
-				while (i > 0)
-				{
-					i--;
-					pBuffer[i] = pSrc[i];
-				}
-			}
+			// Promote the elements to 64 bits in place (and byteswap them if necessary).
+			CArraySwap::Widen32(PUINT32(pBuffer), nElementsCalculated, m_fOmfBigEndian, pBuffer);
 		}
 		goto L_Exit;
 	}
@@ -1409,10 +1855,7 @@ HRESULT CContainerLayer01::CoreReadInt64Array(BENTO_BLOP& rBlop, DWORD dwPropert
 			// Byteswap the elements if necessary.
 			if (m_fOmfBigEndian)
 			{
-				for (ULONG i = 0; i < nElementsCalculated; i++)
-				{
-					pBuffer[i] = Endian64(pBuffer[i]);
-				}
+				CArraySwap::Swap64(pBuffer, nElementsCalculated, pBuffer);
 			}
 		}
 		goto L_Exit;
@@ -1561,17 +2004,11 @@ HRESULT CContainerLayer01::CoreReadPosition32Array(BENTO_BLOP& rBlop, DWORD dwPr
 		// Copy each element from our temporary array to the caller's buffer.
 		if (m_fOmfBigEndian)
 		{
-			for (UINT i = 0; i < nElementsReported; i++)
-			{
-				pBuffer[i] = Endian32(aLocalPos32Array.a[i]);
-			}
+			CArraySwap::Swap32(aLocalPos32Array.a, nElementsReported, pBuffer);
 		}
 		else
 		{
-			for (UINT i = 0; i < nElementsReported; i++)
-			{
-				pBuffer[i] = aLocalPos32Array.a[i];
-			}
+			CopyMemory(pBuffer, aLocalPos32Array.a, nElementsReported * sizeof(UINT32));
 		}
 
 		hr = S_OK;
@@ -1721,21 +2158,8 @@ HRESULT CContainerLayer01::CoreReadPosition64Array(BENTO_BLOP& rBlop, DWORD dwPr
 			goto L_Exit;
 		}
 
-		// Copy each element from our temporary array to the caller's buffer.
-		if (m_fOmfBigEndian)
-		{
-			for (UINT i = 0; i < nElementsReported; i++)
-			{
-				pBuffer[i] = Endian32(aLocalPos32Array.a[i]);
-			}
-		}
-		else
-		{
-			for (UINT i = 0; i < nElementsReported; i++)
-			{
-				pBuffer[i] = aLocalPos32Array.a[i];
-			}
-		}
+		// Copy each element from our temporary array to the caller's buffer, and promote it to 64 bits.
+		CArraySwap::Widen32(aLocalPos32Array.a, nElementsReported, m_fOmfBigEndian, pBuffer);
 
 		hr = S_OK;
 		goto L_Exit;
@@ -1822,17 +2246,11 @@ HRESULT CContainerLayer01::CoreReadPosition64Array(BENTO_BLOP& rBlop, DWORD dwPr
 		// Copy each element from our temporary array to the caller's buffer. 
 		if (m_fOmfBigEndian)
 		{
-			for (UINT i = 0; i < nElementsReported; i++)
-			{
-				pBuffer[i] = Endian64(aLocalPos64Array.a[i]);
-			}
+			CArraySwap::Swap64(aLocalPos64Array.a, nElementsReported, pBuffer);
 		}
 		else
 		{
-			for (UINT i = 0; i < nElementsReported; i++)
-			{
-				pBuffer[i] = aLocalPos64Array.a[i];
-			}
+			CopyMemory(pBuffer, aLocalPos64Array.a, nElementsReported * sizeof(UINT64));
 		}
 
 		hr = S_OK;
@@ -1846,6 +2264,136 @@ L_Exit:
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Reads the Bento object IDs in an omfi:ObjRefArray into a caller-supplied buffer of DWORDs.
+//	This has optional call-twice semantics. Make the first call with pBuffer set to NULL to get the required buffer
+//	size (as measured in elements), and then call again with an appropriately sized buffer to retrieve the full array.
+//	Unlike CoreAllocObjRefArray() this never allocates. OMF2 object IDs are read straight into caller's buffer.
+//	OMF1 entries are twice as large, so we read them a few hundred at a time into a local array and gather them.
+//*********************************************************************************************************************
+HRESULT CContainerLayer01::CoreReadObjRefArray(BENTO_BLOP& rBlop, DWORD dwProperty,
+												ULONG nMaxElements, PDWORD pBuffer, PULONG pnActualElements)
+{
+	HRESULT	hr					= S_OK;
+	ULONG	cbArrayData			= 0;
+	DWORD	dwStoredType		= 0;
+	UINT32	cbBuffer			= 0;
+	ULONG	cbEntry				= m_fOmfVer1 ? sizeof(OMF1_OBJREF_ENTRY) : sizeof(OMF2_OBJREF_ENTRY);
+	ULONG	nElementsCalculated	= 0;
+
+	// The pnActualElements pointer is required.
+	if (IsBadWritePointer(pnActualElements, sizeof(ULONG)))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	// Wipe this. Right here. Right now.
+	*pnActualElements = 0;
+
+	// Calculate the byte size of caller's destination buffer.
+	cbBuffer = nMaxElements * sizeof(DWORD);
+
+	// The pBuffer argument is optional, but if our caller supplied one then make sure we can write to it.
+	if (pBuffer)
+	{
+		if (IsBadWritePointer(pBuffer, cbBuffer))
+		{
+			hr = E_POINTER;
+			goto L_Exit;
+		}
+
+		// Wipe all of it. Right here. Right now.
+		ZeroMemory(pBuffer, cbBuffer);
+	}
+
+	// Get array info.
+	if (FAILED(hr = CoreGetArrayInfo(rBlop, dwProperty, &dwStoredType, NULL, &nElementsCalculated, &cbArrayData)))
+	{
+		goto L_Exit;
+	}
+
+	// Make sure this property is omfi:ObjRefArray.
+	if (dwStoredType != m_dwTypeObjRefArray)
+	{
+		hr = OMF_E_TYPE_SURPRISE;
+		goto L_Exit;
+	}
+
+	// Give the element count back to our caller.
+	*pnActualElements = nElementsCalculated;
+
+	// Fail if caller's buffer is too small to hold all of the object IDs, or if there is no destination pointer.
+	if ((nElementsCalculated > nMaxElements) || (pBuffer == NULL))
+	{
+		hr = OMF_E_INSUFFICIENT_BUFFER;
+		goto L_Exit;
+	}
+
+	// Reality check. The payload is a 16-bit element count followed by the entries.
+	if (cbArrayData != sizeof(WORD) + (nElementsCalculated * cbEntry))
+	{
+		BREAK_IF_DEBUG
+		hr = OMFOO_E_ASSERTION_FAILURE;
+		goto L_Exit;
+	}
+
+	if (0 == nElementsCalculated)
+	{
+		goto L_Exit;
+	}
+
+	if (m_fOmfVer1)
+	{
+		// Keep the Bento object ID from each 8-byte OMF1_OBJREF_ENTRY, and byte-swap it if necessary.
+		UINT64	aChunk[512];
+		ULONG	iElement	= 0;
+
+		while (iElement < nElementsCalculated)
+		{
+			ULONG nChunk = nElementsCalculated - iElement;
+			if (nChunk > ELEMS(aChunk))
+			{
+				nChunk = ELEMS(aChunk);
+			}
+
+			if (FAILED(hr = CoreReadPayloadRange(rBlop,
+													dwProperty,
+													dwStoredType,
+													sizeof(WORD) + (iElement * cbEntry),
+													nChunk * cbEntry,
+													aChunk)))
+			{
+				goto L_Exit;
+			}
+
+			CArraySwap::Gather32(aChunk, nChunk, m_fBentoBigEndian, PUINT32(&pBuffer[iElement]));
+			iElement += nChunk;
+		}
+	}
+	else
+	{
+		// Read the object IDs directly into caller's buffer, and byte-swap them if necessary.
+		if (FAILED(hr = CoreReadPayloadRange(rBlop,
+												dwProperty,
+												dwStoredType,
+												sizeof(WORD),
+												nElementsCalculated * cbEntry,
+												pBuffer)))
+		{
+			goto L_Exit;
+		}
+
+		if (m_fBentoBigEndian)
+		{
+			CArraySwap::Swap32(PUINT32(pBuffer), nElementsCalculated, PUINT32(pBuffer));
+		}
+	}
+
+L_Exit:
+	return hr;
+}
+
 //*********************************************************************************************************************
 //	Data type must be omfi:DataValue (OMF2) or omfi:VarLenBytes (OMF1).
 //*********************************************************************************************************************
@@ -2290,7 +2838,7 @@ L_PropExists:
 	if (m_fOmfVer1)
 	{
 		OMF1_OBJREF_ENTRY	v1	= {0};
-		if (pItem->bStorageMode == SM_OFFSET)
+		if ((pItem->bStorageMode == SM_OFFSET) || (pItem->bStorageMode == SM_PRELOADED))
 		{
 			if (pItem->cbLength64 != sizeof(OMF1_OBJREF_ENTRY))
 			{
@@ -2298,7 +2846,17 @@ L_PropExists:
 			}
 			else
 			{
-				hr = SeekRead(pItem->cbOffset64, &v1, sizeof(OMF1_OBJREF_ENTRY));
+				if (pItem->bStorageMode == SM_PRELOADED)
+				{
+					// The entry was read from the file during Load().
+					CopyMemory(&v1, pItem->aPreloadedBytes, sizeof(OMF1_OBJREF_ENTRY));
+					hr = S_OK;
+				}
+				else
+				{
+					hr = SeekRead(pItem->cbOffset64, &v1, sizeof(OMF1_OBJREF_ENTRY));
+				}
+
 				if (SUCCEEDED(hr))
 				{
 					if (m_fBentoBigEndian)
@@ -2376,6 +2934,11 @@ L_PropExists:
 				goto L_Exit;
 			}
 		}
+		else if (pItem->bStorageMode == SM_PRELOADED)
+		{
+			// When the data was stored somewhere in the file but we already read it during Load() ...
+			dwObjRef = *PDWORD(pItem->aPreloadedBytes);
+		}
 		else
 		{
 			// When we can't deal with the data because we don't know how it is stored ...
@@ -2940,6 +3503,42 @@ HRESULT CContainerLayer01::CoreCreateStreamOnDataValue(BENTO_BLOP& rBlop, DWORD
 			}
 			else
 			{
+				// If the payload is small enough then map a read-only view of it and wrap that with CStreamOnRawBytes.
+				// Nothing gets copied until caller calls Read(), and then it comes straight out of the file cache.
+				// If we can't map it for any reason then fall through to CStreamOnReadableFile.
+				if ((sDataValue.cbLength > 0) && (sDataValue.cbLength <= CSharedBytes::SHARED_VIEW_MAX))
+				{
+					CSharedBytes* pShared = NULL;
+					if (SUCCEEDED(CSharedBytes::CreateOnFileView(m_pwzFullPath,
+																	sDataValue.cbOffset,
+																		sDataValue.cbLength,
+																			&pShared)))
+					{
+						hr = E_OUTOFMEMORY;
+						CStreamOnRawBytes* pStream = new CStreamOnRawBytes(punkOwner);
+						if (pStream)
+						{
+							if (SUCCEEDED(hr = pStream->InitializeShared(pShared->GetBytes(),
+																			pShared->GetLength(),
+																				pShared)))
+							{
+								hr = pStream->QueryInterface(riid, ppvOut);
+							}
+							pStream->Release();
+							pStream = NULL;
+						}
+
+						// The stream holds its own reference on the view.
+						pShared->Release();
+						pShared = NULL;
+
+						if (SUCCEEDED(hr))
+						{
+							goto L_Exit;
+						}
+					}
+				}
+
 				// Use CStreamOnReadableFile to implement the IStream.
 				CStreamOnReadableFile* pStream = new CStreamOnReadableFile(punkOwner);
 				if (pStream)
@@ -2965,6 +3564,7 @@ HRESULT CContainerLayer01::CoreCreateStreamOnDataValue(BENTO_BLOP& rBlop, DWORD
 		}
 	}
 
+L_Exit:
 	return hr;
 }
 
@@ -3414,7 +4014,7 @@ HRESULT CContainerLayer01::CoreAllocMobIndexArray(BENTO_BLOP& rBlop, DWORD dwPro
 	}
 
 	// Allocate memory.
-	pArray	= POMFOO_MOB_INDEX_ARRAY(MemAlloc(cbMemAlloc));
+	pArray	= POMFOO_MOB_INDEX_ARRAY(m_oSmallBlockHeap.Alloc(cbMemAlloc));
 	if (NULL == pArray)
 	{
 		BREAK_IF_DEBUG
@@ -3432,27 +4032,21 @@ HRESULT CContainerLayer01::CoreAllocMobIndexArray(BENTO_BLOP& rBlop, DWORD dwPro
 		goto L_CleanupExit;
 	}
 
-	// Byte-swap each Bento object ID if necessary.
-	if (m_fBentoBigEndian)
+	// Every member of an OMF1_MOB_INDEX_ENTRY is a DWORD. The Bento object ID is in Bento byte order and the others
+	// are in OMF byte order. So if OMF is big-endian we byte-swap the whole array as if it were one flat array of
+	// DWORDs. Then if the two byte orders are different we toggle the object IDs. That's usually not needed.
+	if (m_fOmfBigEndian)
 	{
-		POMF1_MOB_INDEX_ENTRY pEntry = pArray->a;
-		for (ULONG i = 0; i < nElements; i++)
-		{
-			pEntry->dwObject = Endian32(pEntry->dwObject);
-			++pEntry;
-		}
+		SIZE_T nDwords = nElements * (sizeof(OMF1_MOB_INDEX_ENTRY) / sizeof(DWORD));
+		CArraySwap::Swap32(PUINT32(pArray->a), nDwords, PUINT32(pArray->a));
 	}
 
-	// Byte-swap OMF values if necessary.
-	if (m_fOmfBigEndian)
+	if ((!m_fBentoBigEndian) != (!m_fOmfBigEndian))
 	{
 		POMF1_MOB_INDEX_ENTRY pEntry = pArray->a;
 		for (ULONG i = 0; i < nElements; i++)
 		{
-			pEntry->dwKey			= Endian32(pEntry->dwKey);
-			pEntry->mobID.dwPrefix	= Endian32(pEntry->mobID.dwPrefix);
-			pEntry->mobID.dwMajor	= Endian32(pEntry->mobID.dwMajor);
-			pEntry->mobID.dwMinor	= Endian32(pEntry->mobID.dwMinor);
+			pEntry->dwObject = Endian32(pEntry->dwObject);
 			++pEntry;
 		}
 	}
@@ -3471,7 +4065,7 @@ L_CleanupExit:
 	}
 	else
 	{
-		MemFree(pArray);
+		CSmallBlockHeap::Free(pArray);
 	}
 
 	return hr;
@@ -3492,7 +4086,7 @@ HRESULT CContainerLayer01::CoreFreeMobIndexArray(POMFOO_MOB_INDEX_ARRAY* ppArray
 	if (pArray == NULL)
 		return S_FALSE;
 
-	if (MemFree(pArray))
+	if (CSmallBlockHeap::Free(pArray))
 	{
 		// Decrement the counter (used for debugging only).
 		InterlockedDecrement(PLONG(&m_nMobIndexArrays));
@@ -3559,7 +4153,7 @@ HRESULT CContainerLayer01::CoreAllocObjRefArray(BENTO_BLOP& rBlop, DWORD dwPrope
 		}
 		
 		// Allocate memory.
-		pArray	= POMFOO_OBJREF_ARRAY(MemAlloc(cbMemAlloc));
+		pArray	= POMFOO_OBJREF_ARRAY(m_oSmallBlockHeap.Alloc(cbMemAlloc));
 		if (NULL == pArray)
 		{
 			BREAK_IF_DEBUG
@@ -3577,28 +4171,11 @@ HRESULT CContainerLayer01::CoreAllocObjRefArray(BENTO_BLOP& rBlop, DWORD dwPrope
 			goto L_CleanupExit;
 		}
 
+		// Keep the Bento object ID from each 8-byte OMF1_OBJREF_ENTRY, and byte-swap it if necessary.
+		// The destination array begins at the same address as the source array, so this happens in place.
 		if (nElements > 0)
 		{
-			POMF1_OBJREF_ENTRY	pSrc	= pTempOmf1->a;
-			PDWORD				pDst	= pArray->a;
-			SIZE_T				nLoop	= nElements;
-
-			if (m_fBentoBigEndian)
-			{
-				while (nLoop--)
-				{
-					*pDst++ = Endian32(pSrc->dwObject);
-					++pSrc;
-				}
-			}
-			else
-			{
-				while (nLoop--)
-				{
-					*pDst++ = pSrc->dwObject;
-					++pSrc;
-				}
-			}
+			CArraySwap::Gather32(PUINT64(pTempOmf1->a), nElements, m_fBentoBigEndian, PUINT32(pArray->a));
 		}
 
 		hr = S_OK;
@@ -3620,7 +4197,7 @@ HRESULT CContainerLayer01::CoreAllocObjRefArray(BENTO_BLOP& rBlop, DWORD dwPrope
 		}
 
 		// Allocate memory.
-		pArray	= POMFOO_OBJREF_ARRAY(MemAlloc(cbMemAlloc));
+		pArray	= POMFOO_OBJREF_ARRAY(m_oSmallBlockHeap.Alloc(cbMemAlloc));
 		if (NULL == pArray)
 		{
 			BREAK_IF_DEBUG
@@ -3641,10 +4218,7 @@ HRESULT CContainerLayer01::CoreAllocObjRefArray(BENTO_BLOP& rBlop, DWORD dwPrope
 		// Byte-swap each Bento object ID if necessary.
 		if (m_fBentoBigEndian)
 		{
-			for (ULONG i = 0; i < nElements; i++)
-			{
-				pArray->a[i] = Endian32(pArray->a[i]);
-			}
+			CArraySwap::Swap32(PUINT32(pArray->a), nElements, PUINT32(pArray->a));
 		}
 	}
 
@@ -3662,7 +4236,7 @@ L_CleanupExit:
 	}
 	else
 	{
-		MemFree(pArray);
+		CSmallBlockHeap::Free(pArray);
 	}
 
 	return hr;
@@ -3683,7 +4257,7 @@ HRESULT CContainerLayer01::CoreFreeObjRefArray(POMFOO_OBJREF_ARRAY* ppArray)
 	if (pArray == NULL)
 		return S_FALSE;
 
-	if (MemFree(pArray))
+	if (CSmallBlockHeap::Free(pArray))
 	{
 		// Decrement the counter.
 		InterlockedDecrement(PLONG(&m_nObjRefArrays));
@@ -3740,7 +4314,7 @@ HRESULT CContainerLayer01::CoreAllocPositionArray(BENTO_BLOP& rBlop, DWORD dwPro
 		cbMemAlloc = OFFSETOF(OMFOO_POSITION_ARRAY,a) + (nElements * sizeof(UINT64));
 
 		// Allocate memory.
-		pArray	= POMFOO_POSITION_ARRAY(MemAlloc(cbMemAlloc));
+		pArray	= POMFOO_POSITION_ARRAY(m_oSmallBlockHeap.Alloc(cbMemAlloc));
 		if (NULL == pArray)
 		{
 			BREAK_IF_DEBUG
@@ -3758,25 +4332,8 @@ HRESULT CContainerLayer01::CoreAllocPositionArray(BENTO_BLOP& rBlop, DWORD dwPro
 			goto L_CleanupExit;
 		}
 
-		// Byte-swap each offset if necessary.
-		if (m_fOmfBigEndian)
-		{
-			ULONG i = nElements;
-			while (i > 0)
-			{
-				i--;
-				pArray->a[i] = Endian32(pPos32->a[i]);
-			}
-		}
-		else
-		{
-			ULONG i = nElements;
-			while (i > 0)
-			{
-				i--;
-				pArray->a[i] = pPos32->a[i];
-			}
-		}
+		// Promote each offset to 64 bits in place (and byte-swap it if necessary).
+		CArraySwap::Widen32(pPos32->a, nElements, m_fOmfBigEndian, pArray->a);
 
 		goto L_CleanupExit;
 	}
@@ -3798,7 +4355,7 @@ HRESULT CContainerLayer01::CoreAllocPositionArray(BENTO_BLOP& rBlop, DWORD dwPro
 		}
 
 		// Allocate memory.
-		pArray	= POMFOO_POSITION_ARRAY(MemAlloc(cbMemAlloc));
+		pArray	= POMFOO_POSITION_ARRAY(m_oSmallBlockHeap.Alloc(cbMemAlloc));
 		if (NULL == pArray)
 		{
 			BREAK_IF_DEBUG
@@ -3819,10 +4376,7 @@ HRESULT CContainerLayer01::CoreAllocPositionArray(BENTO_BLOP& rBlop, DWORD dwPro
 		// Byte-swap each offset if necessary.
 		if (m_fOmfBigEndian)
 		{
-			for (ULONG i = 0; i < nElements; i++)
-			{
-				pArray->a[i] = Endian64(pArray->a[i]);
-			}
+			CArraySwap::Swap64(pArray->a, nElements, pArray->a);
 		}
 
 		goto L_CleanupExit;
@@ -3844,7 +4398,7 @@ L_CleanupExit:
 	}
 	else
 	{
-		MemFree(pArray);
+		CSmallBlockHeap::Free(pArray);
 	}
 
 	return hr;
@@ -3865,7 +4419,7 @@ HRESULT CContainerLayer01::CoreFreePositionArray(POMFOO_POSITION_ARRAY* ppArray)
 	if (pArray == NULL)
 		return S_FALSE;
 
-	if (MemFree(pArray))
+	if (CSmallBlockHeap::Free(pArray))
 	{
 		// Decrement the counter.
 		InterlockedDecrement(PLONG(&m_nPositionArrays));
@@ -3991,7 +4545,7 @@ L_GotSize:
 
 	// Allocate memory.
 	cbAlloc	= OFFSETOF(OMFOO_REFERENCE_LIST,a) + cbExpected;
-	pList	= POMFOO_REFERENCE_LIST(MemAlloc(cbAlloc));
+	pList	= POMFOO_REFERENCE_LIST(m_oSmallBlockHeap.Alloc(cbAlloc));
 
 	if (NULL == pList)
 	{
@@ -4052,7 +4606,7 @@ L_CleanupExit:
 	}
 	else
 	{
-		MemFree(pList);
+		CSmallBlockHeap::Free(pList);
 	}
 	return hr;
 */
@@ -4074,7 +4628,7 @@ HRESULT CContainerLayer01::CoreFreeReferenceList(POMFOO_REFERENCE_LIST* ppList)
 	if (pList == NULL)
 		return S_FALSE;
 
-	if (MemFree(pList))
+	if (CSmallBlockHeap::Free(pList))
 	{
 		// Decrement the counter (used for debugging only).
 		InterlockedDecrement(PLONG(&m_nReferenceLists));
@@ -4089,7 +4643,7 @@ HRESULT CContainerLayer01::CoreFreeReferenceList(POMFOO_REFERENCE_LIST* ppList)
 //*********************************************************************************************************************
 BOOL CContainerLayer01::IsBadMobIndexArray(POMFOO_MOB_INDEX_ARRAY pArray)
 {
-	if (MemValidate(pArray))
+	if (m_oSmallBlockHeap.Validate(pArray))
 	{
 		SIZE_T cb = OFFSETOF(OMFOO_MOB_INDEX_ARRAY, a);
 		if (!IsBadReadPointer(pArray, cb))
@@ -4110,7 +4664,7 @@ BOOL CContainerLayer01::IsBadMobIndexArray(POMFOO_MOB_INDEX_ARRAY pArray)
 //*********************************************************************************************************************
 BOOL CContainerLayer01::IsBadObjRefArray(POMFOO_OBJREF_ARRAY pArray)
 {
-	if (MemValidate(pArray))
+	if (m_oSmallBlockHeap.Validate(pArray))
 	{
 		SIZE_T cb = OFFSETOF(OMFOO_OBJREF_ARRAY, a);
 		if (!IsBadReadPointer(pArray, cb))
@@ -4131,7 +4685,7 @@ BOOL CContainerLayer01::IsBadObjRefArray(POMFOO_OBJREF_ARRAY pArray)
 //*********************************************************************************************************************
 BOOL CContainerLayer01::IsBadPositionArray(POMFOO_POSITION_ARRAY pArray)
 {
-	if (MemValidate(pArray))
+	if (m_oSmallBlockHeap.Validate(pArray))
 	{
 		SIZE_T cb = OFFSETOF(OMFOO_POSITION_ARRAY, a);
 		if (!IsBadReadPointer(pArray, cb))
@@ -4152,7 +4706,7 @@ BOOL CContainerLayer01::IsBadPositionArray(POMFOO_POSITION_ARRAY pArray)
 //*********************************************************************************************************************
 BOOL CContainerLayer01::IsBadReferenceList(POMFOO_REFERENCE_LIST pList)
 {
-	if (MemValidate(pList))
+	if (m_oSmallBlockHeap.Validate(pList))
 	{
 		SIZE_T cb = OFFSETOF(OMFOO_REFERENCE_LIST, a);
 		if (!IsBadReadPointer(pList, cb))
@@ -7,6 +7,7 @@
 //*********************************************************************************************************************
 #pragma once
 #include "ContainerLayer00.h"
+#include "SmallBlockHeap.h"
 
 #pragma pack(push, 1)		// Explicitly align the members of these structures to byte boundaries!
 
@@ -53,6 +54,15 @@ typedef struct {
 } OMFOO_REFERENCE_LIST, *POMFOO_REFERENCE_LIST;
 #pragma pack(pop)
 
+//	Internal structure used by CoreReadProperties().
+//	Each one represents one SM_OFFSET fragment that needs to be copied from the file into caller's buffer.
+typedef struct {
+	UINT64	cbOffset64;			// physical file position where the fragment begins
+	PBYTE	pDest;				// where the fragment goes in caller's buffer
+	ULONG	cbLength;			// size of the fragment, as measured in bytes
+	ULONG	iRequest;			// index of the OMFOO_PROPERTY_REQUEST that owns this fragment
+} OMFOO_READ_EXTENT, *POMFOO_READ_EXTENT;
+
 //*********************************************************************************************************************
 //
 //*********************************************************************************************************************
@@ -66,8 +76,11 @@ public:
 	STDMETHODIMP	CoreIsPropertyPresent(BENTO_BLOP& rBlop, DWORD dwProperty);
 	STDMETHODIMP	CoreGetPropInfo(BENTO_BLOP& rBlop, DWORD dwProperty, PDWORD pdwStoredType, PDWORD pdwRefList, PULONG pnFragments, PUINT64 pcbPayload);
 	STDMETHODIMP	CoreReadStrict(BENTO_BLOP& rBlop, DWORD dwProperty, DWORD dwRequestedType, ULONG cbBuffer, PVOID pBuffer);
+	STDMETHODIMP	CoreReadPayloadRange(BENTO_BLOP& rBlop, DWORD dwProperty, DWORD dwRequestedType,
+														ULONG cbSkip, ULONG cbBuffer, PVOID pBuffer);
 
 	STDMETHODIMP	CoreReadRawBytes(BENTO_BLOP& rBlop, DWORD dwProperty, ULONG cbBuffer, PVOID pBuffer, PULONG pcbRequired);
+	STDMETHODIMP	CoreReadProperties(BENTO_BLOP& rBlop, ULONG nRequests, POMFOO_PROPERTY_REQUEST aRequests);
 	STDMETHODIMP	CoreReadStringA(BENTO_BLOP& rBlop, DWORD dwProperty, ULONG cchBuffer, PCHAR pBuffer, PULONG pcchRequired);
 	STDMETHODIMP	CoreReadStringW(BENTO_BLOP& rBlop, DWORD dwProperty, ULONG cchBuffer, PWCHAR pBuffer, PULONG pcchRequired);
 
@@ -92,6 +105,7 @@ public:
 	STDMETHODIMP	CoreReadInt64Array(BENTO_BLOP& rBlop, DWORD dwProperty, ULONG nMaxElements, PUINT64 pDest, PULONG pnActualElements);
 	STDMETHODIMP	CoreReadPosition32Array(BENTO_BLOP& rBlop, DWORD dwProperty, ULONG nMaxElements, PUINT32 pDest, PULONG pnActualElements);
 	STDMETHODIMP	CoreReadPosition64Array(BENTO_BLOP& rBlop, DWORD dwProperty, ULONG nMaxElements, PUINT64 pDest, PULONG pnActualElements);
+	STDMETHODIMP	CoreReadObjRefArray(BENTO_BLOP& rBlop, DWORD dwProperty, ULONG nMaxElements, PDWORD pDest, PULONG pnActualElements);
 
 	STDMETHODIMP	CoreReadGuid(BENTO_BLOP& rBlop, DWORD dwProperty, LPGUID pGuid);
 	STDMETHODIMP	CoreReadFirstMobID(BENTO_BLOP& rBlop, POMF_MOB_ID pMobID);
@@ -159,9 +173,27 @@ public:
 													LPCSTR pszAttributeName, BOOL fRecurse,
 														ULONG cchBuffer, LPWSTR pBuffer, PULONG pcchRequired);
 
+private:
+	// Tuning for CoreReadProperties().
+	enum {
+		RP_MAX_REQUESTS	= 1024,		// maximum number of OMFOO_PROPERTY_REQUESTs per call
+		RP_MAX_GAP		= 4096,		// read through gaps up to this size rather than issuing another SeekRead()
+		RP_MAX_BURST	= 65536,	// never coalesce extents into a single SeekRead() larger than this
+	};
+
+	// Private helpers for CoreReadProperties().
+	HRESULT	PrepareReadRequest(BENTO_BLOP& rBlop, POMFOO_PROPERTY_REQUEST pRequest, ULONG iRequest,
+													POMFOO_READ_EXTENT aExtents, ULONG cMaxExtents, ULONG& rnExtents);
+	HRESULT	ReadCoalescedExtents(POMFOO_READ_EXTENT aExtents, ULONG nExtents, POMFOO_PROPERTY_REQUEST aRequests);
+
 protected:
 	ULONG	m_nMobIndexArrays;		// number of unmatched calls to AllocMobIndexArray() and FreeMobIndexArray()
 	ULONG	m_nObjRefArrays;		// number of unmatched calls to AllocObjRefArray() and FreeObjRefArray()
 	ULONG	m_nPositionArrays;		// number of unmatched calls to AllocPositionArray() and FreePositionArray()
 	ULONG	m_nReferenceLists;		// number of unmatched calls to CoreAllocReferenceList() and CoreFreeReferenceList()
+
+public:
+	// Our private slab allocator. The arrays above, our COmfObject wrappers, and our iterators all come from here.
+	// It also keeps the leak count for this container. See CSmallBlockHeap::GetOutstandingBlocks().
+	CSmallBlockHeap	m_oSmallBlockHeap;
 };
@@ -161,6 +161,11 @@ HRESULT CContainerLayer05::ObjReadPosition64Array(DWORD dwObject, DWORD dwProper
 	return CoreReadPosition64Array(GetBlop(dwObject), dwProperty, nMaxElements, pDest, pnActualElements);
 }
 
+HRESULT CContainerLayer05::ObjReadObjRefArray(DWORD dwObject, DWORD dwProperty, ULONG nMaxElements, PDWORD pDest, PULONG pnActualElements)
+{
+	return CoreReadObjRefArray(GetBlop(dwObject), dwProperty, nMaxElements, pDest, pnActualElements);
+}
+
 HRESULT CContainerLayer05::ObjQueryDataValue(DWORD dwObject, DWORD dwProperty, POMF_DATA_VALUE pDataValue)
 {
 	return CoreQueryDataValue(GetBlop(dwObject), dwProperty, pDataValue);
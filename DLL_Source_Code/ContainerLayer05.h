@@ -41,6 +41,7 @@ public:
 	STDMETHODIMP	ObjReadInt64Array(DWORD dwObject, DWORD dwProperty, ULONG nMaxElements, PUINT64 pDest, PULONG pnActualElements);
 	STDMETHODIMP	ObjReadPosition32Array(DWORD dwObject, DWORD dwProperty, ULONG nMaxElements, PUINT32 pDest, PULONG pnActualElements);
 	STDMETHODIMP	ObjReadPosition64Array(DWORD dwObject, DWORD dwProperty, ULONG nMaxElements, PUINT64 pDest, PULONG pnActualElements);
+	STDMETHODIMP	ObjReadObjRefArray(DWORD dwObject, DWORD dwProperty, ULONG nMaxElements, PDWORD pDest, PULONG pnActualElements);
 
 	STDMETHODIMP	ObjReadGuid(DWORD dwObject, DWORD dwProperty, LPGUID pGuid);
 	STDMETHODIMP	ObjReadFirstMobID(DWORD dwObject, POMF_MOB_ID pMobID);
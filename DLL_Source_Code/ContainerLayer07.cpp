@@ -603,6 +603,17 @@ DWORD CContainerLayer07::BlopFindSmobFromMdes_SearchLoop3(BENTO_BLOP& rMDES)
 				}
 			}
 		}
+		else if ((pItem->dwProperty == m_dwPropMediaDesc) &&
+			(pItem->bStorageMode == SM_PRELOADED) &&
+			(pItem->cbLength64 == 8))
+		{
+			// Same as above, but the OMF1_OBJREF_ENTRY was already read during Load().
+			if (*PDWORD(pItem->aPreloadedBytes) == dwCompare)
+			{
+				dwSMOB = pItem->dwObject;
+				break;
+			}
+		}
 	} while (++pItem < pEnd);
 
 	return dwSMOB;
@@ -1083,22 +1083,14 @@ HRESULT CContainerLayer10::DetectOverlappers(void)
 
 					if ((cbThisDataStart == cbThatDataStart)&&(cbThisDataEnd == cbThatDataEnd))
 					{
-						//pCurMdat->cClones++;
-						//pOther->cClones++;
+						// Only count it for this MDAT. The outer loop will get around to the other one.
+						pCurMdat->cClones++;
 						m_cMdatClones++;
 						continue;
 					}
 
 					BREAK_IF_DEBUG
 
-					if ((cbThatDataStart == cbThisDataStart) && (cbThatDataEnd == cbThisDataEnd))
-					{
-						pCurMdat->cClones++;
-						pOther->cClones++;
-						m_cMdatClones++;
-						continue;
-					}
-
 					if ((cbThatDataStart >= cbThisDataStart) && (cbThatDataStart < cbThisDataEnd))
 					{
 						if (cbThatDataEnd <= cbThisDataEnd)
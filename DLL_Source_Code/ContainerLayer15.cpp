@@ -9,12 +9,30 @@
 #include "Omfoo_Alpha_Header.h"
 #include "ContainerLayer15.h"
 #include "StreamOnReadableFile.h"
+#include "StreamOnSplicedHeader.h"
+#include "ExtractDigest.h"
 #include "DllMain.h"
 #include <shlwapi.h>
+#include <winioctl.h>
 
 #include "MiscStatic.h"
 using namespace NsMiscStatic;
 
+// These live in the Windows 10 SDK. Define them ourselves if we're building with an older SDK.
+#ifndef FILE_SUPPORTS_BLOCK_REFCOUNTING
+#define FILE_SUPPORTS_BLOCK_REFCOUNTING	0x08000000
+#endif
+
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE	CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
+typedef struct _DUPLICATE_EXTENTS_DATA {
+	HANDLE			FileHandle;
+	LARGE_INTEGER	SourceFileOffset;
+	LARGE_INTEGER	TargetFileOffset;
+	LARGE_INTEGER	ByteCount;
+} DUPLICATE_EXTENTS_DATA, *PDUPLICATE_EXTENTS_DATA;
+#endif
+
 //*********************************************************************************************************************
 //	Constructor
 //	WARNING: This class is not meant to be instantiated on the stack.
@@ -189,6 +207,28 @@ HRESULT CContainerLayer15::CreateStreamOnMdatData(__in ULONG idx, __in REFIID ri
 	}
 }
 
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMediaData class.
+//	It finds the nth entry in m_aMdatTable[] and passes its reference to the like-named counterpart.
+//	For more into see the non-overloaded implementation.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::CreateStreamOnMdatRange(__in ULONG idx,
+														__in UINT64 cbRangeOffset,
+															__in UINT64 cbRangeLength,
+																__in REFIID riid,
+																	__out PVOID *ppvOut)
+{
+	if (m_aMdatTable && (idx < m_cMDATs))
+	{
+		return CreateStreamOnMdatRange(m_aMdatTable[idx], cbRangeOffset, cbRangeLength, riid, ppvOut);
+	}
+	else
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+}
+
 //*********************************************************************************************************************
 //	Callback/helper routine for our COmfMediaData class.
 //	Creates a DirectShow source filter on the subclass's payload that can be used with the DirectShow API.
@@ -252,6 +292,56 @@ HRESULT CContainerLayer15::ExtractMdatDataToFile(__in ULONG idx,
 	}
 }
 
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMediaData class.
+//	It finds the nth entry in m_aMdatTable[] and passes its reference to the like-named counterpart.
+//	For more into see the non-overloaded implementation.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::ExtractMdatRangeToFile(__in ULONG idx,
+													__in UINT64 cbRangeOffset,
+														__in UINT64 cbRangeLength,
+															__in PCWSTR pwzDestFullPath,
+																__in_opt IOmfooExtractCallback *pCallback,
+																	__in_opt ULONG nPagesPerCallback,
+																		__in BOOL fOverwrite)
+{
+	if (m_aMdatTable && (idx < m_cMDATs))
+	{
+		return ExtractMdatRangeToFile(m_aMdatTable[idx],
+										cbRangeOffset,
+										cbRangeLength,
+										pwzDestFullPath,
+										pCallback,
+										nPagesPerCallback,
+										fOverwrite);
+	}
+	else
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMediaData class.
+//	It finds the nth entry in m_aMdatTable[] and passes its reference to the like-named counterpart.
+//	For more into see the non-overloaded implementation.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::ExtractMdatDataToSink(__in ULONG idx,
+													__in IOmfooExtractSink *pSink,
+														__in_opt ULONG cbChunkSize)
+{
+	if (m_aMdatTable && (idx < m_cMDATs))
+	{
+		return ExtractMdatDataToSink(m_aMdatTable[idx], pSink, cbChunkSize);
+	}
+	else
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+}
+
 //*********************************************************************************************************************
 //	Retrieves the physical file position and length for MDAT's embedded payload.
 //*********************************************************************************************************************
@@ -308,12 +398,95 @@ HRESULT CContainerLayer15::QueryMdatRawFileParams(__in MDAT_CACHE_ENTRY& rCE,
 //	specified by riid. This implementation exposes IStream and ISequentialStream.
 //*********************************************************************************************************************
 HRESULT CContainerLayer15::CreateStreamOnMdatData(__in MDAT_CACHE_ENTRY& rCE, __in REFIID riid, __out PVOID *ppvOut)
+{
+	return CreateStreamOnMdatRange(rCE, 0, rCE.cbPayloadLength, riid, ppvOut);
+}
+
+//*********************************************************************************************************************
+//	Same as above, except that the stream only covers part of the media data. The range begins cbRangeOffset bytes
+//	into the payload and is cbRangeLength bytes long. Stream position zero is the first byte of the range, and reads
+//	stop at the end of the range, so caller never touches the rest of the payload.
+//
+//	If the payload has a broken FORM ckSize (see GetMdatPatchChunkSize()) and caller's range includes it, then we read
+//	the first few bytes of the range into memory, patch them, and splice them in front of a stream on the rest of the
+//	range. Caller sees the same bytes that ExtractMdatRangeToFile() would have written, but nothing else is copied.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::CreateStreamOnMdatRange(__in MDAT_CACHE_ENTRY& rCE,
+														__in UINT64 cbRangeOffset,
+															__in UINT64 cbRangeLength,
+																__in REFIID riid,
+																	__out PVOID *ppvOut)
+{
+	HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+	if (SUCCEEDED(hr))
+	{
+		// The range must lie entirely inside the payload.
+		if ((cbRangeOffset > rCE.cbPayloadLength) || (cbRangeLength > rCE.cbPayloadLength - cbRangeOffset))
+		{
+			return E_INVALIDARG;
+		}
+
+		UINT32	cbPatchChunkSize	= (cbRangeOffset < 8) && (cbRangeLength) ? GetMdatPatchChunkSize(rCE) : 0;
+		BYTE	aHeader[8]			= {0};
+		ULONG	cbHeader			= 0;
+
+		// If we need to patch the ckSize then our header is everything in caller's range up to the end of the ckSize.
+		if (cbPatchChunkSize)
+		{
+			cbHeader = ULONG(8 - cbRangeOffset);
+			if (cbHeader > cbRangeLength)
+			{
+				cbHeader = ULONG(cbRangeLength);
+			}
+
+			if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbRangeOffset, aHeader, cbHeader)))
+			{
+				return hr;
+			}
+
+			PatchMdatChunkSize(cbPatchChunkSize, cbRangeOffset, aHeader, cbHeader);
+		}
+
+		hr = CreateSplicedStreamOnMdatRange(rCE,
+											aHeader,
+											cbHeader,
+											cbRangeOffset + cbHeader,
+											cbRangeLength - cbHeader,
+											0,
+											riid,
+											ppvOut);
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Creates a read-only stream on a range of the media data with caller's header spliced in front of it, and then
+//	queries it for the interface specified by riid. Stream position zero is the first byte of caller's header, and the
+//	range begins right after it. The header is copied (it can't be larger than 256 bytes) but the range is read directly
+//	from the OMF file. The range is followed by cbPadding zero bytes (no more than 16). If cbHeader and cbPadding are
+//	both zero then this is exactly the same as CreateStreamOnMdatRange().
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::CreateSplicedStreamOnMdatRange(__in MDAT_CACHE_ENTRY& rCE,
+																__in_opt LPCVOID pHeader,
+																	__in ULONG cbHeader,
+																		__in UINT64 cbRangeOffset,
+																			__in UINT64 cbRangeLength,
+																				__in ULONG cbPadding,
+																					__in REFIID riid,
+																						__out PVOID *ppvOut)
 {
 	HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
 	if (SUCCEEDED(hr))
 	{
-		UINT64		cbOffset	= rCE.cbPayloadOffset;
-		UINT64		cbLength	= rCE.cbPayloadLength;
+		// The range must lie entirely inside the payload.
+		if ((cbRangeOffset > rCE.cbPayloadLength) || (cbRangeLength > rCE.cbPayloadLength - cbRangeOffset))
+		{
+			return E_INVALIDARG;
+		}
+
+		UINT64		cbOffset	= rCE.cbPayloadOffset + cbRangeOffset;
+		UINT64		cbLength	= cbRangeLength;
 		LPUNKNOWN	pOwner		= LPUNKNOWN(static_cast<INonDelegatingUnknown*>(this));
 
 		hr = E_OUTOFMEMORY;
@@ -326,7 +499,25 @@ HRESULT CContainerLayer15::CreateStreamOnMdatData(__in MDAT_CACHE_ENTRY& rCE, __
 			{
 				if (SUCCEEDED(hr = pStream->SetRegion(cbOffset, cbLength)))
 				{
-					hr = pStream->QueryInterface(riid, ppvOut);
+					if ((0 == cbHeader) && (0 == cbPadding))
+					{
+						hr = pStream->QueryInterface(riid, ppvOut);
+					}
+					else
+					{
+						IStream* pBody = NULL;
+						if (SUCCEEDED(hr = pStream->QueryInterface(IID_IStream, (PVOID*)&pBody)))
+						{
+							hr = CStreamOnSplicedHeader::Create(pOwner,
+																pHeader,
+																cbHeader,
+																pBody,
+																cbPadding,
+																riid,
+																ppvOut);
+							pBody->Release();
+						}
+					}
 				}
 			}
 			pStream->Release();
@@ -587,43 +778,106 @@ HRESULT CContainerLayer15::CreateFileNameForMdat(__in MDAT_CACHE_ENTRY& rCE,
 	return CallTwiceStringHandlerW(hr, wzResult, cchBuffer, pBuffer, pcchRequired);	
 }
 
+//*********************************************************************************************************************
+//	Part 1 (of 2) of the IFF ckSize kludge.
+//	Some AIFC and WAVE payloads (based on the Electronic Arts 'EA IFF 85' standard) have an invalid ckSize value.
+//	The invalid ckSize erroneously represents the size of the entire OMF file minus eight.
+//	(It should represent the size of the embedded WAV or AIF file minus eight.)
+//	These files probably began life as standard *.aif or *.wav files that were later transformed into *.omf files
+//	by appending OMF data to then end. This flaw exists in OMF1 and OMF2 files, and I suspect that they were created
+//	with OMF Toolkit Versions prior to v2.1.2 because v2.1.2 introduced a new method called omfsAppendRawFile()
+//	that automated this transformation.
+//
+//	Returns the corrected ckSize exactly as it should appear in the file (big-endian for AIFC, little-endian for WAVE),
+//	or zero if this payload doesn't need patching. We always patch it, because it costs nothing to write a ckSize that
+//	was already correct.
+//*********************************************************************************************************************
+UINT32 CContainerLayer15::GetMdatPatchChunkSize(__in MDAT_CACHE_ENTRY& rCE)
+{
+	if ((rCE.cbPayloadLength < 8) || (rCE.cbPayloadLength >= 0xFFFFFFFF))
+	{
+		return 0;
+	}
+
+	if (rCE.oMDAT.dwFourCC == FCC('AIFC'))
+	{
+		return Endian32(UINT32(rCE.cbPayloadLength-8));
+	}
+
+	if (rCE.oMDAT.dwFourCC == FCC('WAVE'))
+	{
+		return UINT32(rCE.cbPayloadLength-8);
+	}
+
+	return 0;
+}
+
+//*********************************************************************************************************************
+//	Part 2 (of 2) of the IFF ckSize kludge.
+//	Overlays the corrected ckSize onto caller's buffer. The ckSize lives at bytes 4 through 7 of the payload, and
+//	cbPayloadPos is the payload position of pBuffer[0]. The buffer might only cover part of the ckSize (or none of it)
+//	so we patch it one byte at a time. The loop index is a byte offset into the payload.
+//	Does nothing if cbPatchChunkSize is zero.
+//*********************************************************************************************************************
+void CContainerLayer15::PatchMdatChunkSize(__in UINT32 cbPatchChunkSize,
+												__in UINT64 cbPayloadPos,
+													__inout PBYTE pBuffer,
+														__in UINT64 cbBuffer)
+{
+	if (cbPatchChunkSize)
+	{
+		for (UINT64 i = 4; (i < 8) && (i < cbPayloadPos + cbBuffer); i++)
+		{
+			if (i >= cbPayloadPos)
+			{
+				pBuffer[i - cbPayloadPos] = PBYTE(&cbPatchChunkSize)[i - 4];
+			}
+		}
+	}
+}
+
 //*********************************************************************************************************************
 //	Extracts/exports the embedded media data to a file.
 //	If a file with the specifed name already exists and fOverwrite is TRUE, then that file will be overwritten.
 //*********************************************************************************************************************
 HRESULT CContainerLayer15::ExtractMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
 													__in PCWSTR pwzDestFullPath,
-														__in_opt IOmfooExtractCallback *pUnknown,
+														__in_opt IOmfooExtractCallback *pCallback,
 															__in_opt ULONG nPagesPerCallback,
 																__in BOOL fOverwrite)
 {
-	// Kludge to patch invalid FORM ckSize values on the fly.
-	// Some AIFC and WAVE payloads (based on the Electronic Arts 'EA IFF 85' standard) have an invalid ckSize value.
-	// The invalid ckSize erroneously represents the size of the entire OMF file minus eight.
-	// (It should represent the size of the embedded WAV or AIF file minus eight.)
-	// These files probably began life as standard *.aif or *.wav files that were later transformed into *.omf files
-	// by appending OMF data to then end. This flaw exists in OMF1 and OMF2 files, and I suspect that they were created
-	// with OMF Toolkit Versions prior to v2.1.2 because v2.1.2 introduced a new method called omfsAppendRawFile()
-	// that automated this transformation.
-	//
-	// >>>> So here's part 1 (of 2) of the IFF ckSize kludge. <<<<
-	UINT32 cbPatchChunkSize = 0;
-	if ((rCE.oMDAT.dwFourCC == FCC('AIFC'))&&(rCE.cbPayloadLength >= 8)&&(rCE.cbPayloadLength < 0xFFFFFFFF))
-	{
-		cbPatchChunkSize = Endian32(UINT32(rCE.cbPayloadLength-8));
-	}
-	else if ((rCE.oMDAT.dwFourCC == FCC('WAVE'))&&(rCE.cbPayloadLength >= 8)&&(rCE.cbPayloadLength < 0xFFFFFFFF))
+	return ExtractMdatRangeToFile(rCE, 0, rCE.cbPayloadLength, pwzDestFullPath, pCallback, nPagesPerCallback, fOverwrite);
+}
+
+//*********************************************************************************************************************
+//	Extracts/exports part of the embedded media data to a file.
+//	The range begins cbRangeOffset bytes into the payload and is cbRangeLength bytes long. Only that range is read.
+//	If a file with the specifed name already exists and fOverwrite is TRUE, then that file will be overwritten.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::ExtractMdatRangeToFile(__in MDAT_CACHE_ENTRY& rCE,
+													__in UINT64 cbRangeOffset,
+														__in UINT64 cbRangeLength,
+															__in PCWSTR pwzDestFullPath,
+																__in_opt IOmfooExtractCallback *pUnknown,
+																	__in_opt ULONG nPagesPerCallback,
+																		__in BOOL fOverwrite)
+{
+	// The range must be non-empty and it must lie entirely inside the payload.
+	if ((cbRangeLength == 0) ||
+		(cbRangeOffset > rCE.cbPayloadLength) ||
+		(cbRangeLength > rCE.cbPayloadLength - cbRangeOffset))
 	{
-		cbPatchChunkSize = UINT32(rCE.cbPayloadLength-8);
+		return E_INVALIDARG;
 	}
-	// >>>> End of part 1 (of 2) of the IFF ckSize kludge. <<<<
+
+	// Part 1 (of 2) of the IFF ckSize kludge. See GetMdatPatchChunkSize().
+	// We only need it if caller's range includes the ckSize member, which lives at bytes 4 through 7 of the payload.
+	UINT32 cbPatchChunkSize = (cbRangeOffset < 8) ? GetMdatPatchChunkSize(rCE) : 0;
 
 	HRESULT			hr		= S_OK;
 	LARGE_INTEGER	liPtrEx	= {0};
 
-	UINT64	cbReadPosition	= rCE.cbPayloadOffset;
-	UINT64	cbReadRemaining	= rCE.cbPayloadLength;
-	UINT64	cbRoundUpLength	= rCE.cbPayloadLength;
+	UINT64	cbRoundUpLength	= cbRangeLength;
 
 	// Round up the payload length to the next page boundary (4096 bytes).
 	if (WORD(cbRoundUpLength) & 0x0FFF)
@@ -632,50 +886,21 @@ HRESULT CContainerLayer15::ExtractMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
 		cbRoundUpLength++;
 	}
 
-	// Two OVERLAPPED structures.
-	OVERLAPPED	ovlRead		= {0};
-	OVERLAPPED	ovlWrite	= {0};
-
-	// Two file handles.
-	HANDLE	hFileRead		= NULL;
+	// The destination file, and an event for writing to it.
 	HANDLE	hFileWrite		= NULL;
-
-	// A two-element array of pointers to two memory banks.
-	PBYTE	aMemBank[2]		= {NULL, NULL};
+	HANDLE	hEventWrite		= NULL;
 
 	// Size of each memory bank.
 	UINT32	cbMemoryBank	= 0;
 
-	// Pointer to the current memory bank.
-	PBYTE	pCurrentBank	= NULL;
-
-	// Counter to determine which bank pCurrentBank points to.
-	ULONG	nToggles		= 0;
-
-	// Two functional wait events, plus a third NULL event.
-	union {
-	struct {
-	HANDLE	hEventRead;
-	HANDLE	hEventWrite;
-	HANDLE	hNullEvent;
-	};
-	HANDLE	aEvents[3];	
-	};
+	// Everything that WriteBankToFile() needs.
+	MDAT_EXTRACT_FILE_JOB	oJob	= {0};
 
-	hEventRead	= NULL;
-	hEventWrite	= NULL;
-	hNullEvent	= NULL;
-
-	UINT64	cbWritePosition	= 0;
-
-	DWORD	cbReadRequest	= 0;
-	DWORD	cbReadResult	= 0;
-	DWORD	cbWriteRequest	= 0;
-	DWORD	cbWriteResult	= 0;
-	ULONG	nWaitObjects	= 0;
-
-	DWORD	dwError			= NOERROR;
-	DWORD	dwWaitResult	= NOERROR;
+	// Optional inline checksums. See IOmfooDigestCallback.
+	IOmfooDigestCallback*	pDigestCallback	= NULL;
+	CExtractDigest			oDigest;
+	OMFOO_EXTRACT_DIGESTS	sDigests		= {0};
+	DWORD					dwDigestKinds	= 0;
 
 	// If caller provided a callback handler then verify that it's an IOmfooExtractCallback.
 	IOmfooExtractCallback *pCallback = NULL;
@@ -723,25 +948,34 @@ HRESULT CContainerLayer15::ExtractMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
 		cbMemoryBank = UINT32(cbRoundUpLength);
 	}
 
-	// Allocate memory for two adjacent equally-sized memory banks.
-	PBYTE pMemBase = PBYTE(VirtualAlloc(NULL, cbMemoryBank*2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
-	if (pMemBase == NULL)
+	// Does caller's callback want checksums too? It doesn't have to.
+	if (pCallback && SUCCEEDED(pCallback->QueryInterface(IID_PPV_ARGS(&pDigestCallback))))
 	{
-		BREAK_IF_DEBUG
-		hr = HRESULT_FROM_WIN32(GetLastError());
-		goto L_CleanupExit;
-	}
+		if (FAILED(pDigestCallback->GetDigestKinds(&dwDigestKinds)))
+		{
+			dwDigestKinds = 0;
+		}
 
-	// Save their pointers in our aMemBank[] array.
-	aMemBank[0]	= pMemBase;
-	aMemBank[1]	= &pMemBase[cbMemoryBank];
+		if (dwDigestKinds && FAILED(hr = oDigest.Initialize(dwDigestKinds)))
+		{
+			IUnknown_AtomicRelease((PVOID*)&pDigestCallback);
+			IUnknown_AtomicRelease((PVOID*)&pCallback);
+			return hr;
+		}
+	}
 
-	// Create event handle for reading.
-	if (NULL == (hEventRead = CreateEventW(LPSECURITY_ATTRIBUTES(NULL), FALSE, FALSE, LPCWSTR(0))))
+	// If caller wants the whole payload then see if the file system can clone it for us. That way we don't have to
+	// copy it at all. S_FALSE means that it can't, and that we should copy it ourselves.
+	// A clone never passes through our memory banks so we can't do this if caller wants checksums.
+	if ((cbRangeOffset == 0) && (cbRangeLength == rCE.cbPayloadLength) && (dwDigestKinds == 0))
 	{
-		BREAK_IF_DEBUG
-		hr = HRESULT_FROM_WIN32(GetLastError());
-		goto L_CleanupExit;
+		hr = CloneMdatDataToFile(rCE, pwzDestFullPath, cbPatchChunkSize, pCallback, fOverwrite);
+		if (hr != S_FALSE)
+		{
+			IUnknown_AtomicRelease((PVOID*)&pDigestCallback);
+			IUnknown_AtomicRelease((PVOID*)&pCallback);
+			return hr;
+		}
 	}
 
 	// Create event handle for writing.
@@ -752,24 +986,6 @@ HRESULT CContainerLayer15::ExtractMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
 		goto L_CleanupExit;
 	}
 
-	// Open a handle to our current OMF file for asynchronous reading.
-	// We cannot use the one in CReadableFile::m_hFileRead because it was not opened with FILE_FLAG_OVERLAPPED.
-	hFileRead = CreateFileW(m_pwzFullPath,			// file to open
-							GENERIC_READ,			// open for reading (SYNCHRONIZE = ok)
-							FILE_SHARE_READ,		// share for reading
-							NULL,					// default security
-							OPEN_EXISTING,			// existing file only
-							FILE_FLAG_OVERLAPPED,	// for asynchronous I/O
-							NULL);
-
-	// If that failed for any reason ...
-	if (IsBadHandle(hFileRead))
-	{
-		BREAK_IF_DEBUG
-		hr = HRESULT_FROM_WIN32(GetLastError());
-		goto L_CleanupExit;
-	}
-
 	// Open the destination file for asynchronous writing.
 	hFileWrite = CreateFileW(pwzDestFullPath,		// file to open/create
 							GENERIC_WRITE,			// open/create for writing (SYNCHRONIZE = fail)
@@ -815,86 +1031,296 @@ HRESULT CContainerLayer15::ExtractMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
 		goto L_CleanupExit;
 	}
 
-	// Initialize our bank pointer to the first memory bank.
-	pCurrentBank = aMemBank[0];
-
-	// Main write/read loop.
-	do {
-		// Give pEvents something to point to.
-		PHANDLE	pEvents = &hNullEvent;
+	oJob.hFileWrite		= hFileWrite;
+	oJob.hEventWrite	= hEventWrite;
+	oJob.pCallback		= pCallback;
+	oJob.pDigest		= dwDigestKinds ? &oDigest : NULL;
+	oJob.cbTotal		= cbRangeLength;
+
+	// Read the range into our memory banks and write each one to the destination file.
+	if (FAILED(hr = PumpMdatRange(rCE,
+									cbRangeOffset,
+										cbRangeLength,
+											cbPatchChunkSize,
+												cbMemoryBank,
+													WriteBankToFile,
+														&oJob)))
+	{
+		goto L_CleanupExit;
+	}
 
-		// Reset the object counter for WaitForMultipleObjects().
-		nWaitObjects = 0;
+	// hFileWrite was opened with FILE_FLAG_NO_BUFFERING, and so we always wrote in multiples of 4096 bytes.
+	// That means that our previous write operation probably wrote some extra junk bytes at the end. If so, we need
+	// to close the file and re-open it without FILE_FLAG_NO_BUFFERING so we can truncate it to the proper length.
+	if (WORD(cbRangeLength) & 0x0FFF)
+	{
+		// Close the current write handle.
+		if (!CloseHandle(hFileWrite))
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			goto L_CleanupExit;
+		}
 
-		// Are there any pending blocks waiting to be written from a previous read operation?
-		if (cbWriteRequest)
+		// Reopen the destination file without the FILE_FLAG_NO_BUFFERING flag.
+		hFileWrite = CreateFileW(pwzDestFullPath, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (IsBadHandle(hFileWrite))
 		{
-			// >>>> Begin part 2 (of 2) of the IFF ckSize kludge. <<<<
-			// If this is the very first write buffer then tweak the cbSize member of the file header.
-			// We only do this once.
-			if (cbPatchChunkSize)
-			{
-				if (cbWriteRequest >= 8)
-				{
-					PDWORD pdw = PDWORD(pCurrentBank);
-					pdw[1] = cbPatchChunkSize;
-				}
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			goto L_CleanupExit;
+		}
 
-				// Now set cbPatchChunkSize to zero so that we never do this again!
-				cbPatchChunkSize = 0;
-			}
-			// >>>> End of part 2 (of 2) of the IFF ckSize kludge. That's all. It is done! <<<<
+		// Move the file pointer to the desired end position. - this is where we intend to chop-it-off.
+		liPtrEx.QuadPart = cbRangeLength;
+		if (!SetFilePointerEx(hFileWrite, liPtrEx, NULL, FILE_BEGIN))
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			goto L_CleanupExit;
+		}
 
-			// Round cbWriteRequest up to the next page boundary if necessary.
-			// This can only happen on the last iteration of this loop.
-			// It will happen when the embedded file length is not evenly divisible by 4096.
-			if (cbWriteRequest & 0x0FFF)
-			{
-				cbWriteRequest |= 0x0FFF;
-				cbWriteRequest++;
-			}
+		// Now call SetEndOfFile() to truncate it.
+		if (!SetEndOfFile(hFileWrite))
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			goto L_CleanupExit;
+		}
 
-			// Initialize/re-initialize these every time.
-			ovlWrite.Internal		= 0;
-			ovlWrite.InternalHigh	= 0;
-			ovlWrite.Offset			= PUINT32(&cbWritePosition)[0];
-			ovlWrite.OffsetHigh		= PUINT32(&cbWritePosition)[1];
-			ovlWrite.hEvent			= hEventWrite;
-
-			// Initiate the next async write.
-			if (!WriteFile(hFileWrite, pCurrentBank, cbWriteRequest, NULL, &ovlWrite))
-			{
-				dwError = GetLastError();
-				if (dwError != ERROR_IO_PENDING)
-				{
-					BREAK_IF_DEBUG
-					hr = HRESULT_FROM_WIN32(dwError);
-					goto L_CleanupExit;
-				}
-			}
+		// Fall through.
+	}
 
-			// Modify pEvents to point to the 2nd entry in m_aEvents[].
-			pEvents	= &hEventWrite;
+	// Did caller supply a callback?
+	if (pCallback)
+	{
+		// Does caller want us to cancel?
+		// This is the last call to UpdateProgress() so cbComplete and cbTotal are the same.
+		if (FAILED(pCallback->UpdateProgress(cbRangeLength, cbRangeLength)))
+		{
+			BREAK_IF_DEBUG
+			hr = E_ABORT;
+			goto L_CleanupExit;
+		}
+	}
 
-			// Increment the object counter for WaitForMultipleObjects().
-			nWaitObjects++;
+	if (dwDigestKinds)
+	{
+		if (FAILED(hr = oDigest.Finish(&sDigests)))
+		{
+			goto L_CleanupExit;
 		}
+	}
 
-		// Toggle our memory bank.
-		pCurrentBank = aMemBank[(++nToggles) & 0x00000001];
+	// If we made it to here we succeeded!
+	hr = S_OK;
 
-		// Are there any bytes remaining to be read from the source file?
-		if (cbReadRemaining)
-		{
-			// Decide on the number of bytes to read.
-			if (cbReadRemaining >= cbMemoryBank)
-			{
-				cbReadRequest = cbMemoryBank;
-			}
-			else
-			{
-				cbReadRequest = UINT32(cbReadRemaining);
-			}
+	// Now clean up.
+L_CleanupExit:
+
+	// Did caller abort?
+	// WriteBankToFile() never leaves a write in flight, so we can close the destination file and then delete it.
+	if (hr == E_ABORT)
+	{
+		BREAK_IF_DEBUG
+		CloseHandle(hFileWrite);
+		hFileWrite = INVALID_HANDLE_VALUE;
+		if (!DeleteFileW(pwzDestFullPath))
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+		}
+	}
+
+	// Close all open handles.
+	if (IsValidHandle(hFileWrite))
+	{
+		CloseHandle(hFileWrite);
+	}
+
+	if (IsValidHandle(hEventWrite))
+	{
+		CloseHandle(hEventWrite);
+	}
+
+	// Now that the new file is closed we can hand caller its checksums.
+	if (SUCCEEDED(hr) && dwDigestKinds)
+	{
+		pDigestCallback->DigestsReady(pwzDestFullPath, &sDigests);
+	}
+
+	// Release pCallback if it exists, and set pCallback to NULL.
+	IUnknown_AtomicRelease((PVOID*)&pDigestCallback);
+	IUnknown_AtomicRelease((PVOID*)&pCallback);
+
+	// Done!
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Pushes the embedded media data to a caller-supplied IOmfooExtractSink in buffers of cbChunkSize bytes.
+//	This is ExtractMdatDataToFile() with the caller's WriteData() method in place of our destination file.
+//	PumpMdatRange() does the reading, so the next buffer is already being read while the sink consumes this one.
+//	Once the sink has passed our QueryInterface() test its Complete() method is called exactly once, no matter what.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::ExtractMdatDataToSink(__in MDAT_CACHE_ENTRY& rCE,
+													__in IOmfooExtractSink *pUnknown,
+														__in_opt ULONG cbChunkSize)
+{
+	HRESULT hr = S_OK;
+
+	// Verify that caller's sink is an IOmfooExtractSink.
+	IOmfooExtractSink *pSink = NULL;
+	if (IsBadUnknown(pUnknown))
+	{
+		return E_POINTER;
+	}
+
+	if (FAILED(hr = pUnknown->QueryInterface(IID_PPV_ARGS(&pSink))))
+	{
+		return hr;
+	}
+
+	// If caller did NOT supply cbChunkSize then use our default.
+	if (cbChunkSize == 0)
+	{
+		cbChunkSize = SINK_DEFAULT_CHUNK;
+	}
+	else if (cbChunkSize > SINK_MAX_CHUNK)
+	{
+		hr = E_INVALIDARG;
+		goto L_CleanupExit;
+	}
+
+	// If cbChunkSize is larger than the size of the embedded file then use the lesser.
+	if (rCE.cbPayloadLength < cbChunkSize)
+	{
+		cbChunkSize = ULONG(rCE.cbPayloadLength);
+	}
+
+	// Part 1 (of 2) of the IFF ckSize kludge is GetMdatPatchChunkSize(). PumpMdatRange() does part 2.
+	// An empty payload is not an error. There's just nothing to push.
+	hr = PumpMdatRange(rCE,
+						0,
+							rCE.cbPayloadLength,
+								GetMdatPatchChunkSize(rCE),
+									cbChunkSize,
+										PushBankToSink,
+											pSink);
+
+L_CleanupExit:
+
+	// Tell caller's sink that we're done, and how it went.
+	pSink->Complete(hr);
+
+	// Release pSink, and set pSink to NULL.
+	IUnknown_AtomicRelease((PVOID*)&pSink);
+
+	// Done!
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for ExtractMdatRangeToFile() and ExtractMdatDataToSink().
+//	This is our double-buffered read loop. It reads cbRangeLength bytes of the payload (beginning cbRangeOffset bytes
+//	into it) into two memory banks of cbBank bytes each, and hands each full bank to pfnConsume. While pfnConsume is
+//	busy with one bank an overlapped read is filling the other one. The cbPosition argument of pfnConsume is relative
+//	to cbRangeOffset. Each bank gets part 2 of the IFF ckSize kludge before pfnConsume sees it. See
+//	PatchMdatChunkSize(). The banks come from VirtualAlloc() so they are page-aligned, and the last one is not
+//	guaranteed to be full. pfnConsume must be done with its bank when it returns. If pfnConsume fails then we stop
+//	and return its HRESULT.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::PumpMdatRange(__in MDAT_CACHE_ENTRY& rCE,
+											__in UINT64 cbRangeOffset,
+												__in UINT64 cbRangeLength,
+													__in UINT32 cbPatchChunkSize,
+														__in ULONG cbBank,
+															__in PFN_MDAT_PUMP pfnConsume,
+																__in PVOID pContext)
+{
+	HRESULT		hr					= S_OK;
+	OVERLAPPED	ovlRead				= {0};
+	HANDLE		hFileRead			= NULL;
+	HANDLE		hEventRead			= NULL;
+	PBYTE		pMemBase			= NULL;
+	PBYTE		aMemBank[2]			= {NULL, NULL};
+	ULONG		nToggles			= 0;
+
+	UINT64		cbReadPosition		= rCE.cbPayloadOffset + cbRangeOffset;
+	UINT64		cbReadRemaining		= cbRangeLength;
+	UINT64		cbConsumePosition	= 0;
+
+	DWORD		cbReadRequest		= 0;
+	DWORD		cbReadResult		= 0;
+	DWORD		cbConsumeRequest	= 0;
+	DWORD		dwError				= NOERROR;
+
+	// An empty range is not an error. There's just nothing to read.
+	if (cbRangeLength == 0)
+	{
+		return S_OK;
+	}
+
+	if (cbBank == 0)
+	{
+		BREAK_IF_DEBUG
+		return E_INVALIDARG;
+	}
+
+	// Allocate memory for two adjacent equally-sized memory banks.
+	pMemBase = PBYTE(VirtualAlloc(NULL, SIZE_T(cbBank)*2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+	if (pMemBase == NULL)
+	{
+		BREAK_IF_DEBUG
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Save their pointers in our aMemBank[] array.
+	aMemBank[0]	= pMemBase;
+	aMemBank[1]	= &pMemBase[cbBank];
+
+	// Create event handle for reading.
+	if (NULL == (hEventRead = CreateEventW(LPSECURITY_ATTRIBUTES(NULL), FALSE, FALSE, LPCWSTR(0))))
+	{
+		BREAK_IF_DEBUG
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Open a handle to our current OMF file for asynchronous reading.
+	// We cannot use the one in CReadableFile::m_hFileRead because it was not opened with FILE_FLAG_OVERLAPPED.
+	hFileRead = CreateFileW(m_pwzFullPath,			// file to open
+							GENERIC_READ,			// open for reading (SYNCHRONIZE = ok)
+							FILE_SHARE_READ,		// share for reading
+							NULL,					// default security
+							OPEN_EXISTING,			// existing file only
+							FILE_FLAG_OVERLAPPED |\
+							FILE_FLAG_SEQUENTIAL_SCAN,
+							NULL);
+
+	// If that failed for any reason ...
+	if (IsBadHandle(hFileRead))
+	{
+		BREAK_IF_DEBUG
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Main read/consume loop.
+	do {
+		// Are there any bytes remaining to be read from the source file?
+		if (cbReadRemaining)
+		{
+			// Decide on the number of bytes to read.
+			if (cbReadRemaining >= cbBank)
+			{
+				cbReadRequest = cbBank;
+			}
+			else
+			{
+				cbReadRequest = UINT32(cbReadRemaining);
+			}
 
 			// Initialize/re-initialize these every time.
 			ovlRead.Internal		= 0;
@@ -903,142 +1329,397 @@ HRESULT CContainerLayer15::ExtractMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
 			ovlRead.OffsetHigh		= PUINT32(&cbReadPosition)[1];
 			ovlRead.hEvent			= hEventRead;
 
-			// Initiate the next async read.
-			if (!ReadFile(hFileRead, pCurrentBank, cbReadRequest, LPDWORD(0), &ovlRead))
+			// Initiate the next async read into the bank that pfnConsume is NOT using.
+			if (!ReadFile(hFileRead, aMemBank[nToggles & 0x00000001], cbReadRequest, LPDWORD(0), &ovlRead))
 			{
 				dwError = GetLastError();
 				if (dwError != ERROR_IO_PENDING)
 				{
 					BREAK_IF_DEBUG
+					cbReadRequest = 0;
 					hr = HRESULT_FROM_WIN32(dwError);
 					goto L_CleanupExit;
 				}
 			}
+		}
 
-			// Modify pEvents to point to the 1st entry in m_aEvents[].
-			pEvents	= &hEventRead;
+		// Is there a bank from the previous read waiting to be consumed?
+		if (cbConsumeRequest)
+		{
+			PBYTE pCurrentBank = aMemBank[(nToggles + 1) & 0x00000001];
+
+			// Part 2 (of 2) of the IFF ckSize kludge. See PatchMdatChunkSize().
+			// A bank can be smaller than eight bytes, so the ckSize member might straddle two of them.
+			if (cbRangeOffset + cbConsumePosition < 8)
+			{
+				PatchMdatChunkSize(cbPatchChunkSize, cbRangeOffset + cbConsumePosition, pCurrentBank, cbConsumeRequest);
+			}
+
+			if (FAILED(hr = pfnConsume(pContext, pCurrentBank, cbConsumeRequest, cbConsumePosition)))
+			{
+				goto L_CleanupExit;
+			}
 
-			// Increment the object counter for WaitForMultipleObjects().
-			nWaitObjects++;
+			cbConsumePosition	+= cbConsumeRequest;
+			cbConsumeRequest	= 0;
 		}
 
-		// Are there any pending read or write operations?
-		if (nWaitObjects)
+		// Is there a pending read operation?
+		if (cbReadRequest)
 		{
-			// Did caller supply a callback?
-			if (pCallback)
+			BOOL	fResult		= GetOverlappedResult(hFileRead, &ovlRead, &cbReadResult, TRUE);
+			DWORD	cbExpected	= cbReadRequest;
+
+			// The read is no longer in flight, so our cleanup code must not wait for it.
+			cbReadRequest = 0;
+
+			if (!fResult)
 			{
-				// Does caller want us to abort?
-				if (FAILED(pCallback->UpdateProgress(cbWritePosition, rCE.cbPayloadLength)))
-				{
-					BREAK_IF_DEBUG
-					hr = E_ABORT;
-					goto L_CleanupExit;
-				}
+				BREAK_IF_DEBUG
+				hr = HRESULT_FROM_WIN32(GetLastError());
+				goto L_CleanupExit;
 			}
 
-			// Wait until the states of all objects have been signaled.
-			// Wait time is measured in milliseconds.
-			dwWaitResult = WaitForMultipleObjects(nWaitObjects, pEvents, TRUE, DWORD(30 * 1000));
-			if (dwWaitResult > 1)
+			if (cbReadResult != cbExpected)
 			{
 				BREAK_IF_DEBUG
-				hr = (dwWaitResult == WAIT_TIMEOUT) ? HRESULT_FROM_WIN32(WAIT_TIMEOUT) : E_FAIL;
+				hr = E_FAIL;
 				goto L_CleanupExit;
 			}
 
-			if (cbWriteRequest)
-			{
-				if (!GetOverlappedResult(hFileWrite, &ovlWrite, &cbWriteResult, TRUE))
-				{
-					BREAK_IF_DEBUG
-					hr = HRESULT_FROM_WIN32(GetLastError());
-					goto L_CleanupExit;
-				}
+			// Hand the bank we just filled to pfnConsume on the next iteration, and read into the other one.
+			cbConsumeRequest	= cbReadResult;
+			cbReadPosition		+= cbReadResult;
+			cbReadRemaining		-= cbReadResult;
+			cbReadResult		= 0;
+			nToggles++;
+		}
+	} while (cbConsumeRequest);
 
-				if (cbWriteResult != cbWriteRequest)
-				{
-					BREAK_IF_DEBUG
-					hr = E_FAIL;
-					goto L_CleanupExit;
-				}
+	// If we made it to here we succeeded!
+	hr = S_OK;
 
-				cbWritePosition += cbWriteResult;
-				cbWriteRequest	= 0;
-				cbWriteResult	= 0;
-			}
+	// Now clean up.
+L_CleanupExit:
 
-			if (cbReadRequest)
-			{
-				if (!GetOverlappedResult(hFileRead, &ovlRead, &cbReadResult, TRUE))
-				{
-					BREAK_IF_DEBUG
-					hr = HRESULT_FROM_WIN32(GetLastError());
-					goto L_CleanupExit;
-				}
+	// If a read is still in flight then cancel it, and let it finish before we free its memory bank.
+	if (cbReadRequest)
+	{
+		CancelIo(hFileRead);
+		GetOverlappedResult(hFileRead, &ovlRead, &cbReadResult, TRUE);
+	}
 
-				if (cbReadResult != cbReadRequest)
-				{
-					BREAK_IF_DEBUG
-					hr = E_FAIL;
-					goto L_CleanupExit;
-				}
+	// Close all open handles.
+	if (IsValidHandle(hFileRead))
+	{
+		CloseHandle(hFileRead);
+	}
 
-				cbWriteRequest	= cbReadResult;	
-				cbReadPosition	+= cbReadResult;
-				cbReadRemaining	-= cbReadResult;
-				cbReadRequest	= 0;
-				cbReadResult	= 0;
-			}
+	if (IsValidHandle(hEventRead))
+	{
+		CloseHandle(hEventRead);
+	}
+
+	// Free buffer memory.
+	if (pMemBase)
+	{
+		VirtualFree(pMemBase, SIZE_T(0), MEM_RELEASE);
+	}
+
+	// Done!
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private static helper for ExtractMdatRangeToFile(). This is its PFN_MDAT_PUMP.
+//	Writes one bank to the destination file with an overlapped write, and hashes it and reports our progress while the
+//	write is in flight. PumpMdatRange() is reading the next bank at the same time. We don't return until the write is
+//	finished, because PumpMdatRange() will refill this bank as soon as we do.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::WriteBankToFile(__in PVOID pContext,
+												__in PBYTE pBank,
+													__in ULONG cbData,
+														__in UINT64 cbPosition)
+{
+	MDAT_EXTRACT_FILE_JOB&	rJob			= *PMDAT_EXTRACT_FILE_JOB(pContext);
+	HRESULT					hr				= S_OK;
+	DWORD					cbWriteRequest	= cbData;
+	DWORD					cbWriteResult	= 0;
+	DWORD					dwError			= NOERROR;
+	DWORD					dwWaitResult	= NOERROR;
+
+	// Round cbWriteRequest up to the next page boundary if necessary, because hFileWrite was opened with
+	// FILE_FLAG_NO_BUFFERING. This can only happen on the last bank. It will happen when the range length is not evenly
+	// divisible by 4096. Our caller truncates the file afterwards.
+	if (cbWriteRequest & 0x0FFF)
+	{
+		cbWriteRequest |= 0x0FFF;
+		cbWriteRequest++;
+	}
+
+	// Initialize/re-initialize these every time.
+	rJob.ovlWrite.Internal		= 0;
+	rJob.ovlWrite.InternalHigh	= 0;
+	rJob.ovlWrite.Offset		= PUINT32(&cbPosition)[0];
+	rJob.ovlWrite.OffsetHigh	= PUINT32(&cbPosition)[1];
+	rJob.ovlWrite.hEvent		= rJob.hEventWrite;
+
+	// Initiate the async write.
+	if (!WriteFile(rJob.hFileWrite, pBank, cbWriteRequest, NULL, &rJob.ovlWrite))
+	{
+		dwError = GetLastError();
+		if (dwError != ERROR_IO_PENDING)
+		{
+			BREAK_IF_DEBUG
+			return HRESULT_FROM_WIN32(dwError);
 		}
-	} while (nWaitObjects);
+	}
 
-	// hFileWrite was opened with FILE_FLAG_NO_BUFFERING, and so we always wrote in multiples of 4096 bytes.
-	// That means that our previous write operation probably wrote some extra junk bytes at the end. If so, we need
-	// to close the file and re-open it without FILE_FLAG_NO_BUFFERING so we can truncate it to the proper length.
-	if (WORD(rCE.cbPayloadLength) & 0x0FFF)
+	// Hash the bank while it's being written.
+	// WriteFile() only reads from it, so it's safe to read from it at the same time.
+	if (rJob.pDigest)
 	{
-		// Close the current write handle.
-		if (!CloseHandle(hFileWrite))
+		rJob.pDigest->Update(pBank, cbData);
+	}
+
+	// Did caller supply a callback? If so, does caller want us to abort?
+	if (rJob.pCallback && FAILED(rJob.pCallback->UpdateProgress(cbPosition, rJob.cbTotal)))
+	{
+		BREAK_IF_DEBUG
+		hr = E_ABORT;
+		CancelIo(rJob.hFileWrite);
+	}
+	else
+	{
+		// Wait time is measured in milliseconds.
+		dwWaitResult = WaitForSingleObject(rJob.hEventWrite, DWORD(30 * 1000));
+		if (dwWaitResult != WAIT_OBJECT_0)
 		{
 			BREAK_IF_DEBUG
-			hr = HRESULT_FROM_WIN32(GetLastError());
-			goto L_CleanupExit;
+			hr = (dwWaitResult == WAIT_TIMEOUT) ? HRESULT_FROM_WIN32(WAIT_TIMEOUT) : E_FAIL;
+			CancelIo(rJob.hFileWrite);
 		}
+	}
 
-		// Reopen the destination file without the FILE_FLAG_NO_BUFFERING flag.
-		hFileWrite = CreateFileW(pwzDestFullPath, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-		if (IsBadHandle(hFileWrite))
+	// Even if we cancelled it, the write must be finished before we hand the bank back.
+	if (!GetOverlappedResult(rJob.hFileWrite, &rJob.ovlWrite, &cbWriteResult, TRUE))
+	{
+		if (SUCCEEDED(hr))
 		{
 			BREAK_IF_DEBUG
 			hr = HRESULT_FROM_WIN32(GetLastError());
+		}
+	}
+	else if (SUCCEEDED(hr) && (cbWriteResult != cbWriteRequest))
+	{
+		BREAK_IF_DEBUG
+		hr = E_FAIL;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private static helper for ExtractMdatDataToSink(). This is its PFN_MDAT_PUMP.
+//	Pushes one bank to caller's IOmfooExtractSink. The sink's WriteData() method runs on our caller's thread while
+//	PumpMdatRange() is reading the next bank.
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::PushBankToSink(__in PVOID pContext,
+												__in PBYTE pBank,
+													__in ULONG cbData,
+														__in UINT64 cbPosition)
+{
+	UNREFERENCED_PARAMETER(cbPosition);
+
+	// Push it. Does caller want us to abort?
+	if (FAILED(static_cast<IOmfooExtractSink*>(pContext)->WriteData(pBank, cbData)))
+	{
+		BREAK_IF_DEBUG
+		return E_ABORT;
+	}
+
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper called by ExtractMdatDataToFile().
+//	Tries to extract the payload without copying it, by asking the file system to share the OMF file's clusters with
+//	the new file. This is block cloning, which is only supported by ReFS. It only works when the new file lives on the
+//	same volume as the OMF file, and when the payload begins on a cluster boundary. If any of that isn't true this
+//	returns S_FALSE without leaving anything behind, so our caller can fall back to its normal double-buffered copy.
+//	The partial cluster at the end is copied the old-fashioned way. So is the first cluster if cbPatchChunkSize is
+//	non-zero, because we have to patch it. See GetMdatPatchChunkSize().
+//*********************************************************************************************************************
+HRESULT CContainerLayer15::CloneMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
+													__in PCWSTR pwzDestFullPath,
+														__in UINT32 cbPatchChunkSize,
+															__in_opt IOmfooExtractCallback *pCallback,
+																__in BOOL fOverwrite)
+{
+	BY_HANDLE_FILE_INFORMATION	sInfo		= {0};
+	DUPLICATE_EXTENTS_DATA		sDup		= {0};
+	WCHAR						wzVolume[MAX_PATH]	= {0};
+
+	HANDLE	hFileSource		= NULL;
+	HANDLE	hFileWrite		= NULL;
+	PBYTE	pCluster		= NULL;
+	DWORD	dwVolumeSerial	= 0;
+	DWORD	dwFsFlags		= 0;
+	DWORD	cbResult		= 0;
+	UINT32	cbCluster		= 0;
+	UINT64	cbCloneStart	= 0;
+	UINT64	cbCloneEnd		= 0;
+	HRESULT	hr				= S_FALSE;
+
+	// Is the new file going to live on the same volume as the OMF file? Does that volume support block cloning?
+	if ((!GetVolumePathNameW(pwzDestFullPath, wzVolume, ELEMS(wzVolume))) ||
+		(!GetVolumeInformationW(wzVolume, NULL, 0, &dwVolumeSerial, NULL, &dwFsFlags, NULL, 0)) ||
+		(dwVolumeSerial != m_dwVolumeSerialNumber) ||
+		(0 == (dwFsFlags & FILE_SUPPORTS_BLOCK_REFCOUNTING)))
+	{
+		return S_FALSE;
+	}
+
+	// Does the payload begin on a cluster boundary? Is it long enough to be worth the trouble?
+	if ((FAILED(GetBytesPerCluster(wzVolume, &cbCluster))) ||
+		(cbCluster == 0) ||
+		(rCE.cbPayloadOffset % cbCluster) ||
+		(rCE.cbPayloadLength < (UINT64(cbCluster) * 2)))
+	{
+		return S_FALSE;
+	}
+
+	// These are the parts that we will clone. Everything else gets copied.
+	cbCloneStart	= cbPatchChunkSize ? cbCluster : 0;
+	cbCloneEnd		= rCE.cbPayloadLength - (rCE.cbPayloadLength % cbCluster);
+
+	// Open our own handle to the OMF file. We cannot use the one in CReadableFile::m_hFileRead because it's private.
+	hFileSource = CreateFileW(m_pwzFullPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	if (IsBadHandle(hFileSource))
+	{
+		hFileSource = NULL;
+		goto L_CleanupExit;
+	}
+
+	// If the OMF file is sparse then the new file would have to be sparse too. Don't bother.
+	if ((!GetFileInformationByHandle(hFileSource, &sInfo)) || (sInfo.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE))
+	{
+		goto L_CleanupExit;
+	}
+
+	// Create the destination file.
+	hFileWrite = CreateFileW(pwzDestFullPath,
+								GENERIC_READ | GENERIC_WRITE,
+								0x00000000,				// FILE_SHARE_NONE (don't share)
+								NULL,					// default security
+								fOverwrite ? CREATE_ALWAYS : CREATE_NEW,
+								FILE_ATTRIBUTE_NORMAL,
+								NULL);
+
+	// If that failed for any reason then our caller would fail too. So this is a real error.
+	if (IsBadHandle(hFileWrite))
+	{
+		BREAK_IF_DEBUG
+		hFileWrite = NULL;
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// The destination range must already exist before we can clone into it.
+	if ((!SetFilePointerEx(hFileWrite, *PLARGE_INTEGER(&rCE.cbPayloadLength), NULL, FILE_BEGIN)) ||
+		(!SetEndOfFile(hFileWrite)))
+	{
+		BREAK_IF_DEBUG
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Clone the whole clusters.
+	sDup.FileHandle = hFileSource;
+	for (UINT64 cbPos = cbCloneStart; cbPos < cbCloneEnd;)
+	{
+		UINT64 cbChunk = cbCloneEnd - cbPos;
+		if (cbChunk > CLONE_MAX_CHUNK)
+		{
+			cbChunk = CLONE_MAX_CHUNK;
+		}
+
+		sDup.SourceFileOffset.QuadPart	= rCE.cbPayloadOffset + cbPos;
+		sDup.TargetFileOffset.QuadPart	= cbPos;
+		sDup.ByteCount.QuadPart			= cbChunk;
+
+		if (!DeviceIoControl(hFileWrite, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &sDup, sizeof(sDup), NULL, 0, &cbResult, NULL))
+		{
+			// If the very first call failed then the file system just won't do it for us (for example if the OMF file
+			// is encrypted, or if its clusters are already shared too many times). Fall back to copying.
+			// But if it failed part way through then something is really wrong.
+			hr = (cbPos == cbCloneStart) ? S_FALSE : HRESULT_FROM_WIN32(GetLastError());
 			goto L_CleanupExit;
 		}
 
-		// Move the file pointer to the desired end position. - this is where we intend to chop-it-off.
-		liPtrEx.QuadPart = rCE.cbPayloadLength;
-		if (!SetFilePointerEx(hFileWrite, liPtrEx, NULL, FILE_BEGIN))
+		cbPos += cbChunk;
+
+		// Did caller supply a callback? Does caller want us to abort?
+		if (pCallback)
+		{
+			if (FAILED(pCallback->UpdateProgress(cbPos, rCE.cbPayloadLength)))
+			{
+				BREAK_IF_DEBUG
+				hr = E_ABORT;
+				goto L_CleanupExit;
+			}
+		}
+	}
+
+	pCluster = PBYTE(MemAlloc(cbCluster));
+	if (NULL == pCluster)
+	{
+		BREAK_IF_DEBUG
+		hr = E_OUTOFMEMORY;
+		goto L_CleanupExit;
+	}
+
+	// Now copy the head (if we need to patch it) and the tail.
+	// Neither one is longer than one cluster.
+	for (ULONG iPart = 0; iPart < 2; iPart++)
+	{
+		UINT64		cbPartStart	= (iPart == 0) ? 0 : cbCloneEnd;
+		UINT64		cbPartEnd	= (iPart == 0) ? cbCloneStart : rCE.cbPayloadLength;
+		DWORD		cbPart		= DWORD(cbPartEnd - cbPartStart);
+		UINT64		cbReadPos	= rCE.cbPayloadOffset + cbPartStart;
+		OVERLAPPED	ovl			= {0};
+
+		if (cbPart == 0)
+		{
+			continue;
+		}
+
+		ovl.Offset		= PUINT32(&cbReadPos)[0];
+		ovl.OffsetHigh	= PUINT32(&cbReadPos)[1];
+		if ((!ReadFile(hFileSource, pCluster, cbPart, &cbResult, &ovl)) || (cbResult != cbPart))
 		{
 			BREAK_IF_DEBUG
 			hr = HRESULT_FROM_WIN32(GetLastError());
 			goto L_CleanupExit;
 		}
 
-		// Now call SetEndOfFile() to truncate it.
-		if (!SetEndOfFile(hFileWrite))
+		// Part 2 (of 2) of the IFF ckSize kludge.
+		PatchMdatChunkSize(cbPatchChunkSize, cbPartStart, pCluster, cbPart);
+
+		ZeroMemory(&ovl, sizeof(ovl));
+		ovl.Offset		= PUINT32(&cbPartStart)[0];
+		ovl.OffsetHigh	= PUINT32(&cbPartStart)[1];
+		if ((!WriteFile(hFileWrite, pCluster, cbPart, &cbResult, &ovl)) || (cbResult != cbPart))
 		{
 			BREAK_IF_DEBUG
 			hr = HRESULT_FROM_WIN32(GetLastError());
 			goto L_CleanupExit;
 		}
-
-		// Fall through.
 	}
 
 	// Did caller supply a callback?
 	if (pCallback)
 	{
-		// Does caller want us to cancel?
 		// This is the last call to UpdateProgress() so cbComplete and cbTotal are the same.
 		if (FAILED(pCallback->UpdateProgress(rCE.cbPayloadLength, rCE.cbPayloadLength)))
 		{
@@ -1051,59 +1732,23 @@ HRESULT CContainerLayer15::ExtractMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
 	// If we made it to here we succeeded!
 	hr = S_OK;
 
-	// Now clean up.
 L_CleanupExit:
-
-	// Did caller abort?
-	if (hr == E_ABORT)
-	{
-		BREAK_IF_DEBUG
-
-		// Cancel all outstanding read/write operations.
-		CancelIo(hFileRead);
-		CancelIo(hFileWrite);
-
-		// Close the destination file and then delete it.
-		CloseHandle(hFileWrite);
-		hFileWrite = INVALID_HANDLE_VALUE;
-		if (!DeleteFileW(pwzDestFullPath))
-		{
-			BREAK_IF_DEBUG
-			hr = HRESULT_FROM_WIN32(GetLastError());
-		}
-	}
-
-	// Close all open handles.
-	if (IsValidHandle(hFileRead))
+	if (hFileSource)
 	{
-		CloseHandle(hFileRead);
+		CloseHandle(hFileSource);
 	}
 
-	if (IsValidHandle(hFileWrite))
+	if (hFileWrite)
 	{
 		CloseHandle(hFileWrite);
-	}
-
-	if (IsValidHandle(hEventRead))
-	{
-		CloseHandle(hEventRead);
-	}
-
-	if (IsValidHandle(hEventWrite))
-	{
-		CloseHandle(hEventWrite);
-	}
 
-	// Free buffer memory.
-	if (pMemBase)
-	{
-		VirtualFree(pMemBase, SIZE_T(0), MEM_RELEASE);
+		// If we didn't finish then don't leave a partial file behind.
+		if (hr != S_OK)
+		{
+			DeleteFileW(pwzDestFullPath);
+		}
 	}
 
-	// Release pCallback if it exists, and set pCallback to NULL.
-	IUnknown_AtomicRelease((PVOID*)&pCallback);
-
-	// Done!
+	MemFree(pCluster);
 	return hr;
 }
-
@@ -8,6 +8,20 @@
 #pragma once
 #include "ContainerLayer14.h"
 
+//	Every consumer of PumpMdatRange() looks like this.
+typedef HRESULT (*PFN_MDAT_PUMP)(PVOID pContext, PBYTE pBank, ULONG cbData, UINT64 cbPosition);
+
+//	Internal structure for ExtractMdatRangeToFile(). This is the pContext argument of WriteBankToFile().
+class CExtractDigest;
+typedef struct {
+	HANDLE					hFileWrite;		// the destination file, opened with FILE_FLAG_NO_BUFFERING.
+	HANDLE					hEventWrite;	// event for ovlWrite.
+	OVERLAPPED				ovlWrite;
+	IOmfooExtractCallback*	pCallback;		// caller's callback, or NULL.
+	CExtractDigest*			pDigest;		// NULL if caller doesn't want checksums.
+	UINT64					cbTotal;		// the cbTotal argument for UpdateProgress().
+} MDAT_EXTRACT_FILE_JOB, *PMDAT_EXTRACT_FILE_JOB;
+
 class CContainerLayer15 : public CContainerLayer14
 {
 protected:
@@ -36,6 +50,12 @@ public:
 												__in REFIID riid,
 													__out PVOID *ppvOut);
 
+	STDMETHODIMP	CreateStreamOnMdatRange(__in ULONG idx,
+												__in UINT64 cbRangeOffset,
+													__in UINT64 cbRangeLength,
+														__in REFIID riid,
+															__out PVOID *ppvOut);
+
 	STDMETHODIMP	CreateDShowSourceFilterOnData(__in ULONG idx,
 													__in REFIID riid,
 														__out PVOID *ppvOut);
@@ -52,6 +72,18 @@ public:
 													__in_opt ULONG nPagesPerCallback,
 														__in BOOL fOverwrite);
 
+	STDMETHODIMP	ExtractMdatRangeToFile(__in ULONG idx,
+											__in UINT64 cbRangeOffset,
+												__in UINT64 cbRangeLength,
+													__in PCWSTR pwzFullPathNewFile,
+														__in_opt IOmfooExtractCallback *pCallback,
+															__in_opt ULONG nPagesPerCallback,
+																__in BOOL fOverwrite);
+
+	STDMETHODIMP	ExtractMdatDataToSink(__in ULONG idx,
+											__in IOmfooExtractSink *pSink,
+												__in_opt ULONG cbChunkSize);
+
 	// These are the routines that do the actual work.
 	STDMETHODIMP	QueryMdatRawFileParams(__in MDAT_CACHE_ENTRY& rCE,
 												__out PUINT64 pOffset,
@@ -61,6 +93,20 @@ public:
 	STDMETHODIMP	CreateStreamOnMdatData(__in MDAT_CACHE_ENTRY& rCE,
 												__in REFIID riid, __out PVOID *ppvOut);
 
+	STDMETHODIMP	CreateStreamOnMdatRange(__in MDAT_CACHE_ENTRY& rCE,
+												__in UINT64 cbRangeOffset,
+													__in UINT64 cbRangeLength,
+														__in REFIID riid,
+															__out PVOID *ppvOut);
+
+	STDMETHODIMP	CreateSplicedStreamOnMdatRange(__in MDAT_CACHE_ENTRY& rCE,
+														__in_opt LPCVOID pHeader,
+															__in ULONG cbHeader,
+																__in UINT64 cbRangeOffset,
+																	__in UINT64 cbRangeLength,
+																		__in ULONG cbPadding,
+																			__in REFIID riid,
+																				__out PVOID *ppvOut);
 
 	STDMETHODIMP	CreateDShowSourceFilterOnData(__in MDAT_CACHE_ENTRY& rCE,
 													__in REFIID riid,
@@ -78,4 +124,58 @@ public:
 													__in_opt ULONG nPagesPerCallback,
 														__in BOOL fOverwrite);
 
+	STDMETHODIMP	ExtractMdatRangeToFile(__in MDAT_CACHE_ENTRY& rCE,
+											__in UINT64 cbRangeOffset,
+												__in UINT64 cbRangeLength,
+													__in PCWSTR pwzFullPathNewFile,
+														__in_opt IOmfooExtractCallback *pCallback,
+															__in_opt ULONG nPagesPerCallback,
+																__in BOOL fOverwrite);
+
+	STDMETHODIMP	ExtractMdatDataToSink(__in MDAT_CACHE_ENTRY& rCE,
+											__in IOmfooExtractSink *pSink,
+												__in_opt ULONG cbChunkSize);
+
+	// The IFF ckSize kludge. Every routine that hands out the payload's first eight bytes uses these two.
+	static UINT32	GetMdatPatchChunkSize(__in MDAT_CACHE_ENTRY& rCE);
+	static void		PatchMdatChunkSize(__in UINT32 cbPatchChunkSize,
+											__in UINT64 cbPayloadPos,
+												__inout PBYTE pBuffer,
+													__in UINT64 cbBuffer);
+
+private:
+	enum {
+		// Maximum number of bytes we ask the file system to clone in one FSCTL_DUPLICATE_EXTENTS_TO_FILE call.
+		// This is a multiple of every possible cluster size.
+		CLONE_MAX_CHUNK	= 0x40000000,
+
+		// Default and maximum buffer sizes for ExtractMdatDataToSink(). The maximum is 7200 pages (29491200 bytes),
+		// which is the same as the largest memory bank in ExtractMdatDataToFile().
+		SINK_DEFAULT_CHUNK	= 0x00100000,
+		SINK_MAX_CHUNK		= 0x01C20000,
+	};
+
+	HRESULT	CloneMdatDataToFile(__in MDAT_CACHE_ENTRY& rCE,
+									__in PCWSTR pwzDestFullPath,
+										__in UINT32 cbPatchChunkSize,
+											__in_opt IOmfooExtractCallback *pCallback,
+												__in BOOL fOverwrite);
+
+	HRESULT	PumpMdatRange(__in MDAT_CACHE_ENTRY& rCE,
+							__in UINT64 cbRangeOffset,
+								__in UINT64 cbRangeLength,
+									__in UINT32 cbPatchChunkSize,
+										__in ULONG cbBank,
+											__in PFN_MDAT_PUMP pfnConsume,
+												__in PVOID pContext);
+
+	static HRESULT	WriteBankToFile(__in PVOID pContext,
+										__in PBYTE pBank,
+											__in ULONG cbData,
+												__in UINT64 cbPosition);
+
+	static HRESULT	PushBankToSink(__in PVOID pContext,
+										__in PBYTE pBank,
+											__in ULONG cbData,
+												__in UINT64 cbPosition);
 };
@@ -0,0 +1,2300 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer16.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "Omfoo_Alpha_Header.h"
+#include "ContainerLayer16.h"
+#include "DllMain.h"
+
+#include "MiscStatic.h"
+using namespace NsMiscStatic;
+
+//*********************************************************************************************************************
+//	Constructor
+//	WARNING: This class is not meant to be instantiated on the stack.
+//	It assumes that its C++ operator new() has already zeroed all of its memory.
+//*********************************************************************************************************************
+CContainerLayer16::CContainerLayer16(void)
+{
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//*********************************************************************************************************************
+CContainerLayer16::~CContainerLayer16(void)
+{
+	if (m_apFrameMaps)
+	{
+		for (ULONG i = 0; i < m_cMDATs; i++)
+		{
+			if (m_apFrameMaps[i])
+			{
+				MemFree(m_apFrameMaps[i]);
+			}
+		}
+		MemFree(m_apFrameMaps);
+	}
+
+	if (m_apMpegIndexes)
+	{
+		for (ULONG i = 0; i < m_cMDATs; i++)
+		{
+			if (m_apMpegIndexes[i])
+			{
+				MemFree(m_apMpegIndexes[i]);
+			}
+		}
+		MemFree(m_apMpegIndexes);
+	}
+
+	if (m_apTiffIndexes)
+	{
+		for (ULONG i = 0; i < m_cMDATs; i++)
+		{
+			if (m_apTiffIndexes[i])
+			{
+				MemFree(m_apTiffIndexes[i]);
+			}
+		}
+		MemFree(m_apTiffIndexes);
+	}
+}
+
+//*********************************************************************************************************************
+//	Allocate one (empty) frame map pointer, one (empty) MPEG picture index pointer, and one (empty) TIFF image index
+//	pointer for each entry in m_aMdatTable[]. The maps and indexes themselves are not created until somebody asks for
+//	them. See GetMdatFrameMap().
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::Load(PCWSTR pwzFileName)
+{
+	HRESULT hr = __super::Load(pwzFileName);
+	if (SUCCEEDED(hr) && m_cMDATs)
+	{
+		m_apFrameMaps		= (PMDAT_FRAME_MAP*)MemAlloc(m_cMDATs * sizeof(PMDAT_FRAME_MAP));
+		m_apMpegIndexes		= (PMDAT_MPEG_INDEX*)MemAlloc(m_cMDATs * sizeof(PMDAT_MPEG_INDEX));
+		m_apTiffIndexes		= (PMDAT_TIFF_INDEX*)MemAlloc(m_cMDATs * sizeof(PMDAT_TIFF_INDEX));
+		if ((NULL == m_apFrameMaps) || (NULL == m_apMpegIndexes) || (NULL == m_apTiffIndexes))
+		{
+			hr = E_OUTOFMEMORY;
+		}
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMediaData classes.
+//	Retrieves the number of frames in the MDAT's frame map.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatFrameCount(__in ULONG idx, __out PULONG pnFrames)
+{
+	PMDAT_FRAME_MAP	pMap	= NULL;
+	HRESULT			hr		= S_OK;
+
+	if (IsBadWritePointer(pnFrames, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pnFrames = 0;
+
+	if (SUCCEEDED(hr = GetMdatFrameMap(idx, &pMap)))
+	{
+		*pnFrames = pMap->nFrames;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMediaData classes.
+//	Retrieves the position and size of one frame. The position is measured from the first byte of the payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatFrameExtent(__in ULONG idx,
+												__in ULONG iFrame,
+													__out PUINT64 pcbOffset,
+														__out PULONG pcbLength)
+{
+	PMDAT_FRAME_MAP	pMap		= NULL;
+	UINT64			cbLength	= 0;
+	HRESULT			hr			= S_OK;
+
+	if (IsBadWritePointer(pcbOffset, sizeof(UINT64)) || IsBadWritePointer(pcbLength, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pcbOffset = 0;
+	*pcbLength = 0;
+
+	if (FAILED(hr = GetMdatFrameMap(idx, &pMap)))
+	{
+		return hr;
+	}
+
+	if (iFrame >= pMap->nFrames)
+	{
+		return E_INVALIDARG;
+	}
+
+	// A single frame can't be larger than 4GB.
+	cbLength = GetFrameOffset(pMap, iFrame + 1) - GetFrameOffset(pMap, iFrame);
+	if (cbLength > ULONG_MAX)
+	{
+		return OMF_E_SIZE_SURPRISE;
+	}
+
+	*pcbOffset = GetFrameOffset(pMap, iFrame);
+	*pcbLength = ULONG(cbLength);
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMediaData classes.
+//	Reads nFrames consecutive frames (starting with iFirstFrame) into caller's buffer, back to back.
+//
+//	Our frame maps have no gaps - each frame ends where the next one begins - so any run of consecutive frames is
+//	also a run of consecutive bytes in the OMF file. That means we can always read them with one call to SeekRead(),
+//	no matter how many frames our caller asks for.
+//
+//	The aFrameLengths argument is optional. If it's not NULL then it must point to an array of nFrames ULONGs, and
+//	we fill it with the size of each frame - even if we return OMF_E_INSUFFICIENT_BUFFER.
+//	The pcbRequired argument is required. On exit it holds the total size of all of the frames.
+//	If pBuffer is NULL or cbBuffer is too small then we return OMF_E_INSUFFICIENT_BUFFER.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ReadMdatFrames(__in ULONG idx,
+											__in ULONG iFirstFrame,
+												__in ULONG nFrames,
+													__in ULONG cbBuffer,
+														__out_opt PVOID pBuffer,
+															__out_opt PULONG aFrameLengths,
+																__out PULONG pcbRequired)
+{
+	PMDAT_FRAME_MAP	pMap		= NULL;
+	UINT64			cbTotal		= 0;
+	UINT64			cbFrame		= 0;
+	HRESULT			hr			= S_OK;
+
+	if (IsBadWritePointer(pcbRequired, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pcbRequired = 0;
+
+	if (FAILED(hr = GetMdatFrameMap(idx, &pMap)))
+	{
+		return hr;
+	}
+
+	// Make sure the range of frames lives entirely inside the map.
+	if ((nFrames == 0) || (iFirstFrame >= pMap->nFrames) || (nFrames > pMap->nFrames - iFirstFrame))
+	{
+		return E_INVALIDARG;
+	}
+
+	if (aFrameLengths)
+	{
+		if (IsBadWritePointer(aFrameLengths, nFrames * sizeof(ULONG)))
+		{
+			return E_POINTER;
+		}
+
+		for (ULONG i = 0; i < nFrames; i++)
+		{
+			cbFrame = GetFrameOffset(pMap, iFirstFrame + i + 1) - GetFrameOffset(pMap, iFirstFrame + i);
+			aFrameLengths[i] = (cbFrame > ULONG_MAX) ? ULONG_MAX : ULONG(cbFrame);
+		}
+	}
+
+	// The total can't be larger than 4GB.
+	cbTotal = GetFrameOffset(pMap, iFirstFrame + nFrames) - GetFrameOffset(pMap, iFirstFrame);
+	if (cbTotal > ULONG_MAX)
+	{
+		return OMF_E_SIZE_SURPRISE;
+	}
+
+	*pcbRequired = ULONG(cbTotal);
+
+	// Under these circumstances this is not really an error because the destination buffer is optional.
+	if ((NULL == pBuffer) || (cbBuffer < cbTotal))
+	{
+		return OMF_E_INSUFFICIENT_BUFFER;
+	}
+
+	if (IsBadWritePointer(pBuffer, ULONG(cbTotal)))
+	{
+		return E_POINTER;
+	}
+
+	if (cbTotal)
+	{
+		hr = SeekRead(m_aMdatTable[idx].cbPayloadOffset + GetFrameOffset(pMap, iFirstFrame), pBuffer, UINT32(cbTotal));
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMpegData class.
+//	Retrieves the number of pictures in the MDAT's MPEG picture index.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatPictureCount(__in ULONG idx, __out PULONG pnPictures)
+{
+	PMDAT_MPEG_INDEX	pIndex	= NULL;
+	HRESULT				hr		= S_OK;
+
+	if (IsBadWritePointer(pnPictures, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pnPictures = 0;
+
+	if (SUCCEEDED(hr = GetMdatMpegIndex(idx, &pIndex)))
+	{
+		*pnPictures = pIndex->nPictures;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMpegData class.
+//	Retrieves everything we know about one picture. The offset is measured from the first byte of the payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatPictureInfo(__in ULONG idx,
+												__in ULONG iPicture,
+													__out POMFOO_MPEG_PICTURE_INFO pInfo)
+{
+	PMDAT_MPEG_INDEX	pIndex		= NULL;
+	PMPEG_PICTURE_ENTRY	pPicture	= NULL;
+	UINT64				cbEnd		= 0;
+	HRESULT				hr			= S_OK;
+
+	if (IsBadWritePointer(pInfo, sizeof(OMFOO_MPEG_PICTURE_INFO)))
+	{
+		return E_POINTER;
+	}
+
+	ZeroMemory(pInfo, sizeof(OMFOO_MPEG_PICTURE_INFO));
+
+	if (FAILED(hr = GetMdatMpegIndex(idx, &pIndex)))
+	{
+		return hr;
+	}
+
+	if (iPicture >= pIndex->nPictures)
+	{
+		return E_INVALIDARG;
+	}
+
+	// Each picture ends where the next one begins. The last one ends at the end of the payload.
+	pPicture	= &pIndex->aPictures[iPicture];
+	cbEnd		= (iPicture + 1 < pIndex->nPictures) ? pPicture[1].cbOffset : m_aMdatTable[idx].cbPayloadLength;
+
+	pInfo->cbOffset				= pPicture->cbOffset;
+	pInfo->cbLength				= cbEnd - pPicture->cbOffset;
+	pInfo->iGop					= pPicture->iGop;
+	pInfo->dwFlags				= pPicture->bFlags;
+	pInfo->wTemporalReference	= pPicture->wTemporalReference;
+	pInfo->bPictureType			= pPicture->bPictureType;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMpegData class.
+//	Retrieves the number of GOPs in the MDAT's MPEG picture index.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatGopCount(__in ULONG idx, __out PULONG pnGops)
+{
+	PMDAT_MPEG_INDEX	pIndex	= NULL;
+	HRESULT				hr		= S_OK;
+
+	if (IsBadWritePointer(pnGops, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pnGops = 0;
+
+	if (SUCCEEDED(hr = GetMdatMpegIndex(idx, &pIndex)))
+	{
+		*pnGops = pIndex->nGops;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfMpegData class.
+//	Retrieves everything we know about one GOP. A GOP begins where its first picture begins, and ends where the next
+//	GOP begins (or at the end of the payload). So the range [cbOffset, cbOffset + cbLength) can be cut out of the
+//	payload as is. If the GOP doesn't begin with its own sequence header then a decoder also needs the one that's
+//	described by cbSequenceHeaderOffset and cbSequenceHeaderLength.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatGopInfo(__in ULONG idx,
+											__in ULONG iGop,
+												__out POMFOO_MPEG_GOP_INFO pInfo)
+{
+	PMDAT_MPEG_INDEX	pIndex			= NULL;
+	PMPEG_GOP_ENTRY		pGop			= NULL;
+	ULONG				iNextPicture	= 0;
+	UINT64				cbEnd			= 0;
+	HRESULT				hr				= S_OK;
+
+	if (IsBadWritePointer(pInfo, sizeof(OMFOO_MPEG_GOP_INFO)))
+	{
+		return E_POINTER;
+	}
+
+	ZeroMemory(pInfo, sizeof(OMFOO_MPEG_GOP_INFO));
+
+	if (FAILED(hr = GetMdatMpegIndex(idx, &pIndex)))
+	{
+		return hr;
+	}
+
+	if (iGop >= pIndex->nGops)
+	{
+		return E_INVALIDARG;
+	}
+
+	pGop			= &pIndex->aGops[iGop];
+	iNextPicture	= (iGop + 1 < pIndex->nGops) ? pGop[1].iFirstPicture : pIndex->nPictures;
+	cbEnd			= (iNextPicture < pIndex->nPictures) ? pIndex->aPictures[iNextPicture].cbOffset
+														: m_aMdatTable[idx].cbPayloadLength;
+
+	pInfo->cbOffset					= pIndex->aPictures[pGop->iFirstPicture].cbOffset;
+	pInfo->cbLength					= cbEnd - pInfo->cbOffset;
+	pInfo->cbSequenceHeaderOffset	= pGop->cbSequenceOffset;
+	pInfo->cbSequenceHeaderLength	= pGop->cbSequenceLength;
+	pInfo->iFirstPicture			= pGop->iFirstPicture;
+	pInfo->nPictures				= iNextPicture - pGop->iFirstPicture;
+	pInfo->dwFlags					= pGop->dwFlags;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfTiffData class.
+//	Retrieves the number of images in the MDAT's TIFF image index.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatTiffImageCount(__in ULONG idx, __out PULONG pnImages)
+{
+	PMDAT_TIFF_INDEX	pIndex	= NULL;
+	HRESULT				hr		= S_OK;
+
+	if (IsBadWritePointer(pnImages, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pnImages = 0;
+
+	if (SUCCEEDED(hr = GetMdatTiffIndex(idx, &pIndex)))
+	{
+		*pnImages = pIndex->nImages;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfTiffData class.
+//	Retrieves everything we know about one image. The offset is measured from the first byte of the payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatTiffImageInfo(__in ULONG idx,
+												__in ULONG iImage,
+													__out POMFOO_TIFF_IMAGE_INFO pInfo)
+{
+	PMDAT_TIFF_INDEX	pIndex	= NULL;
+	PTIFF_IMAGE_ENTRY	pImage	= NULL;
+	HRESULT				hr		= S_OK;
+
+	if (IsBadWritePointer(pInfo, sizeof(OMFOO_TIFF_IMAGE_INFO)))
+	{
+		return E_POINTER;
+	}
+
+	ZeroMemory(pInfo, sizeof(OMFOO_TIFF_IMAGE_INFO));
+
+	if (FAILED(hr = GetMdatTiffIndex(idx, &pIndex)))
+	{
+		return hr;
+	}
+
+	if (iImage >= pIndex->nImages)
+	{
+		return E_INVALIDARG;
+	}
+
+	pImage = &pIndex->aImages[iImage];
+
+	pInfo->cbIfdOffset		= pImage->cbIfdOffset;
+	pInfo->nWidth			= pImage->nWidth;
+	pInfo->nLength			= pImage->nLength;
+	pInfo->nStrips			= pImage->nStrips;
+	pInfo->nRowsPerStrip	= pImage->nRowsPerStrip;
+	pInfo->nTileWidth		= pImage->nTileWidth;
+	pInfo->nTileLength		= pImage->nTileLength;
+	pInfo->wCompression		= pImage->wCompression;
+	pInfo->wPhotometric		= pImage->wPhotometric;
+	pInfo->wBitsPerSample	= pImage->wBitsPerSample;
+	pInfo->wSamplesPerPixel	= pImage->wSamplesPerPixel;
+	pInfo->wPlanarConfig	= pImage->wPlanarConfig;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfTiffData class.
+//	Retrieves the position and size of one strip (or tile). The position is measured from the first byte of the
+//	payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatTiffStripExtent(__in ULONG idx,
+													__in ULONG iImage,
+														__in ULONG iStrip,
+															__out PUINT64 pcbOffset,
+																__out PULONG pcbLength)
+{
+	PMDAT_TIFF_INDEX	pIndex	= NULL;
+	PTIFF_STRIP_ENTRY	pStrip	= NULL;
+	HRESULT				hr		= S_OK;
+
+	if (IsBadWritePointer(pcbOffset, sizeof(UINT64)) || IsBadWritePointer(pcbLength, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pcbOffset = 0;
+	*pcbLength = 0;
+
+	if (FAILED(hr = GetMdatTiffIndex(idx, &pIndex)))
+	{
+		return hr;
+	}
+
+	if ((iImage >= pIndex->nImages) || (iStrip >= pIndex->aImages[iImage].nStrips))
+	{
+		return E_INVALIDARG;
+	}
+
+	pStrip = &pIndex->aStrips[pIndex->aImages[iImage].iFirstStrip + iStrip];
+
+	*pcbOffset = pStrip->cbOffset;
+	*pcbLength = pStrip->cbLength;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfTiffData class.
+//	Reads nStrips consecutive strips of one image (starting with iFirstStrip) into caller's buffer, back to back.
+//
+//	Unlike frames, strips don't have to be back to back in the payload. They're usually in ascending order with no
+//	gaps, but a TIFF writer is free to put them anywhere. So we read each run of adjacent strips with one call to
+//	SeekRead(), and we start a new run whenever the next strip isn't where the last one ended.
+//
+//	The aStripLengths argument is optional. If it's not NULL then it must point to an array of nStrips ULONGs, and
+//	we fill it with the size of each strip - even if we return OMF_E_INSUFFICIENT_BUFFER.
+//	The pcbRequired argument is required. On exit it holds the total size of all of the strips.
+//	If pBuffer is NULL or cbBuffer is too small then we return OMF_E_INSUFFICIENT_BUFFER.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ReadMdatTiffStrips(__in ULONG idx,
+												__in ULONG iImage,
+													__in ULONG iFirstStrip,
+														__in ULONG nStrips,
+															__in ULONG cbBuffer,
+																__out_opt PVOID pBuffer,
+																	__out_opt PULONG aStripLengths,
+																		__out PULONG pcbRequired)
+{
+	PMDAT_TIFF_INDEX	pIndex		= NULL;
+	PTIFF_STRIP_ENTRY	aStrips		= NULL;
+	PBYTE				pDest		= PBYTE(pBuffer);
+	UINT64				cbTotal		= 0;
+	ULONG				iRun		= 0;
+	ULONG				cbRun		= 0;
+	HRESULT				hr			= S_OK;
+
+	if (IsBadWritePointer(pcbRequired, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pcbRequired = 0;
+
+	if (FAILED(hr = GetMdatTiffIndex(idx, &pIndex)))
+	{
+		return hr;
+	}
+
+	// Make sure the range of strips lives entirely inside the image.
+	if ((iImage >= pIndex->nImages) ||
+		(nStrips == 0) ||
+		(iFirstStrip >= pIndex->aImages[iImage].nStrips) ||
+		(nStrips > pIndex->aImages[iImage].nStrips - iFirstStrip))
+	{
+		return E_INVALIDARG;
+	}
+
+	aStrips = &pIndex->aStrips[pIndex->aImages[iImage].iFirstStrip + iFirstStrip];
+
+	if (aStripLengths)
+	{
+		if (IsBadWritePointer(aStripLengths, nStrips * sizeof(ULONG)))
+		{
+			return E_POINTER;
+		}
+
+		for (ULONG i = 0; i < nStrips; i++)
+		{
+			aStripLengths[i] = aStrips[i].cbLength;
+		}
+	}
+
+	// The total can't be larger than 4GB.
+	for (ULONG i = 0; i < nStrips; i++)
+	{
+		cbTotal += aStrips[i].cbLength;
+	}
+
+	if (cbTotal > ULONG_MAX)
+	{
+		return OMF_E_SIZE_SURPRISE;
+	}
+
+	*pcbRequired = ULONG(cbTotal);
+
+	// Under these circumstances this is not really an error because the destination buffer is optional.
+	if ((NULL == pBuffer) || (cbBuffer < cbTotal))
+	{
+		return OMF_E_INSUFFICIENT_BUFFER;
+	}
+
+	if (IsBadWritePointer(pBuffer, ULONG(cbTotal)))
+	{
+		return E_POINTER;
+	}
+
+	for (ULONG i = 0; i < nStrips; i++)
+	{
+		cbRun += aStrips[i].cbLength;
+
+		// Keep going as long as the next strip begins where this one ends.
+		if ((i + 1 < nStrips) && (UINT64(aStrips[i].cbOffset) + aStrips[i].cbLength == aStrips[i + 1].cbOffset))
+		{
+			continue;
+		}
+
+		if (cbRun)
+		{
+			if (FAILED(hr = SeekRead(m_aMdatTable[idx].cbPayloadOffset + aStrips[iRun].cbOffset, pDest, cbRun)))
+			{
+				return hr;
+			}
+			pDest += cbRun;
+		}
+
+		iRun	= i + 1;
+		cbRun	= 0;
+	}
+
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Returns the frame map for the nth entry in m_aMdatTable[]. Creates it if it doesn't exist yet.
+//	The map belongs to us - so our caller must not free it.
+//
+//	Two threads can race to create the same map. If that happens then the loser throws its map away and uses the
+//	winner's map instead. Once a map is published in m_apFrameMaps[] it never changes until we are destroyed.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatFrameMap(__in ULONG idx, __out PMDAT_FRAME_MAP* ppMap)
+{
+	PMDAT_FRAME_MAP	pMap	= NULL;
+	PVOID			pPrev	= NULL;
+	HRESULT			hr		= S_OK;
+
+	*ppMap = NULL;
+
+	if ((NULL == m_aMdatTable) || (NULL == m_apFrameMaps) || (idx >= m_cMDATs))
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+
+	pMap = m_apFrameMaps[idx];
+	if (NULL == pMap)
+	{
+		if (FAILED(hr = LoadMdatFrameMap(idx, &pMap)))
+		{
+			return hr;
+		}
+
+		pPrev = InterlockedCompareExchangePointer((PVOID volatile*)&m_apFrameMaps[idx], pMap, NULL);
+		if (pPrev)
+		{
+			// Another thread beat us to it.
+			MemFree(pMap);
+			pMap = PMDAT_FRAME_MAP(pPrev);
+		}
+	}
+
+	*ppMap = pMap;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Returns the MPEG picture index for the nth entry in m_aMdatTable[]. Creates it if it doesn't exist yet.
+//	The index belongs to us - so our caller must not free it. This has the same race rules as GetMdatFrameMap().
+//	Returns OMF_E_CANT_COMPLETE if the MDAT is not an MPEG video elementary stream.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatMpegIndex(__in ULONG idx, __out PMDAT_MPEG_INDEX* ppIndex)
+{
+	PMDAT_MPEG_INDEX	pIndex	= NULL;
+	PVOID				pPrev	= NULL;
+	HRESULT				hr		= S_OK;
+
+	*ppIndex = NULL;
+
+	if ((NULL == m_aMdatTable) || (NULL == m_apMpegIndexes) || (idx >= m_cMDATs))
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+
+	pIndex = m_apMpegIndexes[idx];
+	if (NULL == pIndex)
+	{
+		if (!IsScannableMpeg(m_aMdatTable[idx]))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+
+		if (FAILED(hr = ScanMpegPictureIndex(m_aMdatTable[idx], &pIndex)))
+		{
+			return hr;
+		}
+
+		pPrev = InterlockedCompareExchangePointer((PVOID volatile*)&m_apMpegIndexes[idx], pIndex, NULL);
+		if (pPrev)
+		{
+			// Another thread beat us to it.
+			MemFree(pIndex);
+			pIndex = PMDAT_MPEG_INDEX(pPrev);
+		}
+	}
+
+	*ppIndex = pIndex;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Returns the TIFF image index for the nth entry in m_aMdatTable[]. Creates it if it doesn't exist yet.
+//	The index belongs to us - so our caller must not free it. This has the same race rules as GetMdatFrameMap().
+//	Returns OMF_E_CANT_COMPLETE if the MDAT is not a TIFF file.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetMdatTiffIndex(__in ULONG idx, __out PMDAT_TIFF_INDEX* ppIndex)
+{
+	PMDAT_TIFF_INDEX	pIndex	= NULL;
+	PVOID				pPrev	= NULL;
+	HRESULT				hr		= S_OK;
+
+	*ppIndex = NULL;
+
+	if ((NULL == m_aMdatTable) || (NULL == m_apTiffIndexes) || (idx >= m_cMDATs))
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+
+	pIndex = m_apTiffIndexes[idx];
+	if (NULL == pIndex)
+	{
+		if (!IsParsableTiff(m_aMdatTable[idx]))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+
+		if (FAILED(hr = ParseTiffImageIndex(m_aMdatTable[idx], &pIndex)))
+		{
+			return hr;
+		}
+
+		pPrev = InterlockedCompareExchangePointer((PVOID volatile*)&m_apTiffIndexes[idx], pIndex, NULL);
+		if (pPrev)
+		{
+			// Another thread beat us to it.
+			MemFree(pIndex);
+			pIndex = PMDAT_TIFF_INDEX(pPrev);
+		}
+	}
+
+	*ppIndex = pIndex;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfJpegData class.
+//	Copies the first element of each frame in the MDAT's frame map to caller's array. This has the same rules as
+//	CoreReadPosition64Array(), so it can stand in for the frame index property when the MDAT doesn't have one.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ReadMdatFrameOffsets(__in ULONG idx,
+													__in ULONG nMaxElements,
+														__out_opt PUINT64 pArrayBase,
+															__out PULONG pnActualElements)
+{
+	PMDAT_FRAME_MAP	pMap	= NULL;
+	HRESULT			hr		= S_OK;
+
+	if (IsBadWritePointer(pnActualElements, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pnActualElements = 0;
+
+	if (FAILED(hr = GetMdatFrameMap(idx, &pMap)))
+	{
+		return hr;
+	}
+
+	*pnActualElements = pMap->nFrames;
+
+	// Under these circumstances this is not really an error because the destination buffer is optional.
+	if ((NULL == pArrayBase) || (nMaxElements < pMap->nFrames))
+	{
+		return OMF_E_INSUFFICIENT_BUFFER;
+	}
+
+	if (IsBadWritePointer(pArrayBase, pMap->nFrames * sizeof(UINT64)))
+	{
+		return E_POINTER;
+	}
+
+	if (pMap->dwSource == FRAME_MAP_FIXED_STRIDE)
+	{
+		for (ULONG i = 0; i < pMap->nFrames; i++)
+		{
+			pArrayBase[i] = GetFrameOffset(pMap, i);
+		}
+	}
+	else
+	{
+		CopyMemory(pArrayBase, pMap->a, pMap->nFrames * sizeof(UINT64));
+	}
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private static helper.
+//	Returns the position of frame iFrame, measured from the first byte of the payload. The iFrame argument can be
+//	anything from zero to pMap->nFrames (inclusive), so GetFrameOffset(pMap, n + 1) is always where frame n ends.
+//*********************************************************************************************************************
+UINT64 CContainerLayer16::GetFrameOffset(__in PMDAT_FRAME_MAP pMap, __in ULONG iFrame)
+{
+	if (pMap->dwSource == FRAME_MAP_FIXED_STRIDE)
+	{
+		return pMap->cbFirstFrame + (UINT64(iFrame) * pMap->cbStride);
+	}
+	else
+	{
+		return pMap->a[iFrame];
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper for GetMdatFrameMap().
+//	Creates a new MDAT_FRAME_MAP for the MDAT. Usually we get it from the MDAT's frame index property.
+//
+//	DV and uncompressed video don't need a frame index at all because every frame is the same size. For those we
+//	compute the frame size from the media descriptor, and we never touch the frame index property - which can be
+//	several megabytes for a long HD clip.
+//
+//	A JPEG payload can be mapped even if its frame index property is missing, malformed, or just plain wrong.
+//	Every frame begins with an SOI marker, so if we can't trust the property then we scan the payload for markers.
+//
+//	A TIFF payload is mapped from its own strip offsets. There's no frame index property to read.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::LoadMdatFrameMap(__in ULONG idx, __out PMDAT_FRAME_MAP* ppMap)
+{
+	MDAT_CACHE_ENTRY& rCE = m_aMdatTable[idx];
+
+	if (SUCCEEDED(ComputeFixedStrideFrameMap(rCE, ppMap)))
+	{
+		return S_OK;
+	}
+
+	if (IsParsableTiff(rCE))
+	{
+		return ComputeTiffFrameMap(idx, ppMap);
+	}
+
+	HRESULT hr = DecodeMdatFrameIndex(rCE, ppMap);
+
+	if (IsScannableJpeg(rCE))
+	{
+		if (SUCCEEDED(hr) && (!VerifyJpegFrameMap(rCE, *ppMap)))
+		{
+			MemFree(*ppMap);
+			*ppMap	= NULL;
+			hr		= OMF_E_BAD_ARRAY;
+		}
+
+		if (FAILED(hr))
+		{
+			// If the scan doesn't find anything then report the original problem.
+			HRESULT hrScan = ScanJpegFrameMap(rCE, ppMap);
+			if (SUCCEEDED(hrScan))
+			{
+				hr = hrScan;
+			}
+		}
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatFrameMap().
+//	Creates a FRAME_MAP_FIXED_STRIDE map for the payloads where every frame is the same size. That's DV (a JPEG MDAT
+//	with a CDCI media descriptor and 'DV/C' compression) and uncompressed video (an IDAT MDAT with a CDCI or RGBA
+//	media descriptor and no compression, or 'AUNC' compression).
+//
+//	The frame size comes from OMFI:DIDD:FrameSampleSize or OMFI:DIDD:DIDDImageSize if the media descriptor has one.
+//	Otherwise we work it out for ourselves. The first frame begins at OMFI:DIDD:FirstFrameOffset, if it exists. Any
+//	bytes after the last whole frame are not part of any frame.
+//
+//	Returns OMF_E_CANT_COMPLETE if this is not one of those payloads, or if we can't figure out the frame size.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ComputeFixedStrideFrameMap(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_FRAME_MAP* ppMap)
+{
+	PMDAT_FRAME_MAP	pMap			= NULL;
+	ULONG			cbProperty		= 0;
+	UINT64			cbFirstFrame	= 0;
+	UINT64			cbStride		= 0;
+	UINT64			nFrames			= 0;
+	BOOL			fIsDV			= FALSE;
+	HRESULT			hr				= S_OK;
+
+	*ppMap = NULL;
+
+	if ((rCE.oMDAT.dwFourCC == FCC('JPEG')) && (rCE.oMDES.dwFourCC == FCC('CDCI')))
+	{
+		if (rCE.dwNonambiguousCompressionFourCC != FCC('DV/C'))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+		fIsDV = TRUE;
+	}
+	else if ((rCE.oMDAT.dwFourCC == FCC('IDAT')) && (rCE.oMDES.dwFourCC == FCC('CDCI')))
+	{
+		if ((rCE.dwNonambiguousCompressionFourCC != 0) &&
+			(rCE.dwNonambiguousCompressionFourCC != FCC('NONE')) &&
+			(rCE.dwNonambiguousCompressionFourCC != FCC('AUNC')))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+	}
+	else if ((rCE.oMDAT.dwFourCC == FCC('IDAT')) && (rCE.oMDES.dwFourCC == FCC('RGBA')))
+	{
+		if ((rCE.dwNonambiguousCompressionFourCC != 0) && (rCE.dwNonambiguousCompressionFourCC != FCC('NONE')))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+	}
+	else
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	// OMFI:DIDD:FirstFrameOffset aka OMFI:DIDD:DIDDFirstFrameOffset, omfi:Int32, omfi:Long
+	if (SUCCEEDED(RordReadUInt32(rCE.oMDES, ePropDiddFirstFrameOffset, PUINT32(&cbProperty))) ||
+		SUCCEEDED(RordReadUInt32(rCE.oMDES, ePropDiddDIDDFirstFrameOffset, PUINT32(&cbProperty))))
+	{
+		cbFirstFrame = cbProperty;
+	}
+
+	// OMFI:DIDD:FrameSampleSize aka OMFI:DIDD:DIDDFrameSampleSize, omfi:Int32, omfi:Long
+	// OMFI:DIDD:DIDDImageSize aka OMFI:DIDD:DIDImageSize, omfi:Int32, omfi:Long
+	cbProperty = 0;
+	if (SUCCEEDED(RordReadUInt32(rCE.oMDES, ePropDiddFrameSampleSize, PUINT32(&cbProperty))) ||
+		SUCCEEDED(RordReadUInt32(rCE.oMDES, ePropDiddDIDDFrameSampleSize, PUINT32(&cbProperty))) ||
+		SUCCEEDED(RordReadUInt32(rCE.oMDES, ePropDiddDIDImageSize, PUINT32(&cbProperty))) ||
+		SUCCEEDED(RordReadUInt32(rCE.oMDES, ePropDiddDIDDImageSize, PUINT32(&cbProperty))))
+	{
+		cbStride = cbProperty;
+	}
+
+	if (cbStride == 0)
+	{
+		hr = fIsDV ? GetDvFrameSize(rCE, cbFirstFrame, &cbStride) : GetUncompressedFrameSize(rCE, &cbStride);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	if ((cbStride == 0) || (cbFirstFrame >= rCE.cbPayloadLength))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	nFrames = (rCE.cbPayloadLength - cbFirstFrame) / cbStride;
+	if ((nFrames == 0) || (nFrames > ULONG_MAX))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	// We don't need the a[] array, so this is all there is.
+	pMap = PMDAT_FRAME_MAP(MemAlloc(sizeof(MDAT_FRAME_MAP)));
+	if (NULL == pMap)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pMap->nFrames		= ULONG(nFrames);
+	pMap->dwSource		= FRAME_MAP_FIXED_STRIDE;
+	pMap->cbFirstFrame	= cbFirstFrame;
+	pMap->cbStride		= cbStride;
+
+	*ppMap = pMap;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for ComputeFixedStrideFrameMap().
+//	Works out the size of one DV frame by looking at the first frame's DIF blocks.
+//
+//	Every DV frame is made of 80-byte DIF blocks, 150 of them per DIF sequence. The DSF bit in the header block tells
+//	us if there are 10 DIF sequences per channel (525/60) or 12 of them (625/50). DV25 has one channel, DV50 has two,
+//	and DVCPRO HD has four. We get that from the STYPE field of the VAUX source pack (0x60) if we can find it in the
+//	first DIF sequence. Otherwise we assume one channel.
+//
+//	As a sanity check, the next frame (if there is one) must begin with the same header block as the first one.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetDvFrameSize(__in MDAT_CACHE_ENTRY& rCE,
+											__in UINT64 cbFirstFrame,
+												__out PUINT64 pcbFrame)
+{
+	enum {
+		DIF_BLOCK_SIZE		= 80,
+		DIF_SEQUENCE_SIZE	= 150 * DIF_BLOCK_SIZE,
+		DIF_VAUX_FIRST		= 3,		// the first of the three VAUX blocks in each DIF sequence
+		DIF_VAUX_BLOCKS		= 3,
+		DIF_PACK_SIZE		= 5,
+		DIF_PACKS_PER_BLOCK	= 15,
+		DIF_HEAD_SIZE		= (DIF_VAUX_FIRST + DIF_VAUX_BLOCKS) * DIF_BLOCK_SIZE,	// everything up to the last VAUX block
+	};
+
+	BYTE	aHead[DIF_HEAD_SIZE]	= {0};
+	BYTE	aNext[4]				= {0};
+	ULONG	nChannels				= 1;
+	UINT64	cbFrame					= 0;
+	HRESULT	hr						= S_OK;
+
+	*pcbFrame = 0;
+
+	if (cbFirstFrame + sizeof(aHead) > rCE.cbPayloadLength)
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbFirstFrame, aHead, sizeof(aHead))))
+	{
+		return hr;
+	}
+
+	// The header block's ID is SCT=0, Dseq=0, DBN=0.
+	if ((aHead[0] & 0xE0) || (aHead[1] & 0xF0) || aHead[2])
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	// Look for the VAUX source pack. PC3 holds the 50/60 bit and the 5-bit STYPE.
+	for (ULONG iBlock = DIF_VAUX_FIRST; iBlock < DIF_VAUX_FIRST + DIF_VAUX_BLOCKS; iBlock++)
+	{
+		PBYTE pPacks = &aHead[(iBlock * DIF_BLOCK_SIZE) + 3];
+		for (ULONG iPack = 0; iPack < DIF_PACKS_PER_BLOCK; iPack++)
+		{
+			PBYTE pPack = &pPacks[iPack * DIF_PACK_SIZE];
+			if (pPack[0] == 0x60)
+			{
+				switch (pPack[3] & 0x1F)
+				{
+				case 0x04:
+					nChannels = 2;		// DV50
+					break;
+				case 0x14:
+				case 0x15:
+				case 0x18:
+					nChannels = 4;		// DVCPRO HD
+					break;
+				default:
+					nChannels = 1;		// DV25
+					break;
+				}
+				goto L_FoundSourcePack;
+			}
+		}
+	}
+
+L_FoundSourcePack:
+	// DSF is the high bit of the header block's fourth byte.
+	cbFrame = UINT64(nChannels) * ((aHead[3] & 0x80) ? 12 : 10) * DIF_SEQUENCE_SIZE;
+
+	if (cbFirstFrame + cbFrame + sizeof(aNext) <= rCE.cbPayloadLength)
+	{
+		if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbFirstFrame + cbFrame, aNext, sizeof(aNext))))
+		{
+			return hr;
+		}
+
+		if (0 != memcmp(aHead, aNext, sizeof(aNext)))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+	}
+
+	*pcbFrame = cbFrame;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for ComputeFixedStrideFrameMap().
+//	Works out the size of one uncompressed frame from the media descriptor's StoredWidth and StoredHeight.
+//
+//	For a CDCI the bits per pixel are ComponentWidth + PaddingBits for luma, plus two chroma components that are
+//	shared by HorizontalSubsampling * VerticalSubsampling pixels. For an RGBA they're the sum of the PixelStructure.
+//	Each image is padded out to a multiple of ImageAlignmentFactor. If the FrameLayout is LT_SEPARATE_FIELDS then
+//	StoredHeight is the height of one field, and each frame has two of them.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::GetUncompressedFrameSize(__in MDAT_CACHE_ENTRY& rCE, __out PUINT64 pcbFrame)
+{
+	ULONG	nStoredWidth	= 0;
+	ULONG	nStoredHeight	= 0;
+	ULONG	nAlignment		= 0;
+	WORD	wFrameLayout	= LT_FULL_FRAME;
+	UINT64	cBitsPerImage	= 0;
+	UINT64	cbImage			= 0;
+	HRESULT	hr				= S_OK;
+
+	*pcbFrame = 0;
+
+	if (FAILED(hr = RordReadUInt32(rCE.oMDES, ePropDiddStoredWidth, PUINT32(&nStoredWidth))) ||
+		FAILED(hr = RordReadUInt32(rCE.oMDES, ePropDiddStoredHeight, PUINT32(&nStoredHeight))))
+	{
+		return hr;
+	}
+
+	if (rCE.oMDES.dwFourCC == FCC('CDCI'))
+	{
+		ULONG	nComponentWidth	= 8;
+		ULONG	nHorizSubsample	= 1;
+		ULONG	nVertSubsample	= 1;
+		WORD	wPaddingBits	= 0;
+
+		// These are all optional.
+		RordReadUInt32(rCE.oMDES, ePropCdciComponentWidth, PUINT32(&nComponentWidth));
+		RordReadUInt32(rCE.oMDES, ePropCdciHorizontalSubsampling, PUINT32(&nHorizSubsample));
+		RordReadUInt32(rCE.oMDES, ePropCdciVerticalSubsampling, PUINT32(&nVertSubsample));
+		RordReadUInt16(rCE.oMDES, ePropCdciPaddingBits, &wPaddingBits);
+
+		if ((nComponentWidth == 0) || (nComponentWidth > 32) ||
+			(nHorizSubsample == 0) || (nHorizSubsample > 4) ||
+			(nVertSubsample == 0) || (nVertSubsample > 4))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+
+		cBitsPerImage	= UINT64(nStoredWidth) * nStoredHeight * (nComponentWidth + wPaddingBits);
+		cBitsPerImage	+= UINT64(2 * nComponentWidth) *
+							((nStoredWidth + nHorizSubsample - 1) / nHorizSubsample) *
+								((nStoredHeight + nVertSubsample - 1) / nVertSubsample);
+	}
+	else
+	{
+		OMF_COMP_SIZE_ARRAY	aPixelStructure	= {0};
+		ULONG				nBitsPerPixel	= 0;
+
+		if (FAILED(hr = RordReadCompSizeArray(rCE.oMDES, ePropRgbaPixelStructure, &aPixelStructure)))
+		{
+			return hr;
+		}
+
+		for (ULONG i = 0; (i < ELEMS(aPixelStructure)) && aPixelStructure[i]; i++)
+		{
+			nBitsPerPixel += aPixelStructure[i];
+		}
+
+		cBitsPerImage = UINT64(nStoredWidth) * nStoredHeight * nBitsPerPixel;
+	}
+
+	cbImage = (cBitsPerImage + 7) / 8;
+
+	// OMFI:DIDD:ImageAlignmentFactor, omfi:Int32, omfi:Long
+	if (SUCCEEDED(RordReadUInt32(rCE.oMDES, ePropDiddImageAlignmentFactor, PUINT32(&nAlignment))) && (nAlignment > 1))
+	{
+		cbImage = ((cbImage + nAlignment - 1) / nAlignment) * nAlignment;
+	}
+
+	// OMFI:DIDD:FrameLayout, omfi:LayoutType
+	RordReadUInt16(rCE.oMDES, ePropDiddFrameLayout, &wFrameLayout);
+	if (wFrameLayout == LT_SEPARATE_FIELDS)
+	{
+		cbImage *= 2;
+	}
+
+	*pcbFrame = cbImage;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatFrameMap().
+//	Reads the MDAT's frame index property and converts it into a new MDAT_FRAME_MAP.
+//
+//	Some writers end their frame index with one extra element that marks the end of the last frame. Others don't.
+//	If the last element is the length of the payload then we assume it's one of those, and we don't count it as a
+//	frame. Otherwise the last frame runs all the way to the end of the payload. Either way, the last element of our
+//	map is the length of the payload.
+//
+//	Every offset must lie inside the payload, and they must be in ascending order. If not we return OMF_E_BAD_ARRAY.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::DecodeMdatFrameIndex(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_FRAME_MAP* ppMap)
+{
+	POMFOO_POSITION_ARRAY	pArray	= NULL;
+	PMDAT_FRAME_MAP			pMap	= NULL;
+	ULONG					nFrames	= 0;
+
+	*ppMap = NULL;
+
+	HRESULT hr = ReadMdatFrameIndex(rCE, &pArray);
+	if (FAILED(hr))
+	{
+		goto L_CleanupExit;
+	}
+
+	nFrames = pArray->nElements;
+	if (nFrames == 0)
+	{
+		hr = OMF_E_BAD_ARRAY;
+		goto L_CleanupExit;
+	}
+
+	if ((nFrames > 1) && (pArray->a[nFrames - 1] == rCE.cbPayloadLength))
+	{
+		nFrames--;
+	}
+
+	// Note that sizeof(MDAT_FRAME_MAP) already includes one element of a[], so this has room for nFrames+1.
+	pMap = PMDAT_FRAME_MAP(MemAlloc(sizeof(MDAT_FRAME_MAP) + (nFrames * sizeof(UINT64))));
+	if (NULL == pMap)
+	{
+		hr = E_OUTOFMEMORY;
+		goto L_CleanupExit;
+	}
+
+	pMap->nFrames		= nFrames;
+	pMap->dwSource		= FRAME_MAP_FROM_PROPERTY;
+	pMap->a[nFrames]	= rCE.cbPayloadLength;
+
+	for (ULONG i = nFrames; i > 0; i--)
+	{
+		if (pArray->a[i - 1] > pMap->a[i])
+		{
+			hr = OMF_E_BAD_ARRAY;
+			goto L_CleanupExit;
+		}
+		pMap->a[i - 1] = pArray->a[i - 1];
+	}
+
+	*ppMap	= pMap;
+	pMap	= NULL;
+	hr		= S_OK;
+
+L_CleanupExit:
+	if (pMap)
+	{
+		MemFree(pMap);
+	}
+	CoreFreePositionArray(&pArray);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for DecodeMdatFrameIndex().
+//	Allocates a OMFOO_POSITION_ARRAY for the MDAT's frame index property. Our caller must free it with
+//	CoreFreePositionArray(). The name of the property depends on the MDAT's class, and some classes have two of them.
+//	Returns OMF_E_PROP_NOT_FOUND if the MDAT's class doesn't have a frame index.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ReadMdatFrameIndex(__in MDAT_CACHE_ENTRY& rCE, __out POMFOO_POSITION_ARRAY* ppArray)
+{
+	HRESULT hr = OMF_E_PROP_NOT_FOUND;
+	switch (rCE.oMDAT.dwFourCC)
+	{
+	case FCC('JPEG'):
+		hr = RordAllocPositionArray(rCE.oMDAT, ePropJpegFrameIndexExt, ppArray);
+		if (FAILED(hr))
+		{
+			hr = RordAllocPositionArray(rCE.oMDAT, ePropJpegFrameIndex, ppArray);
+		}
+		break;
+
+	case FCC('MPEG'):
+		hr = RordAllocPositionArray(rCE.oMDAT, ePropMpegMPEGFrameIndex, ppArray);
+		if (FAILED(hr))
+		{
+			hr = RordAllocPositionArray(rCE.oMDAT, ePropMpegFrameIndex, ppArray);
+		}
+		break;
+
+	case FCC('RLE '):
+		hr = RordAllocPositionArray(rCE.oMDAT, ePropRledFrameIndex, ppArray);
+		if (FAILED(hr) && rCE.oMDES.dwObject)
+		{
+			// STRANGE BUT TRUE:
+			// The OMFI:RLED:FrameIndex property usually lives in the corresponding 'RLED' media descriptor.
+			hr = RordAllocPositionArray(rCE.oMDES, ePropRledFrameIndex, ppArray);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatFrameMap().
+//	Returns TRUE if the MDAT's payload is a series of JFIF frames that we can find by scanning for markers.
+//	The other kinds of JPEG MDATs (like the ones with CDCI media descriptors) hold DV or AVHD frames, which don't
+//	have JPEG markers.
+//*********************************************************************************************************************
+BOOL CContainerLayer16::IsScannableJpeg(__in MDAT_CACHE_ENTRY& rCE)
+{
+	return ((rCE.oMDAT.dwFourCC == FCC('JPEG')) && (rCE.oMDES.dwFourCC == FCC('JPED')) && (rCE.cbPayloadLength >= 4));
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatFrameMap().
+//	Spot-checks a JPEG frame map that came from the frame index property. Returns TRUE if the first frame and the last
+//	frame both begin with an SOI marker. That's not proof that every entry is right, but it's only two tiny reads, and
+//	it catches the frame indexes that are shifted, truncated, or belong to some other MDAT.
+//*********************************************************************************************************************
+BOOL CContainerLayer16::VerifyJpegFrameMap(__in MDAT_CACHE_ENTRY& rCE, __in PMDAT_FRAME_MAP pMap)
+{
+	ULONG	aFrames[2]	= {0, pMap->nFrames - 1};
+	BYTE	aSOI[2]		= {0};
+
+	for (ULONG i = 0; i < ELEMS(aFrames); i++)
+	{
+		UINT64 cbFrameOffset = pMap->a[aFrames[i]];
+		if (cbFrameOffset + sizeof(aSOI) > rCE.cbPayloadLength)
+		{
+			return FALSE;
+		}
+
+		if (FAILED(SeekRead(rCE.cbPayloadOffset + cbFrameOffset, aSOI, sizeof(aSOI))))
+		{
+			return FALSE;
+		}
+
+		if ((aSOI[0] != 0xFF) || (aSOI[1] != 0xD8))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatFrameMap().
+//	Synthesizes a frame map for a JPEG payload by scanning it for SOI and EOI markers.
+//
+//	A frame begins at the first SOI marker after the previous frame's EOI marker. Any other SOI marker is ignored.
+//	That takes care of the thumbnails that some writers put in their APPn segments - the thumbnail's SOI is ignored,
+//	and after the thumbnail's EOI we're just waiting for the next frame's SOI. Each frame ends where the next one
+//	begins, so any padding between frames is included in the frame that precedes it. JPEG decoders don't mind.
+//
+//	Returns OMF_E_CANT_COMPLETE if there aren't any frames in the payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ScanJpegFrameMap(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_FRAME_MAP* ppMap)
+{
+	CMarkerList		oMarkers;
+	PMDAT_FRAME_MAP	pMap		= NULL;
+	PSCAN_MARKER	aMarkers	= NULL;
+	ULONG			nMarkers	= 0;
+	ULONG			nFrames		= 0;
+	BOOL			fWantSOI	= TRUE;
+
+	*ppMap = NULL;
+
+	HRESULT hr = ScanMdatPayload(rCE, CMarkerList::FindJpegMarkers, oMarkers);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	aMarkers = oMarkers.GetArray();
+	nMarkers = oMarkers.GetCount();
+
+	// Count the frames.
+	for (ULONG i = 0; i < nMarkers; i++)
+	{
+		if (fWantSOI && (aMarkers[i].dwCode == 0xD8))
+		{
+			nFrames++;
+			fWantSOI = FALSE;
+		}
+		else if ((!fWantSOI) && (aMarkers[i].dwCode == 0xD9))
+		{
+			fWantSOI = TRUE;
+		}
+	}
+
+	if ((nFrames == 0) || (nFrames > (ULONG_MAX - sizeof(MDAT_FRAME_MAP)) / sizeof(UINT64)))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	// Note that sizeof(MDAT_FRAME_MAP) already includes one element of a[], so this has room for nFrames+1.
+	pMap = PMDAT_FRAME_MAP(MemAlloc(sizeof(MDAT_FRAME_MAP) + (nFrames * sizeof(UINT64))));
+	if (NULL == pMap)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	// Do it again, for real this time.
+	fWantSOI = TRUE;
+	for (ULONG i = 0; i < nMarkers; i++)
+	{
+		if (fWantSOI && (aMarkers[i].dwCode == 0xD8))
+		{
+			pMap->a[pMap->nFrames++] = aMarkers[i].cbOffset;
+			fWantSOI = FALSE;
+		}
+		else if ((!fWantSOI) && (aMarkers[i].dwCode == 0xD9))
+		{
+			fWantSOI = TRUE;
+		}
+	}
+
+	pMap->dwSource		= FRAME_MAP_FROM_JPEG_SCAN;
+	pMap->a[nFrames]	= rCE.cbPayloadLength;
+
+	*ppMap = pMap;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for GetMdatMpegIndex().
+//	Returns TRUE if the MDAT's payload is an MPEG video elementary stream - that is, an MPEG MDAT with an MPGI media
+//	descriptor. Those are the only ones that are stored as a series of start codes that we can scan for.
+//*********************************************************************************************************************
+BOOL CContainerLayer16::IsScannableMpeg(__in MDAT_CACHE_ENTRY& rCE)
+{
+	return ((rCE.oMDAT.dwFourCC == FCC('MPEG')) && (rCE.oMDES.dwFourCC == FCC('MPGI')) && (rCE.cbPayloadLength >= 4));
+}
+
+//*********************************************************************************************************************
+//	Private helper for GetMdatMpegIndex().
+//	Builds a new MDAT_MPEG_INDEX by scanning an MPEG video payload for sequence headers, GOP headers, and picture
+//	headers. We don't decode anything. All we need is the position of each header, and a few bits from the picture
+//	headers and GOP headers. See CMarkerList::FindMpegStartCodes().
+//
+//	Each picture begins at the first sequence header or GOP header that precedes it (with no other picture in
+//	between), or at its own picture header if there aren't any. So every picture can be cut out along with the
+//	headers that belong to it. A new GOP begins with every picture that has a GOP header in front of it. Some streams
+//	don't have any GOP headers, and in those a new GOP begins with every I picture. The first picture always begins
+//	a GOP, whatever it is.
+//
+//	Returns OMF_E_CANT_COMPLETE if there aren't any pictures in the payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ScanMpegPictureIndex(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_MPEG_INDEX* ppIndex)
+{
+	CMarkerList			oMarkers;
+	PMDAT_MPEG_INDEX	pIndex				= NULL;
+	PSCAN_MARKER		aMarkers			= NULL;
+	ULONG				nMarkers			= 0;
+	ULONG				nPictures			= 0;
+	ULONG				nGops				= 0;
+	ULONG				nGopHeaders			= 0;
+	UINT64				cbUnitOffset		= 0;		// where the current picture begins.
+	UINT64				cbSequenceOffset	= 0;		// the most recent sequence header.
+	ULONG				cbSequenceLength	= 0;
+	DWORD				dwGopFlags			= 0;
+	BYTE				bFlags				= 0;		// the headers in front of the current picture.
+	BOOL				fNewGop				= FALSE;
+
+	*ppIndex = NULL;
+
+	HRESULT hr = ScanMdatPayload(rCE, CMarkerList::FindMpegStartCodes, oMarkers);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	aMarkers = oMarkers.GetArray();
+	nMarkers = oMarkers.GetCount();
+
+	// Count the pictures and the GOP headers.
+	for (ULONG i = 0; i < nMarkers; i++)
+	{
+		if (aMarkers[i].dwCode == MPEG_PICTURE_START_CODE)
+		{
+			nPictures++;
+		}
+		else if (aMarkers[i].dwCode == MPEG_GROUP_START_CODE)
+		{
+			nGopHeaders++;
+		}
+	}
+
+	// Count the GOPs.
+	nPictures = 0;
+	for (ULONG i = 0; i < nMarkers; i++)
+	{
+		if (aMarkers[i].dwCode == MPEG_GROUP_START_CODE)
+		{
+			fNewGop = TRUE;
+		}
+		else if (aMarkers[i].dwCode == MPEG_PICTURE_START_CODE)
+		{
+			if ((nPictures == 0) || (nGopHeaders ? fNewGop : ((aMarkers[i].dwExtra & 0x07) == 1)))
+			{
+				nGops++;
+			}
+			nPictures++;
+			fNewGop = FALSE;
+		}
+	}
+
+	if ((nPictures == 0) ||
+		(nPictures > (ULONG_MAX - sizeof(MDAT_MPEG_INDEX)) / (sizeof(MPEG_PICTURE_ENTRY) + sizeof(MPEG_GOP_ENTRY))))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	pIndex = PMDAT_MPEG_INDEX(MemAlloc(ULONG(sizeof(MDAT_MPEG_INDEX) +
+												(nPictures * sizeof(MPEG_PICTURE_ENTRY)) +
+													(nGops * sizeof(MPEG_GOP_ENTRY)))));
+	if (NULL == pIndex)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pIndex->aPictures	= PMPEG_PICTURE_ENTRY(&pIndex[1]);
+	pIndex->aGops		= PMPEG_GOP_ENTRY(&pIndex->aPictures[nPictures]);
+
+	// Do it again, for real this time.
+	for (ULONG i = 0; i < nMarkers; i++)
+	{
+		PSCAN_MARKER pMarker = &aMarkers[i];
+
+		switch (pMarker->dwCode)
+		{
+		case MPEG_SEQUENCE_HEADER_CODE:
+			{
+				// The sequence header and its extensions run up to the next header that we know about.
+				UINT64 cbNext = (i + 1 < nMarkers) ? pMarker[1].cbOffset : rCE.cbPayloadLength;
+				cbSequenceOffset = pMarker->cbOffset;
+				cbSequenceLength = ((cbNext - cbSequenceOffset) > ULONG_MAX) ? 0 : ULONG(cbNext - cbSequenceOffset);
+			}
+			if (bFlags == 0)
+			{
+				cbUnitOffset = pMarker->cbOffset;
+			}
+			bFlags |= MPX_SEQUENCE_HEADER;
+			break;
+
+		case MPEG_GROUP_START_CODE:
+			if (bFlags == 0)
+			{
+				cbUnitOffset = pMarker->cbOffset;
+			}
+			bFlags |= MPX_GOP_HEADER;
+			dwGopFlags = MPX_GOP_HEADER;
+			if (pMarker->dwExtra & 0x01)
+			{
+				dwGopFlags |= MPX_CLOSED_GOP;
+			}
+			if (pMarker->dwExtra & 0x02)
+			{
+				dwGopFlags |= MPX_BROKEN_LINK;
+			}
+			break;
+
+		case MPEG_PICTURE_START_CODE:
+			{
+				PMPEG_PICTURE_ENTRY	pPicture	= &pIndex->aPictures[pIndex->nPictures];
+				BYTE				bType		= BYTE(pMarker->dwExtra & 0x07);
+
+				if ((pIndex->nPictures == 0) || (nGopHeaders ? (bFlags & MPX_GOP_HEADER) : (bType == 1)))
+				{
+					PMPEG_GOP_ENTRY pGop = &pIndex->aGops[pIndex->nGops++];
+					pGop->cbSequenceOffset	= cbSequenceOffset;
+					pGop->cbSequenceLength	= cbSequenceLength;
+					pGop->iFirstPicture		= pIndex->nPictures;
+					pGop->dwFlags			= dwGopFlags | (bFlags & MPX_SEQUENCE_HEADER);
+				}
+
+				pPicture->cbOffset				= bFlags ? cbUnitOffset : pMarker->cbOffset;
+				pPicture->iGop					= pIndex->nGops - 1;
+				pPicture->wTemporalReference	= WORD(pMarker->dwExtra >> 8);
+				pPicture->bPictureType			= bType;
+				pPicture->bFlags				= bFlags;
+				pIndex->nPictures++;
+
+				bFlags		= 0;
+				dwGopFlags	= 0;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	*ppIndex = pIndex;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Protected.
+//	Runs the scan routine pfnScan over the MDAT's entire payload, and collects all of the markers in rResult in the
+//	order that they appear in the payload.
+//
+//	The payload is cut into chunks of SCAN_CHUNK_SIZE bytes. Each chunk gets its own CMarkerList, so the chunks can be
+//	scanned in any order by any thread. Each chunk is read with SCAN_OVERLAP extra bytes so that a marker that
+//	straddles two chunks is still found - by the chunk where it begins. When every chunk is done we stitch the lists
+//	together in chunk order.
+//
+//	Small payloads are scanned right here on the calling thread. Larger ones are scanned by up to SCAN_MAX_WORKERS
+//	threads from the Windows thread pool. Each thread claims the next unclaimed chunk, so the payload is still read
+//	more or less from front to back.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ScanMdatPayload(__in MDAT_CACHE_ENTRY& rCE,
+												__in PFN_MARKER_SCAN pfnScan,
+													__inout CMarkerList& rResult)
+{
+	MDAT_SCAN_JOB	oJob		= {0};
+	SYSTEM_INFO		si			= {0};
+	PTP_WORK		pWork		= NULL;
+	ULONG			nWorkers	= 0;
+	UINT64			nChunks		= 0;
+	HRESULT			hr			= S_OK;
+
+	nChunks = (rCE.cbPayloadLength + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE;
+	if (nChunks == 0)
+	{
+		return S_OK;
+	}
+
+	if (nChunks > ULONG_MAX)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	oJob.pThis				= this;
+	oJob.cbPayloadOffset	= rCE.cbPayloadOffset;
+	oJob.cbPayloadLength	= rCE.cbPayloadLength;
+	oJob.pfnScan			= pfnScan;
+	oJob.nChunks			= ULONG(nChunks);
+	oJob.iNextChunk			= 0;
+	oJob.hrFirstError		= S_OK;
+
+	oJob.aLists = (CMarkerList*)MemAlloc(oJob.nChunks * sizeof(CMarkerList));
+	if (NULL == oJob.aLists)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	for (ULONG i = 0; i < oJob.nChunks; i++)
+	{
+		oJob.aLists[i].Init();
+	}
+
+	GetSystemInfo(&si);
+	nWorkers = si.dwNumberOfProcessors;
+	if (nWorkers > SCAN_MAX_WORKERS)
+	{
+		nWorkers = SCAN_MAX_WORKERS;
+	}
+	if (nWorkers > oJob.nChunks)
+	{
+		nWorkers = oJob.nChunks;
+	}
+
+	// If we can't get a work object then we can still do all of the work ourselves.
+	if ((nWorkers > 1) && (NULL != (pWork = CreateThreadpoolWork(ScanWorkCallback, &oJob, NULL))))
+	{
+		for (ULONG i = 0; i < nWorkers - 1; i++)
+		{
+			SubmitThreadpoolWork(pWork);
+		}
+	}
+
+	// The calling thread is one of the workers.
+	ScanMdatChunks(oJob);
+
+	if (pWork)
+	{
+		WaitForThreadpoolWorkCallbacks(pWork, FALSE);
+		CloseThreadpoolWork(pWork);
+	}
+
+	hr = oJob.hrFirstError;
+	if (SUCCEEDED(hr))
+	{
+		for (ULONG i = 0; i < oJob.nChunks; i++)
+		{
+			if (FAILED(hr = rResult.AppendList(oJob.aLists[i])))
+			{
+				break;
+			}
+		}
+	}
+
+	for (ULONG i = 0; i < oJob.nChunks; i++)
+	{
+		oJob.aLists[i].Free();
+	}
+
+	MemFree(oJob.aLists);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private static helper for ScanMdatPayload().
+//	This is the thread pool's entry point. Its only job is to get back inside our object.
+//*********************************************************************************************************************
+VOID CALLBACK CContainerLayer16::ScanWorkCallback(__inout PTP_CALLBACK_INSTANCE pInstance,
+													__inout_opt PVOID pContext,
+														__inout PTP_WORK pWork)
+{
+	UNREFERENCED_PARAMETER(pInstance);
+	UNREFERENCED_PARAMETER(pWork);
+
+	PMDAT_SCAN_JOB pJob = PMDAT_SCAN_JOB(pContext);
+	pJob->pThis->ScanMdatChunks(*pJob);
+}
+
+//*********************************************************************************************************************
+//	Private helper for ScanMdatPayload().
+//	Claims chunks one at a time, reads them, and scans them - until there are no more chunks or somebody fails.
+//	Each thread that runs this has its own buffer, and SeekRead() doesn't use the file pointer, so the only thing the
+//	threads share is the chunk counter.
+//*********************************************************************************************************************
+void CContainerLayer16::ScanMdatChunks(__inout MDAT_SCAN_JOB& rJob)
+{
+	PBYTE	pBuffer	= NULL;
+	LONG	iChunk	= 0;
+	HRESULT	hr		= S_OK;
+
+	pBuffer = PBYTE(VirtualAlloc(NULL,
+									SCAN_CHUNK_SIZE + CMarkerList::SCAN_OVERLAP,
+									MEM_COMMIT|MEM_RESERVE,
+									PAGE_READWRITE));
+	if (NULL == pBuffer)
+	{
+		BREAK_IF_DEBUG
+		InterlockedCompareExchange(&rJob.hrFirstError, HRESULT_FROM_WIN32(GetLastError()), S_OK);
+		return;
+	}
+
+	while (SUCCEEDED(rJob.hrFirstError) && (ULONG(iChunk = InterlockedIncrement(&rJob.iNextChunk) - 1) < rJob.nChunks))
+	{
+		UINT64	cbChunkPos	= UINT64(iChunk) * SCAN_CHUNK_SIZE;
+		UINT64	cbLeft		= rJob.cbPayloadLength - cbChunkPos;
+		SIZE_T	cbScan		= (cbLeft > SCAN_CHUNK_SIZE) ? SCAN_CHUNK_SIZE : SIZE_T(cbLeft);
+		SIZE_T	cbAvail		= (cbLeft > cbScan + CMarkerList::SCAN_OVERLAP) ? (cbScan + CMarkerList::SCAN_OVERLAP)
+																			: SIZE_T(cbLeft);
+
+		if (FAILED(hr = SeekRead(rJob.cbPayloadOffset + cbChunkPos, pBuffer, UINT32(cbAvail))))
+		{
+			InterlockedCompareExchange(&rJob.hrFirstError, hr, S_OK);
+			break;
+		}
+
+		rJob.pfnScan(pBuffer, cbScan, cbAvail, cbChunkPos, rJob.aLists[iChunk]);
+
+		if (FAILED(hr = rJob.aLists[iChunk].GetStatus()))
+		{
+			InterlockedCompareExchange(&rJob.hrFirstError, hr, S_OK);
+			break;
+		}
+	}
+
+	VirtualFree(pBuffer, 0, MEM_RELEASE);
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatFrameMap() and GetMdatTiffIndex().
+//	Returns TRUE if the MDAT's payload is a TIFF file - that is, a TIFF MDAT with a TIFD media descriptor. The
+//	smallest possible TIFF file is an 8-byte header followed by an IFD with no entries.
+//*********************************************************************************************************************
+BOOL CContainerLayer16::IsParsableTiff(__in MDAT_CACHE_ENTRY& rCE)
+{
+	return ((rCE.oMDAT.dwFourCC == FCC('TIFF')) && (rCE.oMDES.dwFourCC == FCC('TIFD')) && (rCE.cbPayloadLength >= 14));
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatFrameMap().
+//	Creates a FRAME_MAP_FROM_TIFF_IFD map from the MDAT's TIFF image index.
+//
+//	If the TIFF file has exactly one image then each strip is a frame. That's how OMF stores TIFF video - one IFD, and
+//	one strip per frame. Otherwise each image is a frame. An image begins with whichever of its strips comes first,
+//	and ends with whichever of its strips ends last.
+//
+//	Our frame maps have no gaps, so each frame runs all the way to the beginning of the next frame. That means a frame
+//	can include some padding, or the next image's IFD. The last frame ends where its last strip ends. If the frames
+//	overlap, or if they aren't in ascending order, then we return OMF_E_BAD_ARRAY.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ComputeTiffFrameMap(__in ULONG idx, __out PMDAT_FRAME_MAP* ppMap)
+{
+	PMDAT_TIFF_INDEX	pIndex		= NULL;
+	PMDAT_FRAME_MAP		pMap		= NULL;
+	PTIFF_IMAGE_ENTRY	pImage		= NULL;
+	PTIFF_STRIP_ENTRY	pStrip		= NULL;
+	ULONG				nFrames		= 0;
+	UINT64				cbBegin		= 0;
+	UINT64				cbFinish	= 0;
+	UINT64				cbEnd		= 0;
+	HRESULT				hr			= S_OK;
+
+	*ppMap = NULL;
+
+	if (FAILED(hr = GetMdatTiffIndex(idx, &pIndex)))
+	{
+		return hr;
+	}
+
+	nFrames = (pIndex->nImages == 1) ? pIndex->nStrips : pIndex->nImages;
+	if (nFrames == 0)
+	{
+		return OMF_E_BAD_ARRAY;
+	}
+
+	if (nFrames > (ULONG_MAX - sizeof(MDAT_FRAME_MAP)) / sizeof(UINT64))
+	{
+		return OMF_E_SIZE_SURPRISE;
+	}
+
+	// Note that sizeof(MDAT_FRAME_MAP) already includes one element of a[], so this has room for nFrames+1.
+	pMap = PMDAT_FRAME_MAP(MemAlloc(ULONG(sizeof(MDAT_FRAME_MAP) + (nFrames * sizeof(UINT64)))));
+	if (NULL == pMap)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pMap->nFrames	= nFrames;
+	pMap->dwSource	= FRAME_MAP_FROM_TIFF_IFD;
+
+	for (ULONG i = 0; i < nFrames; i++)
+	{
+		if (pIndex->nImages == 1)
+		{
+			pStrip		= &pIndex->aStrips[i];
+			cbBegin		= pStrip->cbOffset;
+			cbFinish	= UINT64(pStrip->cbOffset) + pStrip->cbLength;
+		}
+		else
+		{
+			pImage = &pIndex->aImages[i];
+			if (pImage->nStrips == 0)
+			{
+				hr = OMF_E_BAD_ARRAY;
+				goto L_CleanupExit;
+			}
+
+			pStrip		= &pIndex->aStrips[pImage->iFirstStrip];
+			cbBegin		= pStrip->cbOffset;
+			cbFinish	= UINT64(pStrip->cbOffset) + pStrip->cbLength;
+
+			for (ULONG j = 1; j < pImage->nStrips; j++)
+			{
+				pStrip = &pIndex->aStrips[pImage->iFirstStrip + j];
+				if (cbBegin > pStrip->cbOffset)
+				{
+					cbBegin = pStrip->cbOffset;
+				}
+				if (cbFinish < UINT64(pStrip->cbOffset) + pStrip->cbLength)
+				{
+					cbFinish = UINT64(pStrip->cbOffset) + pStrip->cbLength;
+				}
+			}
+		}
+
+		// This frame can't begin before the previous one ends.
+		if (cbBegin < cbEnd)
+		{
+			hr = OMF_E_BAD_ARRAY;
+			goto L_CleanupExit;
+		}
+
+		pMap->a[i]	= cbBegin;
+		cbEnd		= cbFinish;
+	}
+
+	pMap->a[nFrames]	= cbEnd;
+	*ppMap				= pMap;
+	pMap				= NULL;
+
+L_CleanupExit:
+	MemFree(pMap);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for GetMdatTiffIndex().
+//	Builds a new MDAT_TIFF_INDEX by parsing the TIFF header and following the chain of image file directories (IFDs).
+//	We don't decode any pixels. All we need from each IFD is a handful of fields that describe the image, and the
+//	two arrays that say where its strips (or tiles) are.
+//
+//	The TIFF header tells us the byte order, and every 16-bit and 32-bit number in the file is stored that way. We
+//	make two passes over the chain. The first pass just counts the IFDs, so we know how much room we need for them.
+//	The second pass parses them. Then we know how many strips there are, and we can read their arrays straight into
+//	the new index. A chain that's longer than TIFF_MAX_IMAGES is probably a loop, so we give up on it.
+//
+//	Returns OMF_E_CANT_COMPLETE if the payload isn't a classic TIFF file (BigTIFF files have 64-bit offsets).
+//	Returns OMF_E_BAD_ARRAY if an IFD is malformed, or if a strip doesn't lie entirely inside the payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ParseTiffImageIndex(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_TIFF_INDEX* ppIndex)
+{
+	PMDAT_TIFF_INDEX	pIndex			= NULL;
+	PTIFF_IMAGE_ENTRY	aImages			= NULL;
+	PTIFF_FIELD			aFields			= NULL;		// two per image - the strip offsets and the strip lengths.
+	PTIFF_STRIP_ENTRY	pStrip			= NULL;
+	BYTE				aHeader[8]		= {0};
+	BYTE				aCount[2]		= {0};
+	BYTE				aNextIfd[4]		= {0};
+	BOOL				fBigEndian		= FALSE;
+	ULONG				cbIfd			= 0;
+	ULONG				nImages			= 0;
+	UINT64				cbNextIfd		= 0;
+	UINT64				nStrips			= 0;
+	UINT64				cbIndex			= 0;
+	HRESULT				hr				= S_OK;
+
+	*ppIndex = NULL;
+
+	if (FAILED(hr = SeekRead(rCE.cbPayloadOffset, aHeader, sizeof(aHeader))))
+	{
+		goto L_CleanupExit;
+	}
+
+	// "II" means little-endian and "MM" means big-endian. Either way the next word is 42. (BigTIFF's is 43.)
+	if ((aHeader[0] == 'I') && (aHeader[1] == 'I'))
+	{
+		fBigEndian = FALSE;
+	}
+	else if ((aHeader[0] == 'M') && (aHeader[1] == 'M'))
+	{
+		fBigEndian = TRUE;
+	}
+	else
+	{
+		hr = OMF_E_CANT_COMPLETE;
+		goto L_CleanupExit;
+	}
+
+	if (TiffWord(&aHeader[2], fBigEndian) != 42)
+	{
+		hr = OMF_E_CANT_COMPLETE;
+		goto L_CleanupExit;
+	}
+
+	// First pass. Each IFD is a 16-bit entry count, 12 bytes per entry, and the 32-bit offset of the next IFD.
+	cbIfd = TiffLong(&aHeader[4], fBigEndian);
+	while (cbIfd)
+	{
+		if ((nImages == TIFF_MAX_IMAGES) || (UINT64(cbIfd) + sizeof(aCount) > rCE.cbPayloadLength))
+		{
+			hr = OMF_E_BAD_ARRAY;
+			goto L_CleanupExit;
+		}
+
+		if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbIfd, aCount, sizeof(aCount))))
+		{
+			goto L_CleanupExit;
+		}
+
+		cbNextIfd = UINT64(cbIfd) + sizeof(aCount) + (TiffWord(aCount, fBigEndian) * 12);
+		if (cbNextIfd + sizeof(aNextIfd) > rCE.cbPayloadLength)
+		{
+			hr = OMF_E_BAD_ARRAY;
+			goto L_CleanupExit;
+		}
+
+		if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbNextIfd, aNextIfd, sizeof(aNextIfd))))
+		{
+			goto L_CleanupExit;
+		}
+
+		cbIfd = TiffLong(aNextIfd, fBigEndian);
+		nImages++;
+	}
+
+	// A TIFF file must have at least one image.
+	if (nImages == 0)
+	{
+		hr = OMF_E_BAD_ARRAY;
+		goto L_CleanupExit;
+	}
+
+	aImages = PTIFF_IMAGE_ENTRY(MemAlloc(nImages * sizeof(TIFF_IMAGE_ENTRY)));
+	aFields = PTIFF_FIELD(MemAlloc(nImages * 2 * sizeof(TIFF_FIELD)));
+	if ((NULL == aImages) || (NULL == aFields))
+	{
+		hr = E_OUTOFMEMORY;
+		goto L_CleanupExit;
+	}
+
+	// Second pass. Follow the same chain again, and parse each IFD.
+	cbIfd = TiffLong(&aHeader[4], fBigEndian);
+	for (ULONG i = 0; i < nImages; i++)
+	{
+		hr = ParseTiffIfd(rCE, fBigEndian, cbIfd, &aImages[i], &aFields[i * 2], &aFields[(i * 2) + 1], &cbIfd);
+		if (FAILED(hr))
+		{
+			goto L_CleanupExit;
+		}
+
+		aImages[i].iFirstStrip = ULONG(nStrips);
+		nStrips += aImages[i].nStrips;
+		if (nStrips > ULONG_MAX)
+		{
+			hr = OMF_E_SIZE_SURPRISE;
+			goto L_CleanupExit;
+		}
+	}
+
+	// The two arrays live in the same allocation as the header.
+	cbIndex = sizeof(MDAT_TIFF_INDEX) + (nImages * sizeof(TIFF_IMAGE_ENTRY)) + (nStrips * sizeof(TIFF_STRIP_ENTRY));
+	if (cbIndex > ULONG_MAX)
+	{
+		hr = OMF_E_SIZE_SURPRISE;
+		goto L_CleanupExit;
+	}
+
+	pIndex = PMDAT_TIFF_INDEX(MemAlloc(ULONG(cbIndex)));
+	if (NULL == pIndex)
+	{
+		hr = E_OUTOFMEMORY;
+		goto L_CleanupExit;
+	}
+
+	pIndex->nImages	= nImages;
+	pIndex->nStrips	= ULONG(nStrips);
+	pIndex->aImages	= PTIFF_IMAGE_ENTRY(&pIndex[1]);
+	pIndex->aStrips	= PTIFF_STRIP_ENTRY(&pIndex->aImages[nImages]);
+	CopyMemory(pIndex->aImages, aImages, nImages * sizeof(TIFF_IMAGE_ENTRY));
+
+	// Now read each image's offsets and lengths into the interleaved members of its TIFF_STRIP_ENTRY structures.
+	for (ULONG i = 0; i < nImages; i++)
+	{
+		if (aImages[i].nStrips == 0)
+		{
+			continue;
+		}
+
+		pStrip = &pIndex->aStrips[aImages[i].iFirstStrip];
+
+		if (FAILED(hr = ReadTiffFieldValues(rCE, fBigEndian, &aFields[i * 2], aImages[i].nStrips,
+												&pStrip->cbOffset, sizeof(TIFF_STRIP_ENTRY))) ||
+			FAILED(hr = ReadTiffFieldValues(rCE, fBigEndian, &aFields[(i * 2) + 1], aImages[i].nStrips,
+												&pStrip->cbLength, sizeof(TIFF_STRIP_ENTRY))))
+		{
+			goto L_CleanupExit;
+		}
+	}
+
+	// Every strip must lie entirely inside the payload.
+	for (ULONG i = 0; i < pIndex->nStrips; i++)
+	{
+		pStrip = &pIndex->aStrips[i];
+		if (UINT64(pStrip->cbOffset) + pStrip->cbLength > rCE.cbPayloadLength)
+		{
+			hr = OMF_E_BAD_ARRAY;
+			goto L_CleanupExit;
+		}
+	}
+
+	*ppIndex	= pIndex;
+	pIndex		= NULL;
+
+L_CleanupExit:
+	MemFree(pIndex);
+	MemFree(aFields);
+	MemFree(aImages);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for ParseTiffImageIndex().
+//	Parses the IFD that begins at cbIfdOffset. Fills in caller's TIFF_IMAGE_ENTRY (except for iFirstStrip), and saves
+//	the IFD entries that describe the strip offsets and the strip lengths so that our caller can read them later. If
+//	the image is tiled then those are the tile offsets and the tile lengths instead. The fields that the IFD doesn't
+//	have get their default values from the TIFF 6.0 specification.
+//
+//	We only look at entries whose values are SHORTs or LONGs. Every field that we care about is one or the other.
+//	On exit pcbNextIfd holds the offset of the next IFD, or zero if this is the last one.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ParseTiffIfd(__in MDAT_CACHE_ENTRY& rCE,
+											__in BOOL fBigEndian,
+												__in ULONG cbIfdOffset,
+													__out PTIFF_IMAGE_ENTRY pImage,
+														__out PTIFF_FIELD pOffsets,
+															__out PTIFF_FIELD pLengths,
+																__out PULONG pcbNextIfd)
+{
+	PBYTE		pEntries		= NULL;
+	PBYTE		pEntry			= NULL;
+	TIFF_FIELD	oField			= {0};
+	TIFF_FIELD	oTileOffsets	= {0};
+	TIFF_FIELD	oTileLengths	= {0};
+	BYTE		aCount[2]		= {0};
+	ULONG		nEntries		= 0;
+	ULONG		cbEntries		= 0;
+	ULONG		nValue			= 0;
+	ULONG		nRowsPerStrip	= ULONG_MAX;
+	HRESULT		hr				= S_OK;
+
+	ZeroMemory(pImage, sizeof(TIFF_IMAGE_ENTRY));
+	ZeroMemory(pOffsets, sizeof(TIFF_FIELD));
+	ZeroMemory(pLengths, sizeof(TIFF_FIELD));
+	*pcbNextIfd = 0;
+
+	if (UINT64(cbIfdOffset) + sizeof(aCount) > rCE.cbPayloadLength)
+	{
+		hr = OMF_E_BAD_ARRAY;
+		goto L_CleanupExit;
+	}
+
+	if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbIfdOffset, aCount, sizeof(aCount))))
+	{
+		goto L_CleanupExit;
+	}
+
+	// Read all of the entries, and the offset of the next IFD, with one call to SeekRead().
+	nEntries	= TiffWord(aCount, fBigEndian);
+	cbEntries	= ULONG((nEntries * 12) + sizeof(ULONG));
+	if (UINT64(cbIfdOffset) + sizeof(aCount) + cbEntries > rCE.cbPayloadLength)
+	{
+		hr = OMF_E_BAD_ARRAY;
+		goto L_CleanupExit;
+	}
+
+	pEntries = PBYTE(MemAlloc(cbEntries));
+	if (NULL == pEntries)
+	{
+		hr = E_OUTOFMEMORY;
+		goto L_CleanupExit;
+	}
+
+	if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbIfdOffset + sizeof(aCount), pEntries, cbEntries)))
+	{
+		goto L_CleanupExit;
+	}
+
+	pImage->cbIfdOffset			= cbIfdOffset;
+	pImage->wCompression		= 1;
+	pImage->wBitsPerSample		= 1;
+	pImage->wSamplesPerPixel	= 1;
+	pImage->wPlanarConfig		= 1;
+
+	for (ULONG i = 0; i < nEntries; i++)
+	{
+		// Each entry is a 16-bit tag, a 16-bit type, a 32-bit count, and a 32-bit value (or offset).
+		pEntry			= &pEntries[i * 12];
+		oField.wType	= WORD(TiffWord(&pEntry[2], fBigEndian));
+		oField.nCount	= TiffLong(&pEntry[4], fBigEndian);
+		CopyMemory(oField.aValue, &pEntry[8], sizeof(oField.aValue));
+
+		if (((oField.wType != TIFF_SHORT) && (oField.wType != TIFF_LONG)) || (oField.nCount == 0))
+		{
+			continue;
+		}
+
+		// The first value is always left-justified in the value field if it fits there.
+		nValue = (oField.wType == TIFF_SHORT) ? TiffWord(oField.aValue, fBigEndian)
+											  : TiffLong(oField.aValue, fBigEndian);
+
+		switch (TiffWord(pEntry, fBigEndian))
+		{
+		case 256:	// ImageWidth
+			pImage->nWidth = nValue;
+			break;
+
+		case 257:	// ImageLength
+			pImage->nLength = nValue;
+			break;
+
+		case 258:	// BitsPerSample - one per sample, but they're almost always the same.
+			if (FAILED(hr = ReadTiffFieldValues(rCE, fBigEndian, &oField, 1, &nValue, sizeof(ULONG))))
+			{
+				goto L_CleanupExit;
+			}
+			pImage->wBitsPerSample = WORD(nValue);
+			break;
+
+		case 259:	// Compression
+			pImage->wCompression = WORD(nValue);
+			break;
+
+		case 262:	// PhotometricInterpretation
+			pImage->wPhotometric = WORD(nValue);
+			break;
+
+		case 273:	// StripOffsets
+			*pOffsets = oField;
+			break;
+
+		case 277:	// SamplesPerPixel
+			pImage->wSamplesPerPixel = WORD(nValue);
+			break;
+
+		case 278:	// RowsPerStrip
+			nRowsPerStrip = nValue;
+			break;
+
+		case 279:	// StripByteCounts
+			*pLengths = oField;
+			break;
+
+		case 284:	// PlanarConfiguration
+			pImage->wPlanarConfig = WORD(nValue);
+			break;
+
+		case 322:	// TileWidth
+			pImage->nTileWidth = nValue;
+			break;
+
+		case 323:	// TileLength
+			pImage->nTileLength = nValue;
+			break;
+
+		case 324:	// TileOffsets
+			oTileOffsets = oField;
+			break;
+
+		case 325:	// TileByteCounts
+			oTileLengths = oField;
+			break;
+		}
+	}
+
+	*pcbNextIfd = TiffLong(&pEntries[nEntries * 12], fBigEndian);
+
+	if (oTileOffsets.wType)
+	{
+		*pOffsets				= oTileOffsets;
+		*pLengths				= oTileLengths;
+		pImage->nRowsPerStrip	= 0;
+	}
+	else
+	{
+		pImage->nTileWidth		= 0;
+		pImage->nTileLength		= 0;
+		pImage->nRowsPerStrip	= (nRowsPerStrip < pImage->nLength) ? nRowsPerStrip : pImage->nLength;
+	}
+
+	// There must be one length for every offset. Each one takes at least two bytes, so they can't outnumber the bytes
+	// in the payload. (That keeps a bogus count from making our caller allocate gigabytes.)
+	if ((pOffsets->nCount != pLengths->nCount) || (UINT64(pOffsets->nCount) * 2 > rCE.cbPayloadLength))
+	{
+		hr = OMF_E_BAD_ARRAY;
+		goto L_CleanupExit;
+	}
+
+	pImage->nStrips = pOffsets->nCount;
+
+L_CleanupExit:
+	MemFree(pEntries);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for ParseTiffImageIndex() and ParseTiffIfd().
+//	Reads the first nValues values of an IFD entry, widens them to ULONGs, and stores them in caller's array. The
+//	cbStride argument is the distance between caller's elements, so the values can be scattered into the members of
+//	an array of structures. If all of the entry's values fit in four bytes then they are in the entry itself.
+//	Otherwise they are somewhere else in the payload, and the entry holds their offset.
+//*********************************************************************************************************************
+HRESULT CContainerLayer16::ReadTiffFieldValues(__in MDAT_CACHE_ENTRY& rCE,
+												__in BOOL fBigEndian,
+													__in PTIFF_FIELD pField,
+														__in ULONG nValues,
+															__out PULONG pDest,
+																__in ULONG cbStride)
+{
+	PBYTE	pRaw		= NULL;
+	PBYTE	pSrc		= pField->aValue;
+	ULONG	cbValue		= (pField->wType == TIFF_SHORT) ? sizeof(WORD) : sizeof(ULONG);
+	UINT64	cbValues	= UINT64(pField->nCount) * cbValue;
+	ULONG	cbOffset	= 0;
+	HRESULT	hr			= S_OK;
+
+	if (nValues > pField->nCount)
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+
+	if (cbValues > sizeof(pField->aValue))
+	{
+		cbOffset = TiffLong(pField->aValue, fBigEndian);
+		if (UINT64(cbOffset) + cbValues > rCE.cbPayloadLength)
+		{
+			return OMF_E_BAD_ARRAY;
+		}
+
+		if (cbValues > ULONG_MAX)
+		{
+			return OMF_E_SIZE_SURPRISE;
+		}
+
+		pRaw = PBYTE(MemAlloc(nValues * cbValue));
+		if (NULL == pRaw)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbOffset, pRaw, nValues * cbValue)))
+		{
+			goto L_CleanupExit;
+		}
+
+		pSrc = pRaw;
+	}
+
+	for (ULONG i = 0; i < nValues; i++)
+	{
+		*PULONG(PBYTE(pDest) + (i * cbStride)) = (cbValue == sizeof(WORD)) ? TiffWord(&pSrc[i * cbValue], fBigEndian)
+																			: TiffLong(&pSrc[i * cbValue], fBigEndian);
+	}
+
+L_CleanupExit:
+	MemFree(pRaw);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private static helpers.
+//	Return the unsigned 16-bit or 32-bit number at p, stored in the TIFF file's byte order.
+//*********************************************************************************************************************
+ULONG CContainerLayer16::TiffWord(__in const BYTE* p, __in BOOL fBigEndian)
+{
+	WORD w = *(UNALIGNED WORD*)(p);
+	return fBigEndian ? Endian16(w) : w;
+}
+
+ULONG CContainerLayer16::TiffLong(__in const BYTE* p, __in BOOL fBigEndian)
+{
+	ULONG dw = *(UNALIGNED ULONG*)(p);
+	return fBigEndian ? Endian32(dw) : dw;
+}
@@ -0,0 +1,245 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer16.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+#include "ContainerLayer15.h"
+#include "MarkerScan.h"
+
+//*********************************************************************************************************************
+//	Structures.
+//*********************************************************************************************************************
+//	Internal structure for our per-MDAT frame map.
+//	The a[] array holds nFrames+1 offsets, measured from the first byte of the MDAT's payload.
+//	Frame n begins at a[n] and ends at a[n+1]. The last element is always the end of the last frame.
+//	If every frame is the same size then dwSource is FRAME_MAP_FIXED_STRIDE and the a[] array is not used at all.
+//	Frame n begins at cbFirstFrame + (n * cbStride). Use GetFrameOffset() so you don't have to care which is which.
+typedef struct {
+	ULONG	nFrames;			// number of frames in the map.
+	DWORD	dwSource;			// FRAME_MAP_FROM_PROPERTY, etc.
+	UINT64	cbFirstFrame;		// FRAME_MAP_FIXED_STRIDE only - where the first frame begins.
+	UINT64	cbStride;			// FRAME_MAP_FIXED_STRIDE only - the size of every frame.
+	UINT64	a[ANYSIZE_ARRAY];	// nFrames+1 payload-relative offsets in ascending order.
+} MDAT_FRAME_MAP, *PMDAT_FRAME_MAP;
+
+//	Enumerated values for the dwSource member of the MDAT_FRAME_MAP structure.
+enum MDAT_FRAME_MAP_SOURCE {
+	FRAME_MAP_FROM_PROPERTY		= 1,	// decoded from the MDAT's (or MDES's) FrameIndex property.
+	FRAME_MAP_FROM_JPEG_SCAN	= 2,	// synthesized by scanning a JPEG payload for SOI and EOI markers.
+	FRAME_MAP_FIXED_STRIDE		= 3,	// computed from the media descriptor - every frame is the same size.
+	FRAME_MAP_FROM_TIFF_IFD		= 4,	// synthesized from the strip offsets in a TIFF payload's IFDs.
+};
+
+//	Internal structures for our per-MDAT MPEG picture index. See ScanMpegPictureIndex().
+//	Pictures are listed in the order that they are stored (decode order). The cbOffset member of each picture includes
+//	the sequence header and/or GOP header in front of it, so each picture ends where the next one begins.
+typedef struct {
+	UINT64	cbOffset;			// where the picture begins, measured from the first byte of the MDAT's payload.
+	ULONG	iGop;				// index of the GOP that the picture belongs to.
+	WORD	wTemporalReference;	// the picture header's temporal_reference.
+	BYTE	bPictureType;		// the picture header's picture_coding_type (1 = I, 2 = P, 3 = B, 4 = D).
+	BYTE	bFlags;				// MPX_SEQUENCE_HEADER and/or MPX_GOP_HEADER.
+} MPEG_PICTURE_ENTRY, *PMPEG_PICTURE_ENTRY;
+
+typedef struct {
+	UINT64	cbSequenceOffset;	// the most recent sequence header at or before the GOP's first picture.
+	ULONG	cbSequenceLength;	// size of that sequence header (and its extensions), or zero if there isn't one.
+	ULONG	iFirstPicture;		// index of the GOP's first picture.
+	DWORD	dwFlags;			// MPX_GOP_HEADER, MPX_CLOSED_GOP, etc.
+	DWORD	dwReserved;
+} MPEG_GOP_ENTRY, *PMPEG_GOP_ENTRY;
+
+//	The two arrays live in the same allocation as the header, so MemFree() takes care of everything.
+typedef struct {
+	ULONG				nPictures;	// number of elements in aPictures[].
+	ULONG				nGops;		// number of elements in aGops[].
+	PMPEG_PICTURE_ENTRY	aPictures;
+	PMPEG_GOP_ENTRY		aGops;
+} MDAT_MPEG_INDEX, *PMDAT_MPEG_INDEX;
+
+//	Internal structures for our per-MDAT TIFF image index. See ParseTiffImageIndex().
+//	Classic TIFF offsets are 32 bits, and they are measured from the TIFF header - which is the first byte of the
+//	MDAT's payload. So every strip (or tile) fits in 8 bytes, and images are listed in the order of the IFD chain.
+typedef struct {
+	ULONG	cbOffset;			// where the strip begins, measured from the first byte of the MDAT's payload.
+	ULONG	cbLength;			// the strip's StripByteCounts (or TileByteCounts) entry.
+} TIFF_STRIP_ENTRY, *PTIFF_STRIP_ENTRY;
+
+typedef struct {
+	ULONG	cbIfdOffset;		// where the image file directory begins.
+	ULONG	iFirstStrip;		// index of the image's first strip in aStrips[].
+	ULONG	nStrips;			// number of strips (or tiles) in the image.
+	ULONG	nWidth;				// ImageWidth.
+	ULONG	nLength;			// ImageLength.
+	ULONG	nRowsPerStrip;		// RowsPerStrip, or zero if the image is tiled.
+	ULONG	nTileWidth;			// TileWidth, or zero if the image is stored in strips.
+	ULONG	nTileLength;		// TileLength, or zero if the image is stored in strips.
+	WORD	wCompression;		// Compression (1 if the IFD doesn't say).
+	WORD	wPhotometric;		// PhotometricInterpretation.
+	WORD	wBitsPerSample;		// the first element of BitsPerSample (1 if the IFD doesn't say).
+	WORD	wSamplesPerPixel;	// SamplesPerPixel (1 if the IFD doesn't say).
+	WORD	wPlanarConfig;		// PlanarConfiguration (1 if the IFD doesn't say).
+	WORD	wReserved;
+} TIFF_IMAGE_ENTRY, *PTIFF_IMAGE_ENTRY;
+
+//	The two arrays live in the same allocation as the header, so MemFree() takes care of everything.
+typedef struct {
+	ULONG				nImages;	// number of elements in aImages[].
+	ULONG				nStrips;	// number of elements in aStrips[].
+	PTIFF_IMAGE_ENTRY	aImages;
+	PTIFF_STRIP_ENTRY	aStrips;
+} MDAT_TIFF_INDEX, *PMDAT_TIFF_INDEX;
+
+//	Internal structure for one IFD entry that we need to come back to. See ParseTiffIfd().
+//	If the values fit in four bytes then aValue[] holds the values themselves. Otherwise it holds their offset.
+typedef struct {
+	WORD	wType;				// TIFF_SHORT or TIFF_LONG. Zero if the IFD doesn't have this entry.
+	WORD	wReserved;
+	ULONG	nCount;				// number of values.
+	BYTE	aValue[4];			// the entry's value/offset field, exactly as it's stored.
+} TIFF_FIELD, *PTIFF_FIELD;
+
+//	Internal structure shared by the threads that scan one payload. See ScanMdatPayload().
+class CContainerLayer16;
+typedef struct {
+	CContainerLayer16*	pThis;
+	UINT64				cbPayloadOffset;	// copied from the MDAT_CACHE_ENTRY.
+	UINT64				cbPayloadLength;	// copied from the MDAT_CACHE_ENTRY.
+	PFN_MARKER_SCAN		pfnScan;			// the scan routine.
+	CMarkerList*		aLists;				// one list per chunk.
+	ULONG				nChunks;			// number of chunks, and number of elements in aLists[].
+	volatile LONG		iNextChunk;			// the next chunk that nobody has claimed yet.
+	volatile LONG		hrFirstError;		// the first thing that went wrong, or S_OK.
+} MDAT_SCAN_JOB, *PMDAT_SCAN_JOB;
+
+class CContainerLayer16 : public CContainerLayer15
+{
+protected:
+			CContainerLayer16(void);
+	virtual	~CContainerLayer16(void);
+	STDMETHODIMP	Load(__in PCWSTR pwzFileName);
+
+public:
+	enum {
+		SCAN_CHUNK_SIZE		= 0x00400000,	// payloads are scanned in chunks of this many bytes. (4MB)
+		SCAN_MAX_WORKERS	= 4,			// maximum number of threads that scan one payload.
+		TIFF_MAX_IMAGES		= 0x00010000,	// longest IFD chain that we'll follow. (Protects us from loops.)
+		TIFF_SHORT			= 3,			// IFD field type for 16-bit unsigned integers.
+		TIFF_LONG			= 4,			// IFD field type for 32-bit unsigned integers.
+	};
+
+	// Callback/helper routines for our COmfMediaData classes.
+	// They all accept an index to m_aMdatTable[] as their MDAT argument.
+	STDMETHODIMP	GetMdatFrameCount(__in ULONG idx,
+										__out PULONG pnFrames);
+
+	STDMETHODIMP	GetMdatFrameExtent(__in ULONG idx,
+										__in ULONG iFrame,
+											__out PUINT64 pcbOffset,
+												__out PULONG pcbLength);
+
+	STDMETHODIMP	ReadMdatFrameOffsets(__in ULONG idx,
+											__in ULONG nMaxElements,
+												__out_opt PUINT64 pArrayBase,
+													__out PULONG pnActualElements);
+
+	STDMETHODIMP	ReadMdatFrames(__in ULONG idx,
+									__in ULONG iFirstFrame,
+										__in ULONG nFrames,
+											__in ULONG cbBuffer,
+												__out_opt PVOID pBuffer,
+													__out_opt PULONG aFrameLengths,
+														__out PULONG pcbRequired);
+
+	STDMETHODIMP	GetMdatPictureCount(__in ULONG idx,
+										__out PULONG pnPictures);
+
+	STDMETHODIMP	GetMdatPictureInfo(__in ULONG idx,
+										__in ULONG iPicture,
+											__out POMFOO_MPEG_PICTURE_INFO pInfo);
+
+	STDMETHODIMP	GetMdatGopCount(__in ULONG idx,
+									__out PULONG pnGops);
+
+	STDMETHODIMP	GetMdatGopInfo(__in ULONG idx,
+									__in ULONG iGop,
+										__out POMFOO_MPEG_GOP_INFO pInfo);
+
+	STDMETHODIMP	GetMdatTiffImageCount(__in ULONG idx,
+											__out PULONG pnImages);
+
+	STDMETHODIMP	GetMdatTiffImageInfo(__in ULONG idx,
+											__in ULONG iImage,
+												__out POMFOO_TIFF_IMAGE_INFO pInfo);
+
+	STDMETHODIMP	GetMdatTiffStripExtent(__in ULONG idx,
+											__in ULONG iImage,
+												__in ULONG iStrip,
+													__out PUINT64 pcbOffset,
+														__out PULONG pcbLength);
+
+	STDMETHODIMP	ReadMdatTiffStrips(__in ULONG idx,
+										__in ULONG iImage,
+											__in ULONG iFirstStrip,
+												__in ULONG nStrips,
+													__in ULONG cbBuffer,
+														__out_opt PVOID pBuffer,
+															__out_opt PULONG aStripLengths,
+																__out PULONG pcbRequired);
+
+protected:
+	HRESULT	GetMdatFrameMap(__in ULONG idx, __out PMDAT_FRAME_MAP* ppMap);
+	HRESULT	GetMdatMpegIndex(__in ULONG idx, __out PMDAT_MPEG_INDEX* ppIndex);
+	HRESULT	GetMdatTiffIndex(__in ULONG idx, __out PMDAT_TIFF_INDEX* ppIndex);
+	HRESULT	ScanMdatPayload(__in MDAT_CACHE_ENTRY& rCE, __in PFN_MARKER_SCAN pfnScan, __inout CMarkerList& rResult);
+
+private:
+	HRESULT	LoadMdatFrameMap(__in ULONG idx, __out PMDAT_FRAME_MAP* ppMap);
+	HRESULT	ComputeFixedStrideFrameMap(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_FRAME_MAP* ppMap);
+	HRESULT	GetDvFrameSize(__in MDAT_CACHE_ENTRY& rCE, __in UINT64 cbFirstFrame, __out PUINT64 pcbFrame);
+	HRESULT	GetUncompressedFrameSize(__in MDAT_CACHE_ENTRY& rCE, __out PUINT64 pcbFrame);
+	HRESULT	DecodeMdatFrameIndex(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_FRAME_MAP* ppMap);
+	HRESULT	ReadMdatFrameIndex(__in MDAT_CACHE_ENTRY& rCE, __out POMFOO_POSITION_ARRAY* ppArray);
+	BOOL	IsScannableJpeg(__in MDAT_CACHE_ENTRY& rCE);
+	BOOL	VerifyJpegFrameMap(__in MDAT_CACHE_ENTRY& rCE, __in PMDAT_FRAME_MAP pMap);
+	HRESULT	ScanJpegFrameMap(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_FRAME_MAP* ppMap);
+	BOOL	IsScannableMpeg(__in MDAT_CACHE_ENTRY& rCE);
+	HRESULT	ScanMpegPictureIndex(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_MPEG_INDEX* ppIndex);
+	void	ScanMdatChunks(__inout MDAT_SCAN_JOB& rJob);
+	BOOL	IsParsableTiff(__in MDAT_CACHE_ENTRY& rCE);
+	HRESULT	ComputeTiffFrameMap(__in ULONG idx, __out PMDAT_FRAME_MAP* ppMap);
+	HRESULT	ParseTiffImageIndex(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_TIFF_INDEX* ppIndex);
+	HRESULT	ParseTiffIfd(__in MDAT_CACHE_ENTRY& rCE,
+							__in BOOL fBigEndian,
+								__in ULONG cbIfdOffset,
+									__out PTIFF_IMAGE_ENTRY pImage,
+										__out PTIFF_FIELD pOffsets,
+											__out PTIFF_FIELD pLengths,
+												__out PULONG pcbNextIfd);
+	HRESULT	ReadTiffFieldValues(__in MDAT_CACHE_ENTRY& rCE,
+									__in BOOL fBigEndian,
+										__in PTIFF_FIELD pField,
+											__in ULONG nValues,
+												__out PULONG pDest,
+													__in ULONG cbStride);
+
+	static UINT64 GetFrameOffset(__in PMDAT_FRAME_MAP pMap, __in ULONG iFrame);
+	static ULONG TiffWord(__in const BYTE* p, __in BOOL fBigEndian);
+	static ULONG TiffLong(__in const BYTE* p, __in BOOL fBigEndian);
+	static VOID CALLBACK ScanWorkCallback(__inout PTP_CALLBACK_INSTANCE pInstance,
+											__inout_opt PVOID pContext,
+												__inout PTP_WORK pWork);
+
+	// One frame map pointer per entry in m_aMdatTable[]. Each map is created on demand, the first time it's needed,
+	// and then it lives until the container is destroyed.
+	PMDAT_FRAME_MAP*	m_apFrameMaps;
+
+	// Same idea, for the MPEG picture indexes. These are only created for MPEG video elementary streams.
+	PMDAT_MPEG_INDEX*	m_apMpegIndexes;
+
+	// Same idea, for the TIFF image indexes. These are only created for TIFF MDATs with a TIFD media descriptor.
+	PMDAT_TIFF_INDEX*	m_apTiffIndexes;
+};
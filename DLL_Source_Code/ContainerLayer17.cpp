@@ -0,0 +1,753 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer17.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "Omfoo_Alpha_Header.h"
+#include "ContainerLayer17.h"
+#include "DllMain.h"
+
+#include "MiscStatic.h"
+using namespace NsMiscStatic;
+
+//*********************************************************************************************************************
+//	Constructor
+//	WARNING: This class is not meant to be instantiated on the stack.
+//	It assumes that its C++ operator new() has already zeroed all of its memory.
+//*********************************************************************************************************************
+CContainerLayer17::CContainerLayer17(void)
+{
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//*********************************************************************************************************************
+CContainerLayer17::~CContainerLayer17(void)
+{
+	if (m_apPcmLayouts)
+	{
+		for (ULONG i = 0; i < m_cMDATs; i++)
+		{
+			if (m_apPcmLayouts[i])
+			{
+				MemFree(m_apPcmLayouts[i]);
+			}
+		}
+		MemFree(m_apPcmLayouts);
+	}
+}
+
+//*********************************************************************************************************************
+//	Allocate one (empty) PCM layout pointer for each entry in m_aMdatTable[].
+//	The layouts themselves are not created until somebody asks for them. See GetMdatPcmLayout().
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::Load(PCWSTR pwzFileName)
+{
+	HRESULT hr = __super::Load(pwzFileName);
+	if (SUCCEEDED(hr) && m_cMDATs)
+	{
+		m_apPcmLayouts = (PMDAT_PCM_LAYOUT*)MemAlloc(m_cMDATs * sizeof(PMDAT_PCM_LAYOUT));
+		if (NULL == m_apPcmLayouts)
+		{
+			hr = E_OUTOFMEMORY;
+		}
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfAifcData, COmfWaveData, and COmfSd2fData classes.
+//	Describes the PCM samples in the MDAT's payload.
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::GetMdatSampleFormat(__in ULONG idx, __out POMFOO_PCM_FORMAT pFormat)
+{
+	PMDAT_PCM_LAYOUT	pLayout	= NULL;
+	HRESULT				hr		= S_OK;
+
+	if (IsBadWritePointer(pFormat, sizeof(OMFOO_PCM_FORMAT)))
+	{
+		return E_POINTER;
+	}
+
+	ZeroMemory(pFormat, sizeof(OMFOO_PCM_FORMAT));
+
+	if (SUCCEEDED(hr = GetMdatPcmLayout(idx, &pLayout)))
+	{
+		*pFormat = pLayout->oFormat;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfAifcData, COmfWaveData, and COmfSd2fData classes.
+//	Reads nFrames sample frames (starting with iFirstFrame) into caller's buffer, and converts each sample to dwFormat.
+//	The channels are interleaved, just like they are in the payload.
+//
+//	We only read the bytes that hold the requested frames - never the whole payload. The stored samples are read in
+//	chunks of PCM_READ_CHUNK_SIZE bytes into a scratch buffer, and each chunk is converted straight into caller's
+//	buffer. See CPcmConvert::Convert().
+//
+//	If the run of frames goes past the end of the payload then we clip it, and *pnFramesRead tells our caller how many
+//	frames we actually read. If pBuffer is NULL or cbBuffer is too small for the clipped run then we return
+//	OMF_E_INSUFFICIENT_BUFFER.
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::ReadMdatSampleFrames(__in ULONG idx,
+													__in UINT64 iFirstFrame,
+														__in ULONG nFrames,
+															__in DWORD dwFormat,
+																__in ULONG cbBuffer,
+																	__out_opt PVOID pBuffer,
+																		__out PULONG pnFramesRead)
+{
+	PMDAT_PCM_LAYOUT	pLayout			= NULL;
+	PBYTE				pRaw			= NULL;
+	PBYTE				pOut			= PBYTE(pBuffer);
+	UINT64				cbReadPos		= 0;
+	UINT64				cbRequired		= 0;
+	ULONG				cbOutSample		= CPcmConvert::GetBytesPerOutput(dwFormat);
+	ULONG				nChunkFrames	= 0;
+	ULONG				nFramesDone		= 0;
+	HRESULT				hr				= S_OK;
+
+	if (IsBadWritePointer(pnFramesRead, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pnFramesRead = 0;
+
+	if (0 == cbOutSample)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (FAILED(hr = GetMdatPcmLayout(idx, &pLayout)))
+	{
+		return hr;
+	}
+
+	OMFOO_PCM_FORMAT& rFormat = pLayout->oFormat;
+
+	// Make sure the run begins inside the payload. If it ends past the last frame then clip it.
+	if ((nFrames == 0) || (iFirstFrame >= rFormat.nSampleFrames))
+	{
+		return E_INVALIDARG;
+	}
+
+	if (nFrames > rFormat.nSampleFrames - iFirstFrame)
+	{
+		nFrames = ULONG(rFormat.nSampleFrames - iFirstFrame);
+	}
+
+	// The converted samples can't be larger than 4GB.
+	cbRequired = UINT64(nFrames) * rFormat.wChannels * cbOutSample;
+	if (cbRequired > ULONG_MAX)
+	{
+		return OMF_E_SIZE_SURPRISE;
+	}
+
+	// Under these circumstances this is not really an error because the destination buffer is optional.
+	if ((NULL == pBuffer) || (cbBuffer < cbRequired))
+	{
+		return OMF_E_INSUFFICIENT_BUFFER;
+	}
+
+	if (IsBadWritePointer(pBuffer, ULONG(cbRequired)))
+	{
+		return E_POINTER;
+	}
+
+	// wBlockAlign is a WORD, so nChunkFrames is never zero.
+	nChunkFrames = PCM_READ_CHUNK_SIZE / rFormat.wBlockAlign;
+	if (nChunkFrames > nFrames)
+	{
+		nChunkFrames = nFrames;
+	}
+
+	pRaw = PBYTE(MemAlloc(nChunkFrames * rFormat.wBlockAlign));
+	if (NULL == pRaw)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	cbReadPos = m_aMdatTable[idx].cbPayloadOffset + rFormat.cbDataOffset + (iFirstFrame * rFormat.wBlockAlign);
+
+	while (nFramesDone < nFrames)
+	{
+		ULONG nChunk = nFrames - nFramesDone;
+		if (nChunk > nChunkFrames)
+		{
+			nChunk = nChunkFrames;
+		}
+
+		if (FAILED(hr = SeekRead(cbReadPos, pRaw, nChunk * rFormat.wBlockAlign)))
+		{
+			goto L_CleanupExit;
+		}
+
+		CPcmConvert::Convert(pRaw, pLayout->dwSampleKind, SIZE_T(nChunk) * rFormat.wChannels, dwFormat, pOut);
+
+		cbReadPos	+= UINT64(nChunk) * rFormat.wBlockAlign;
+		pOut		+= SIZE_T(nChunk) * rFormat.wChannels * cbOutSample;
+		nFramesDone	+= nChunk;
+	}
+
+	*pnFramesRead = nFramesDone;
+
+L_CleanupExit:
+	MemFree(pRaw);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Returns the PCM layout for the nth entry in m_aMdatTable[]. Creates it if it doesn't exist yet.
+//	The layout belongs to us - so our caller must not free it. This has the same race rules as GetMdatFrameMap().
+//	Returns OMF_E_CANT_COMPLETE if the MDAT is not uncompressed audio, or if we can't make sense of its header.
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::GetMdatPcmLayout(__in ULONG idx, __out PMDAT_PCM_LAYOUT* ppLayout)
+{
+	PMDAT_PCM_LAYOUT	pLayout	= NULL;
+	PVOID				pPrev	= NULL;
+	HRESULT				hr		= S_OK;
+
+	*ppLayout = NULL;
+
+	if ((NULL == m_aMdatTable) || (NULL == m_apPcmLayouts) || (idx >= m_cMDATs))
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+
+	pLayout = m_apPcmLayouts[idx];
+	if (NULL == pLayout)
+	{
+		if (FAILED(hr = LoadMdatPcmLayout(m_aMdatTable[idx], &pLayout)))
+		{
+			return hr;
+		}
+
+		pPrev = InterlockedCompareExchangePointer((PVOID volatile*)&m_apPcmLayouts[idx], pLayout, NULL);
+		if (pPrev)
+		{
+			// Another thread beat us to it.
+			MemFree(pLayout);
+			pLayout = PMDAT_PCM_LAYOUT(pPrev);
+		}
+	}
+
+	*ppLayout = pLayout;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for GetMdatPcmLayout().
+//	Allocates a new MDAT_PCM_LAYOUT and fills it in. How we do that depends on the MDAT's class.
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::LoadMdatPcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT* ppLayout)
+{
+	PMDAT_PCM_LAYOUT	pLayout	= NULL;
+	HRESULT				hr		= S_OK;
+
+	*ppLayout = NULL;
+
+	pLayout = PMDAT_PCM_LAYOUT(MemAlloc(sizeof(MDAT_PCM_LAYOUT)));
+	if (NULL == pLayout)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	switch (rCE.oMDAT.dwFourCC)
+	{
+	case FCC('WAVE'):
+		hr = ParseWavePcmLayout(rCE, pLayout);
+		break;
+
+	case FCC('AIFC'):
+		hr = ParseAifcPcmLayout(rCE, pLayout);
+		break;
+
+	case FCC('SD2M'):
+		hr = ParseSd2PcmLayout(rCE, pLayout);
+		break;
+
+	default:
+		hr = OMF_E_CANT_COMPLETE;
+		break;
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		// Every parser must leave us with something that we can convert.
+		OMFOO_PCM_FORMAT& rFormat = pLayout->oFormat;
+		if ((rFormat.wChannels == 0) ||
+			(rFormat.wBytesPerSample != CPcmConvert::GetBytesPerSample(pLayout->dwSampleKind)) ||
+			(rFormat.wBlockAlign != rFormat.wChannels * rFormat.wBytesPerSample) ||
+			(rFormat.nSampleFrames == 0))
+		{
+			hr = OMF_E_CANT_COMPLETE;
+		}
+	}
+
+	if (FAILED(hr))
+	{
+		MemFree(pLayout);
+		return hr;
+	}
+
+	*ppLayout = pLayout;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatPcmLayout().
+//	Walks the chunks of an embedded RIFF/WAVE file to find its 'fmt ' and 'data' chunks.
+//
+//	We ignore the RIFF ckSize because some OMF writers got it wrong. See the IFF ckSize kludge in
+//	CContainerLayer15::GetMdatPatchChunkSize(). We also clip the 'data' chunk to the end of the payload. That takes care
+//	of RF64 files too, because their 'data' ckSize is 0xFFFFFFFF and the real size lives in their 'ds64' chunk.
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::ParseWavePcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT pLayout)
+{
+// This is a WAVEFORMATEXTENSIBLE without the GUID. Only the first 16 bytes are required.
+#pragma pack(push, 2)	// align structure members to 16-bit boundaries
+typedef struct {
+	WORD	wFormatTag;
+	WORD	nChannels;
+	DWORD	nSamplesPerSec;
+	DWORD	nAvgBytesPerSec;
+	WORD	nBlockAlign;
+	WORD	wBitsPerSample;
+	WORD	cbSize;
+	WORD	wValidBitsPerSample;
+	DWORD	dwChannelMask;
+	DWORD	dwSubFormat;		// the first four bytes of the SubFormat GUID, which is the format tag in disguise.
+	BYTE	aSubFormatRest[12];
+} WAVE_FMT_CHUNK;
+#pragma pack(pop)
+
+	DWORD			aRiffHeader[3]	= {0};
+	DWORD			aChunkHeader[2]	= {0};
+	WAVE_FMT_CHUNK	oFmt			= {0};
+	UINT64			cbChunkPos		= 12;
+	UINT64			cbDataOffset	= 0;
+	UINT64			cbDataLength	= 0;
+	ULONG			cbFmt			= 0;
+	BOOL			fFoundFmt		= FALSE;
+	BOOL			fFoundData		= FALSE;
+	WORD			wFormatTag		= 0;
+	WORD			wBitsPerSample	= 0;
+	WORD			cbSample		= 0;
+	HRESULT			hr				= S_OK;
+
+	if (rCE.cbPayloadLength < sizeof(aRiffHeader))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	if (FAILED(hr = SeekRead(rCE.cbPayloadOffset, aRiffHeader, sizeof(aRiffHeader))))
+	{
+		return hr;
+	}
+
+	if (((aRiffHeader[0] != FCC('RIFF')) && (aRiffHeader[0] != FCC('RF64'))) || (aRiffHeader[2] != FCC('WAVE')))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	while ((!fFoundFmt || !fFoundData) && (cbChunkPos + sizeof(aChunkHeader) <= rCE.cbPayloadLength))
+	{
+		if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbChunkPos, aChunkHeader, sizeof(aChunkHeader))))
+		{
+			return hr;
+		}
+
+		UINT64 cbChunk		= aChunkHeader[1];
+		UINT64 cbRemaining	= rCE.cbPayloadLength - cbChunkPos - sizeof(aChunkHeader);
+		if (cbChunk > cbRemaining)
+		{
+			cbChunk = cbRemaining;
+		}
+
+		if ((aChunkHeader[0] == FCC('fmt ')) && !fFoundFmt)
+		{
+			cbFmt = (cbChunk < sizeof(oFmt)) ? ULONG(cbChunk) : ULONG(sizeof(oFmt));
+			if (cbFmt < 16)
+			{
+				return OMF_E_CANT_COMPLETE;
+			}
+
+			if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbChunkPos + sizeof(aChunkHeader), &oFmt, cbFmt)))
+			{
+				return hr;
+			}
+			fFoundFmt = TRUE;
+		}
+		else if ((aChunkHeader[0] == FCC('data')) && !fFoundData)
+		{
+			cbDataOffset	= cbChunkPos + sizeof(aChunkHeader);
+			cbDataLength	= cbChunk;
+			fFoundData		= TRUE;
+		}
+
+		// Chunks are padded to an even number of bytes.
+		cbChunkPos += sizeof(aChunkHeader) + cbChunk + (cbChunk & 1);
+	}
+
+	if (!fFoundFmt || !fFoundData || (oFmt.nChannels == 0) || (oFmt.nBlockAlign % oFmt.nChannels))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	wFormatTag		= oFmt.wFormatTag;
+	wBitsPerSample	= oFmt.wBitsPerSample;
+	cbSample		= WORD(oFmt.nBlockAlign / oFmt.nChannels);
+
+	// WAVE_FORMAT_EXTENSIBLE
+	if (wFormatTag == 0xFFFE)
+	{
+		if (cbFmt < sizeof(oFmt))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+
+		wFormatTag = WORD(oFmt.dwSubFormat);
+		if (oFmt.wValidBitsPerSample)
+		{
+			wBitsPerSample = oFmt.wValidBitsPerSample;
+		}
+	}
+
+	// WAVE_FORMAT_PCM
+	if (wFormatTag == 0x0001)
+	{
+		switch (cbSample)
+		{
+		case 1:
+			pLayout->dwSampleKind		= PCM_KIND_U8;
+			pLayout->oFormat.dwFlags	= PCMF_UNSIGNED;
+			break;
+
+		case 2:
+			pLayout->dwSampleKind		= PCM_KIND_S16LE;
+			break;
+
+		case 3:
+			pLayout->dwSampleKind		= PCM_KIND_S24LE;
+			break;
+
+		case 4:
+			pLayout->dwSampleKind		= PCM_KIND_S32LE;
+			break;
+
+		default:
+			return OMF_E_CANT_COMPLETE;
+		}
+	}
+	// WAVE_FORMAT_IEEE_FLOAT
+	else if ((wFormatTag == 0x0003) && (cbSample == 4))
+	{
+		pLayout->dwSampleKind		= PCM_KIND_F32LE;
+		pLayout->oFormat.dwFlags	= PCMF_FLOAT;
+	}
+	else
+	{
+		// Compressed.
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	if ((wBitsPerSample == 0) || (wBitsPerSample > cbSample * 8))
+	{
+		wBitsPerSample = WORD(cbSample * 8);
+	}
+
+	pLayout->oFormat.nSampleFrames		= cbDataLength / oFmt.nBlockAlign;
+	pLayout->oFormat.cbDataOffset		= cbDataOffset;
+	pLayout->oFormat.nSamplesPerSec		= oFmt.nSamplesPerSec;
+	pLayout->oFormat.wChannels			= oFmt.nChannels;
+	pLayout->oFormat.wBitsPerSample		= wBitsPerSample;
+	pLayout->oFormat.wBytesPerSample	= cbSample;
+	pLayout->oFormat.wBlockAlign		= oFmt.nBlockAlign;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatPcmLayout().
+//	Walks the chunks of an embedded AIFF or AIFF-C file to find its 'COMM' and 'SSND' chunks.
+//	Everything in these files is big-endian, including the ckSize members.
+//
+//	The only AIFF-C compression types that we understand are the ones that are really just PCM: 'NONE' and 'twos'
+//	(big-endian), 'sowt' (little-endian), 'fl32' (big-endian floats), and 'raw ' (8-bit unsigned).
+//	We trust the COMM chunk's numSampleFrames, unless the SSND chunk is too short to hold that many.
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::ParseAifcPcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT pLayout)
+{
+	DWORD	aFormHeader[3]		= {0};
+	DWORD	aChunkHeader[2]		= {0};
+	DWORD	aSsndHeader[2]		= {0};	// offset and blockSize.
+	BYTE	aComm[22]			= {0};	// numChannels, numSampleFrames, sampleSize, sampleRate, and compressionType.
+	UINT64	cbChunkPos			= 12;
+	UINT64	cbDataOffset		= 0;
+	UINT64	cbDataLength		= 0;
+	BOOL	fAifc				= FALSE;
+	BOOL	fFoundComm			= FALSE;
+	BOOL	fFoundSsnd			= FALSE;
+	WORD	wChannels			= 0;
+	DWORD	nSampleFrames		= 0;
+	WORD	wSampleSize			= 0;
+	WORD	cbSample			= 0;
+	DOUBLE	dSampleRate			= 0;
+	DWORD	dwCompression		= FCC('NONE');
+	HRESULT	hr					= S_OK;
+
+	if (rCE.cbPayloadLength < sizeof(aFormHeader))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	if (FAILED(hr = SeekRead(rCE.cbPayloadOffset, aFormHeader, sizeof(aFormHeader))))
+	{
+		return hr;
+	}
+
+	if ((aFormHeader[0] != FCC('FORM')) || ((aFormHeader[2] != FCC('AIFF')) && (aFormHeader[2] != FCC('AIFC'))))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	fAifc = (aFormHeader[2] == FCC('AIFC'));
+
+	while ((!fFoundComm || !fFoundSsnd) && (cbChunkPos + sizeof(aChunkHeader) <= rCE.cbPayloadLength))
+	{
+		if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbChunkPos, aChunkHeader, sizeof(aChunkHeader))))
+		{
+			return hr;
+		}
+
+		UINT64 cbChunk		= Endian32(aChunkHeader[1]);
+		UINT64 cbRemaining	= rCE.cbPayloadLength - cbChunkPos - sizeof(aChunkHeader);
+		if (cbChunk > cbRemaining)
+		{
+			cbChunk = cbRemaining;
+		}
+
+		if ((aChunkHeader[0] == FCC('COMM')) && !fFoundComm)
+		{
+			// The AIFF version of this chunk doesn't have a compressionType.
+			if (cbChunk < (fAifc ? sizeof(aComm) : sizeof(aComm) - 4))
+			{
+				return OMF_E_CANT_COMPLETE;
+			}
+
+			if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbChunkPos + sizeof(aChunkHeader),
+										aComm,
+											fAifc ? sizeof(aComm) : sizeof(aComm) - 4)))
+			{
+				return hr;
+			}
+			fFoundComm = TRUE;
+		}
+		else if ((aChunkHeader[0] == FCC('SSND')) && !fFoundSsnd)
+		{
+			if (cbChunk < sizeof(aSsndHeader))
+			{
+				return OMF_E_CANT_COMPLETE;
+			}
+
+			if (FAILED(hr = SeekRead(rCE.cbPayloadOffset + cbChunkPos + sizeof(aChunkHeader),
+										aSsndHeader,
+											sizeof(aSsndHeader))))
+			{
+				return hr;
+			}
+
+			// The offset member says how many bytes of padding come before the first sample frame.
+			UINT64 cbPadding = Endian32(aSsndHeader[0]);
+			if (cbPadding > cbChunk - sizeof(aSsndHeader))
+			{
+				return OMF_E_CANT_COMPLETE;
+			}
+
+			cbDataOffset	= cbChunkPos + sizeof(aChunkHeader) + sizeof(aSsndHeader) + cbPadding;
+			cbDataLength	= cbChunk - sizeof(aSsndHeader) - cbPadding;
+			fFoundSsnd		= TRUE;
+		}
+
+		// Chunks are padded to an even number of bytes.
+		cbChunkPos += sizeof(aChunkHeader) + cbChunk + (cbChunk & 1);
+	}
+
+	if (!fFoundComm || !fFoundSsnd)
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	wChannels		= Endian16(*PWORD(&aComm[0]));
+	nSampleFrames	= Endian32(*(UNALIGNED DWORD*)&aComm[2]);
+	wSampleSize		= Endian16(*PWORD(&aComm[6]));
+	if (FAILED(hr = Extended80ToDouble(&aComm[8], &dSampleRate)))
+	{
+		return hr;
+	}
+
+	if (fAifc)
+	{
+		dwCompression = *(UNALIGNED DWORD*)&aComm[18];
+	}
+
+	if ((wSampleSize == 0) || (wSampleSize > 32))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	cbSample = WORD((wSampleSize + 7) / 8);
+
+	switch (dwCompression)
+	{
+	case FCC('NONE'):
+	case FCC('twos'):
+		switch (cbSample)
+		{
+		case 1:
+			pLayout->dwSampleKind	= PCM_KIND_S8;
+			break;
+
+		case 2:
+			pLayout->dwSampleKind	= PCM_KIND_S16BE;
+			break;
+
+		case 3:
+			pLayout->dwSampleKind	= PCM_KIND_S24BE;
+			break;
+
+		default:
+			pLayout->dwSampleKind	= PCM_KIND_S32BE;
+			break;
+		}
+		pLayout->oFormat.dwFlags	= PCMF_BIG_ENDIAN;
+		break;
+
+	case FCC('sowt'):
+		switch (cbSample)
+		{
+		case 1:
+			pLayout->dwSampleKind	= PCM_KIND_S8;
+			break;
+
+		case 2:
+			pLayout->dwSampleKind	= PCM_KIND_S16LE;
+			break;
+
+		case 3:
+			pLayout->dwSampleKind	= PCM_KIND_S24LE;
+			break;
+
+		default:
+			pLayout->dwSampleKind	= PCM_KIND_S32LE;
+			break;
+		}
+		break;
+
+	case FCC('fl32'):
+	case FCC('FL32'):
+		// Some writers put zero in sampleSize. The samples are always 32 bits.
+		wSampleSize					= 32;
+		cbSample					= 4;
+		pLayout->dwSampleKind		= PCM_KIND_F32BE;
+		pLayout->oFormat.dwFlags	= PCMF_BIG_ENDIAN|PCMF_FLOAT;
+		break;
+
+	case FCC('raw '):
+		if (cbSample != 1)
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+		pLayout->dwSampleKind		= PCM_KIND_U8;
+		pLayout->oFormat.dwFlags	= PCMF_UNSIGNED;
+		break;
+
+	default:
+		// Compressed.
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	if ((wChannels == 0) || (ULONG(wChannels) * cbSample > 0xFFFF) || (dSampleRate <= 0) || (dSampleRate >= ULONG_MAX))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	pLayout->oFormat.wChannels			= wChannels;
+	pLayout->oFormat.wBitsPerSample		= wSampleSize;
+	pLayout->oFormat.wBytesPerSample	= cbSample;
+	pLayout->oFormat.wBlockAlign		= WORD(wChannels * cbSample);
+	pLayout->oFormat.nSamplesPerSec		= ULONG(dSampleRate + 0.5);
+	pLayout->oFormat.cbDataOffset		= cbDataOffset;
+	pLayout->oFormat.nSampleFrames		= cbDataLength / pLayout->oFormat.wBlockAlign;
+	if (pLayout->oFormat.nSampleFrames > nSampleFrames)
+	{
+		pLayout->oFormat.nSampleFrames = nSampleFrames;
+	}
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for LoadMdatPcmLayout().
+//	Sound Designer II payloads have no header at all. They are just big-endian PCM samples, so everything we need to
+//	know comes from the media descriptor (SD2D). See also CContainerLayer12::IdentifySD2M_SD2D().
+//*********************************************************************************************************************
+HRESULT CContainerLayer17::ParseSd2PcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT pLayout)
+{
+	UINT16	wNumOfChannels	= 0;	// OMFI:SD2D:NumOfChannels
+	UINT16	wBitsPerSample	= 0;	// OMFI:SD2D:BitsPerSample
+	WORD	cbSample		= 0;
+	UINT64	nSampleFrames	= 0;
+	HRESULT	hr				= S_OK;
+
+	if (FAILED(hr = RordReadUInt16(rCE.oMDES, ePropSd2dNumOfChannels, &wNumOfChannels)) ||
+		FAILED(hr = RordReadUInt16(rCE.oMDES, ePropSd2dBitsPerSample, &wBitsPerSample)))
+	{
+		return hr;
+	}
+
+	if ((wNumOfChannels == 0) || (wNumOfChannels > 0x5555) ||
+		(wBitsPerSample == 0) || (wBitsPerSample > 24) || (rCE.fSampleRate <= 0))
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	cbSample = WORD((wBitsPerSample + 7) / 8);
+	switch (cbSample)
+	{
+	case 1:
+		pLayout->dwSampleKind	= PCM_KIND_S8;
+		break;
+
+	case 2:
+		pLayout->dwSampleKind	= PCM_KIND_S16BE;
+		break;
+
+	default:
+		pLayout->dwSampleKind	= PCM_KIND_S24BE;
+		break;
+	}
+
+	// Trust OMFI:MDFL:Length, unless the payload is too short to hold that many frames.
+	nSampleFrames = rCE.cbPayloadLength / (wNumOfChannels * cbSample);
+	if ((rCE.qwDuration) && (rCE.qwDuration < nSampleFrames))
+	{
+		nSampleFrames = rCE.qwDuration;
+	}
+
+	pLayout->oFormat.nSampleFrames		= nSampleFrames;
+	pLayout->oFormat.cbDataOffset		= 0;
+	pLayout->oFormat.nSamplesPerSec		= ULONG(rCE.fSampleRate + 0.5f);
+	pLayout->oFormat.wChannels			= wNumOfChannels;
+	pLayout->oFormat.wBitsPerSample		= wBitsPerSample;
+	pLayout->oFormat.wBytesPerSample	= cbSample;
+	pLayout->oFormat.wBlockAlign		= WORD(wNumOfChannels * cbSample);
+	pLayout->oFormat.dwFlags			= PCMF_BIG_ENDIAN;
+	return S_OK;
+}
@@ -0,0 +1,59 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer17.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+#include "ContainerLayer16.h"
+#include "PcmConvert.h"
+
+//*********************************************************************************************************************
+//	Structures.
+//*********************************************************************************************************************
+//	Internal structure for our per-MDAT PCM sample layout. See LoadMdatPcmLayout().
+typedef struct {
+	OMFOO_PCM_FORMAT	oFormat;		// what we report to our callers.
+	DWORD				dwSampleKind;	// PCM_KIND_S16LE, etc. See PcmConvert.h.
+	DWORD				dwReserved;
+} MDAT_PCM_LAYOUT, *PMDAT_PCM_LAYOUT;
+
+class CContainerLayer17 : public CContainerLayer16
+{
+protected:
+			CContainerLayer17(void);
+	virtual	~CContainerLayer17(void);
+	STDMETHODIMP	Load(__in PCWSTR pwzFileName);
+
+public:
+	enum {
+		PCM_READ_CHUNK_SIZE	= 0x00040000,	// stored samples are read in chunks of this many bytes. (256KB)
+	};
+
+	// Callback/helper routines for our COmfMediaData classes.
+	// They all accept an index to m_aMdatTable[] as their MDAT argument.
+	STDMETHODIMP	GetMdatSampleFormat(__in ULONG idx,
+										__out POMFOO_PCM_FORMAT pFormat);
+
+	STDMETHODIMP	ReadMdatSampleFrames(__in ULONG idx,
+											__in UINT64 iFirstFrame,
+												__in ULONG nFrames,
+													__in DWORD dwFormat,
+														__in ULONG cbBuffer,
+															__out_opt PVOID pBuffer,
+																__out PULONG pnFramesRead);
+
+protected:
+	HRESULT	GetMdatPcmLayout(__in ULONG idx, __out PMDAT_PCM_LAYOUT* ppLayout);
+
+private:
+	HRESULT	LoadMdatPcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT* ppLayout);
+	HRESULT	ParseWavePcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT pLayout);
+	HRESULT	ParseAifcPcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT pLayout);
+	HRESULT	ParseSd2PcmLayout(__in MDAT_CACHE_ENTRY& rCE, __out PMDAT_PCM_LAYOUT pLayout);
+
+	// One PCM layout pointer per entry in m_aMdatTable[]. Each layout is created on demand, the first time it's
+	// needed, and then it lives until the container is destroyed. These are only created for audio MDATs.
+	PMDAT_PCM_LAYOUT*	m_apPcmLayouts;
+};
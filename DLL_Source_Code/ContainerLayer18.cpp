@@ -0,0 +1,556 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer18.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "Omfoo_Alpha_Header.h"
+#include "ContainerLayer18.h"
+#include "DllMain.h"
+#include <shlwapi.h>
+
+#include "MiscStatic.h"
+using namespace NsMiscStatic;
+
+//*********************************************************************************************************************
+//	Constructor
+//	WARNING: This class is not meant to be instantiated on the stack.
+//	It assumes that its C++ operator new() has already zeroed all of its memory.
+//*********************************************************************************************************************
+CContainerLayer18::CContainerLayer18(void)
+{
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//*********************************************************************************************************************
+CContainerLayer18::~CContainerLayer18(void)
+{
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfAifcData, COmfWaveData, COmfSd2fData, and COmfIdatData classes.
+//	Creates a read-only IStream on the MDAT's samples or frames wrapped in a container that other tools understand,
+//	and then queries it for the interface specified by riid.
+//
+//	The container header is generated from the PCM layout (see GetMdatPcmLayout()) and spliced in front of a stream on
+//	the stored samples. See CContainerLayer15::CreateSplicedStreamOnMdatRange(). If there are an odd number of bytes
+//	of samples then a zero pad byte follows them, because both RIFF and IFF require every chunk to be even-sized.
+//	We never swap bytes, so WAVE and RF64 only work for little-endian samples and AIFF only works for big-endian
+//	samples. SYNTH_CONTAINER_AUTO picks the one that fits. Video has no header at all. It's just the whole frames,
+//	and GetMdatRawVideoSidecar() describes them.
+//*********************************************************************************************************************
+HRESULT CContainerLayer18::CreateStreamOnMdatContainer(__in ULONG idx,
+															__in DWORD dwContainer,
+																__in REFIID riid,
+																	__out PVOID *ppvOut)
+{
+	PMDAT_PCM_LAYOUT	pLayout	= NULL;
+	HRESULT				hr		= VerifyIID_PPV_ARGS(riid, ppvOut);
+
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	if ((NULL == m_aMdatTable) || (idx >= m_cMDATs))
+	{
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+
+	switch (dwContainer)
+	{
+	case SYNTH_CONTAINER_AUTO:
+		// If it has a PCM layout then it's audio. Otherwise see if it's uncompressed video.
+		if (SUCCEEDED(GetMdatPcmLayout(idx, &pLayout)))
+		{
+			hr = CreateStreamOnPcmContainer(idx, pLayout, dwContainer, riid, ppvOut);
+		}
+		else
+		{
+			hr = CreateStreamOnRawVideo(idx, riid, ppvOut);
+		}
+		break;
+
+	case SYNTH_CONTAINER_WAVE:
+	case SYNTH_CONTAINER_RF64:
+	case SYNTH_CONTAINER_AIFF:
+		if (SUCCEEDED(hr = GetMdatPcmLayout(idx, &pLayout)))
+		{
+			hr = CreateStreamOnPcmContainer(idx, pLayout, dwContainer, riid, ppvOut);
+		}
+		break;
+
+	case SYNTH_CONTAINER_RAW_VIDEO:
+		hr = CreateStreamOnRawVideo(idx, riid, ppvOut);
+		break;
+
+	default:
+		hr = E_INVALIDARG;
+		break;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Callback/helper routine for our COmfIdatData and COmfJpegData classes.
+//	Describes the frames in the SYNTH_CONTAINER_RAW_VIDEO stream as ffmpeg-style input options. For example:
+//	"-f rawvideo -pixel_format uyvy422 -video_size 720x486 -framerate 30000/1001"
+//
+//	DV frames don't need a description, because every DV frame describes itself. For those we just say "-f dv".
+//	Otherwise the frames must be uncompressed, they must have a pixel layout that we can name, and there can't be
+//	any padding between them. If not we return OMF_E_CANT_COMPLETE.
+//*********************************************************************************************************************
+HRESULT CContainerLayer18::GetMdatRawVideoSidecar(__in ULONG idx,
+														__in ULONG cchBuffer,
+															__out_opt PWCHAR pBuffer,
+																__out_opt PULONG pcchRequired)
+{
+	WCHAR			wzResult[128]	= {0};
+	PMDAT_FRAME_MAP	pMap			= NULL;
+	PCWSTR			pwzPixelFormat	= NULL;
+	OMF_RATIONAL	oFrameRate		= {0};
+	ULONG			nStoredWidth	= 0;
+	ULONG			nStoredHeight	= 0;
+	ULONG			nBitsPerPixel	= 0;
+	WORD			wFrameLayout	= LT_FULL_FRAME;
+	HRESULT			hr				= S_OK;
+
+	if (FAILED(hr = GetMdatFrameMap(idx, &pMap)))
+	{
+		goto L_Exit;
+	}
+
+	if (pMap->dwSource != FRAME_MAP_FIXED_STRIDE)
+	{
+		hr = OMF_E_CANT_COMPLETE;
+		goto L_Exit;
+	}
+
+	MDAT_CACHE_ENTRY& rCE = m_aMdatTable[idx];
+
+	if (rCE.dwNonambiguousCompressionFourCC == FCC('DV/C'))
+	{
+		lstrcpyW(wzResult, L"-f dv");
+		goto L_Exit;
+	}
+
+	if (FAILED(hr = GetRawVideoPixelFormat(rCE, &pwzPixelFormat, &nBitsPerPixel)))
+	{
+		goto L_Exit;
+	}
+
+	if (FAILED(hr = RordReadUInt32(rCE.oMDES, ePropDiddStoredWidth, PUINT32(&nStoredWidth))) ||
+		FAILED(hr = RordReadUInt32(rCE.oMDES, ePropDiddStoredHeight, PUINT32(&nStoredHeight))) ||
+		FAILED(hr = RordReadRational(rCE.oMDES, ePropMdflSampleRate, &oFrameRate)))
+	{
+		goto L_Exit;
+	}
+
+	// A frame with two separate fields is two pictures stacked on top of each other. Nobody can play that.
+	RordReadUInt16(rCE.oMDES, ePropDiddFrameLayout, &wFrameLayout);
+	if ((wFrameLayout == LT_SEPARATE_FIELDS) || (oFrameRate.nNumerator <= 0) || (oFrameRate.nDenominator <= 0))
+	{
+		hr = OMF_E_CANT_COMPLETE;
+		goto L_Exit;
+	}
+
+	// A raw video reader assumes that every frame is exactly one picture, so there can't be any padding.
+	if (pMap->cbStride != (UINT64(nStoredWidth) * nStoredHeight * nBitsPerPixel) / 8)
+	{
+		hr = OMF_E_CANT_COMPLETE;
+		goto L_Exit;
+	}
+
+	wnsprintfW(wzResult,
+				ELEMS(wzResult),
+				L"-f rawvideo -pixel_format %s -video_size %lux%lu -framerate %ld/%ld",
+				pwzPixelFormat,
+				nStoredWidth,
+				nStoredHeight,
+				oFrameRate.nNumerator,
+				oFrameRate.nDenominator);
+
+L_Exit:
+	// We always call this even when we fail because it manages and validates our caller's arguments.
+	return CallTwiceStringHandlerW(hr, wzResult, cchBuffer, pBuffer, pcchRequired);
+}
+
+//*********************************************************************************************************************
+//	Private helper for CreateStreamOnMdatContainer().
+//	Builds a WAVE, RF64, or AIFF header for the stored samples, and splices it in front of them.
+//*********************************************************************************************************************
+HRESULT CContainerLayer18::CreateStreamOnPcmContainer(__in ULONG idx,
+														__in PMDAT_PCM_LAYOUT pLayout,
+															__in DWORD dwContainer,
+																__in REFIID riid,
+																	__out PVOID *ppvOut)
+{
+	BYTE				aHeader[SYNTH_HEADER_MAX]	= {0};
+	ULONG				cbHeader					= 0;
+	OMFOO_PCM_FORMAT&	rFormat						= pLayout->oFormat;
+	UINT64				cbData						= rFormat.nSampleFrames * rFormat.wBlockAlign;
+
+	// This is the size limit for both RIFF and AIFF - with room to spare for the header.
+	BOOL fFitsIn32Bits = (cbData <= 0xFFFFFF00);
+
+	if (dwContainer == SYNTH_CONTAINER_AUTO)
+	{
+		if (IsWaveSampleKind(pLayout->dwSampleKind))
+		{
+			dwContainer = fFitsIn32Bits ? SYNTH_CONTAINER_WAVE : SYNTH_CONTAINER_RF64;
+		}
+		else
+		{
+			dwContainer = SYNTH_CONTAINER_AIFF;
+		}
+	}
+
+	switch (dwContainer)
+	{
+	case SYNTH_CONTAINER_WAVE:
+	case SYNTH_CONTAINER_RF64:
+		if (!IsWaveSampleKind(pLayout->dwSampleKind) || ((dwContainer == SYNTH_CONTAINER_WAVE) && !fFitsIn32Bits))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+		cbHeader = BuildWaveHeader(pLayout, (dwContainer == SYNTH_CONTAINER_RF64), aHeader);
+		break;
+
+	case SYNTH_CONTAINER_AIFF:
+		if (!IsAiffSampleKind(pLayout->dwSampleKind) || !fFitsIn32Bits || (rFormat.nSampleFrames > ULONG_MAX))
+		{
+			return OMF_E_CANT_COMPLETE;
+		}
+		cbHeader = BuildAiffHeader(pLayout, aHeader);
+		break;
+
+	default:
+		BREAK_IF_DEBUG
+		return OMFOO_E_ASSERTION_FAILURE;
+	}
+
+	return CreateSplicedStreamOnMdatRange(m_aMdatTable[idx],
+											aHeader,
+											cbHeader,
+											rFormat.cbDataOffset,
+											cbData,
+											ULONG(cbData & 1),
+											riid,
+											ppvOut);
+}
+
+//*********************************************************************************************************************
+//	Private helper for CreateStreamOnMdatContainer().
+//	Creates a stream on the whole frames of a payload with a fixed frame size (uncompressed video or DV), without
+//	any header. Anything in front of the first frame and anything after the last whole frame is left out.
+//*********************************************************************************************************************
+HRESULT CContainerLayer18::CreateStreamOnRawVideo(__in ULONG idx, __in REFIID riid, __out PVOID *ppvOut)
+{
+	PMDAT_FRAME_MAP	pMap	= NULL;
+	HRESULT			hr		= S_OK;
+
+	if (FAILED(hr = GetMdatFrameMap(idx, &pMap)))
+	{
+		return hr;
+	}
+
+	if (pMap->dwSource != FRAME_MAP_FIXED_STRIDE)
+	{
+		return OMF_E_CANT_COMPLETE;
+	}
+
+	return CreateStreamOnMdatRange(m_aMdatTable[idx], pMap->cbFirstFrame, pMap->nFrames * pMap->cbStride, riid, ppvOut);
+}
+
+//*********************************************************************************************************************
+//	Private helper for GetMdatRawVideoSidecar().
+//	Returns ffmpeg's name for the pixel format of an uncompressed CDCI or RGBA payload, and its bits per pixel.
+//	The only CDCI we can name is 8-bit 4:2:2 with no padding, which Avid stores as Cb Y Cr Y (UYVY). An RGBA can be any
+//	arrangement of 8-bit R, G, B, A, and F (fill) components that ffmpeg has a name for.
+//*********************************************************************************************************************
+HRESULT CContainerLayer18::GetRawVideoPixelFormat(__in MDAT_CACHE_ENTRY& rCE,
+													__out PCWSTR* ppwzPixelFormat,
+														__out PULONG pnBitsPerPixel)
+{
+	static const struct {
+		CHAR	szLayout[8];
+		PCWSTR	pwzPixelFormat;
+	} aRgbaFormats[] = {
+		{"RGB",		L"rgb24"},
+		{"BGR",		L"bgr24"},
+		{"RGBA",	L"rgba"},
+		{"BGRA",	L"bgra"},
+		{"ARGB",	L"argb"},
+		{"ABGR",	L"abgr"},
+		{"RGBF",	L"rgb0"},
+		{"BGRF",	L"bgr0"},
+		{"FRGB",	L"0rgb"},
+		{"FBGR",	L"0bgr"},
+	};
+
+	*ppwzPixelFormat	= NULL;
+	*pnBitsPerPixel		= 0;
+
+	if (rCE.oMDES.dwFourCC == FCC('CDCI'))
+	{
+		ULONG	nComponentWidth	= 8;
+		ULONG	nHorizSubsample	= 1;
+		ULONG	nVertSubsample	= 1;
+		WORD	wPaddingBits	= 0;
+
+		// These are all optional. See CContainerLayer16::GetUncompressedFrameSize().
+		RordReadUInt32(rCE.oMDES, ePropCdciComponentWidth, PUINT32(&nComponentWidth));
+		RordReadUInt32(rCE.oMDES, ePropCdciHorizontalSubsampling, PUINT32(&nHorizSubsample));
+		RordReadUInt32(rCE.oMDES, ePropCdciVerticalSubsampling, PUINT32(&nVertSubsample));
+		RordReadUInt16(rCE.oMDES, ePropCdciPaddingBits, &wPaddingBits);
+
+		if ((nComponentWidth == 8) && (nHorizSubsample == 2) && (nVertSubsample == 1) && (wPaddingBits == 0))
+		{
+			*ppwzPixelFormat	= L"uyvy422";
+			*pnBitsPerPixel		= 16;
+			return S_OK;
+		}
+	}
+	else if (rCE.oMDES.dwFourCC == FCC('RGBA'))
+	{
+		OMF_COMP_CODE_ARRAY	aPixelLayout		= {0};
+		OMF_COMP_SIZE_ARRAY	aPixelStructure		= {0};
+		CHAR				szLayout[9]			= {0};
+		ULONG				nComponents			= 0;
+		HRESULT				hr					= S_OK;
+
+		if (FAILED(hr = RordReadCompCodeArray(rCE.oMDES, ePropRgbaPixelLayout, &aPixelLayout)) ||
+			FAILED(hr = RordReadCompSizeArray(rCE.oMDES, ePropRgbaPixelStructure, &aPixelStructure)))
+		{
+			return hr;
+		}
+
+		// Every component must be eight bits.
+		while ((nComponents < ELEMS(aPixelLayout)) && aPixelLayout[nComponents])
+		{
+			if (aPixelStructure[nComponents] != 8)
+			{
+				return OMF_E_CANT_COMPLETE;
+			}
+			szLayout[nComponents] = aPixelLayout[nComponents];
+			nComponents++;
+		}
+
+		for (ULONG i = 0; i < ELEMS(aRgbaFormats); i++)
+		{
+			if (0 == lstrcmpA(szLayout, aRgbaFormats[i].szLayout))
+			{
+				*ppwzPixelFormat	= aRgbaFormats[i].pwzPixelFormat;
+				*pnBitsPerPixel		= nComponents * 8;
+				return S_OK;
+			}
+		}
+	}
+
+	return OMF_E_CANT_COMPLETE;
+}
+
+//*********************************************************************************************************************
+//	Private helper for CreateStreamOnPcmContainer().
+//	Builds a RIFF/WAVE header (or an RF64/WAVE header if fRF64 is TRUE) for the stored samples in pHeader[], which must
+//	have room for SYNTH_HEADER_MAX bytes. Returns the size of the header. The last thing in the header is the 'data'
+//	chunk's header, so the samples follow immediately. The 'data' ckSize doesn't include the pad byte that follows an
+//	odd number of sample bytes, but the RIFF ckSize does.
+//
+//	We use WAVE_FORMAT_EXTENSIBLE if there are more than two channels, or if the samples don't fill their containers.
+//	RF64 is described in EBU Tech 3306. Its RIFF and 'data' ckSize members are 0xFFFFFFFF, and the real sizes live in
+//	the 'ds64' chunk, which must be the first chunk in the file.
+//*********************************************************************************************************************
+ULONG CContainerLayer18::BuildWaveHeader(__in PMDAT_PCM_LAYOUT pLayout, __in BOOL fRF64, __out PBYTE pHeader)
+{
+// This is a complete WAVEFORMATEXTENSIBLE. Only the first 16 bytes are used by WAVE_FORMAT_PCM.
+#pragma pack(push, 2)	// align structure members to 16-bit boundaries
+typedef struct {
+	WORD	wFormatTag;
+	WORD	nChannels;
+	DWORD	nSamplesPerSec;
+	DWORD	nAvgBytesPerSec;
+	WORD	nBlockAlign;
+	WORD	wBitsPerSample;
+	WORD	cbSize;
+	WORD	wValidBitsPerSample;
+	DWORD	dwChannelMask;
+	GUID	guidSubFormat;
+} WAVE_FMT_CHUNK;
+#pragma pack(pop)
+
+	// KSDATAFORMAT_SUBTYPE_PCM without the format tag in Data1.
+	static const GUID guidSubFormatBase = {0x00000000, 0x0000, 0x0010, {0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}};
+
+	OMFOO_PCM_FORMAT&	rFormat		= pLayout->oFormat;
+	WAVE_FMT_CHUNK		oFmt		= {0};
+	BOOL				fFloat		= (rFormat.dwFlags & PCMF_FLOAT) ? TRUE : FALSE;
+	BOOL				fPadded		= (rFormat.wBitsPerSample != rFormat.wBytesPerSample * 8);
+	BOOL				fExtensible	= (rFormat.wChannels > 2) || fPadded;
+	ULONG				cbFmt		= fExtensible ? sizeof(WAVE_FMT_CHUNK) : 16;
+	ULONG				cbHeader	= 12 + (fRF64 ? 36 : 0) + 8 + cbFmt + 8;
+	UINT64				cbData		= rFormat.nSampleFrames * rFormat.wBlockAlign;
+	UINT64				cbRiff		= cbHeader - 8 + cbData + (cbData & 1);
+	PBYTE				pDest		= pHeader;
+
+	oFmt.wFormatTag			= WORD(fFloat ? 3 : 1);		// WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM
+	oFmt.nChannels			= rFormat.wChannels;
+	oFmt.nSamplesPerSec		= rFormat.nSamplesPerSec;
+	oFmt.nAvgBytesPerSec	= rFormat.nSamplesPerSec * rFormat.wBlockAlign;
+	oFmt.nBlockAlign		= rFormat.wBlockAlign;
+	oFmt.wBitsPerSample		= WORD(rFormat.wBytesPerSample * 8);
+
+	if (fExtensible)
+	{
+		oFmt.guidSubFormat			= guidSubFormatBase;
+		oFmt.guidSubFormat.Data1	= oFmt.wFormatTag;
+		oFmt.wFormatTag				= 0xFFFE;					// WAVE_FORMAT_EXTENSIBLE
+		oFmt.cbSize					= 22;
+		oFmt.wValidBitsPerSample	= rFormat.wBitsPerSample;
+		oFmt.dwChannelMask			= 0;						// no particular speaker assignment
+	}
+
+	DWORD aRiffHeader[3] = {fRF64 ? FCC('RF64') : FCC('RIFF'), fRF64 ? 0xFFFFFFFF : DWORD(cbRiff), FCC('WAVE')};
+	CopyMemory(pDest, aRiffHeader, sizeof(aRiffHeader));
+	pDest += sizeof(aRiffHeader);
+
+	if (fRF64)
+	{
+		DWORD	aChunkHeader[2]	= {FCC('ds64'), 28};
+		UINT64	aSizes[3]		= {cbRiff, cbData, rFormat.nSampleFrames};
+		DWORD	nTableLength	= 0;
+
+		CopyMemory(pDest, aChunkHeader, sizeof(aChunkHeader));
+		pDest += sizeof(aChunkHeader);
+		CopyMemory(pDest, aSizes, sizeof(aSizes));
+		pDest += sizeof(aSizes);
+		CopyMemory(pDest, &nTableLength, sizeof(nTableLength));
+		pDest += sizeof(nTableLength);
+	}
+
+	DWORD aFmtHeader[2] = {FCC('fmt '), cbFmt};
+	CopyMemory(pDest, aFmtHeader, sizeof(aFmtHeader));
+	pDest += sizeof(aFmtHeader);
+	CopyMemory(pDest, &oFmt, cbFmt);
+	pDest += cbFmt;
+
+	DWORD aDataHeader[2] = {FCC('data'), fRF64 ? 0xFFFFFFFF : DWORD(cbData)};
+	CopyMemory(pDest, aDataHeader, sizeof(aDataHeader));
+	pDest += sizeof(aDataHeader);
+
+	return ULONG(pDest - pHeader);
+}
+
+//*********************************************************************************************************************
+//	Private helper for CreateStreamOnPcmContainer().
+//	Builds an AIFF header for the stored samples in pHeader[], which must have room for SYNTH_HEADER_MAX bytes. Returns
+//	the size of the header. Floats need AIFF-C, which adds an 'FVER' chunk and a compression type of 'fl32'.
+//	The last thing in the header is the 'SSND' chunk's header (with a zero offset), so the samples follow immediately.
+//	The 'SSND' ckSize doesn't include the pad byte that follows an odd number of sample bytes, but the FORM ckSize does.
+//	Everything in an AIFF header is big-endian, including the 80-bit IEEE 754 extended sample rate.
+//*********************************************************************************************************************
+ULONG CContainerLayer18::BuildAiffHeader(__in PMDAT_PCM_LAYOUT pLayout, __out PBYTE pHeader)
+{
+	OMFOO_PCM_FORMAT&	rFormat		= pLayout->oFormat;
+	BOOL				fAifc		= (rFormat.dwFlags & PCMF_FLOAT) ? TRUE : FALSE;
+	ULONG				cbComm		= fAifc ? 24 : 18;
+	ULONG				cbHeader	= 12 + (fAifc ? 12 : 0) + 8 + cbComm + 16;
+	UINT64				cbData		= rFormat.nSampleFrames * rFormat.wBlockAlign;
+	UINT64				cbForm		= cbHeader - 8 + cbData + (cbData & 1);
+	BYTE				aComm[24]	= {0};
+	PBYTE				pDest		= pHeader;
+
+	DWORD aFormHeader[3] = {FCC('FORM'), Endian32(UINT32(cbForm)), fAifc ? FCC('AIFC') : FCC('AIFF')};
+	CopyMemory(pDest, aFormHeader, sizeof(aFormHeader));
+	pDest += sizeof(aFormHeader);
+
+	if (fAifc)
+	{
+		// AIFC Version 1 (May 23, 1990 2:40pm).
+		DWORD aFver[3] = {FCC('FVER'), Endian32(4), Endian32(0xA2805140)};
+		CopyMemory(pDest, aFver, sizeof(aFver));
+		pDest += sizeof(aFver);
+	}
+
+	// numChannels, numSampleFrames, sampleSize, and sampleRate.
+	*PUINT16(&aComm[0])	= Endian16(rFormat.wChannels);
+	*PUINT32(&aComm[2])	= Endian32(UINT32(rFormat.nSampleFrames));
+	*PUINT16(&aComm[6])	= Endian16(rFormat.wBitsPerSample);
+
+	// The sample rate is an integer, so its 80-bit extended form is easy. The mantissa has an explicit integer bit,
+	// so we shift the highest bit that's set up to bit 63 and the exponent is 16383 plus that bit's position.
+	if (rFormat.nSamplesPerSec)
+	{
+		ULONG	iHighBit	= 31;
+		while (0 == (rFormat.nSamplesPerSec & (1UL << iHighBit)))
+		{
+			iHighBit--;
+		}
+		*PUINT16(&aComm[8])		= Endian16(UINT16(16383 + iHighBit));
+		*PUINT64(&aComm[10])	= Endian64(UINT64(rFormat.nSamplesPerSec) << (63 - iHighBit));
+	}
+
+	// AIFF-C adds a compressionType and an empty compressionName (a pascal string with a pad byte).
+	if (fAifc)
+	{
+		*PDWORD(&aComm[18]) = FCC('fl32');
+	}
+
+	DWORD aCommHeader[2] = {FCC('COMM'), Endian32(cbComm)};
+	CopyMemory(pDest, aCommHeader, sizeof(aCommHeader));
+	pDest += sizeof(aCommHeader);
+	CopyMemory(pDest, aComm, cbComm);
+	pDest += cbComm;
+
+	// ckSize, offset, and blockSize.
+	DWORD aSsndHeader[4] = {FCC('SSND'), Endian32(UINT32(8 + cbData)), 0, 0};
+	CopyMemory(pDest, aSsndHeader, sizeof(aSsndHeader));
+	pDest += sizeof(aSsndHeader);
+
+	return ULONG(pDest - pHeader);
+}
+
+//*********************************************************************************************************************
+//	Private helpers for CreateStreamOnPcmContainer().
+//	Returns TRUE if a WAVE file can hold samples of this kind without changing them. 8-bit WAVE samples are unsigned.
+//*********************************************************************************************************************
+BOOL CContainerLayer18::IsWaveSampleKind(__in DWORD dwSampleKind)
+{
+	switch (dwSampleKind)
+	{
+	case PCM_KIND_U8:
+	case PCM_KIND_S16LE:
+	case PCM_KIND_S24LE:
+	case PCM_KIND_S32LE:
+	case PCM_KIND_F32LE:
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
+//*********************************************************************************************************************
+//	Returns TRUE if an AIFF or AIFF-C file can hold samples of this kind without changing them.
+//	8-bit AIFF samples are signed.
+//*********************************************************************************************************************
+BOOL CContainerLayer18::IsAiffSampleKind(__in DWORD dwSampleKind)
+{
+	switch (dwSampleKind)
+	{
+	case PCM_KIND_S8:
+	case PCM_KIND_S16BE:
+	case PCM_KIND_S24BE:
+	case PCM_KIND_S32BE:
+	case PCM_KIND_F32BE:
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
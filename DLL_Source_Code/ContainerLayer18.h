@@ -0,0 +1,50 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer18.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+#include "ContainerLayer17.h"
+
+class CContainerLayer18 : public CContainerLayer17
+{
+protected:
+			CContainerLayer18(void);
+	virtual	~CContainerLayer18(void);
+
+public:
+	enum {
+		SYNTH_HEADER_MAX	= 128,	// room for our largest synthesized header (RF64 with WAVE_FORMAT_EXTENSIBLE).
+	};
+
+	// Callback/helper routines for our COmfMediaData classes.
+	// They all accept an index to m_aMdatTable[] as their MDAT argument.
+	STDMETHODIMP	CreateStreamOnMdatContainer(__in ULONG idx,
+													__in DWORD dwContainer,
+														__in REFIID riid,
+															__out PVOID *ppvOut);
+
+	STDMETHODIMP	GetMdatRawVideoSidecar(__in ULONG idx,
+											__in ULONG cchBuffer,
+												__out_opt PWCHAR pBuffer,
+													__out_opt PULONG pcchRequired);
+
+private:
+	HRESULT	CreateStreamOnPcmContainer(__in ULONG idx,
+											__in PMDAT_PCM_LAYOUT pLayout,
+												__in DWORD dwContainer,
+													__in REFIID riid,
+														__out PVOID *ppvOut);
+
+	HRESULT	CreateStreamOnRawVideo(__in ULONG idx, __in REFIID riid, __out PVOID *ppvOut);
+	HRESULT	GetRawVideoPixelFormat(__in MDAT_CACHE_ENTRY& rCE,
+										__out PCWSTR* ppwzPixelFormat,
+											__out PULONG pnBitsPerPixel);
+
+	static ULONG	BuildWaveHeader(__in PMDAT_PCM_LAYOUT pLayout, __in BOOL fRF64, __out PBYTE pHeader);
+	static ULONG	BuildAiffHeader(__in PMDAT_PCM_LAYOUT pLayout, __out PBYTE pHeader);
+	static BOOL		IsWaveSampleKind(__in DWORD dwSampleKind);
+	static BOOL		IsAiffSampleKind(__in DWORD dwSampleKind);
+};
@@ -0,0 +1,404 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer94.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "Omfoo_Alpha_Header.h"
+#include "ContainerLayer94.h"
+#include "SortByFilePos.h"
+#include "DllMain.h"
+
+#include "MiscStatic.h"
+using namespace NsMiscStatic;
+
+//*********************************************************************************************************************
+//	Constructor
+//	WARNING: This class is not meant to be instantiated on the stack.
+//	It assumes that its C++ operator new() has already zeroed all of its memory.
+//*********************************************************************************************************************
+CContainerLayer94::CContainerLayer94(void)
+{
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//*********************************************************************************************************************
+CContainerLayer94::~CContainerLayer94(void)
+{
+}
+
+//*********************************************************************************************************************
+//	IOmfooWaveformBuilder::BuildWaveforms()
+//	Computes the min, max, and RMS of every nSamplesPerPeak sample frames of every channel of every audio MDAT, and
+//	reports each MDAT's waveform to caller's callback.
+//
+//	The audio MDATs are sorted by file position. Worker threads from the Windows thread pool claim them one at a time
+//	in that order, and read each payload from front to back in chunks of PCM_READ_CHUNK_SIZE bytes. Each chunk is
+//	converted to floats by CPcmConvert::Convert() and summarized by CPcmConvert::AccumulatePeaks().
+//
+//	Meanwhile the calling thread waits for the waveforms in the same order, and reports each one as soon as it's done.
+//	That way caller's callback never runs on one of our threads, and it sees the MDATs in a predictable order. The
+//	waveforms are tiny compared to their payloads, so we don't mind if the workers get ahead of the callback.
+//	If caller asks for one thread (or we can't get any) then the calling thread builds each waveform itself.
+//*********************************************************************************************************************
+HRESULT CContainerLayer94::BuildWaveforms(__in ULONG nSamplesPerPeak,
+												__in ULONG nThreads,
+													__in IOmfooWaveformCallback *pUnknown)
+{
+	IOmfooWaveformCallback*	pCallback	= NULL;
+	WAVEFORM_BATCH			oBatch		= {0};
+	SYSTEM_INFO				si			= {0};
+	PTP_WORK				pWork		= NULL;
+	PBYTE					pScratch	= NULL;
+	ULONG					nWorkers	= 0;
+
+	HRESULT hr = m_hrFirewall;
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	if ((nSamplesPerPeak < WAVEFORM_MIN_BLOCK) || (nSamplesPerPeak > WAVEFORM_MAX_BLOCK))
+	{
+		return E_INVALIDARG;
+	}
+
+	// Verify that caller's callback handler is an IOmfooWaveformCallback.
+	if (IsBadUnknown(pUnknown))
+	{
+		return E_FAIL;
+	}
+
+	if (FAILED(hr = pUnknown->QueryInterface(IID_PPV_ARGS(&pCallback))))
+	{
+		return hr;
+	}
+
+	// Nothing to do?
+	if (0 == m_cMDATs)
+	{
+		goto L_CleanupExit;
+	}
+
+	oBatch.aJobs = PWAVEFORM_JOB(MemAlloc(m_cMDATs * sizeof(WAVEFORM_JOB)));
+	if (NULL == oBatch.aJobs)
+	{
+		BREAK_IF_DEBUG
+		hr = E_OUTOFMEMORY;
+		goto L_CleanupExit;
+	}
+
+	oBatch.pThis			= this;
+	oBatch.nJobs			= PrepareWaveformJobs(oBatch.aJobs);
+	oBatch.nSamplesPerPeak	= nSamplesPerPeak;
+	oBatch.iNextJob			= 0;
+	oBatch.hrFirstError		= S_OK;
+
+	if (0 == oBatch.nJobs)
+	{
+		goto L_CleanupExit;
+	}
+
+	if (nThreads == 0)
+	{
+		GetSystemInfo(&si);
+		nThreads = si.dwNumberOfProcessors;
+	}
+
+	nWorkers = nThreads;
+	if (nWorkers > WAVEFORM_MAX_WORKERS)
+	{
+		nWorkers = WAVEFORM_MAX_WORKERS;
+	}
+	if (nWorkers > oBatch.nJobs)
+	{
+		nWorkers = oBatch.nJobs;
+	}
+
+	// If we can't get an event or a work object then we can still do all of the work ourselves.
+	if (nWorkers > 1)
+	{
+		oBatch.hJobDone = CreateEventW(NULL, FALSE, FALSE, NULL);
+		if (oBatch.hJobDone && (NULL != (pWork = CreateThreadpoolWork(WaveformWorkCallback, &oBatch, NULL))))
+		{
+			for (ULONG i = 0; i < nWorkers; i++)
+			{
+				SubmitThreadpoolWork(pWork);
+			}
+		}
+	}
+
+	if (NULL == pWork)
+	{
+		pScratch = PBYTE(VirtualAlloc(NULL, WAVEFORM_SCRATCH_SIZE, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+		if (NULL == pScratch)
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			goto L_CleanupExit;
+		}
+	}
+
+	// Report the waveforms in file order.
+	for (ULONG i = 0; i < oBatch.nJobs; i++)
+	{
+		WAVEFORM_JOB&		rJob	= oBatch.aJobs[i];
+		OMFOO_PCM_FORMAT	oFormat	= {0};
+
+		if (pWork)
+		{
+			while ((!rJob.fDone) && SUCCEEDED(oBatch.hrFirstError))
+			{
+				WaitForSingleObject(oBatch.hJobDone, INFINITE);
+			}
+
+			if (FAILED(hr = oBatch.hrFirstError))
+			{
+				break;
+			}
+		}
+		else if (FAILED(hr = BuildWaveformJob(oBatch, rJob, pScratch)))
+		{
+			break;
+		}
+
+		// Give caller a copy of the format, so that our own copy can't be changed.
+		oFormat = rJob.pLayout->oFormat;
+		if (FAILED(pCallback->WaveformReady(m_aMdatTable[rJob.idx].oMDAT.dwObject, &oFormat, rJob.nPeaks, rJob.aPeaks)))
+		{
+			// Tell the workers to stop.
+			hr = E_ABORT;
+			InterlockedCompareExchange(&oBatch.hrFirstError, hr, S_OK);
+			break;
+		}
+
+		MemFree(rJob.aPeaks);
+		rJob.aPeaks = NULL;
+	}
+
+L_CleanupExit:
+	if (pWork)
+	{
+		// If we're done early then the callbacks that haven't started yet have nothing to do, so we cancel them.
+		WaitForThreadpoolWorkCallbacks(pWork, TRUE);
+		CloseThreadpoolWork(pWork);
+	}
+
+	if (oBatch.hJobDone)
+	{
+		CloseHandle(oBatch.hJobDone);
+	}
+
+	if (pScratch)
+	{
+		VirtualFree(pScratch, 0, MEM_RELEASE);
+	}
+
+	if (oBatch.aJobs)
+	{
+		for (ULONG i = 0; i < oBatch.nJobs; i++)
+		{
+			MemFree(oBatch.aJobs[i].aPeaks);
+		}
+		MemFree(oBatch.aJobs);
+	}
+
+	pCallback->Release();
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Function object for SortByFilePos(). Returns the file position of a WAVEFORM_JOB's first sample frame.
+//*********************************************************************************************************************
+class CWaveformJobFilePos
+{
+public:
+	UINT64 operator()(const WAVEFORM_JOB& rJob) const { return rJob.cbDataPos; }
+};
+
+//*********************************************************************************************************************
+//	Private helper for BuildWaveforms().
+//	Creates a WAVEFORM_JOB for each MDAT that holds uncompressed PCM audio, sorts them by the file position of their
+//	first sample frame, and returns how many there are. On entry aJobs[] must have room for m_cMDATs elements.
+//*********************************************************************************************************************
+ULONG CContainerLayer94::PrepareWaveformJobs(__out PWAVEFORM_JOB aJobs)
+{
+	ULONG nJobs = 0;
+
+	for (ULONG i = 0; i < m_cMDATs; i++)
+	{
+		PMDAT_PCM_LAYOUT pLayout = NULL;
+
+		// Anything that isn't uncompressed audio fails here, and we skip it. So do empty payloads.
+		if (FAILED(GetMdatPcmLayout(i, &pLayout)) ||
+			(0 == pLayout->oFormat.nSampleFrames) ||
+			(0 == pLayout->oFormat.wChannels))
+		{
+			continue;
+		}
+
+		aJobs[nJobs].idx		= i;
+		aJobs[nJobs].pLayout	= pLayout;
+		aJobs[nJobs].cbDataPos	= m_aMdatTable[i].cbPayloadOffset + pLayout->oFormat.cbDataOffset;
+		nJobs++;
+	}
+
+	// Sort by file position.
+	SortByFilePos(aJobs, nJobs, CWaveformJobFilePos());
+
+	return nJobs;
+}
+
+//*********************************************************************************************************************
+//	Private helper for BuildWaveforms() and RunWaveformWorker().
+//	Reads one MDAT's samples from front to back, and fills in rJob.aPeaks[]. The pScratch buffer must have room for
+//	WAVEFORM_SCRATCH_SIZE bytes: one chunk of stored samples, followed by the same number of samples as floats. If
+//	somebody else fails while we're busy then we stop early, because nobody will ever see our results.
+//*********************************************************************************************************************
+HRESULT CContainerLayer94::BuildWaveformJob(__in WAVEFORM_BATCH& rBatch,
+												__inout WAVEFORM_JOB& rJob,
+													__in PBYTE pScratch)
+{
+	OMFOO_PCM_FORMAT&	rFormat			= rJob.pLayout->oFormat;
+	ULONG				nChannels		= rFormat.wChannels;
+	ULONG				nPerPeak		= rBatch.nSamplesPerPeak;
+	PBYTE				pRaw			= pScratch;
+	PFLOAT				pFloat			= PFLOAT(pScratch + PCM_READ_CHUNK_SIZE);
+	PDOUBLE				aSumSq			= NULL;
+	PFLOAT				aMin			= NULL;
+	PFLOAT				aMax			= NULL;
+	UINT64				nPeaks			= 0;
+	UINT64				cbPeaks			= 0;
+	UINT64				cbReadPos		= rJob.cbDataPos;
+	UINT64				nFramesLeft		= rFormat.nSampleFrames;
+	ULONG				nChunkFrames	= PCM_READ_CHUNK_SIZE / rFormat.wBlockAlign;
+	ULONG				nInPeak			= 0;
+	ULONG				iPeak			= 0;
+	HRESULT				hr				= S_OK;
+
+	// The waveform has to fit in one allocation.
+	nPeaks	= (rFormat.nSampleFrames + nPerPeak - 1) / nPerPeak;
+	cbPeaks	= nPeaks * nChannels * sizeof(OMFOO_WAVEFORM_PEAK);
+	if (cbPeaks > ULONG_MAX)
+	{
+		return OMF_E_SIZE_SURPRISE;
+	}
+
+	rJob.aPeaks = POMFOO_WAVEFORM_PEAK(MemAlloc(ULONG(cbPeaks)));
+	if (NULL == rJob.aPeaks)
+	{
+		return E_OUTOFMEMORY;
+	}
+	rJob.nPeaks = ULONG(nPeaks);
+
+	// The running peaks for the block that we're working on. All three arrays live in the same allocation.
+	aSumSq = PDOUBLE(MemAlloc(nChannels * (sizeof(DOUBLE) + sizeof(FLOAT) + sizeof(FLOAT))));
+	if (NULL == aSumSq)
+	{
+		return E_OUTOFMEMORY;
+	}
+	aMin = PFLOAT(aSumSq + nChannels);
+	aMax = aMin + nChannels;
+	CPcmConvert::ResetPeaks(nChannels, aMin, aMax, aSumSq);
+
+	while (nFramesLeft && SUCCEEDED(rBatch.hrFirstError))
+	{
+		ULONG nChunk = (nFramesLeft > nChunkFrames) ? nChunkFrames : ULONG(nFramesLeft);
+
+		if (FAILED(hr = SeekRead(cbReadPos, pRaw, nChunk * rFormat.wBlockAlign)))
+		{
+			goto L_CleanupExit;
+		}
+
+		CPcmConvert::Convert(pRaw, rJob.pLayout->dwSampleKind, SIZE_T(nChunk) * nChannels, PCM_FORMAT_FLOAT32, pFloat);
+
+		// A block can begin in one chunk and end in another, so we cut each chunk at the block boundaries.
+		for (ULONG iFrame = 0; iFrame < nChunk;)
+		{
+			ULONG nSpan = nPerPeak - nInPeak;
+			if (nSpan > nChunk - iFrame)
+			{
+				nSpan = nChunk - iFrame;
+			}
+
+			CPcmConvert::AccumulatePeaks(pFloat + (SIZE_T(iFrame) * nChannels), nSpan, nChannels, aMin, aMax, aSumSq);
+			iFrame	+= nSpan;
+			nInPeak	+= nSpan;
+
+			if (nInPeak == nPerPeak)
+			{
+				CPcmConvert::FinishPeaks(nInPeak, nChannels, aMin, aMax, aSumSq, &rJob.aPeaks[iPeak * nChannels]);
+				nInPeak = 0;
+				iPeak++;
+			}
+		}
+
+		cbReadPos	+= UINT64(nChunk) * rFormat.wBlockAlign;
+		nFramesLeft	-= nChunk;
+	}
+
+	// The last block is usually short.
+	if (nInPeak)
+	{
+		CPcmConvert::FinishPeaks(nInPeak, nChannels, aMin, aMax, aSumSq, &rJob.aPeaks[iPeak * nChannels]);
+	}
+
+L_CleanupExit:
+	MemFree(aSumSq);
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private static helper for BuildWaveforms().
+//	This is the thread pool's entry point. Its only job is to get back inside our object.
+//*********************************************************************************************************************
+VOID CALLBACK CContainerLayer94::WaveformWorkCallback(__inout PTP_CALLBACK_INSTANCE pInstance,
+														__inout_opt PVOID pContext,
+															__inout PTP_WORK pWork)
+{
+	UNREFERENCED_PARAMETER(pInstance);
+	UNREFERENCED_PARAMETER(pWork);
+
+	PWAVEFORM_BATCH pBatch = PWAVEFORM_BATCH(pContext);
+	pBatch->pThis->RunWaveformWorker(*pBatch);
+}
+
+//*********************************************************************************************************************
+//	Private helper for BuildWaveforms().
+//	Claims jobs one at a time and builds their waveforms - until there are no more jobs or somebody fails.
+//	Every job that we claim is marked done (even if it failed) and then we wake up the calling thread, so that it
+//	never waits for a job that nobody is working on.
+//*********************************************************************************************************************
+void CContainerLayer94::RunWaveformWorker(__inout WAVEFORM_BATCH& rBatch)
+{
+	PBYTE	pScratch	= NULL;
+	LONG	iJob		= 0;
+	HRESULT	hr			= S_OK;
+
+	pScratch = PBYTE(VirtualAlloc(NULL, WAVEFORM_SCRATCH_SIZE, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+	if (NULL == pScratch)
+	{
+		BREAK_IF_DEBUG
+		InterlockedCompareExchange(&rBatch.hrFirstError, HRESULT_FROM_WIN32(GetLastError()), S_OK);
+		SetEvent(rBatch.hJobDone);
+		return;
+	}
+
+	while (SUCCEEDED(rBatch.hrFirstError) && (ULONG(iJob = InterlockedIncrement(&rBatch.iNextJob) - 1) < rBatch.nJobs))
+	{
+		WAVEFORM_JOB& rJob = rBatch.aJobs[iJob];
+
+		if (FAILED(hr = BuildWaveformJob(rBatch, rJob, pScratch)))
+		{
+			InterlockedCompareExchange(&rBatch.hrFirstError, hr, S_OK);
+		}
+
+		InterlockedExchange(&rJob.fDone, TRUE);
+		SetEvent(rBatch.hJobDone);
+	}
+
+	VirtualFree(pScratch, 0, MEM_RELEASE);
+}
@@ -0,0 +1,64 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ContainerLayer94.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+#include "ContainerLayer18.h"
+
+//*********************************************************************************************************************
+//	Structures used internally by BuildWaveforms().
+//*********************************************************************************************************************
+// One of these per audio MDAT.
+typedef struct {
+	ULONG					idx;			// the MDAT's index in m_aMdatTable[].
+	PMDAT_PCM_LAYOUT		pLayout;		// see CContainerLayer17::GetMdatPcmLayout().
+	UINT64					cbDataPos;		// physical file position of the first sample frame. This is our sort key.
+	POMFOO_WAVEFORM_PEAK	aPeaks;			// allocated by whoever builds the waveform, and freed after it's reported.
+	ULONG					nPeaks;			// number of blocks in aPeaks[]. Each block has one element per channel.
+	volatile LONG			fDone;			// TRUE when the job is finished - whether it succeeded or not.
+} WAVEFORM_JOB, *PWAVEFORM_JOB;
+
+// Shared by the calling thread and the worker threads.
+class CContainerLayer94;
+typedef struct {
+	CContainerLayer94*	pThis;
+	PWAVEFORM_JOB		aJobs;				// sorted by cbDataPos.
+	ULONG				nJobs;				// number of elements in aJobs[].
+	ULONG				nSamplesPerPeak;	// caller's block size.
+	HANDLE				hJobDone;			// auto-reset event. A worker sets it every time it finishes a job.
+	volatile LONG		iNextJob;			// the next job that nobody has claimed yet.
+	volatile LONG		hrFirstError;		// the first thing that went wrong, or S_OK.
+} WAVEFORM_BATCH, *PWAVEFORM_BATCH;
+
+class CContainerLayer94
+	: public CContainerLayer18
+	, public IOmfooWaveformBuilder
+{
+protected:
+			CContainerLayer94(void);
+	virtual	~CContainerLayer94(void);
+
+	// IOmfooWaveformBuilder methods in V-table order.
+	STDMETHODIMP	BuildWaveforms(__in ULONG nSamplesPerPeak,
+									__in ULONG nThreads,
+										__in IOmfooWaveformCallback *pCallback);
+
+private:
+	enum {
+		WAVEFORM_MIN_BLOCK		= 16,			// smallest value for nSamplesPerPeak.
+		WAVEFORM_MAX_BLOCK		= 0x00100000,	// largest value for nSamplesPerPeak.
+		WAVEFORM_MAX_WORKERS	= 8,			// maximum number of worker threads.
+		WAVEFORM_SCRATCH_SIZE	= 5 * PCM_READ_CHUNK_SIZE,	// a chunk of stored samples, and the same chunk as floats.
+	};
+
+	ULONG	PrepareWaveformJobs(__out PWAVEFORM_JOB aJobs);
+	HRESULT	BuildWaveformJob(__in WAVEFORM_BATCH& rBatch, __inout WAVEFORM_JOB& rJob, __in PBYTE pScratch);
+	void	RunWaveformWorker(__inout WAVEFORM_BATCH& rBatch);
+
+	static VOID CALLBACK WaveformWorkCallback(__inout PTP_CALLBACK_INSTANCE pInstance,
+												__inout_opt PVOID pContext,
+													__inout PTP_WORK pWork);
+};
@@ -8,6 +8,13 @@
 #include "stdafx.h"
 #include "Omfoo_Alpha_Header.h"
 #include "ContainerLayer95.h"
+#include "ExtractDigest.h"
+#include "SortByFilePos.h"
+#include "DllMain.h"
+#include <shlwapi.h>
+
+#include "MiscStatic.h"
+using namespace NsMiscStatic;
 
 //*********************************************************************************************************************
 //	Constructor
@@ -38,4 +45,1015 @@ CContainerLayer95::~CContainerLayer95(void)
 //	return hr;
 //}
 
+//*********************************************************************************************************************
+//	IOmfooBulkExtractor::GetMdatCount()
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::GetMdatCount(__out PULONG pnMdats)
+{
+	if (IsBadWritePointer(pnMdats, sizeof(ULONG)))
+	{
+		return E_POINTER;
+	}
+
+	*pnMdats = 0;
+
+	HRESULT hr = m_hrFirewall;
+	if (SUCCEEDED(hr))
+	{
+		*pnMdats = m_cMDATs;
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooBulkExtractor::ExtractAllMdats()
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::ExtractAllMdats(__in PCWSTR pwzDestFolder,
+												__in DWORD dwSyntax,
+													__in BOOL fOverwrite,
+														__in_opt IOmfooBulkExtractCallback *pCallback,
+															__in_opt ULONG nPagesPerBuffer)
+{
+	return BulkExtractMdats(pwzDestFolder, dwSyntax, 0, fOverwrite, pCallback, nPagesPerBuffer);
+}
+
+//*********************************************************************************************************************
+//	IOmfooBulkExtractor2::ExtractUniqueMdats()
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::ExtractUniqueMdats(__in PCWSTR pwzDestFolder,
+												__in DWORD dwSyntax,
+													__in DWORD dwDedupFlags,
+														__in BOOL fOverwrite,
+															__in_opt IOmfooBulkExtractCallback *pCallback,
+																__in_opt ULONG nPagesPerBuffer)
+{
+	if (dwDedupFlags & ~DWORD(BXF_LINK_CLONES|BXF_REPORT_CLONES|BXF_REPORT_NESTED))
+	{
+		return E_INVALIDARG;
+	}
+
+	if ((dwDedupFlags & BXF_LINK_CLONES) && (dwDedupFlags & BXF_REPORT_CLONES))
+	{
+		return E_INVALIDARG;
+	}
+
+	return BulkExtractMdats(pwzDestFolder, dwSyntax, dwDedupFlags, fOverwrite, pCallback, nPagesPerBuffer);
+}
+
+//*********************************************************************************************************************
+//	Private worker for ExtractAllMdats() and ExtractUniqueMdats().
+//	Extracts the payload of every MDAT in m_aMdatTable[] into pwzDestFolder.
+//
+//	This is a bulk version of CContainerLayer15::ExtractMdatDataToFile(). Instead of opening a new read handle,
+//	allocating two banks, and creating two events for every MDAT, we do all of that once. Then we walk through the
+//	MDATs in file order and keep a small pool of buffers busy. Each buffer is read from the OMF file and then written
+//	to its destination file. Because the reads are issued in file order the OMF file is read from front to back, and
+//	because each buffer is written as soon as it's filled the writes to several destination files overlap each other.
+//	At most BULK_SLOTS destination files are open at any one time.
+//
+//	If caller's callback also exposes IOmfooDigestCallback then each buffer is hashed before it is written. Reads can
+//	finish out of order, but hashes can't be computed out of order. So a buffer that finishes reading before an earlier
+//	buffer of the same MDAT waits in the BULK_SLOT_HASHING state until that earlier buffer has been hashed.
+//
+//	If dwDedupFlags is non-zero then FindBulkExtractDuplicates() marks the clones and nested MDATs that we don't have
+//	to read. We skip them in the main loop, and then FinishBulkExtractDuplicate() links them or reports them at the end.
+//
+//	The destination files are always written with FILE_FLAG_NO_BUFFERING. If the OMF file lives on a volume whose
+//	sector size is no larger than a page then we read it with FILE_FLAG_NO_BUFFERING too, so that a multi-gigabyte
+//	extraction doesn't flush everything else out of the system file cache. MDAT payloads almost never start on a
+//	sector boundary, so each read starts at the page boundary in front of the payload and its length is rounded up to
+//	a whole number of pages. When the read completes we slide the payload down to the front of the buffer. Every
+//	buffer has BULK_READ_SLOP extra bytes to make room for that unaligned head. If we can't learn the sector size then
+//	we fall back to ordinary cached reads.
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::BulkExtractMdats(__in PCWSTR pwzDestFolder,
+												__in DWORD dwSyntax,
+													__in DWORD dwDedupFlags,
+														__in BOOL fOverwrite,
+															__in_opt IOmfooBulkExtractCallback *pUnknown,
+																__in_opt ULONG nPagesPerBuffer)
+{
+	IOmfooBulkExtractCallback*	pCallback		= NULL;
+	IOmfooDigestCallback*		pDigestCallback	= NULL;
+	IOmfooBulkAliasCallback*	pAliasCallback	= NULL;
+	PBULK_EXTRACT_JOB			aJobs			= NULL;
+	PBYTE						pMemBase		= NULL;
+	HANDLE						hFileRead		= NULL;
+	BULK_EXTRACT_SLOT			aSlots[BULK_SLOTS];
+	HANDLE						aWaitEvents[BULK_SLOTS];
+	ULONG						aWaitSlots[BULK_SLOTS];
+
+	UINT64	cbTotal			= 0;
+	UINT64	cbCompleted		= 0;
+	ULONG	nJobsCompleted	= 0;
+	ULONG	iNextJob		= 0;
+	DWORD	cbBuffer		= 0;
+	DWORD	cbSlot			= 0;
+	DWORD	dwDigestKinds	= 0;
+	DWORD	dwReadFlags		= FILE_FLAG_OVERLAPPED|FILE_FLAG_SEQUENTIAL_SCAN;
+	UINT32	cbSector		= 0;
+	DWORD	dwError			= NOERROR;
+	DWORD	dwWaitResult	= NOERROR;
+
+	HRESULT hr = m_hrFirewall;
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	ZeroMemory(aSlots, sizeof(aSlots));
+
+	if (IsBadStringPointerW(pwzDestFolder, MAX_PATH))
+	{
+		return E_POINTER;
+	}
+
+	// Syntax #0 only creates a filename extension.
+	if ((dwSyntax == 0) || (dwSyntax > 5))
+	{
+		return E_INVALIDARG;
+	}
+
+	// See the note about memory buffer sizes in CContainerLayer15::ExtractMdatDataToFile().
+	if (nPagesPerBuffer == 0)
+	{
+		cbBuffer = BULK_DEFAULT_PAGES * 4096;
+	}
+	else if (nPagesPerBuffer <= BULK_MAX_PAGES)
+	{
+		cbBuffer = nPagesPerBuffer * 4096;
+	}
+	else
+	{
+		return E_INVALIDARG;
+	}
+
+	// If caller provided a callback handler then verify that it's an IOmfooBulkExtractCallback.
+	if (pUnknown)
+	{
+		if (IsBadUnknown(pUnknown))
+		{
+			return E_FAIL;
+		}
+		else
+		{
+			if (FAILED(hr = pUnknown->QueryInterface(IID_PPV_ARGS(&pCallback))))
+			{
+				return hr;
+			}
+		}
+
+		// Does caller's callback want checksums too? It doesn't have to.
+		if (SUCCEEDED(pCallback->QueryInterface(IID_PPV_ARGS(&pDigestCallback))))
+		{
+			if (FAILED(pDigestCallback->GetDigestKinds(&dwDigestKinds)))
+			{
+				dwDigestKinds = 0;
+			}
+
+			if (dwDigestKinds & ~DWORD(DK_CRC32C|DK_XXH64|DK_SHA256))
+			{
+				hr = E_INVALIDARG;
+				goto L_CleanupExit;
+			}
+		}
+
+		if (dwDedupFlags & (BXF_REPORT_CLONES|BXF_REPORT_NESTED))
+		{
+			pCallback->QueryInterface(IID_PPV_ARGS(&pAliasCallback));
+		}
+	}
+
+	// If caller wants aliases reported then caller has to give us somewhere to report them.
+	if ((dwDedupFlags & (BXF_REPORT_CLONES|BXF_REPORT_NESTED)) && (NULL == pAliasCallback))
+	{
+		hr = E_INVALIDARG;
+		goto L_CleanupExit;
+	}
+
+	// Nothing to do?
+	if (0 == m_cMDATs)
+	{
+		hr = S_OK;
+		goto L_CleanupExit;
+	}
+
+	aJobs = PBULK_EXTRACT_JOB(MemAlloc(m_cMDATs * sizeof(BULK_EXTRACT_JOB)));
+	if (NULL == aJobs)
+	{
+		BREAK_IF_DEBUG
+		hr = E_OUTOFMEMORY;
+		goto L_CleanupExit;
+	}
+
+	// Create all of the filenames up front, so that we fail before we write anything if one of them is bad.
+	if (FAILED(hr = PrepareBulkExtractJobs(pwzDestFolder, dwSyntax, aJobs)))
+	{
+		goto L_CleanupExit;
+	}
+
+	// Find the payloads that we don't have to read.
+	if (dwDedupFlags)
+	{
+		FindBulkExtractDuplicates(aJobs, dwDedupFlags);
+	}
+
+	for (ULONG i = 0; i < m_cMDATs; i++)
+	{
+		if (aJobs[i].bDedup == BULK_JOB_UNIQUE)
+		{
+			cbTotal += aJobs[i].pCE->cbPayloadLength;
+		}
+	}
+
+	// Can we bypass the system file cache when we read the OMF file?
+	// The sector size must be a power of two, and a page-aligned read must also be a sector-aligned read.
+	if (SUCCEEDED(CReadableFile::GetBytesPerSector(m_pwzFullPath, &cbSector)) &&
+		(cbSector != 0) && (cbSector <= BULK_MAX_SECTOR) && (0 == (cbSector & (cbSector - 1))))
+	{
+		dwReadFlags |= FILE_FLAG_NO_BUFFERING;
+	}
+
+	// Allocate memory for all of the buffers in one shot.
+	cbSlot = cbBuffer + BULK_READ_SLOP;
+	pMemBase = PBYTE(VirtualAlloc(NULL, SIZE_T(cbSlot) * BULK_SLOTS, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+	if (pMemBase == NULL)
+	{
+		BREAK_IF_DEBUG
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Create one manual-reset event per buffer.
+	// ReadFile() and WriteFile() reset it for us every time we start a new operation.
+	for (ULONG i = 0; i < BULK_SLOTS; i++)
+	{
+		aSlots[i].pBuffer = &pMemBase[SIZE_T(cbSlot) * i];
+		if (NULL == (aSlots[i].ovl.hEvent = CreateEventW(LPSECURITY_ATTRIBUTES(NULL), TRUE, FALSE, LPCWSTR(0))))
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			goto L_CleanupExit;
+		}
+	}
+
+	// Open a handle to our current OMF file for asynchronous reading.
+	// We cannot use the one in CReadableFile::m_hFileRead because it was not opened with FILE_FLAG_OVERLAPPED.
+	hFileRead = CreateFileW(m_pwzFullPath,			// file to open
+							GENERIC_READ,			// open for reading (SYNCHRONIZE = ok)
+							FILE_SHARE_READ,		// share for reading
+							NULL,					// default security
+							OPEN_EXISTING,			// existing file only
+							dwReadFlags,			// overlapped, sequential, and maybe unbuffered
+							NULL);
+
+	// If that failed for any reason ...
+	if (IsBadHandle(hFileRead))
+	{
+		BREAK_IF_DEBUG
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Main read/write loop.
+	for (;;)
+	{
+		ULONG nWaitObjects = 0;
+
+		// Put every idle buffer to work. Reads are always issued in file order.
+		for (ULONG iSlot = 0; iSlot < BULK_SLOTS; iSlot++)
+		{
+			PBULK_EXTRACT_SLOT	pSlot	= &aSlots[iSlot];
+			PBULK_EXTRACT_JOB	pJob	= NULL;
+
+			if (pSlot->bState != BULK_SLOT_IDLE)
+			{
+				continue;
+			}
+
+			// Zero-length payloads don't need a buffer. They are done as soon as they're created.
+			// Clones and nested MDATs don't need one either. We'll take care of them after everything else is done.
+			while (iNextJob < m_cMDATs)
+			{
+				if (aJobs[iNextJob].bDedup == BULK_JOB_UNIQUE)
+				{
+					if (aJobs[iNextJob].pCE->cbPayloadLength)
+					{
+						break;
+					}
+
+					if (FAILED(hr = OpenBulkExtractJob(aJobs[iNextJob], fOverwrite, dwDigestKinds)) ||
+						FAILED(hr = CloseBulkExtractJob(aJobs[iNextJob], pDigestCallback)))
+					{
+						goto L_CleanupExit;
+					}
+					nJobsCompleted++;
+				}
+				iNextJob++;
+			}
+
+			// Has every byte of every MDAT been queued?
+			if (iNextJob == m_cMDATs)
+			{
+				break;
+			}
+
+			// Is this the first buffer for this MDAT?
+			pJob = &aJobs[iNextJob];
+			if (NULL == pJob->hFileWrite)
+			{
+				if (FAILED(hr = OpenBulkExtractJob(*pJob, fOverwrite, dwDigestKinds)))
+				{
+					goto L_CleanupExit;
+				}
+			}
+
+			UINT64	cbRemaining	= pJob->pCE->cbPayloadLength - pJob->cbQueued;
+			UINT64	cbReadPos	= pJob->pCE->cbPayloadOffset + pJob->cbQueued;
+
+			pSlot->iJob			= iNextJob;
+			pSlot->cbJobPos		= pJob->cbQueued;
+			pSlot->cbPayload	= (cbRemaining >= cbBuffer) ? cbBuffer : DWORD(cbRemaining);
+			pSlot->cbRequest	= pSlot->cbPayload;
+			pSlot->cbSkew		= 0;
+
+			// Unbuffered reads must start on a sector boundary and their length must be a multiple of the sector size.
+			// So back up to the page boundary in front of cbReadPos, and round the length up to a whole page.
+			if (dwReadFlags & FILE_FLAG_NO_BUFFERING)
+			{
+				pSlot->cbSkew		= DWORD(cbReadPos) & 0x0FFF;
+				pSlot->cbRequest	= pSlot->cbPayload + pSlot->cbSkew;
+				if (pSlot->cbRequest & 0x0FFF)
+				{
+					pSlot->cbRequest |= 0x0FFF;
+					pSlot->cbRequest++;
+				}
+				cbReadPos -= pSlot->cbSkew;
+			}
+
+			// Initialize/re-initialize these every time.
+			pSlot->ovl.Internal		= 0;
+			pSlot->ovl.InternalHigh	= 0;
+			pSlot->ovl.Offset		= PUINT32(&cbReadPos)[0];
+			pSlot->ovl.OffsetHigh	= PUINT32(&cbReadPos)[1];
+
+			// Initiate the next async read.
+			if (!ReadFile(hFileRead, pSlot->pBuffer, pSlot->cbRequest, LPDWORD(0), &pSlot->ovl))
+			{
+				dwError = GetLastError();
+				if (dwError != ERROR_IO_PENDING)
+				{
+					BREAK_IF_DEBUG
+					hr = HRESULT_FROM_WIN32(dwError);
+					goto L_CleanupExit;
+				}
+			}
+
+			pSlot->bState = BULK_SLOT_READING;
+
+			// Advance to the next MDAT after we've queued the last byte of this one.
+			pJob->cbQueued += pSlot->cbPayload;
+			if (pJob->cbQueued == pJob->pCE->cbPayloadLength)
+			{
+				iNextJob++;
+			}
+		}
+
+		// Collect the events for every buffer that's busy.
+		// Buffers that are waiting their turn to be hashed are not busy. Their events are already signaled.
+		for (ULONG iSlot = 0; iSlot < BULK_SLOTS; iSlot++)
+		{
+			if ((aSlots[iSlot].bState == BULK_SLOT_READING) || (aSlots[iSlot].bState == BULK_SLOT_WRITING))
+			{
+				aWaitEvents[nWaitObjects]	= aSlots[iSlot].ovl.hEvent;
+				aWaitSlots[nWaitObjects]	= iSlot;
+				nWaitObjects++;
+			}
+		}
+
+		// If nothing is busy then we're done.
+		if (0 == nWaitObjects)
+		{
+			break;
+		}
+
+		// Did caller supply a callback?
+		if (pCallback)
+		{
+			// Does caller want us to abort?
+			if (FAILED(pCallback->UpdateProgress(cbCompleted, cbTotal, nJobsCompleted, m_cMDATs)))
+			{
+				BREAK_IF_DEBUG
+				hr = E_ABORT;
+				goto L_CleanupExit;
+			}
+		}
+
+		// Wait until any one of the busy buffers has been signaled.
+		// Wait time is measured in milliseconds.
+		dwWaitResult = WaitForMultipleObjects(nWaitObjects, aWaitEvents, FALSE, DWORD(30 * 1000));
+		if (dwWaitResult >= nWaitObjects)
+		{
+			BREAK_IF_DEBUG
+			hr = (dwWaitResult == WAIT_TIMEOUT) ? HRESULT_FROM_WIN32(WAIT_TIMEOUT) : E_FAIL;
+			goto L_CleanupExit;
+		}
+
+		PBULK_EXTRACT_SLOT	pSlot	= &aSlots[aWaitSlots[dwWaitResult]];
+		PBULK_EXTRACT_JOB	pJob	= &aJobs[pSlot->iJob];
+		DWORD				cbResult	= 0;
+
+		if (pSlot->bState == BULK_SLOT_READING)
+		{
+			if (!GetOverlappedResult(hFileRead, &pSlot->ovl, &cbResult, TRUE))
+			{
+				BREAK_IF_DEBUG
+				hr = HRESULT_FROM_WIN32(GetLastError());
+				pSlot->bState = BULK_SLOT_IDLE;
+				goto L_CleanupExit;
+			}
+
+			// An unbuffered read can stop short at the end of the OMF file, but never before the end of the payload.
+			if ((cbResult != pSlot->cbRequest) && (cbResult < pSlot->cbSkew + pSlot->cbPayload))
+			{
+				BREAK_IF_DEBUG
+				hr = E_FAIL;
+				pSlot->bState = BULK_SLOT_IDLE;
+				goto L_CleanupExit;
+			}
+
+			// Slide the payload down to the front of the buffer.
+			if (pSlot->cbSkew)
+			{
+				MoveMemory(pSlot->pBuffer, &pSlot->pBuffer[pSlot->cbSkew], pSlot->cbPayload);
+			}
+
+			// Part 2 of the IFF ckSize kludge. See CContainerLayer15::PatchMdatChunkSize().
+			PatchMdatChunkSize(pJob->cbPatchChunkSize, pSlot->cbJobPos, pSlot->pBuffer, pSlot->cbPayload);
+
+			// If we're not hashing then write it right now.
+			if (NULL == pJob->pDigest)
+			{
+				if (FAILED(hr = StartBulkExtractWrite(*pSlot, *pJob)))
+				{
+					goto L_CleanupExit;
+				}
+				continue;
+			}
+
+			// Otherwise it has to wait its turn.
+			pSlot->bState = BULK_SLOT_HASHING;
+
+			// Hash and write every buffer of this MDAT that's next in line. Each one that we hash can make another
+			// one next in line, so keep going until we don't find any.
+			for (ULONG iSlot = 0; iSlot < BULK_SLOTS;)
+			{
+				PBULK_EXTRACT_SLOT pNext = &aSlots[iSlot];
+				if ((pNext->bState == BULK_SLOT_HASHING) &&
+					(pNext->iJob == pSlot->iJob) &&
+					(pNext->cbJobPos == pJob->cbHashed))
+				{
+					pJob->pDigest->Update(pNext->pBuffer, pNext->cbPayload);
+					pJob->cbHashed += pNext->cbPayload;
+
+					if (FAILED(hr = StartBulkExtractWrite(*pNext, *pJob)))
+					{
+						goto L_CleanupExit;
+					}
+
+					// Start over.
+					iSlot = 0;
+				}
+				else
+				{
+					iSlot++;
+				}
+			}
+		}
+		else
+		{
+			// This buffer is idle from here on, whether the write worked or not.
+			pSlot->bState = BULK_SLOT_IDLE;
+
+			if (!GetOverlappedResult(pJob->hFileWrite, &pSlot->ovl, &cbResult, TRUE))
+			{
+				BREAK_IF_DEBUG
+				hr = HRESULT_FROM_WIN32(GetLastError());
+				goto L_CleanupExit;
+			}
+
+			if (cbResult != pSlot->cbRequest)
+			{
+				BREAK_IF_DEBUG
+				hr = E_FAIL;
+				goto L_CleanupExit;
+			}
+
+			pJob->cbWritten	+= pSlot->cbPayload;
+			cbCompleted		+= pSlot->cbPayload;
+
+			// Was that the last buffer for this MDAT?
+			if (pJob->cbWritten == pJob->pCE->cbPayloadLength)
+			{
+				if (FAILED(hr = CloseBulkExtractJob(*pJob, pDigestCallback)))
+				{
+					goto L_CleanupExit;
+				}
+				nJobsCompleted++;
+			}
+		}
+	}
+
+	// Every unique payload has been written and closed. Now link or report the others.
+	for (ULONG i = 0; i < m_cMDATs; i++)
+	{
+		if (aJobs[i].bDedup != BULK_JOB_UNIQUE)
+		{
+			if (FAILED(hr = FinishBulkExtractDuplicate(aJobs[i],
+														aJobs[aJobs[i].iPrimary],
+														dwDedupFlags,
+														fOverwrite,
+														pAliasCallback,
+														pDigestCallback)))
+			{
+				goto L_CleanupExit;
+			}
+			nJobsCompleted++;
+		}
+	}
+
+	// Did caller supply a callback?
+	if (pCallback)
+	{
+		// Does caller want us to cancel?
+		// This is the last call to UpdateProgress() so cbCompleted and cbTotal are the same.
+		if (FAILED(pCallback->UpdateProgress(cbTotal, cbTotal, m_cMDATs, m_cMDATs)))
+		{
+			BREAK_IF_DEBUG
+			hr = E_ABORT;
+			goto L_CleanupExit;
+		}
+	}
+
+	// If we made it to here we succeeded!
+	hr = S_OK;
+
+	// Now clean up.
+L_CleanupExit:
+
+	// Cancel all outstanding read/write operations, and wait for them to drain before we free their buffers.
+	for (ULONG iSlot = 0; iSlot < BULK_SLOTS; iSlot++)
+	{
+		PBULK_EXTRACT_SLOT pSlot = &aSlots[iSlot];
+		if ((pSlot->bState == BULK_SLOT_READING) || (pSlot->bState == BULK_SLOT_WRITING))
+		{
+			HANDLE	hFile		= (pSlot->bState == BULK_SLOT_READING) ? hFileRead : aJobs[pSlot->iJob].hFileWrite;
+			DWORD	cbResult	= 0;
+
+			CancelIo(hFile);
+			GetOverlappedResult(hFile, &pSlot->ovl, &cbResult, TRUE);
+		}
+		pSlot->bState = BULK_SLOT_IDLE;
+
+		if (IsValidHandle(pSlot->ovl.hEvent))
+		{
+			CloseHandle(pSlot->ovl.hEvent);
+		}
+	}
 
+	// Close any destination files that are still open. They are all incomplete.
+	if (aJobs)
+	{
+		for (ULONG i = 0; i < m_cMDATs; i++)
+		{
+			if ((aJobs[i].hFileWrite) && (!aJobs[i].fDone))
+			{
+				CloseHandle(aJobs[i].hFileWrite);
+				aJobs[i].hFileWrite = NULL;
+
+				// Did caller abort?
+				if (hr == E_ABORT)
+				{
+					if (!DeleteFileW(aJobs[i].wzFullPath))
+					{
+						BREAK_IF_DEBUG
+					}
+				}
+			}
+
+			if (aJobs[i].pDigest)
+			{
+				delete aJobs[i].pDigest;
+				aJobs[i].pDigest = NULL;
+			}
+		}
+		MemFree(aJobs);
+	}
+
+	if (IsValidHandle(hFileRead))
+	{
+		CloseHandle(hFileRead);
+	}
+
+	// Free buffer memory.
+	if (pMemBase)
+	{
+		VirtualFree(pMemBase, SIZE_T(0), MEM_RELEASE);
+	}
+
+	// Release pCallback if it exists, and set pCallback to NULL.
+	IUnknown_AtomicRelease((PVOID*)&pAliasCallback);
+	IUnknown_AtomicRelease((PVOID*)&pDigestCallback);
+	IUnknown_AtomicRelease((PVOID*)&pCallback);
+
+	// Done!
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Function object for SortByFilePos(). Returns the file position of a BULK_EXTRACT_JOB's payload.
+//*********************************************************************************************************************
+class CBulkExtractJobFilePos
+{
+public:
+	UINT64 operator()(const BULK_EXTRACT_JOB& rJob) const { return rJob.pCE->cbPayloadOffset; }
+};
+
+//*********************************************************************************************************************
+//	Private helper for BulkExtractMdats().
+//	Initializes one BULK_EXTRACT_JOB for each entry in m_aMdatTable[], sorts them by payload offset, and then
+//	creates each destination path. Returns HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE) if a path is too long.
+//	On entry aJobs[] must have room for m_cMDATs elements, and it must be zeroed.
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::PrepareBulkExtractJobs(__in PCWSTR pwzDestFolder,
+														__in DWORD dwSyntax,
+															__out PBULK_EXTRACT_JOB aJobs)
+{
+	WCHAR	wzFileName[MAX_PATH_FILENAME]	= {0};
+	HRESULT	hr = S_OK;
+
+	for (ULONG i = 0; i < m_cMDATs; i++)
+	{
+		aJobs[i].pCE = &m_aMdatTable[i];
+	}
+
+	// Sort by payload offset.
+	SortByFilePos(aJobs, m_cMDATs, CBulkExtractJobFilePos());
+
+	for (ULONG i = 0; i < m_cMDATs; i++)
+	{
+		PBULK_EXTRACT_JOB	pJob	= &aJobs[i];
+		PMDAT_CACHE_ENTRY	pCE		= pJob->pCE;
+
+		if (FAILED(hr = CreateFileNameForMdat(*pCE, dwSyntax, ELEMS(wzFileName), wzFileName, NULL)))
+		{
+			BREAK_IF_DEBUG
+			break;
+		}
+
+		if (NULL == PathCombineW(pJob->wzFullPath, pwzDestFolder, wzFileName))
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+			break;
+		}
+
+		// Part 1 of the IFF ckSize kludge. See CContainerLayer15::GetMdatPatchChunkSize().
+		pJob->cbPatchChunkSize = GetMdatPatchChunkSize(*pCE);
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for BulkExtractMdats().
+//	Creates the destination file for asynchronous unbuffered writing, and extends it to its final page-rounded size.
+//	If dwDigestKinds is non-zero then this also creates the job's CExtractDigest.
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::OpenBulkExtractJob(__in BULK_EXTRACT_JOB& rJob,
+												__in BOOL fOverwrite,
+													__in DWORD dwDigestKinds)
+{
+	LARGE_INTEGER	liPtrEx			= {0};
+	UINT64			cbRoundUpLength	= rJob.pCE->cbPayloadLength;
+	HRESULT			hr				= S_OK;
+
+	if (dwDigestKinds)
+	{
+		if (NULL == (rJob.pDigest = new CExtractDigest))
+		{
+			BREAK_IF_DEBUG
+			return E_OUTOFMEMORY;
+		}
+
+		if (FAILED(hr = rJob.pDigest->Initialize(dwDigestKinds)))
+		{
+			return hr;
+		}
+	}
+
+	// Round up the payload length to the next page boundary (4096 bytes).
+	if (WORD(cbRoundUpLength) & 0x0FFF)
+	{
+		cbRoundUpLength |= 0x0FFF;
+		cbRoundUpLength++;
+	}
+
+	// Open the destination file for asynchronous writing.
+	rJob.hFileWrite = CreateFileW(rJob.wzFullPath,		// file to open/create
+									GENERIC_WRITE,			// open/create for writing (SYNCHRONIZE = fail)
+									0x00000000,				// FILE_SHARE_NONE (don't share)
+									NULL,					// default security
+									fOverwrite ? CREATE_ALWAYS : CREATE_NEW,
+									FILE_FLAG_WRITE_THROUGH |\
+									FILE_FLAG_OVERLAPPED |\
+									FILE_FLAG_NO_BUFFERING |\
+									FILE_ATTRIBUTE_NORMAL |\
+									FILE_FLAG_SEQUENTIAL_SCAN,
+									NULL);
+
+	// If that failed for any reason ...
+	if (IsBadHandle(rJob.hFileWrite))
+	{
+		BREAK_IF_DEBUG
+		rJob.hFileWrite = NULL;
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	// "It is not an error to set the file pointer to a position beyond the end of the file."
+	// "The size of the file does not increase until you call the SetEndOfFile()."
+	if ((!SetFilePointerEx(rJob.hFileWrite, *PLARGE_INTEGER(&cbRoundUpLength), NULL, FILE_BEGIN)) ||
+		(!SetEndOfFile(rJob.hFileWrite)) ||
+		(!SetFilePointerEx(rJob.hFileWrite, liPtrEx, NULL, FILE_BEGIN)))
+	{
+		BREAK_IF_DEBUG
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for BulkExtractMdats().
+//	Closes the destination file after its last buffer has been written.
+//	We always wrote in multiples of 4096 bytes so the last write probably left some junk at the end. If so we re-open
+//	the file without FILE_FLAG_NO_BUFFERING and truncate it - just like CContainerLayer15::ExtractMdatDataToFile().
+//	Then if the job was hashing, this finishes the hash and hands it to pDigestCallback.
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::CloseBulkExtractJob(__in BULK_EXTRACT_JOB& rJob,
+													__in_opt IOmfooDigestCallback *pDigestCallback)
+{
+	OMFOO_EXTRACT_DIGESTS	sDigests	= {0};
+	LARGE_INTEGER			liPtrEx		= {0};
+	HRESULT					hr			= S_OK;
+
+	// Close the current write handle.
+	if (!CloseHandle(rJob.hFileWrite))
+	{
+		BREAK_IF_DEBUG
+		hr = HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	rJob.hFileWrite	= NULL;
+	rJob.fDone		= TRUE;
+
+	if (SUCCEEDED(hr) && (WORD(rJob.pCE->cbPayloadLength) & 0x0FFF))
+	{
+		// Reopen the destination file without the FILE_FLAG_NO_BUFFERING flag.
+		HANDLE hFileWrite = CreateFileW(rJob.wzFullPath, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (IsBadHandle(hFileWrite))
+		{
+			BREAK_IF_DEBUG
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		// Move the file pointer to the desired end position and chop it off.
+		liPtrEx.QuadPart = rJob.pCE->cbPayloadLength;
+		if ((!SetFilePointerEx(hFileWrite, liPtrEx, NULL, FILE_BEGIN)) || (!SetEndOfFile(hFileWrite)))
+		{
+			BREAK_IF_DEBUG
+			hr = HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		CloseHandle(hFileWrite);
+	}
+
+	// Is this job hashing?
+	if (rJob.pDigest)
+	{
+		if (SUCCEEDED(hr) && SUCCEEDED(hr = rJob.pDigest->Finish(&sDigests)) && pDigestCallback)
+		{
+			pDigestCallback->DigestsReady(rJob.wzFullPath, &sDigests);
+
+			// Save them for our clones.
+			rJob.sDigests = sDigests;
+		}
+
+		delete rJob.pDigest;
+		rJob.pDigest = NULL;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for BulkExtractMdats().
+//	Starts writing a buffer that has just been read (and hashed if necessary) to its destination file.
+//	If this fails the buffer is idle when we return.
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::StartBulkExtractWrite(__in BULK_EXTRACT_SLOT& rSlot, __in BULK_EXTRACT_JOB& rJob)
+{
+	// The destination file was opened with FILE_FLAG_NO_BUFFERING so round up to the next page boundary.
+	// This can only happen on the last buffer of each MDAT. CloseBulkExtractJob() chops off the junk.
+	rSlot.cbRequest = rSlot.cbPayload;
+	if (rSlot.cbRequest & 0x0FFF)
+	{
+		rSlot.cbRequest |= 0x0FFF;
+		rSlot.cbRequest++;
+	}
+
+	// Initialize/re-initialize these every time.
+	rSlot.ovl.Internal		= 0;
+	rSlot.ovl.InternalHigh	= 0;
+	rSlot.ovl.Offset		= PUINT32(&rSlot.cbJobPos)[0];
+	rSlot.ovl.OffsetHigh	= PUINT32(&rSlot.cbJobPos)[1];
+
+	// Initiate the async write.
+	if (!WriteFile(rJob.hFileWrite, rSlot.pBuffer, rSlot.cbRequest, NULL, &rSlot.ovl))
+	{
+		DWORD dwError = GetLastError();
+		if (dwError != ERROR_IO_PENDING)
+		{
+			BREAK_IF_DEBUG
+			rSlot.bState = BULK_SLOT_IDLE;
+			return HRESULT_FROM_WIN32(dwError);
+		}
+	}
+
+	rSlot.bState = BULK_SLOT_WRITING;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for BulkExtractMdats().
+//	Marks the jobs whose payloads are already covered by another job, so that we don't read them twice.
+//	CContainerLayer10::DetectOverlappers() already counted the clones and nested MDATs for each MDAT, so we only look
+//	for them where it found some. A job is only marked if its new file would be byte-for-byte identical to the bytes
+//	that it refers to, so the IFF ckSize kludge has to agree.
+//	On entry aJobs[] must be sorted by payload offset. See PrepareBulkExtractJobs().
+//*********************************************************************************************************************
+void CContainerLayer95::FindBulkExtractDuplicates(__inout PBULK_EXTRACT_JOB aJobs, __in DWORD dwDedupFlags)
+{
+	// Clones. Because aJobs[] is sorted by offset all of the MDATs that begin at the same offset are neighbors.
+	// The first one in each set of clones becomes the primary and the others refer to it.
+	if (dwDedupFlags & (BXF_LINK_CLONES|BXF_REPORT_CLONES))
+	{
+		for (ULONG i = 0; i < m_cMDATs; i++)
+		{
+			PBULK_EXTRACT_JOB pJob = &aJobs[i];
+			if ((pJob->bDedup != BULK_JOB_UNIQUE) || (pJob->pCE->cClones == 0) || (pJob->pCE->cbPayloadLength == 0))
+			{
+				continue;
+			}
+
+			for (ULONG j = i + 1; (j < m_cMDATs) && (aJobs[j].pCE->cbPayloadOffset == pJob->pCE->cbPayloadOffset); j++)
+			{
+				PBULK_EXTRACT_JOB pOther = &aJobs[j];
+				if ((pOther->bDedup == BULK_JOB_UNIQUE) &&
+					(pOther->pCE->cbPayloadLength == pJob->pCE->cbPayloadLength) &&
+					(pOther->cbPatchChunkSize == pJob->cbPatchChunkSize))
+				{
+					pOther->bDedup			= BULK_JOB_CLONE;
+					pOther->iPrimary		= i;
+					pOther->cbPrimaryOffset	= 0;
+					pJob->fHasClones		= TRUE;
+				}
+			}
+		}
+	}
+
+	// Nested MDATs. Each one refers to the largest unique payload that holds it. That one can't be nested inside
+	// anything else, because whatever it was nested in would hold this one too - and it would be even larger.
+	if (dwDedupFlags & BXF_REPORT_NESTED)
+	{
+		for (ULONG i = 0; i < m_cMDATs; i++)
+		{
+			PBULK_EXTRACT_JOB	pJob		= &aJobs[i];
+			UINT64				cbStart		= pJob->pCE->cbPayloadOffset;
+			UINT64				cbEnd		= cbStart + pJob->pCE->cbPayloadLength;
+			UINT64				cbParent	= 0;
+			ULONG				iParent		= ULONG(-1);
+
+			// Skip jobs that are already taken care of, jobs that have clones referring to them, empty jobs, and
+			// jobs that need their own ckSize patch.
+			if ((pJob->bDedup != BULK_JOB_UNIQUE) || (pJob->fHasClones) ||
+				(pJob->pCE->cbPayloadLength == 0) || (pJob->cbPatchChunkSize))
+			{
+				continue;
+			}
+
+			// Every possible parent begins at or before we do.
+			for (ULONG j = 0; (j < m_cMDATs) && (aJobs[j].pCE->cbPayloadOffset <= cbStart); j++)
+			{
+				PBULK_EXTRACT_JOB	pOther		= &aJobs[j];
+				UINT64				cbThatStart	= pOther->pCE->cbPayloadOffset;
+				UINT64				cbThatEnd	= cbThatStart + pOther->pCE->cbPayloadLength;
+
+				if ((j == i) || (pOther->bDedup != BULK_JOB_UNIQUE) || (pOther->pCE->cNestedMdats == 0))
+				{
+					continue;
+				}
+
+				// It has to hold all of us, and it has to be larger than us (otherwise it's a clone).
+				if ((cbThatEnd < cbEnd) || (pOther->pCE->cbPayloadLength <= pJob->pCE->cbPayloadLength))
+				{
+					continue;
+				}
+
+				// If its ckSize gets patched then bytes 4 through 7 of its file won't match the OMF file.
+				if ((pOther->cbPatchChunkSize) && (cbStart - cbThatStart < 8))
+				{
+					continue;
+				}
+
+				if (pOther->pCE->cbPayloadLength > cbParent)
+				{
+					cbParent	= pOther->pCE->cbPayloadLength;
+					iParent		= j;
+				}
+			}
+
+			if (iParent != ULONG(-1))
+			{
+				pJob->bDedup			= BULK_JOB_NESTED;
+				pJob->iPrimary			= iParent;
+				pJob->cbPrimaryOffset	= cbStart - aJobs[iParent].pCE->cbPayloadOffset;
+			}
+		}
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper for BulkExtractMdats().
+//	Takes care of a job that FindBulkExtractDuplicates() marked, after rPrimary's file has been written and closed.
+//	Clones become hard links (or copies) if caller asked for BXF_LINK_CLONES. Everything else is reported as an alias.
+//	Returns E_ABORT if caller's AliasFound() method fails.
+//*********************************************************************************************************************
+HRESULT CContainerLayer95::FinishBulkExtractDuplicate(__inout BULK_EXTRACT_JOB& rJob,
+															__in BULK_EXTRACT_JOB& rPrimary,
+																__in DWORD dwDedupFlags,
+																	__in BOOL fOverwrite,
+																		__in_opt IOmfooBulkAliasCallback *pAliasCallback,
+																			__in_opt IOmfooDigestCallback *pDigestCallback)
+{
+	DWORD dwError = NOERROR;
+
+	if ((rJob.bDedup == BULK_JOB_CLONE) && (dwDedupFlags & BXF_LINK_CLONES))
+	{
+		// CreateHardLinkW() won't replace an existing file, so get rid of it first if caller said we could.
+		// It's okay if this fails because the file doesn't exist.
+		if (fOverwrite)
+		{
+			DeleteFileW(rJob.wzFullPath);
+		}
+
+		if (!CreateHardLinkW(rJob.wzFullPath, rPrimary.wzFullPath, NULL))
+		{
+			dwError = GetLastError();
+			if (dwError == ERROR_ALREADY_EXISTS)
+			{
+				return HRESULT_FROM_WIN32(ERROR_FILE_EXISTS);
+			}
+
+			// FAT32, exFAT, and some network shares can't do hard links. So copy it from the primary file instead.
+			// At least that doesn't read the OMF file again, and on ReFS the copy may just be a block clone.
+			if (!CopyFileW(rPrimary.wzFullPath, rJob.wzFullPath, TRUE))
+			{
+				BREAK_IF_DEBUG
+				return HRESULT_FROM_WIN32(GetLastError());
+			}
+		}
+
+		rJob.fDone = TRUE;
+
+		// Our file is the same as our primary's file, so it has the same checksums.
+		if (pDigestCallback && rPrimary.sDigests.dwDigestKinds)
+		{
+			pDigestCallback->DigestsReady(rJob.wzFullPath, &rPrimary.sDigests);
+		}
+		return S_OK;
+	}
+
+	if (pAliasCallback)
+	{
+		if (FAILED(pAliasCallback->AliasFound(rJob.wzFullPath,
+												rPrimary.wzFullPath,
+												rJob.cbPrimaryOffset,
+												rJob.pCE->cbPayloadLength)))
+		{
+			return E_ABORT;
+		}
+	}
+
+	return S_OK;
+}
@@ -6,12 +6,102 @@
 // Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
 //*********************************************************************************************************************
 #pragma once
-#include "ContainerLayer15.h"
+#include "ContainerLayer94.h"
 
-class CContainerLayer95 : public CContainerLayer15
+class CExtractDigest;
+
+//*********************************************************************************************************************
+//	Structures used internally by BulkExtractMdats().
+//*********************************************************************************************************************
+// One of these per MDAT.
+typedef struct {
+	PMDAT_CACHE_ENTRY	pCE;				// the MDAT whose payload we are extracting.
+	HANDLE				hFileWrite;			// the destination file, or NULL until the first buffer is queued.
+	UINT64				cbQueued;			// number of payload bytes handed to ReadFile() so far.
+	UINT64				cbWritten;			// number of payload bytes written to the destination file so far.
+	UINT64				cbHashed;			// number of payload bytes passed to pDigest so far.
+	CExtractDigest*		pDigest;			// inline checksums, or NULL if caller didn't ask for them.
+	UINT32				cbPatchChunkSize;	// see CContainerLayer15::GetMdatPatchChunkSize().
+	BOOL				fDone;				// TRUE after the destination file has been truncated and closed.
+	BYTE				bDedup;				// BULK_JOB_UNIQUE, BULK_JOB_CLONE, or BULK_JOB_NESTED.
+	BOOLEAN				fHasClones;			// TRUE if some other job is a BULK_JOB_CLONE of this one.
+	ULONG				iPrimary;			// if bDedup is not BULK_JOB_UNIQUE, the job whose file holds our payload.
+	UINT64				cbPrimaryOffset;	// ... and where our payload begins inside that file.
+	OMFOO_EXTRACT_DIGESTS	sDigests;		// saved by CloseBulkExtractJob() so that our clones can report them too.
+	WCHAR				wzFullPath[MAX_PATH];
+} BULK_EXTRACT_JOB, *PBULK_EXTRACT_JOB;
+
+// One of these per buffer in the pool.
+typedef struct {
+	OVERLAPPED	ovl;						// ovl.hEvent is created once and reused for every read and write.
+	PBYTE		pBuffer;					// page-aligned, so it can be written to a FILE_FLAG_NO_BUFFERING handle.
+	ULONG		iJob;						// index into our array of BULK_EXTRACT_JOBs.
+	UINT64		cbJobPos;					// where this buffer lives inside the MDAT's payload.
+	DWORD		cbPayload;					// number of payload bytes in this buffer.
+	DWORD		cbRequest;					// number of bytes requested from ReadFile() or WriteFile().
+	DWORD		cbSkew;						// number of bytes in front of the payload in an unbuffered read.
+	BYTE		bState;						// BULK_SLOT_IDLE, BULK_SLOT_READING, BULK_SLOT_HASHING, etc.
+} BULK_EXTRACT_SLOT, *PBULK_EXTRACT_SLOT;
+
+class CContainerLayer95
+	: public CContainerLayer94
+	, public IOmfooBulkExtractor2
 {
 protected:
 			CContainerLayer95(void);
 	virtual	~CContainerLayer95(void);
 //	STDMETHODIMP	Load(__in PCWSTR pwzFileName);
+
+	// IOmfooBulkExtractor methods in V-table order.
+	STDMETHODIMP	GetMdatCount(__out PULONG pnMdats);
+	STDMETHODIMP	ExtractAllMdats(__in PCWSTR pwzDestFolder,
+										__in DWORD dwSyntax,
+											__in BOOL fOverwrite,
+												__in_opt IOmfooBulkExtractCallback *pCallback,
+													__in_opt ULONG nPagesPerBuffer);
+
+	// IOmfooBulkExtractor2 methods in V-table order.
+	STDMETHODIMP	ExtractUniqueMdats(__in PCWSTR pwzDestFolder,
+										__in DWORD dwSyntax,
+											__in DWORD dwDedupFlags,
+												__in BOOL fOverwrite,
+													__in_opt IOmfooBulkExtractCallback *pCallback,
+														__in_opt ULONG nPagesPerBuffer);
+
+private:
+	enum {
+		BULK_SLOTS				= 8,		// number of buffers in the pool. Must not exceed MAXIMUM_WAIT_OBJECTS.
+		BULK_DEFAULT_PAGES		= 1024,		// default size of each buffer, in 4096-byte pages. (4MB)
+		BULK_MAX_PAGES			= 7200,		// same limit as ExtractMdatDataToFile(). (29491200 bytes)
+		BULK_READ_SLOP			= 4096,		// extra bytes per buffer for the unaligned head of an unbuffered read.
+		BULK_MAX_SECTOR			= 4096,		// largest sector size that our unbuffered reads can handle.
+
+		BULK_SLOT_IDLE			= 0,
+		BULK_SLOT_READING		= 1,
+		BULK_SLOT_WRITING		= 2,
+		BULK_SLOT_HASHING		= 3,		// read is done, but an earlier buffer of the same MDAT must be hashed first.
+
+		BULK_JOB_UNIQUE			= 0,		// this job's payload is read and written.
+		BULK_JOB_CLONE			= 1,		// this job's payload is identical to its primary job's payload.
+		BULK_JOB_NESTED			= 2,		// this job's payload lives entirely inside its primary job's payload.
+	};
+
+	HRESULT	BulkExtractMdats(__in PCWSTR pwzDestFolder,
+								__in DWORD dwSyntax,
+									__in DWORD dwDedupFlags,
+										__in BOOL fOverwrite,
+											__in_opt IOmfooBulkExtractCallback *pUnknown,
+												__in_opt ULONG nPagesPerBuffer);
+
+	HRESULT	PrepareBulkExtractJobs(__in PCWSTR pwzDestFolder, __in DWORD dwSyntax, __out PBULK_EXTRACT_JOB aJobs);
+	HRESULT	OpenBulkExtractJob(__in BULK_EXTRACT_JOB& rJob, __in BOOL fOverwrite, __in DWORD dwDigestKinds);
+	HRESULT	CloseBulkExtractJob(__in BULK_EXTRACT_JOB& rJob, __in_opt IOmfooDigestCallback *pDigestCallback);
+	HRESULT	StartBulkExtractWrite(__in BULK_EXTRACT_SLOT& rSlot, __in BULK_EXTRACT_JOB& rJob);
+	void	FindBulkExtractDuplicates(__inout PBULK_EXTRACT_JOB aJobs, __in DWORD dwDedupFlags);
+	HRESULT	FinishBulkExtractDuplicate(__inout BULK_EXTRACT_JOB& rJob,
+											__in BULK_EXTRACT_JOB& rPrimary,
+												__in DWORD dwDedupFlags,
+													__in BOOL fOverwrite,
+														__in_opt IOmfooBulkAliasCallback *pAliasCallback,
+															__in_opt IOmfooDigestCallback *pDigestCallback);
 };
@@ -40,6 +40,11 @@ protected:
 	{
 		return m_pContainer->IteratorCallback(m_iPos, m_dwClassFourCC, m_fStrict, riid, ppvOut);
 	}
+
+	HRESULT InternalNextBatch(REFIID riid, ULONG nMax, PVOID *ppvOut, ULONG& rnFetched)
+	{
+		return m_pContainer->IteratorBatchCallback(m_iPos, m_dwClassFourCC, m_fStrict, riid, nMax, ppvOut, rnFetched);
+	}
 };
 
 //*********************************************************************************************************************
@@ -161,6 +166,52 @@ HRESULT CContainerLayer97::IteratorCallback(ULONG& rPos, DWORD dwClassFourCC, BO
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Batch callback routine for the CTableIterator class.
+//	We come here from within IOmfooIterator::NextBatch().
+//	This is the same as IteratorCallback() except that it makes just one pass through the blop table to fill as many
+//	as nMax slots in caller's array. Blops that don't match, or that don't expose riid, are skipped.
+//	The caller has already validated and wiped ppvOut[] and rnFetched.
+//*********************************************************************************************************************
+HRESULT CContainerLayer97::IteratorBatchCallback(ULONG& rPos, DWORD dwClassFourCC, BOOL fStrict, REFIID riid,
+																	ULONG nMax, PVOID *ppvOut, ULONG& rnFetched)
+{
+	ULONG i			= rPos;
+	ULONG nFetched	= 0;
+
+	while ((nFetched < nMax) && (i < m_nBlops))
+	{
+		BENTO_BLOP& rBlop = m_aBlopTable[i++];
+
+		// Did caller provide a class fourCC?
+		if (dwClassFourCC)
+		{
+			if (fStrict)
+			{
+				if (rBlop.dwFourCC != dwClassFourCC)
+				{
+					continue;
+				}
+			}
+			else if (S_OK != IsBlopATypeOf(rBlop, dwClassFourCC))
+			{
+				continue;
+			}
+		}
+
+		// Instantiate a IOmfObject and query for the specified interface.
+		if (SUCCEEDED(Instantiate(rBlop, static_cast<COmfObject*>(NULL), NULL, riid, &ppvOut[nFetched])))
+		{
+			nFetched++;
+		}
+	}
+
+	// Give updated position index and count back to caller.
+	rPos		= i;
+	rnFetched	= nFetched;
+	return S_OK;
+}
+
 //*********************************************************************************************************************
 //	Our main public function.
 //	Instantiates a COmfObject on dwObject and then queries it for the interface specified by riid.
@@ -288,7 +339,7 @@ HRESULT CContainerLayer97::IterateObjects(__in_opt DWORD dwClassFourCC,
 		if ((dwClassFourCC == 0) || IsValidFourCC(dwClassFourCC))
 		{
 			// See CContainerLayer97::IteratorCallback().
-			CTableIterator* pIterator = new CTableIterator(this, dwClassFourCC, fStrict);
+			CTableIterator* pIterator = new (this) CTableIterator(this, dwClassFourCC, fStrict);
 			if (pIterator)
 			{
 				*ppIterator = static_cast<IOmfooIterator*>(pIterator);
@@ -325,6 +376,30 @@ COmfooIterator::~COmfooIterator(void)
 {
 }
 
+//*********************************************************************************************************************
+//	Class-specific C++ operators.
+//	Our iterators are carved out of their container's CSmallBlockHeap, just like our COmfObject wrappers.
+//*********************************************************************************************************************
+PVOID COmfooIterator::operator new(size_t cb, CContainerLayer97* pContainer)
+{
+	return pContainer->m_oSmallBlockHeap.Alloc(cb);
+}
+
+PVOID COmfooIterator::operator new(size_t cb)
+{
+	return CSmallBlockHeap::AllocUnowned(cb);
+}
+
+void COmfooIterator::operator delete(PVOID pv, CContainerLayer97* /*pContainer*/)
+{
+	CSmallBlockHeap::Free(pv);
+}
+
+void COmfooIterator::operator delete(PVOID pv)
+{
+	CSmallBlockHeap::Free(pv);
+}
+
 //*********************************************************************************************************************
 // IUnknown
 //*********************************************************************************************************************
@@ -405,6 +480,68 @@ STDMETHODIMP COmfooIterator::Reset(void)
 	return S_OK;
 }
 
+//*********************************************************************************************************************
+// IOmfooIterator
+// Validates caller's arguments and then hands off to our subclass's InternalNextBatch().
+//*********************************************************************************************************************
+STDMETHODIMP COmfooIterator::NextBatch(__in REFIID riid, __in ULONG nMax, __out PVOID *ppvOut, __out_opt PULONG pnFetched)
+{
+	ULONG	nFetched	= 0;
+	HRESULT	hr			= S_OK;
+
+	// The pnFetched argument is optional.
+	if (pnFetched)
+	{
+		if (IsBadWritePointer(pnFetched, sizeof(ULONG)))
+			return E_POINTER;
+
+		*pnFetched = 0;
+	}
+
+	// Make sure nMax is not insanely huge. (And make sure our math below can't overflow.)
+	if (nMax > 0x00100000)
+		return E_INVALIDARG;
+
+	// IEnumXXX::Next() semantics. Asking for nothing is not an error.
+	if (nMax == 0)
+		return S_OK;
+
+	// Validate caller's array.
+	if (IsBadWritePointer(ppvOut, nMax * sizeof(PVOID)))
+		return E_POINTER;
+
+	// Wipe it now.
+	ZeroMemory(ppvOut, nMax * sizeof(PVOID));
+
+	// Validate caller's IID.
+	if (IsBadReadPointer(&riid, sizeof(IID)))
+		return E_INVALIDARG;
+
+	hr = InternalNextBatch(riid, nMax, ppvOut, nFetched);
+
+	if (pnFetched)
+	{
+		*pnFetched = nFetched;
+	}
+
+	if (nFetched == nMax)
+	{
+		hr = S_OK;
+	}
+	else if (nFetched)
+	{
+		// We stopped early. Either we hit the end of the set or the subclass hit a hard error.
+		// Either way the caller gets what we have. A hard error will show up again on the next call.
+		hr = S_FALSE;
+	}
+	else if (SUCCEEDED(hr))
+	{
+		hr = OMF_E_NO_MORE_ITEMS;
+	}
+
+	return hr;
+}
+
 //*********************************************************************************************************************
 // IOmfooIterator
 //*********************************************************************************************************************
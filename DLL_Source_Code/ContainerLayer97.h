@@ -23,6 +23,8 @@ public:
 
 public:
 	STDMETHODIMP	IteratorCallback(ULONG& rPos, DWORD dwClassFourCC, BOOL fStrict, REFIID riid, PVOID *ppvOut);
+	STDMETHODIMP	IteratorBatchCallback(ULONG& rPos, DWORD dwClassFourCC, BOOL fStrict, REFIID riid,
+																ULONG nMax, PVOID *ppvOut, ULONG& rnFetched);
 	STDMETHODIMP	Instantiate(DWORD dwObject, COmfObject* pParent, PVOID pNewReserved, REFIID riid, PVOID *ppvOut);
 	STDMETHODIMP	Instantiate(BENTO_BLOP& rBlop, COmfObject* pParent, PVOID pNewReserved, REFIID riid, PVOID *ppvOut);
 	STDMETHODIMP	IterateObjects(__in_opt DWORD dwClassFourCC, __in BOOL fStrict, __out IOmfooIterator **ppIterator);
@@ -40,6 +42,12 @@ public:
 			COmfooIterator(CContainerLayer97* pContainer);
 	virtual ~COmfooIterator(void);
 
+	// Class-specific C++ operators. Same as COmfObject.
+	static PVOID	operator new(size_t cb, CContainerLayer97* pContainer);
+	static PVOID	operator new(size_t cb);
+	static void		operator delete(PVOID pv, CContainerLayer97* pContainer);
+	static void		operator delete(PVOID pv);
+
 	// IUnknown methods in V-table order.
 	STDMETHODIMP	QueryInterface(REFIID riid, PVOID *ppvOut);
 	ULONG __stdcall	AddRef(void);
@@ -49,6 +57,12 @@ public:
 	STDMETHODIMP	GetCount(__out PULONG pnObjects);
 	STDMETHODIMP	Reset(void);
 //	STDMETHODIMP	Next(__in REFIID riid, __out PVOID *ppvOut);
+	STDMETHODIMP	NextBatch(__in REFIID riid, __in ULONG nMax, __out PVOID *ppvOut, __out_opt PULONG pnFetched);
+
+protected:
+	// Our subclasses implement this to do the real work for NextBatch().
+	// By the time we get here the arguments have been validated and caller's ppvOut array has been wiped.
+	virtual HRESULT	InternalNextBatch(REFIID riid, ULONG nMax, PVOID *ppvOut, ULONG& rnFetched)= 0;
 
 protected:
 	CContainerLayer97*	m_pContainer;
@@ -8,6 +8,7 @@
 #include "stdafx.h"
 #include "Omfoo_Alpha_Header.h"
 #include "ContainerLayer98.h"
+#include "OmfObject.h"
 #include <shlwapi.h>
 
 #pragma warning(disable:4100)	// unreferenced formal parameter
@@ -93,6 +94,427 @@ L_Exit:
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	IOmfooFastReader::GetPropertyID()
+//	Translates a fully qualified property name into the 32-bit property ID that the other methods expect.
+//	Returns OMF_E_PROP_NOT_DEFINED if no object in this file uses that property.
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::GetPropertyID(__in LPCSTR pszPropertyName, __out PDWORD pdwProperty)
+{
+	HRESULT	hr = S_OK;
+
+	if (IsBadWritePointer(pdwProperty, sizeof(DWORD)))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	*pdwProperty = 0;
+
+	if (FAILED(hr = m_hrFirewall))
+	{
+		goto L_Exit;
+	}
+
+	if (IsBadReadPointer(pszPropertyName, 1))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	if (0 == (*pdwProperty = NameToPropertyID(pszPropertyName)))
+	{
+		hr = OMF_E_PROP_NOT_DEFINED;
+	}
+
+L_Exit:
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::GetHeadObjectID()
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::GetHeadObjectID(__out PDWORD pdwObject)
+{
+	if (IsBadWritePointer(pdwObject, sizeof(DWORD)))
+	{
+		return E_POINTER;
+	}
+
+	*pdwObject = 0;
+
+	HRESULT hr = m_hrFirewall;
+	if (SUCCEEDED(hr))
+	{
+		// See the comments in IOmfooReader::GetHeadObject().
+		*pdwObject = m_aBlopTable[0].dwObject;
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::GetObjectID()
+//	Retrieves the object ID of an IOmfObject. Uses the same private back door as IOmfObject::IsSelf().
+//	Returns OMF_E_OOBJ_NOT_FOUND if punk is not an IOmfObject, or if it belongs to a different file.
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::GetObjectID(__in IUnknown *punk, __out PDWORD pdwObject)
+{
+	IOobjBackDoor*		pBackDoor	= NULL;
+	SELF_COMPARE_INFO	sInfo		= {0};
+	HRESULT				hr			= S_OK;
+
+	if (IsBadWritePointer(pdwObject, sizeof(DWORD)))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	*pdwObject = 0;
+
+	if (FAILED(hr = m_hrFirewall))
+	{
+		goto L_Exit;
+	}
+
+	if (IsBadReadPointer(punk, sizeof(PVOID)))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	if (FAILED(punk->QueryInterface(__uuidof(IOobjBackDoor), (PVOID*)&pBackDoor)))
+	{
+		hr = OMF_E_OOBJ_NOT_FOUND;
+		goto L_Exit;
+	}
+
+	if (FAILED(pBackDoor->GetSelfCompareInfo(&sInfo)))
+	{
+		hr = E_UNEXPECTED;
+		goto L_Exit;
+	}
+
+	// Object IDs are only meaningful within the file that they came from.
+	if ((sInfo.dwFileIndexHigh		!= m_dwFileIndexHigh)||
+		(sInfo.dwFileIndexLow		!= m_dwFileIndexLow)||
+		(sInfo.dwVolumeSerialNumber	!= m_dwVolumeSerialNumber))
+	{
+		hr = OMF_E_OOBJ_NOT_FOUND;
+		goto L_Exit;
+	}
+
+	*pdwObject = sInfo.pBlop->dwObject;
+
+L_Exit:
+	if (pBackDoor)
+	{
+		pBackDoor->Release();
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::Instantiate()
+//	Returns OMF_E_OOBJ_NOT_FOUND if dwObject is not in our blop table.
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::Instantiate(__in DWORD dwObject, __in REFIID riid, __out PVOID *ppvOut)
+{
+	HRESULT	hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+	if (SUCCEEDED(hr))
+	{
+		if (SUCCEEDED(hr = m_hrFirewall))
+		{
+			BENTO_BLOP&	rBlop = GetBlop(dwObject);
+			if (rBlop.dwObject == 0)
+			{
+				hr = OMF_E_OOBJ_NOT_FOUND;
+			}
+			else
+			{
+				hr = Instantiate(rBlop, static_cast<COmfObject*>(NULL), NULL, riid, ppvOut);
+			}
+		}
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::FindNextObject()
+//	This is IteratorCallback() without the IOmfObject. The caller owns the cursor.
+//
+//	Possible return codes: S_OK, OMF_E_NO_MORE_ITEMS.
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::FindNextObject(__in_opt DWORD dwClassFourCC, __in BOOL fStrict, __inout PULONG piPos,
+																						__out PDWORD pdwObject)
+{
+	HRESULT	hr	= S_OK;
+	ULONG	i	= 0;
+
+	if (IsBadWritePointer(pdwObject, sizeof(DWORD)))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	*pdwObject = 0;
+
+	if (IsBadWritePointer(piPos, sizeof(ULONG)))
+	{
+		hr = E_POINTER;
+		goto L_Exit;
+	}
+
+	if (FAILED(hr = m_hrFirewall))
+	{
+		goto L_Exit;
+	}
+
+	// Assume there are no more items.
+	hr = OMF_E_NO_MORE_ITEMS;
+
+	// While there are more blops in the blop table.
+	for (i = *piPos; i < m_nBlops; i++)
+	{
+		BENTO_BLOP&	rBlop = m_aBlopTable[i];
+
+		// Did caller provide a class fourCC?
+		if (dwClassFourCC)
+		{
+			if (fStrict)
+			{
+				if (rBlop.dwFourCC != dwClassFourCC)
+				{
+					continue;
+				}
+			}
+			else if (S_OK != IsBlopATypeOf(rBlop, dwClassFourCC))
+			{
+				continue;
+			}
+		}
+
+		*pdwObject = rBlop.dwObject;
+		hr = S_OK;
+		i++;
+		break;
+	}
+
+	*piPos = i;
+
+L_Exit:
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::GetClassFourCC()
+//	Same as IOmfObject::GetClassFourCC(). The fourCC is returned in the HRESULT.
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::GetClassFourCC(__in DWORD dwObject)
+{
+	HRESULT hr = m_hrFirewall;
+	if (SUCCEEDED(hr))
+	{
+		BENTO_BLOP&	rBlop = GetBlop(dwObject);
+		if (rBlop.dwObject == 0)
+		{
+			hr = OMF_E_OOBJ_NOT_FOUND;
+		}
+		else if ((rBlop.dwFourCC & 0x80808080)||
+				(rBlop.dwFourCC < 0x20202020)||
+				(rBlop.dwFourCC > 0x7E7E7E7E))
+		{
+			hr = OMF_E_BAD_FOURCC;
+		}
+		else
+		{
+			hr = rBlop.dwFourCC;
+		}
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::IsATypeOf()
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::IsATypeOf(__in DWORD dwObject, __in DWORD dwClassFourCC)
+{
+	HRESULT hr = m_hrFirewall;
+	if (SUCCEEDED(hr))
+	{
+		hr = IsObjectATypeOf(dwObject, dwClassFourCC);
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::IsPropertyPresent()
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::IsPropertyPresent(__in DWORD dwObject, __in DWORD dwProperty)
+{
+	HRESULT hr = m_hrFirewall;
+	if (SUCCEEDED(hr))
+	{
+		hr = ObjIsPropertyPresent(dwObject, dwProperty);
+	}
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader read methods.
+//	These are thin wrappers around the CContainerLayer05 Obj* routines. The only thing we add is the firewall.
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::ReadRawBytes(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cbBuffer,
+												__out_opt PVOID pBuffer, __out_opt PULONG pcbRequired)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadRawBytes(dwObject, dwProperty, cbBuffer, pBuffer, pcbRequired) : hr;
+}
+
+HRESULT CContainerLayer98::ReadStringA(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cchBuffer,
+												__out_opt PCHAR pBuffer, __out_opt PULONG pcchRequired)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadStringA(dwObject, dwProperty, cchBuffer, pBuffer, pcchRequired) : hr;
+}
+
+HRESULT CContainerLayer98::ReadStringW(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cchBuffer,
+												__out_opt PWCHAR pBuffer, __out_opt PULONG pcchRequired)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadStringW(dwObject, dwProperty, cchBuffer, pBuffer, pcchRequired) : hr;
+}
+
+HRESULT CContainerLayer98::ReadBoolean(__in DWORD dwObject, __in DWORD dwProperty, __out PBOOLEAN pBoolean)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadBoolean(dwObject, dwProperty, pBoolean) : hr;
+}
+
+HRESULT CContainerLayer98::ReadInt8(__in DWORD dwObject, __in DWORD dwProperty, __out PINT8 pn8)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadInt8(dwObject, dwProperty, pn8) : hr;
+}
+
+HRESULT CContainerLayer98::ReadInt16(__in DWORD dwObject, __in DWORD dwProperty, __out PINT16 pn16)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadInt16(dwObject, dwProperty, pn16) : hr;
+}
+
+HRESULT CContainerLayer98::ReadInt32(__in DWORD dwObject, __in DWORD dwProperty, __out PINT32 pn32)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadInt32(dwObject, dwProperty, pn32) : hr;
+}
+
+HRESULT CContainerLayer98::ReadInt64(__in DWORD dwObject, __in DWORD dwProperty, __out PINT64 pn64)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadInt64(dwObject, dwProperty, pn64) : hr;
+}
+
+HRESULT CContainerLayer98::ReadUInt8(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT8 pu8)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadUInt8(dwObject, dwProperty, pu8) : hr;
+}
+
+HRESULT CContainerLayer98::ReadUInt16(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT16 pu16)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadUInt16(dwObject, dwProperty, pu16) : hr;
+}
+
+HRESULT CContainerLayer98::ReadUInt32(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT32 pu32)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadUInt32(dwObject, dwProperty, pu32) : hr;
+}
+
+HRESULT CContainerLayer98::ReadUInt64(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT64 pu64)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadUInt64(dwObject, dwProperty, pu64) : hr;
+}
+
+HRESULT CContainerLayer98::ReadFourCC(__in DWORD dwObject, __in DWORD dwProperty, __out PDWORD pdwFourCC)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadFourCC(dwObject, dwProperty, pdwFourCC) : hr;
+}
+
+HRESULT CContainerLayer98::ReadLength64(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT64 pLength)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadLength64(dwObject, dwProperty, pLength) : hr;
+}
+
+HRESULT CContainerLayer98::ReadPosition64(__in DWORD dwObject, __in DWORD dwProperty, __out PINT64 pPosition)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadPosition64(dwObject, dwProperty, pPosition) : hr;
+}
+
+HRESULT CContainerLayer98::ReadMobID(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_MOB_ID pMobID)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadMobID(dwObject, dwProperty, pMobID) : hr;
+}
+
+HRESULT CContainerLayer98::ReadRational(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_RATIONAL pRational)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadRational(dwObject, dwProperty, pRational) : hr;
+}
+
+HRESULT CContainerLayer98::ReadTimeStamp(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_TIMESTAMP pTimeStamp)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadTimeStamp(dwObject, dwProperty, pTimeStamp) : hr;
+}
+
+HRESULT CContainerLayer98::ReadInt32Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT32 pDest, __out PULONG pnActualElements)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadInt32Array(dwObject, dwProperty, nMaxElements, pDest, pnActualElements) : hr;
+}
+
+HRESULT CContainerLayer98::ReadInt64Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT64 pDest, __out PULONG pnActualElements)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadInt64Array(dwObject, dwProperty, nMaxElements, pDest, pnActualElements) : hr;
+}
+
+HRESULT CContainerLayer98::ReadPosition64Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT64 pDest, __out PULONG pnActualElements)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadPosition64Array(dwObject, dwProperty, nMaxElements, pDest, pnActualElements) : hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::ReadObjRef()
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::ReadObjRef(__in DWORD dwObject, __in DWORD dwProperty, __out PDWORD pdwObjRef)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadObjRef(dwObject, dwProperty, NULL, pdwObjRef) : hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooFastReader::ReadObjRefArray()
+//	Same call-twice semantics as CoreReadInt32Array(). The object IDs are decoded directly into caller's buffer.
+//*********************************************************************************************************************
+HRESULT CContainerLayer98::ReadObjRefArray(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PDWORD pDest, __out PULONG pnActualElements)
+{
+	HRESULT hr = m_hrFirewall;
+	return SUCCEEDED(hr) ? ObjReadObjRefArray(dwObject, dwProperty, nMaxElements, pDest, pnActualElements) : hr;
+}
+
 /*
 	// Temporary test code to verify CDShowFilterWithPin()
 	__debugbreak();
@@ -8,10 +8,57 @@
 #pragma once
 #include "ContainerLayer97.h"
 
-class CContainerLayer98 : public CContainerLayer97
+class CContainerLayer98
+	: public CContainerLayer97
+	, public IOmfooFastReader
 {
 protected:
 			CContainerLayer98(void);
 	virtual	~CContainerLayer98(void);
 	STDMETHODIMP	Load(__in PCWSTR pwzFileName);	
+
+	// Don't let IOmfooFastReader::Instantiate() hide the two CContainerLayer97::Instantiate() overloads.
+	using CContainerLayer97::Instantiate;
+
+protected:
+	// IOmfooFastReader methods in V-table order.
+	STDMETHODIMP	GetPropertyID(__in LPCSTR pszPropertyName, __out PDWORD pdwProperty);
+	STDMETHODIMP	GetHeadObjectID(__out PDWORD pdwObject);
+	STDMETHODIMP	GetObjectID(__in IUnknown *punk, __out PDWORD pdwObject);
+	STDMETHODIMP	Instantiate(__in DWORD dwObject, __in REFIID riid, __out PVOID *ppvOut);
+	STDMETHODIMP	FindNextObject(__in_opt DWORD dwClassFourCC, __in BOOL fStrict, __inout PULONG piPos,
+																				__out PDWORD pdwObject);
+	STDMETHODIMP	GetClassFourCC(__in DWORD dwObject);
+	STDMETHODIMP	IsATypeOf(__in DWORD dwObject, __in DWORD dwClassFourCC);
+	STDMETHODIMP	IsPropertyPresent(__in DWORD dwObject, __in DWORD dwProperty);
+	STDMETHODIMP	ReadRawBytes(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cbBuffer,
+												__out_opt PVOID pBuffer, __out_opt PULONG pcbRequired);
+	STDMETHODIMP	ReadStringA(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cchBuffer,
+												__out_opt PCHAR pBuffer, __out_opt PULONG pcchRequired);
+	STDMETHODIMP	ReadStringW(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cchBuffer,
+												__out_opt PWCHAR pBuffer, __out_opt PULONG pcchRequired);
+	STDMETHODIMP	ReadBoolean(__in DWORD dwObject, __in DWORD dwProperty, __out PBOOLEAN pBoolean);
+	STDMETHODIMP	ReadInt8(__in DWORD dwObject, __in DWORD dwProperty, __out PINT8 pn8);
+	STDMETHODIMP	ReadInt16(__in DWORD dwObject, __in DWORD dwProperty, __out PINT16 pn16);
+	STDMETHODIMP	ReadInt32(__in DWORD dwObject, __in DWORD dwProperty, __out PINT32 pn32);
+	STDMETHODIMP	ReadInt64(__in DWORD dwObject, __in DWORD dwProperty, __out PINT64 pn64);
+	STDMETHODIMP	ReadUInt8(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT8 pu8);
+	STDMETHODIMP	ReadUInt16(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT16 pu16);
+	STDMETHODIMP	ReadUInt32(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT32 pu32);
+	STDMETHODIMP	ReadUInt64(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT64 pu64);
+	STDMETHODIMP	ReadFourCC(__in DWORD dwObject, __in DWORD dwProperty, __out PDWORD pdwFourCC);
+	STDMETHODIMP	ReadLength64(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT64 pLength);
+	STDMETHODIMP	ReadPosition64(__in DWORD dwObject, __in DWORD dwProperty, __out PINT64 pPosition);
+	STDMETHODIMP	ReadMobID(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_MOB_ID pMobID);
+	STDMETHODIMP	ReadRational(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_RATIONAL pRational);
+	STDMETHODIMP	ReadTimeStamp(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_TIMESTAMP pTimeStamp);
+	STDMETHODIMP	ReadInt32Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT32 pDest, __out PULONG pnActualElements);
+	STDMETHODIMP	ReadInt64Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT64 pDest, __out PULONG pnActualElements);
+	STDMETHODIMP	ReadPosition64Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT64 pDest, __out PULONG pnActualElements);
+	STDMETHODIMP	ReadObjRef(__in DWORD dwObject, __in DWORD dwProperty, __out PDWORD pdwObjRef);
+	STDMETHODIMP	ReadObjRefArray(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PDWORD pDest, __out PULONG pnActualElements);
 };
@@ -85,6 +85,18 @@ HRESULT CContainerLayer99::NonDelegatingQueryInterface(REFIID riid, PVOID *ppvOu
 	{
 		pUnk = LPUNKNOWN(static_cast<IOmfooReader*>(this));
 	}
+	else if (riid == __uuidof(IOmfooFastReader))
+	{
+		pUnk = LPUNKNOWN(static_cast<IOmfooFastReader*>(this));
+	}
+	else if ((riid == __uuidof(IOmfooBulkExtractor)) || (riid == __uuidof(IOmfooBulkExtractor2)))
+	{
+		pUnk = LPUNKNOWN(static_cast<IOmfooBulkExtractor2*>(this));
+	}
+	else if (riid == __uuidof(IOmfooWaveformBuilder))
+	{
+		pUnk = LPUNKNOWN(static_cast<IOmfooWaveformBuilder*>(this));
+	}
 	else
 	{
 		return E_NOINTERFACE;
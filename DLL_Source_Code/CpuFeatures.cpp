@@ -0,0 +1,69 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: CpuFeatures.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "CpuFeatures.h"
+#include <intrin.h>
+
+// The CPU_HAS_ flags, plus CPU_FLAGS_VALID. They're filled in on first use. If two threads get there at the same time
+// they both compute exactly the same value, so we don't need a lock.
+static LONG		g_nCpuFeatures	= 0;	// 0 = not initialized yet
+
+// Set in g_nCpuFeatures once it's initialized, so that a CPU without any of our features isn't asked again.
+#define CPU_FLAGS_VALID		0x80000000
+
+//*********************************************************************************************************************
+//	Public.
+//	Returns any combination of the CPU_HAS_ flags.
+//*********************************************************************************************************************
+DWORD CCpuFeatures::GetFlags(void)
+{
+	if (0 == g_nCpuFeatures)
+	{
+		DWORD	dwFlags		= CPU_FLAGS_VALID;
+
+#if defined(_M_IX86) || defined(_M_X64)
+		// CPUID function 1 returns the SSSE3 feature bit in bit 9 of ECX, the SSE 4.2 feature bit in bit 20, the
+		// OSXSAVE feature bit in bit 27, and the AVX feature bit in bit 28. CPUID function 7 returns the AVX2 feature
+		// bit in bit 5 of EBX. If OSXSAVE is set then XCR0 bits 1 and 2 say whether the OS saves the XMM and YMM
+		// registers.
+		int		aCpuInfo[4]	= {0};
+		int		nMaxLeaf	= 0;
+
+		__cpuid(aCpuInfo, 0);
+		nMaxLeaf = aCpuInfo[0];
+
+		__cpuid(aCpuInfo, 1);
+		if (aCpuInfo[2] & (1 << 9))
+		{
+			dwFlags |= CPU_HAS_SSSE3;
+		}
+
+		if (aCpuInfo[2] & (1 << 20))
+		{
+			dwFlags |= CPU_HAS_SSE42;
+		}
+
+		if (((aCpuInfo[2] & (3 << 27)) == (3 << 27)) && ((_xgetbv(0) & 6) == 6))
+		{
+			dwFlags |= CPU_HAS_AVX;
+
+			if (nMaxLeaf >= 7)
+			{
+				__cpuidex(aCpuInfo, 7, 0);
+				if (aCpuInfo[1] & (1 << 5))
+				{
+					dwFlags |= CPU_HAS_AVX2;
+				}
+			}
+		}
+#endif
+
+		InterlockedExchange(&g_nCpuFeatures, LONG(dwFlags));
+	}
+	return DWORD(g_nCpuFeatures) & ~CPU_FLAGS_VALID;
+}
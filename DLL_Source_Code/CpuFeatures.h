@@ -0,0 +1,30 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: CpuFeatures.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+
+//*********************************************************************************************************************
+//	CCpuFeatures.
+//	Tells CArraySwap, CPcmConvert, and CExtractDigest which instruction set extensions they can use. We ask the CPU
+//	once, the first time anybody calls GetFlags(), and remember the answer for the life of the process.
+//
+//	CPU_HAS_AVX and CPU_HAS_AVX2 are only set if the OS also saves the upper halves of the YMM registers on a context
+//	switch. A CPU can support AVX while the OS doesn't, and then the AVX instructions fault.
+//*********************************************************************************************************************
+class CCpuFeatures
+{
+public:
+	enum {
+		CPU_HAS_SSSE3	= 0x00000001,	// _mm_shuffle_epi8()
+		CPU_HAS_SSE42	= 0x00000002,	// _mm_crc32_u8(), _mm_crc32_u32(), _mm_crc32_u64()
+		CPU_HAS_AVX		= 0x00000004,	// 256-bit float instructions
+		CPU_HAS_AVX2	= 0x00000008,	// 256-bit integer instructions
+	};
+
+	static DWORD	GetFlags(void);
+	static BOOL		Has(__in DWORD dwFeature)	{return (dwFeature == (GetFlags() & dwFeature));}
+};
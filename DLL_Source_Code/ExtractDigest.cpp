@@ -0,0 +1,425 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ExtractDigest.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "Omfoo_Alpha_Header.h"
+#include "ExtractDigest.h"
+#include "DllMain.h"
+#include "CpuFeatures.h"
+#include <intrin.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <nmmintrin.h>		// _mm_crc32_u8, _mm_crc32_u32, _mm_crc32_u64
+#endif
+
+#pragma comment(lib, "bcrypt.lib")
+
+// xxHash64 primes.
+#define XXH_PRIME64_1	0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2	0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3	0x165667B19E3779F9ULL
+#define XXH_PRIME64_4	0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5	0x27D4EB2F165667C5ULL
+
+// CRC-32C lookup table and mode. Both are filled in on first use. If two threads get there at the same time they both
+// compute exactly the same values, so we don't need a lock.
+static DWORD	g_aCrc32cTable[256];
+static LONG		g_nCrc32cMode	= 0;	// 0 = not initialized yet, 1 = use SSE 4.2, 2 = use g_aCrc32cTable[]
+
+//*********************************************************************************************************************
+//	Constructor
+//*********************************************************************************************************************
+CExtractDigest::CExtractDigest(void)
+	: m_dwDigestKinds(0)
+	, m_dwCrc32c(0)
+	, m_cbHashed(0)
+	, m_hrUpdate(S_OK)
+	, m_cbXxhBuffered(0)
+	, m_hShaAlg(NULL)
+	, m_hSha(NULL)
+	, m_pShaObject(NULL)
+{
+	ZeroMemory(m_aXxhAcc, sizeof(m_aXxhAcc));
+	ZeroMemory(m_aXxhBuffer, sizeof(m_aXxhBuffer));
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//*********************************************************************************************************************
+CExtractDigest::~CExtractDigest(void)
+{
+	Cleanup();
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Prepares to hash a new series of buffers. dwDigestKinds is any combination of the DK_ flags.
+//	Returns E_INVALIDARG if dwDigestKinds has any bits that we don't know about.
+//*********************************************************************************************************************
+HRESULT CExtractDigest::Initialize(__in DWORD dwDigestKinds)
+{
+	DWORD		cbShaObject	= 0;
+	ULONG		cbResult	= 0;
+	NTSTATUS	status		= 0;
+
+	Cleanup();
+
+	if (dwDigestKinds & ~(DK_CRC32C|DK_XXH64|DK_SHA256))
+	{
+		return E_INVALIDARG;
+	}
+
+	m_dwDigestKinds	= dwDigestKinds;
+	m_dwCrc32c		= 0xFFFFFFFF;
+	m_cbHashed		= 0;
+	m_hrUpdate		= S_OK;
+	m_cbXxhBuffered	= 0;
+
+	// Seed is zero.
+	m_aXxhAcc[0]	= XXH_PRIME64_1 + XXH_PRIME64_2;
+	m_aXxhAcc[1]	= XXH_PRIME64_2;
+	m_aXxhAcc[2]	= 0;
+	m_aXxhAcc[3]	= 0 - XXH_PRIME64_1;
+
+	if (m_dwDigestKinds & DK_CRC32C)
+	{
+		if (0 == g_nCrc32cMode)
+		{
+			// Build the table for the reflected Castagnoli polynomial 0x82F63B78.
+			for (DWORD i = 0; i < 256; i++)
+			{
+				DWORD dwCrc = i;
+				for (ULONG j = 0; j < 8; j++)
+				{
+					dwCrc = (dwCrc & 1) ? ((dwCrc >> 1) ^ 0x82F63B78) : (dwCrc >> 1);
+				}
+				g_aCrc32cTable[i] = dwCrc;
+			}
+
+			InterlockedExchange(&g_nCrc32cMode, CCpuFeatures::Has(CCpuFeatures::CPU_HAS_SSE42) ? 1 : 2);
+		}
+	}
+
+	if (m_dwDigestKinds & DK_SHA256)
+	{
+		if (!BCRYPT_SUCCESS(status = BCryptOpenAlgorithmProvider(&m_hShaAlg, BCRYPT_SHA256_ALGORITHM, NULL, 0)))
+		{
+			BREAK_IF_DEBUG
+			m_hShaAlg = NULL;
+			goto L_Exit;
+		}
+
+		if (!BCRYPT_SUCCESS(status = BCryptGetProperty(m_hShaAlg,
+														BCRYPT_OBJECT_LENGTH,
+														PUCHAR(&cbShaObject),
+														sizeof(cbShaObject),
+														&cbResult,
+														0)))
+		{
+			BREAK_IF_DEBUG
+			goto L_Exit;
+		}
+
+		if (NULL == (m_pShaObject = PBYTE(MemAlloc(cbShaObject))))
+		{
+			BREAK_IF_DEBUG
+			Cleanup();
+			return E_OUTOFMEMORY;
+		}
+
+		if (!BCRYPT_SUCCESS(status = BCryptCreateHash(m_hShaAlg, &m_hSha, m_pShaObject, cbShaObject, NULL, 0, 0)))
+		{
+			BREAK_IF_DEBUG
+			m_hSha = NULL;
+			goto L_Exit;
+		}
+	}
+
+L_Exit:
+	if (!BCRYPT_SUCCESS(status))
+	{
+		Cleanup();
+		return HRESULT_FROM_NT(status);
+	}
+
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Hashes the next buffer in the series.
+//*********************************************************************************************************************
+void CExtractDigest::Update(__in_bcount(cbData) LPCVOID pData, __in SIZE_T cbData)
+{
+	const BYTE* pBytes = static_cast<const BYTE*>(pData);
+
+	if (m_dwDigestKinds & DK_CRC32C)
+	{
+		m_dwCrc32c = Crc32cUpdate(m_dwCrc32c, pBytes, cbData);
+	}
+
+	if (m_dwDigestKinds & DK_XXH64)
+	{
+		Xxh64Update(pBytes, cbData);
+	}
+
+	if ((m_dwDigestKinds & DK_SHA256) && m_hSha && SUCCEEDED(m_hrUpdate))
+	{
+		// BCryptHashData() takes a ULONG byte count, so feed it in pieces if we have to.
+		for (SIZE_T cbDone = 0; cbDone < cbData;)
+		{
+			ULONG		cbChunk	= (cbData - cbDone > 0x40000000) ? 0x40000000 : ULONG(cbData - cbDone);
+			NTSTATUS	status	= BCryptHashData(m_hSha, PUCHAR(pBytes + cbDone), cbChunk, 0);
+			if (!BCRYPT_SUCCESS(status))
+			{
+				BREAK_IF_DEBUG
+				m_hrUpdate = HRESULT_FROM_NT(status);
+				break;
+			}
+			cbDone += cbChunk;
+		}
+	}
+
+	m_cbHashed += cbData;
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Finishes the series and fills in caller's OMFOO_EXTRACT_DIGESTS. After this you must call Initialize() again
+//	before you call Update() again.
+//*********************************************************************************************************************
+HRESULT CExtractDigest::Finish(__out POMFOO_EXTRACT_DIGESTS pDigests)
+{
+	HRESULT hr = m_hrUpdate;
+
+	ZeroMemory(pDigests, sizeof(OMFOO_EXTRACT_DIGESTS));
+
+	if (SUCCEEDED(hr))
+	{
+		pDigests->dwDigestKinds	= m_dwDigestKinds;
+		pDigests->cbHashed		= m_cbHashed;
+
+		if (m_dwDigestKinds & DK_CRC32C)
+		{
+			pDigests->dwCrc32c = ~m_dwCrc32c;
+		}
+
+		if (m_dwDigestKinds & DK_XXH64)
+		{
+			pDigests->qwXxh64 = Xxh64Finish();
+		}
+
+		if (m_dwDigestKinds & DK_SHA256)
+		{
+			NTSTATUS status = BCryptFinishHash(m_hSha, pDigests->aSha256, sizeof(pDigests->aSha256), 0);
+			if (!BCRYPT_SUCCESS(status))
+			{
+				BREAK_IF_DEBUG
+				hr = HRESULT_FROM_NT(status);
+				ZeroMemory(pDigests, sizeof(OMFOO_EXTRACT_DIGESTS));
+			}
+		}
+	}
+
+	Cleanup();
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private static helper.
+//	Folds cbData bytes into a running CRC-32C. The caller is responsible for the initial and final inversions.
+//*********************************************************************************************************************
+DWORD CExtractDigest::Crc32cUpdate(__in DWORD dwCrc, __in_bcount(cbData) const BYTE* pData, __in SIZE_T cbData)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	if (g_nCrc32cMode == 1)
+	{
+		// Do the odd bytes one at a time until pData is aligned, and then do the rest eight (or four) at a time.
+		while (cbData && (UINT_PTR(pData) & 7))
+		{
+			dwCrc = _mm_crc32_u8(dwCrc, *pData++);
+			cbData--;
+		}
+
+#ifdef _M_X64
+		UINT64 qwCrc = dwCrc;
+		while (cbData >= 8)
+		{
+			qwCrc = _mm_crc32_u64(qwCrc, *(const UINT64*)pData);
+			pData	+= 8;
+			cbData	-= 8;
+		}
+		dwCrc = DWORD(qwCrc);
+#else
+		while (cbData >= 4)
+		{
+			dwCrc = _mm_crc32_u32(dwCrc, *(const UINT32*)pData);
+			pData	+= 4;
+			cbData	-= 4;
+		}
+#endif
+
+		while (cbData)
+		{
+			dwCrc = _mm_crc32_u8(dwCrc, *pData++);
+			cbData--;
+		}
+		return dwCrc;
+	}
+#endif
+
+	while (cbData)
+	{
+		dwCrc = g_aCrc32cTable[(dwCrc ^ *pData++) & 0xFF] ^ (dwCrc >> 8);
+		cbData--;
+	}
+	return dwCrc;
+}
+
+//*********************************************************************************************************************
+//	Private helper.
+//	xxHash64 streaming update. This follows the reference implementation at https://github.com/Cyan4973/xxHash.
+//*********************************************************************************************************************
+void CExtractDigest::Xxh64Update(__in_bcount(cbData) const BYTE* pData, __in SIZE_T cbData)
+{
+	// Top off the leftovers from last time.
+	if (m_cbXxhBuffered)
+	{
+		SIZE_T cbCopy = sizeof(m_aXxhBuffer) - m_cbXxhBuffered;
+		if (cbCopy > cbData)
+		{
+			cbCopy = cbData;
+		}
+
+		CopyMemory(&m_aXxhBuffer[m_cbXxhBuffered], pData, cbCopy);
+		m_cbXxhBuffered	+= ULONG(cbCopy);
+		pData			+= cbCopy;
+		cbData			-= cbCopy;
+
+		if (m_cbXxhBuffered < sizeof(m_aXxhBuffer))
+		{
+			return;
+		}
+
+		for (ULONG i = 0; i < 4; i++)
+		{
+			UINT64 qwLane = *(const UINT64*)&m_aXxhBuffer[i * 8];
+			m_aXxhAcc[i] = _rotl64(m_aXxhAcc[i] + (qwLane * XXH_PRIME64_2), 31) * XXH_PRIME64_1;
+		}
+		m_cbXxhBuffered = 0;
+	}
+
+	// This is where almost all of the time is spent. Four independent lanes, so the CPU can overlap the multiplies.
+	UINT64	v1	= m_aXxhAcc[0];
+	UINT64	v2	= m_aXxhAcc[1];
+	UINT64	v3	= m_aXxhAcc[2];
+	UINT64	v4	= m_aXxhAcc[3];
+
+	while (cbData >= 32)
+	{
+		v1 = _rotl64(v1 + (((const UINT64*)pData)[0] * XXH_PRIME64_2), 31) * XXH_PRIME64_1;
+		v2 = _rotl64(v2 + (((const UINT64*)pData)[1] * XXH_PRIME64_2), 31) * XXH_PRIME64_1;
+		v3 = _rotl64(v3 + (((const UINT64*)pData)[2] * XXH_PRIME64_2), 31) * XXH_PRIME64_1;
+		v4 = _rotl64(v4 + (((const UINT64*)pData)[3] * XXH_PRIME64_2), 31) * XXH_PRIME64_1;
+		pData	+= 32;
+		cbData	-= 32;
+	}
+
+	m_aXxhAcc[0]	= v1;
+	m_aXxhAcc[1]	= v2;
+	m_aXxhAcc[2]	= v3;
+	m_aXxhAcc[3]	= v4;
+
+	// Save the leftovers for next time.
+	if (cbData)
+	{
+		CopyMemory(m_aXxhBuffer, pData, cbData);
+		m_cbXxhBuffered = ULONG(cbData);
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper.
+//	xxHash64 finalization.
+//*********************************************************************************************************************
+UINT64 CExtractDigest::Xxh64Finish(void)
+{
+	UINT64		h64		= 0;
+	const BYTE*	pData	= m_aXxhBuffer;
+	ULONG		cbData	= m_cbXxhBuffered;
+
+	if (m_cbHashed >= 32)
+	{
+		h64 = _rotl64(m_aXxhAcc[0], 1) + _rotl64(m_aXxhAcc[1], 7) + _rotl64(m_aXxhAcc[2], 12) + _rotl64(m_aXxhAcc[3], 18);
+		for (ULONG i = 0; i < 4; i++)
+		{
+			UINT64 qwRound = _rotl64(m_aXxhAcc[i] * XXH_PRIME64_2, 31) * XXH_PRIME64_1;
+			h64 = ((h64 ^ qwRound) * XXH_PRIME64_1) + XXH_PRIME64_4;
+		}
+	}
+	else
+	{
+		h64 = XXH_PRIME64_5;
+	}
+
+	h64 += m_cbHashed;
+
+	while (cbData >= 8)
+	{
+		UINT64 qwRound = _rotl64(*(const UINT64*)pData * XXH_PRIME64_2, 31) * XXH_PRIME64_1;
+		h64 = (_rotl64(h64 ^ qwRound, 27) * XXH_PRIME64_1) + XXH_PRIME64_4;
+		pData	+= 8;
+		cbData	-= 8;
+	}
+
+	if (cbData >= 4)
+	{
+		h64 = (_rotl64(h64 ^ (UINT64(*(const UINT32*)pData) * XXH_PRIME64_1), 23) * XXH_PRIME64_2) + XXH_PRIME64_3;
+		pData	+= 4;
+		cbData	-= 4;
+	}
+
+	while (cbData)
+	{
+		h64 = _rotl64(h64 ^ (*pData * XXH_PRIME64_5), 11) * XXH_PRIME64_1;
+		pData++;
+		cbData--;
+	}
+
+	// Avalanche.
+	h64 ^= h64 >> 33;
+	h64 *= XXH_PRIME64_2;
+	h64 ^= h64 >> 29;
+	h64 *= XXH_PRIME64_3;
+	h64 ^= h64 >> 32;
+	return h64;
+}
+
+//*********************************************************************************************************************
+//	Private helper.
+//	Releases the CNG objects. It's safe to call this more than once.
+//*********************************************************************************************************************
+void CExtractDigest::Cleanup(void)
+{
+	if (m_hSha)
+	{
+		BCryptDestroyHash(m_hSha);
+		m_hSha = NULL;
+	}
+
+	if (m_pShaObject)
+	{
+		MemFree(m_pShaObject);
+		m_pShaObject = NULL;
+	}
+
+	if (m_hShaAlg)
+	{
+		BCryptCloseAlgorithmProvider(m_hShaAlg, 0);
+		m_hShaAlg = NULL;
+	}
+}
@@ -0,0 +1,52 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: ExtractDigest.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+#include <bcrypt.h>
+
+//*********************************************************************************************************************
+//	CExtractDigest.
+//	Computes any combination of CRC-32C, xxHash64, and SHA-256 over a series of buffers, one buffer at a time.
+//	The extraction routines feed it each buffer on its way to the destination file, so the checksums cost no extra I/O.
+//
+//	CRC-32C uses the SSE 4.2 CRC32 instruction when the CPU has it, and a table when it doesn't.
+//	SHA-256 comes from Windows CNG (bcrypt.dll), which uses the SHA extensions on CPUs that have them.
+//	xxHash64 is small enough to do ourselves.
+//
+//	This is not a COM object. It's meant to live on the stack or inside some other structure, and it cleans up after
+//	itself in its destructor.
+//*********************************************************************************************************************
+class CExtractDigest
+{
+public:
+			CExtractDigest(void);
+			~CExtractDigest(void);
+
+	HRESULT		Initialize(__in DWORD dwDigestKinds);
+	void		Update(__in_bcount(cbData) LPCVOID pData, __in SIZE_T cbData);
+	HRESULT		Finish(__out POMFOO_EXTRACT_DIGESTS pDigests);
+	DWORD		GetDigestKinds(void)	{return m_dwDigestKinds;}
+
+private:
+	static DWORD	Crc32cUpdate(__in DWORD dwCrc, __in_bcount(cbData) const BYTE* pData, __in SIZE_T cbData);
+	void			Xxh64Update(__in_bcount(cbData) const BYTE* pData, __in SIZE_T cbData);
+	UINT64			Xxh64Finish(void);
+	void			Cleanup(void);
+
+	DWORD				m_dwDigestKinds;	// DK_ flags from caller
+	DWORD				m_dwCrc32c;			// running CRC (pre-inverted)
+	UINT64				m_cbHashed;			// total number of bytes passed to Update()
+	HRESULT				m_hrUpdate;			// first failure from BCryptHashData(), if any
+
+	UINT64				m_aXxhAcc[4];		// xxHash64 accumulators
+	BYTE				m_aXxhBuffer[32];	// xxHash64 consumes 32 bytes at a time - this holds the leftovers
+	ULONG				m_cbXxhBuffered;	// number of bytes in m_aXxhBuffer[]
+
+	BCRYPT_ALG_HANDLE	m_hShaAlg;
+	BCRYPT_HASH_HANDLE	m_hSha;
+	PBYTE				m_pShaObject;		// CNG's hash object lives here
+};
@@ -0,0 +1,343 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: MarkerScan.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "Omfoo_Alpha_Header.h"
+#include "MarkerScan.h"
+#include "DllMain.h"
+#include <intrin.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>		// SSE2
+#endif
+
+//*********************************************************************************************************************
+//	Constructor
+//*********************************************************************************************************************
+CMarkerList::CMarkerList(void)
+{
+	Init();
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//*********************************************************************************************************************
+CMarkerList::~CMarkerList(void)
+{
+	Free();
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Puts the list in its empty state. This is what our constructor does.
+//*********************************************************************************************************************
+void CMarkerList::Init(void)
+{
+	m_aMarkers		= NULL;
+	m_nMarkers		= 0;
+	m_nMaxMarkers	= 0;
+	m_hrStatus		= S_OK;
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Frees the array and puts the list back in its empty state. This is what our destructor does.
+//*********************************************************************************************************************
+void CMarkerList::Free(void)
+{
+	if (m_aMarkers)
+	{
+		MemFree(m_aMarkers);
+	}
+	Init();
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Adds one marker to the end of the list. Returns FALSE if we're out of memory.
+//*********************************************************************************************************************
+BOOL CMarkerList::Append(__in UINT64 cbOffset, __in DWORD dwCode, __in DWORD dwExtra)
+{
+	if (m_nMarkers == m_nMaxMarkers)
+	{
+		if (!Grow(m_nMarkers + 1))
+		{
+			return FALSE;
+		}
+	}
+
+	PSCAN_MARKER pMarker = &m_aMarkers[m_nMarkers++];
+	pMarker->cbOffset	= cbOffset;
+	pMarker->dwCode		= dwCode;
+	pMarker->dwExtra	= dwExtra;
+	return TRUE;
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Copies all of the markers in rOther to the end of this list.
+//*********************************************************************************************************************
+HRESULT CMarkerList::AppendList(__in CMarkerList& rOther)
+{
+	if (FAILED(m_hrStatus))
+	{
+		return m_hrStatus;
+	}
+
+	if (FAILED(rOther.m_hrStatus))
+	{
+		return rOther.m_hrStatus;
+	}
+
+	if (rOther.m_nMarkers)
+	{
+		if (rOther.m_nMarkers > ULONG_MAX - m_nMarkers)
+		{
+			return (m_hrStatus = E_OUTOFMEMORY);
+		}
+
+		if (!Grow(m_nMarkers + rOther.m_nMarkers))
+		{
+			return m_hrStatus;
+		}
+
+		CopyMemory(&m_aMarkers[m_nMarkers], rOther.m_aMarkers, rOther.m_nMarkers * sizeof(SCAN_MARKER));
+		m_nMarkers += rOther.m_nMarkers;
+	}
+
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper.
+//	Makes sure m_aMarkers[] has room for at least nMinMarkers elements.
+//*********************************************************************************************************************
+BOOL CMarkerList::Grow(__in ULONG nMinMarkers)
+{
+	PSCAN_MARKER	aNewMarkers		= NULL;
+	ULONG			nNewMaxMarkers	= m_nMaxMarkers ? m_nMaxMarkers : ULONG(INITIAL_MARKERS);
+
+	if (FAILED(m_hrStatus))
+	{
+		return FALSE;
+	}
+
+	if (nMinMarkers <= m_nMaxMarkers)
+	{
+		return TRUE;
+	}
+
+	while (nNewMaxMarkers < nMinMarkers)
+	{
+		nNewMaxMarkers <<= 1;
+	}
+
+	// MemAlloc() takes a ULONG, so this is as big as we can get.
+	if (nNewMaxMarkers > (ULONG_MAX / sizeof(SCAN_MARKER)))
+	{
+		m_hrStatus = E_OUTOFMEMORY;
+		return FALSE;
+	}
+
+	aNewMarkers = PSCAN_MARKER(MemAlloc(nNewMaxMarkers * sizeof(SCAN_MARKER)));
+	if (NULL == aNewMarkers)
+	{
+		BREAK_IF_DEBUG
+		m_hrStatus = E_OUTOFMEMORY;
+		return FALSE;
+	}
+
+	if (m_aMarkers)
+	{
+		CopyMemory(aNewMarkers, m_aMarkers, m_nMarkers * sizeof(SCAN_MARKER));
+		MemFree(m_aMarkers);
+	}
+
+	m_aMarkers		= aNewMarkers;
+	m_nMaxMarkers	= nNewMaxMarkers;
+	return TRUE;
+}
+
+//*********************************************************************************************************************
+//	Public static scan routine.
+//	Finds every JPEG Start Of Image (0xFFD8) and End Of Image (0xFFD9) marker. The dwCode member of each SCAN_MARKER
+//	is the marker's second byte. The dwExtra member is always zero.
+//
+//	Inside the entropy-coded data every 0xFF byte is followed by a zero byte or an RSTn marker (0xD0-0xD7), so these
+//	two markers can only appear where they really mean something - or inside an APPn segment, like an EXIF thumbnail.
+//	Our caller sorts that out.
+//
+//	The SSE2 loop tests 16 positions at a time. It compares the bytes at those positions to 0xFF, and the bytes that
+//	follow them to 0xD8 or 0xD9 (that is, 0xD8 with the low bit masked off). Only the positions that pass both tests
+//	need to be looked at one at a time. SSE2 is always available on x64, and we require it on x86.
+//*********************************************************************************************************************
+void CMarkerList::FindJpegMarkers(__in_bcount(cbAvail) const BYTE* pData,
+									__in SIZE_T cbScan,
+										__in SIZE_T cbAvail,
+											__in UINT64 cbBase,
+												__inout CMarkerList& rList)
+{
+	SIZE_T i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	const __m128i	vFF	= _mm_set1_epi8(char(0xFF));
+	const __m128i	vFE	= _mm_set1_epi8(char(0xFE));
+	const __m128i	vD8	= _mm_set1_epi8(char(0xD8));
+
+	// Each pass tests 16 positions, and that takes 17 bytes.
+	while ((i < cbScan) && (i + 17 <= cbAvail))
+	{
+		__m128i	vLead	= _mm_loadu_si128((const __m128i*)&pData[i]);
+		__m128i	vNext	= _mm_loadu_si128((const __m128i*)&pData[i + 1]);
+		__m128i	vHits	= _mm_and_si128(_mm_cmpeq_epi8(vLead, vFF), _mm_cmpeq_epi8(_mm_and_si128(vNext, vFE), vD8));
+		ULONG	fMask	= ULONG(_mm_movemask_epi8(vHits));
+
+		while (fMask)
+		{
+			ULONG iBit = 0;
+			_BitScanForward(&iBit, fMask);
+			fMask &= fMask - 1;
+
+			if (i + iBit >= cbScan)
+			{
+				break;
+			}
+
+			if (!rList.Append(cbBase + i + iBit, pData[i + iBit + 1], 0))
+			{
+				return;
+			}
+		}
+		i += 16;
+	}
+#endif
+
+	// Do the leftovers one at a time.
+	for (; (i < cbScan) && (i + 1 < cbAvail); i++)
+	{
+		if ((pData[i] == 0xFF) && ((pData[i + 1] & 0xFE) == 0xD8))
+		{
+			if (!rList.Append(cbBase + i, pData[i + 1], 0))
+			{
+				return;
+			}
+		}
+	}
+}
+
+//*********************************************************************************************************************
+//	Public static scan routine.
+//	Finds every MPEG-1/MPEG-2 video start code that we need to build a picture index - the sequence header (B3),
+//	the group of pictures header (B8), and the picture header (00). The dwCode member of each SCAN_MARKER is the
+//	start code's fourth byte. See AppendMpegStartCode() for the dwExtra member.
+//
+//	A video elementary stream never has three bytes of 00 00 01 anywhere except at a start code. Slice start codes
+//	(01 through AF) are by far the most common ones, and we skip them.
+//
+//	The SSE2 loop tests 16 positions at a time. It compares the bytes at those positions to 00, the bytes that follow
+//	them to 00, and the bytes that follow those to 01. That takes 18 bytes, plus one more for the fourth byte of the
+//	start code. Only the positions that pass all three tests need to be looked at one at a time.
+//*********************************************************************************************************************
+void CMarkerList::FindMpegStartCodes(__in_bcount(cbAvail) const BYTE* pData,
+										__in SIZE_T cbScan,
+											__in SIZE_T cbAvail,
+												__in UINT64 cbBase,
+													__inout CMarkerList& rList)
+{
+	SIZE_T i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	const __m128i	v00	= _mm_setzero_si128();
+	const __m128i	v01	= _mm_set1_epi8(1);
+
+	// Each pass tests 16 positions, and that takes 19 bytes.
+	while ((i < cbScan) && (i + 19 <= cbAvail))
+	{
+		__m128i	vByte0	= _mm_loadu_si128((const __m128i*)&pData[i]);
+		__m128i	vByte1	= _mm_loadu_si128((const __m128i*)&pData[i + 1]);
+		__m128i	vByte2	= _mm_loadu_si128((const __m128i*)&pData[i + 2]);
+		__m128i	vHits	= _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(vByte0, v00), _mm_cmpeq_epi8(vByte1, v00)),
+										_mm_cmpeq_epi8(vByte2, v01));
+		ULONG	fMask	= ULONG(_mm_movemask_epi8(vHits));
+
+		while (fMask)
+		{
+			ULONG iBit = 0;
+			_BitScanForward(&iBit, fMask);
+			fMask &= fMask - 1;
+
+			if (i + iBit >= cbScan)
+			{
+				break;
+			}
+
+			if (!AppendMpegStartCode(&pData[i + iBit], cbAvail - (i + iBit), cbBase + i + iBit, rList))
+			{
+				return;
+			}
+		}
+		i += 16;
+	}
+#endif
+
+	// Do the leftovers one at a time.
+	for (; (i < cbScan) && (i + 3 < cbAvail); i++)
+	{
+		if ((pData[i] == 0x00) && (pData[i + 1] == 0x00) && (pData[i + 2] == 0x01))
+		{
+			if (!AppendMpegStartCode(&pData[i], cbAvail - i, cbBase + i, rList))
+			{
+				return;
+			}
+		}
+	}
+}
+
+//*********************************************************************************************************************
+//	Private static helper for FindMpegStartCodes().
+//	The pCode argument points to the first byte of a 00 00 01 prefix, and cbAvail says how many bytes are valid.
+//	If the start code is one that we want then we append it to rList, along with a few bits from its header.
+//
+//	For a picture header the dwExtra member holds the picture_coding_type in bits 0-2 (1 = I, 2 = P, 3 = B, 4 = D)
+//	and the temporal_reference in bits 8-17. For a group of pictures header it holds the closed_gop flag in bit 0 and
+//	the broken_link flag in bit 1. If the header runs past the end of the buffer (that only happens at the very end
+//	of the payload) then dwExtra is zero. Returns FALSE only if we're out of memory.
+//*********************************************************************************************************************
+BOOL CMarkerList::AppendMpegStartCode(__in_bcount(cbAvail) const BYTE* pCode,
+										__in SIZE_T cbAvail,
+											__in UINT64 cbOffset,
+												__inout CMarkerList& rList)
+{
+	DWORD dwExtra = 0;
+
+	switch (pCode[3])
+	{
+	case MPEG_PICTURE_START_CODE:
+		// temporal_reference is 10 bits, then picture_coding_type is 3 bits.
+		if (cbAvail >= 6)
+		{
+			dwExtra = ((pCode[5] >> 3) & 0x07) | (((DWORD(pCode[4]) << 2) | (pCode[5] >> 6)) << 8);
+		}
+		break;
+
+	case MPEG_GROUP_START_CODE:
+		// time_code is 25 bits, then closed_gop and broken_link.
+		if (cbAvail >= 8)
+		{
+			dwExtra = ((pCode[7] >> 6) & 0x01) | ((pCode[7] >> 4) & 0x02);
+		}
+		break;
+
+	case MPEG_SEQUENCE_HEADER_CODE:
+		break;
+
+	default:
+		return TRUE;
+	}
+
+	return rList.Append(cbOffset, pCode[3], dwExtra);
+}
@@ -0,0 +1,88 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: MarkerScan.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+
+//	One of these for each marker (or start code) that a scan routine finds.
+typedef struct {
+	UINT64	cbOffset;			// position of the marker's first byte, measured from the start of the payload.
+	DWORD	dwCode;				// which marker it is. For JPEG this is the marker's second byte (0xD8 = SOI, etc.)
+								// For MPEG this is the start code's fourth byte (0xB3 = sequence header, etc.)
+	DWORD	dwExtra;			// more info about the marker, if the scan routine has any.
+} SCAN_MARKER, *PSCAN_MARKER;
+
+//*********************************************************************************************************************
+//	CMarkerList.
+//	A growable array of SCAN_MARKERs, plus the routines that fill it.
+//
+//	Each scan routine looks at cbScan bytes of the payload and reports every marker that begins inside those bytes.
+//	Markers are more than one byte long, so the routine may peek at up to SCAN_OVERLAP bytes past the end of cbScan.
+//	The cbAvail argument says how many bytes are actually in the buffer (it's less than cbScan + SCAN_OVERLAP at the
+//	end of the payload). That way a payload can be cut into chunks and the chunks can be scanned by different threads,
+//	and a marker that straddles two chunks is still reported exactly once - by the chunk where it begins.
+//
+//	If Append() can't allocate memory then it remembers E_OUTOFMEMORY, and it ignores everything after that.
+//	Check GetStatus() when the scan is done.
+//
+//	This is not a COM object. It's meant to live on the stack or inside some other structure, and it cleans up after
+//	itself in its destructor. If you allocate an array of them with MemAlloc() then call Init() on each one before you
+//	use it, and call Free() on each one before you MemFree() the array.
+//*********************************************************************************************************************
+class CMarkerList
+{
+public:
+	enum {
+		SCAN_OVERLAP	= 16,		// number of bytes a scan routine may peek past the end of its chunk.
+		INITIAL_MARKERS	= 256,		// initial size of m_aMarkers[]. It doubles every time it fills up.
+	};
+
+			CMarkerList(void);
+			~CMarkerList(void);
+
+	void			Init(void);
+	void			Free(void);
+	BOOL			Append(__in UINT64 cbOffset, __in DWORD dwCode, __in DWORD dwExtra);
+	HRESULT			AppendList(__in CMarkerList& rOther);
+	ULONG			GetCount(void)	{return m_nMarkers;}
+	PSCAN_MARKER	GetArray(void)	{return m_aMarkers;}
+	HRESULT			GetStatus(void)	{return m_hrStatus;}
+
+	// Scan routines.
+	static void		FindJpegMarkers(__in_bcount(cbAvail) const BYTE* pData,
+										__in SIZE_T cbScan,
+											__in SIZE_T cbAvail,
+												__in UINT64 cbBase,
+													__inout CMarkerList& rList);
+
+	static void		FindMpegStartCodes(__in_bcount(cbAvail) const BYTE* pData,
+										__in SIZE_T cbScan,
+											__in SIZE_T cbAvail,
+												__in UINT64 cbBase,
+													__inout CMarkerList& rList);
+
+private:
+	BOOL			Grow(__in ULONG nMinMarkers);
+	static BOOL		AppendMpegStartCode(__in_bcount(cbAvail) const BYTE* pCode,
+											__in SIZE_T cbAvail,
+												__in UINT64 cbOffset,
+													__inout CMarkerList& rList);
+
+	PSCAN_MARKER	m_aMarkers;
+	ULONG			m_nMarkers;			// number of elements in use.
+	ULONG			m_nMaxMarkers;		// number of elements allocated.
+	HRESULT			m_hrStatus;			// S_OK, or E_OUTOFMEMORY.
+};
+
+//	Enumerated values for the dwCode member of the SCAN_MARKER structure when it comes from FindMpegStartCodes().
+enum MPEG_START_CODE {
+	MPEG_PICTURE_START_CODE		= 0x00,		// picture header (00 00 01 00)
+	MPEG_SEQUENCE_HEADER_CODE	= 0xB3,		// sequence header (00 00 01 B3)
+	MPEG_GROUP_START_CODE		= 0xB8,		// group of pictures header (00 00 01 B8)
+};
+
+//	Every scan routine looks like this.
+typedef void (*PFN_MARKER_SCAN)(const BYTE* pData, SIZE_T cbScan, SIZE_T cbAvail, UINT64 cbBase, CMarkerList& rList);
@@ -23,7 +23,7 @@ COmfObject* COmfAttribute::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfAttribute(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfAttribute(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -22,7 +22,7 @@ COmfObject* COmfAttributeArray::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfAttributeArray(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfAttributeArray(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -22,7 +22,7 @@ COmfObject* COmfClassDictionaryEntry::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfClassDictionaryEntry(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfClassDictionaryEntry(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
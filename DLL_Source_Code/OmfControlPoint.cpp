@@ -22,7 +22,7 @@ COmfObject* COmfControlPoint::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfControlPoint(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfControlPoint(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
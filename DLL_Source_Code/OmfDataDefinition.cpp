@@ -22,7 +22,7 @@ COmfObject* COmfDataDefinition::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfDataDefinition(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfDataDefinition(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
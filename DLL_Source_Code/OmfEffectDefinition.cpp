@@ -22,7 +22,7 @@ COmfObject* COmfEffectDefinition::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfEffectDefinition(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfEffectDefinition(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -22,7 +22,7 @@ COmfObject* COmfEffectSlot::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfEffectSlot(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfEffectSlot(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -22,7 +22,7 @@ COmfObject* COmfHeader::NewInstance(BENTO_BLOP& rBlop,
 											COmfObject* pParent,
 											PVOID pNewReserved)
 {
-	return new COmfHeader(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfHeader(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -22,7 +22,7 @@ COmfObject* COmfIdentity::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfIdentity(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfIdentity(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
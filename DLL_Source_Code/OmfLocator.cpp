@@ -57,7 +57,7 @@ COmfObject* COmfLocator::NewInstance(BENTO_BLOP& rBlop,
 										COmfObject* pParent,
 										PVOID pNewReserved)
 {
-	return new COmfLocator(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfLocator(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -32,38 +32,95 @@ protected:
 //*********************************************************************************************************************
 //	AIFC Audio Data Class (AIFC).
 //*********************************************************************************************************************
-class COmfAifcData : protected COmfMediaDataT<IOmfAifcData>
+typedef COmfMediaDataContainerT<COmfMediaDataSamplesT<COmfMediaDataT<IOmfAifcData> > > COmfAifcDataBase;
+class COmfAifcData : protected COmfAifcDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfAifcData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfAifcData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfAifcDataBase(rBlop, pContainer, pParent, pNewReserved)
 	{
 	}
+
+	//*****************************************************************************************************************
+	// INonDelegatingUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+		if (SUCCEEDED(hr))
+		{
+			if (riid == __uuidof(IOmfMediaDataSamples))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataSamples*>(this));
+			}
+			else if (riid == __uuidof(IOmfMediaDataContainer))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataContainer*>(this));
+			}
+			else
+			{
+				hr = COmfMediaDataT<IOmfAifcData>::NonDelegatingQueryInterface(riid, ppvOut);
+			}
+		}
+		return hr;
+	}
 };
 
 //*********************************************************************************************************************
 //	Image Data Class (IDAT).
 //*********************************************************************************************************************
-class COmfIdatData : protected COmfMediaDataT<IOmfIdatData>
+typedef COmfMediaDataContainerT<COmfMediaDataFramesT<COmfMediaDataT<IOmfIdatData> > > COmfIdatDataBase;
+class COmfIdatData : protected COmfIdatDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfIdatData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfIdatData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfIdatDataBase(rBlop, pContainer, pParent, pNewReserved)
 	{
 	}
+
+	//*****************************************************************************************************************
+	// INonDelegatingUnknown
+	// An IDAT doesn't have a frame index, but uncompressed video has fixed-size frames, so we still expose
+	// IOmfMediaDataFrames and IOmfMediaDataContainer. Their methods fail if the payload isn't uncompressed video.
+	//*****************************************************************************************************************
+	STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+		if (SUCCEEDED(hr))
+		{
+			if (riid == __uuidof(IOmfMediaDataFrames))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataFrames*>(this));
+			}
+			else if (riid == __uuidof(IOmfMediaDataContainer))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataContainer*>(this));
+			}
+			else
+			{
+				hr = COmfMediaDataT<IOmfIdatData>::NonDelegatingQueryInterface(riid, ppvOut);
+			}
+		}
+		return hr;
+	}
 };
 
 //*********************************************************************************************************************
 //	JPEG Image Data Class (JPEG).
 //*********************************************************************************************************************
-class COmfJpegData : protected COmfMediaDataT<IOmfJpegData>
+typedef COmfMediaDataFramesT<COmfMediaDataT<IOmfJpegData> > COmfJpegDataBase;
+class COmfJpegData : protected COmfJpegDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfJpegData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfJpegData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfJpegDataBase(rBlop, pContainer, pParent, pNewReserved)
 	{
 	}
 
@@ -82,9 +139,14 @@ protected:
 				NonDelegatingAddRef();
 				*ppvOut = LPUNKNOWN(static_cast<IOmfJpegData*>(this));
 			}
+			else if (riid == __uuidof(IOmfMediaDataFrames))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataFrames*>(this));
+			}
 			else
 			{
-				hr = COmfObject::NonDelegatingQueryInterface(riid, ppvOut);
+				hr = COmfMediaDataT<IOmfJpegData>::NonDelegatingQueryInterface(riid, ppvOut);
 			}
 		}
 		return hr;
@@ -104,6 +166,8 @@ protected:
 	//*****************************************************************************************************************
 	// Retrieves the OMFI:JPEG:FrameIndexExt property as an array of UINT64s.
 	// The data type must be Position32Array or omfi:Position64Array or this will return OMF_E_TYPE_SURPRISE.
+	// If neither property is usable then we fall back to the frame map that the container synthesizes by scanning
+	// the payload for SOI markers. See CContainerLayer16::ScanJpegFrameMap().
 	//*****************************************************************************************************************
 	STDMETHODIMP ReadFrameIndexArray64(__in ULONG nMaxElements,
 										__out_opt PUINT64 pArrayBase,
@@ -114,6 +178,14 @@ protected:
 		{
 			hr = OrdReadPosition64Array(ePropJpegFrameIndex, nMaxElements, pArrayBase, pnActualElements);
 		}
+		if (FAILED(hr) && (hr != OMF_E_INSUFFICIENT_BUFFER))
+		{
+			HRESULT hrMap = m_pContainer->ReadMdatFrameOffsets(m_idx, nMaxElements, pArrayBase, pnActualElements);
+			if (SUCCEEDED(hrMap) || (hrMap == OMF_E_INSUFFICIENT_BUFFER))
+			{
+				hr = hrMap;
+			}
+		}
 		return hr;
 	}
 };
@@ -121,12 +193,13 @@ protected:
 //*********************************************************************************************************************
 //	MPEG Image Data Class (MPEG)
 //*********************************************************************************************************************
-class COmfMpegData : protected COmfMediaDataT<IOmfMpegData>
+typedef COmfMpegPictureIndexT<COmfMediaDataFramesT<COmfMediaDataT<IOmfMpegData> > > COmfMpegDataBase;
+class COmfMpegData : protected COmfMpegDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfMpegData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfMpegData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfMpegDataBase(rBlop, pContainer, pParent, pNewReserved)
 	{
 	}
 
@@ -145,9 +218,19 @@ protected:
 				NonDelegatingAddRef();
 				*ppvOut = LPUNKNOWN(static_cast<IOmfMpegData*>(this));
 			}
+			else if (riid == __uuidof(IOmfMediaDataFrames))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataFrames*>(this));
+			}
+			else if (riid == __uuidof(IOmfMpegPictureIndex))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMpegPictureIndex*>(this));
+			}
 			else
 			{
-				hr = COmfObject::NonDelegatingQueryInterface(riid, ppvOut);
+				hr = COmfMediaDataT<IOmfMpegData>::NonDelegatingQueryInterface(riid, ppvOut);
 			}
 		}
 		return hr;
@@ -184,12 +267,13 @@ protected:
 //*********************************************************************************************************************
 //	RLE Compressed Image Data (RLE ).
 //*********************************************************************************************************************
-class COmfRleiData : protected COmfMediaDataT<IOmfRleiData>
+typedef COmfMediaDataFramesT<COmfMediaDataT<IOmfRleiData> > COmfRleiDataBase;
+class COmfRleiData : protected COmfRleiDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfRleiData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfRleiData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfRleiDataBase(rBlop, pContainer, pParent, pNewReserved)
 	{
 	}
 
@@ -208,9 +292,14 @@ protected:
 				NonDelegatingAddRef();
 				*ppvOut = LPUNKNOWN(static_cast<IOmfRleiData*>(this));
 			}
+			else if (riid == __uuidof(IOmfMediaDataFrames))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataFrames*>(this));
+			}
 			else
 			{
-				hr = COmfObject::NonDelegatingQueryInterface(riid, ppvOut);
+				hr = COmfMediaDataT<IOmfRleiData>::NonDelegatingQueryInterface(riid, ppvOut);
 			}
 		}
 		return hr;
@@ -242,38 +331,119 @@ protected:
 //*********************************************************************************************************************
 //	Sound Designer II Audio Data (SD2M).
 //*********************************************************************************************************************
-class COmfSd2fData : protected COmfMediaDataT<IOmfSd2fData>
+typedef COmfMediaDataContainerT<COmfMediaDataSamplesT<COmfMediaDataT<IOmfSd2fData> > > COmfSd2fDataBase;
+class COmfSd2fData : protected COmfSd2fDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfSd2fData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfSd2fData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfSd2fDataBase(rBlop, pContainer, pParent, pNewReserved)
 	{
 	}
+
+	//*****************************************************************************************************************
+	// INonDelegatingUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+		if (SUCCEEDED(hr))
+		{
+			if (riid == __uuidof(IOmfMediaDataSamples))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataSamples*>(this));
+			}
+			else if (riid == __uuidof(IOmfMediaDataContainer))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataContainer*>(this));
+			}
+			else
+			{
+				hr = COmfMediaDataT<IOmfSd2fData>::NonDelegatingQueryInterface(riid, ppvOut);
+			}
+		}
+		return hr;
+	}
 };
 
 //*********************************************************************************************************************
 //	TIFF Image Data Class (TIFF).
 //*********************************************************************************************************************
-class COmfTiffData : protected COmfMediaDataT<IOmfTiffData>
+typedef COmfTiffImageIndexT<COmfMediaDataFramesT<COmfMediaDataT<IOmfTiffData> > > COmfTiffDataBase;
+class COmfTiffData : protected COmfTiffDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfTiffData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfTiffData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfTiffDataBase(rBlop, pContainer, pParent, pNewReserved)
 	{
 	}
+
+	//*****************************************************************************************************************
+	// INonDelegatingUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+		if (SUCCEEDED(hr))
+		{
+			if (riid == __uuidof(IOmfMediaDataFrames))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataFrames*>(this));
+			}
+			else if (riid == __uuidof(IOmfTiffImageIndex))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfTiffImageIndex*>(this));
+			}
+			else
+			{
+				hr = COmfMediaDataT<IOmfTiffData>::NonDelegatingQueryInterface(riid, ppvOut);
+			}
+		}
+		return hr;
+	}
 };
 
 //*********************************************************************************************************************
 //	WAVE Audio Data Class (WAVE).
 //*********************************************************************************************************************
-class COmfWaveData : protected COmfMediaDataT<IOmfWaveData>
+typedef COmfMediaDataContainerT<COmfMediaDataSamplesT<COmfMediaDataT<IOmfWaveData> > > COmfWaveDataBase;
+class COmfWaveData : protected COmfWaveDataBase
 {
 friend class CNewMdatFactory;
 protected:
 	COmfWaveData(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
-		: COmfMediaDataT<IOmfWaveData>(rBlop, pContainer, pParent, pNewReserved)
+		: COmfWaveDataBase(rBlop, pContainer, pParent, pNewReserved)
+	{
+	}
+
+	//*****************************************************************************************************************
+	// INonDelegatingUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, PVOID *ppvOut)
 	{
+		HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+		if (SUCCEEDED(hr))
+		{
+			if (riid == __uuidof(IOmfMediaDataSamples))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataSamples*>(this));
+			}
+			else if (riid == __uuidof(IOmfMediaDataContainer))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataContainer*>(this));
+			}
+			else
+			{
+				hr = COmfMediaDataT<IOmfWaveData>::NonDelegatingQueryInterface(riid, ppvOut);
+			}
+		}
+		return hr;
 	}
 };
@@ -8,10 +8,17 @@
 #pragma once
 
 //*********************************************************************************************************************
-//	Template class to implement the methods of IOmfMediaData.
+//	Template class to implement the methods of IOmfMediaData, IOmfMediaDataStreamer, and IOmfMediaDataRange.
+//	Every MDAT subclass exposes these. The interfaces that only some subclasses expose are implemented by the
+//	template classes that follow this one. Each of them is layered on top of this one (or on top of another one of
+//	them), so a subclass only carries the V-table pointers for the interfaces that it actually exposes.
 //*********************************************************************************************************************
 template <class TBase = IOmfMediaData>
-class __declspec(novtable) COmfMediaDataT : protected COmfObject, protected TBase
+class __declspec(novtable) COmfMediaDataT
+	: protected COmfObject
+	, protected IOmfMediaDataStreamer
+	, protected IOmfMediaDataRange
+	, protected TBase
 {
 protected:
 	ULONG	m_idx;			// our index in CContainerLayer10::m_aMdatTable[], or -1 if we are not a member.
@@ -50,6 +57,16 @@ protected:
 				NonDelegatingAddRef();
 				*ppvOut = LPUNKNOWN(static_cast<TBase*>(this));
 			}
+			else if (riid == __uuidof(IOmfMediaDataStreamer))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataStreamer*>(this));
+			}
+			else if (riid == __uuidof(IOmfMediaDataRange))
+			{
+				NonDelegatingAddRef();
+				*ppvOut = LPUNKNOWN(static_cast<IOmfMediaDataRange*>(this));
+			}
 			else
 			{
 				hr = COmfObject::NonDelegatingQueryInterface(riid, ppvOut);
@@ -168,4 +185,347 @@ protected:
 	{
 		return m_pContainer->ExtractMdatDataToFile(m_idx, pwzFullPathNewFile, pCallback, nPagesPerCallback, fOverwrite);
 	}
+
+	//*****************************************************************************************************************
+	// IOmfMediaDataStreamer
+	// Pushes the embedded media data to a caller-supplied sink in buffers of cbChunkSize bytes.
+	//*****************************************************************************************************************
+	STDMETHODIMP ExtractDataToSink(__in IOmfooExtractSink *pSink, __in_opt ULONG cbChunkSize)
+	{
+		return m_pContainer->ExtractMdatDataToSink(m_idx, pSink, cbChunkSize);
+	}
+
+	//*****************************************************************************************************************
+	// IOmfMediaDataRange
+	// Extracts/exports part of the embedded media data to an external file.
+	//*****************************************************************************************************************
+	STDMETHODIMP ExtractRangeToFile(__in UINT64 cbOffset,
+										__in UINT64 cbLength,
+											__in PCWSTR pwzFullPathNewFile,
+												__in_opt IOmfooExtractCallback *pCallback,
+													__in_opt ULONG nPagesPerCallback,
+														__in BOOL fOverwrite)
+	{
+		return m_pContainer->ExtractMdatRangeToFile(m_idx,
+													cbOffset,
+													cbLength,
+													pwzFullPathNewFile,
+													pCallback,
+													nPagesPerCallback,
+													fOverwrite);
+	}
+
+	//*****************************************************************************************************************
+	// Creates a Windows Stream object on part of the payload and queries it for the interface specified by riid.
+	//*****************************************************************************************************************
+	STDMETHODIMP CreateStreamOnDataRange(__in UINT64 cbOffset, __in UINT64 cbLength, __in REFIID riid, __out PVOID *ppvOut)
+	{
+		return m_pContainer->CreateStreamOnMdatRange(m_idx, cbOffset, cbLength, riid, ppvOut);
+	}
+};
+
+//*********************************************************************************************************************
+//	Template class to implement the methods of IOmfMediaDataFrames.
+//	Exposed by COmfIdatData, COmfJpegData, COmfMpegData, COmfRleiData, and COmfTiffData.
+//*********************************************************************************************************************
+template <class TMediaData>
+class __declspec(novtable) COmfMediaDataFramesT
+	: protected TMediaData
+	, protected IOmfMediaDataFrames
+{
+protected:
+	COmfMediaDataFramesT(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
+		: TMediaData(rBlop, pContainer, pParent, pNewReserved)
+	{
+	}
+
+	//*****************************************************************************************************************
+	// IUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP QueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		return NonDelegatingQueryInterface(riid, ppvOut);
+	}
+	STDMETHODIMP_(ULONG) AddRef()
+	{
+		return NonDelegatingAddRef();
+	}
+	STDMETHODIMP_(ULONG) Release()
+	{
+		return NonDelegatingRelease();
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the number of frames in the payload.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetFrameCount(__out PULONG pnFrames)
+	{
+		return m_pContainer->GetMdatFrameCount(m_idx, pnFrames);
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the position (relative to the start of the payload) and size of one frame.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetFrameExtent(__in ULONG iFrame, __out PUINT64 pcbOffset, __out PULONG pcbLength)
+	{
+		return m_pContainer->GetMdatFrameExtent(m_idx, iFrame, pcbOffset, pcbLength);
+	}
+
+	//*****************************************************************************************************************
+	// Reads one frame into caller's buffer.
+	//*****************************************************************************************************************
+	STDMETHODIMP ReadFrame(__in ULONG iFrame, __in ULONG cbBuffer, __out_opt PVOID pBuffer, __out PULONG pcbRequired)
+	{
+		return m_pContainer->ReadMdatFrames(m_idx, iFrame, 1, cbBuffer, pBuffer, NULL, pcbRequired);
+	}
+
+	//*****************************************************************************************************************
+	// Reads a run of consecutive frames into caller's buffer with one read.
+	//*****************************************************************************************************************
+	STDMETHODIMP ReadFrames(__in ULONG iFirstFrame,
+								__in ULONG nFrames,
+									__in ULONG cbBuffer,
+										__out_opt PVOID pBuffer,
+											__out_opt PULONG aFrameLengths,
+												__out PULONG pcbRequired)
+	{
+		return m_pContainer->ReadMdatFrames(m_idx, iFirstFrame, nFrames, cbBuffer, pBuffer, aFrameLengths, pcbRequired);
+	}
+};
+
+//*********************************************************************************************************************
+//	Template class to implement the methods of IOmfMpegPictureIndex.
+//	Only exposed by COmfMpegData.
+//*********************************************************************************************************************
+template <class TMediaData>
+class __declspec(novtable) COmfMpegPictureIndexT
+	: protected TMediaData
+	, protected IOmfMpegPictureIndex
+{
+protected:
+	COmfMpegPictureIndexT(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
+		: TMediaData(rBlop, pContainer, pParent, pNewReserved)
+	{
+	}
+
+	//*****************************************************************************************************************
+	// IUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP QueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		return NonDelegatingQueryInterface(riid, ppvOut);
+	}
+	STDMETHODIMP_(ULONG) AddRef()
+	{
+		return NonDelegatingAddRef();
+	}
+	STDMETHODIMP_(ULONG) Release()
+	{
+		return NonDelegatingRelease();
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the number of pictures in the payload.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetPictureCount(__out PULONG pnPictures)
+	{
+		return m_pContainer->GetMdatPictureCount(m_idx, pnPictures);
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the position, size, and type of one picture.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetPictureInfo(__in ULONG iPicture, __out POMFOO_MPEG_PICTURE_INFO pInfo)
+	{
+		return m_pContainer->GetMdatPictureInfo(m_idx, iPicture, pInfo);
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the number of GOPs in the payload.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetGopCount(__out PULONG pnGops)
+	{
+		return m_pContainer->GetMdatGopCount(m_idx, pnGops);
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the position and size of one GOP, and the sequence header that applies to it.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetGopInfo(__in ULONG iGop, __out POMFOO_MPEG_GOP_INFO pInfo)
+	{
+		return m_pContainer->GetMdatGopInfo(m_idx, iGop, pInfo);
+	}
+};
+
+//*********************************************************************************************************************
+//	Template class to implement the methods of IOmfTiffImageIndex.
+//	Only exposed by COmfTiffData.
+//*********************************************************************************************************************
+template <class TMediaData>
+class __declspec(novtable) COmfTiffImageIndexT
+	: protected TMediaData
+	, protected IOmfTiffImageIndex
+{
+protected:
+	COmfTiffImageIndexT(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
+		: TMediaData(rBlop, pContainer, pParent, pNewReserved)
+	{
+	}
+
+	//*****************************************************************************************************************
+	// IUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP QueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		return NonDelegatingQueryInterface(riid, ppvOut);
+	}
+	STDMETHODIMP_(ULONG) AddRef()
+	{
+		return NonDelegatingAddRef();
+	}
+	STDMETHODIMP_(ULONG) Release()
+	{
+		return NonDelegatingRelease();
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the number of images in the payload.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetImageCount(__out PULONG pnImages)
+	{
+		return m_pContainer->GetMdatTiffImageCount(m_idx, pnImages);
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the dimensions, format, and number of strips of one image.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetImageInfo(__in ULONG iImage, __out POMFOO_TIFF_IMAGE_INFO pInfo)
+	{
+		return m_pContainer->GetMdatTiffImageInfo(m_idx, iImage, pInfo);
+	}
+
+	//*****************************************************************************************************************
+	// Retrieves the position (relative to the start of the payload) and size of one strip of one image.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetStripExtent(__in ULONG iImage, __in ULONG iStrip, __out PUINT64 pcbOffset, __out PULONG pcbLength)
+	{
+		return m_pContainer->GetMdatTiffStripExtent(m_idx, iImage, iStrip, pcbOffset, pcbLength);
+	}
+
+	//*****************************************************************************************************************
+	// Reads a run of consecutive strips of one image into caller's buffer.
+	//*****************************************************************************************************************
+	STDMETHODIMP ReadStrips(__in ULONG iImage,
+								__in ULONG iFirstStrip,
+									__in ULONG nStrips,
+										__in ULONG cbBuffer,
+											__out_opt PVOID pBuffer,
+												__out_opt PULONG aStripLengths,
+													__out PULONG pcbRequired)
+	{
+		return m_pContainer->ReadMdatTiffStrips(m_idx, iImage, iFirstStrip, nStrips,
+													cbBuffer, pBuffer, aStripLengths, pcbRequired);
+	}
+};
+
+//*********************************************************************************************************************
+//	Template class to implement the methods of IOmfMediaDataSamples.
+//	Exposed by the audio subclasses (COmfAifcData, COmfSd2fData, and COmfWaveData).
+//*********************************************************************************************************************
+template <class TMediaData>
+class __declspec(novtable) COmfMediaDataSamplesT
+	: protected TMediaData
+	, protected IOmfMediaDataSamples
+{
+protected:
+	COmfMediaDataSamplesT(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
+		: TMediaData(rBlop, pContainer, pParent, pNewReserved)
+	{
+	}
+
+	//*****************************************************************************************************************
+	// IUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP QueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		return NonDelegatingQueryInterface(riid, ppvOut);
+	}
+	STDMETHODIMP_(ULONG) AddRef()
+	{
+		return NonDelegatingAddRef();
+	}
+	STDMETHODIMP_(ULONG) Release()
+	{
+		return NonDelegatingRelease();
+	}
+
+	//*****************************************************************************************************************
+	// Describes the stored PCM samples.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetSampleFormat(__out POMFOO_PCM_FORMAT pFormat)
+	{
+		return m_pContainer->GetMdatSampleFormat(m_idx, pFormat);
+	}
+
+	//*****************************************************************************************************************
+	// Reads a run of sample frames into caller's buffer, and converts them to dwFormat.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetSampleFrames(__in UINT64 iFirstFrame,
+									__in ULONG nFrames,
+										__in DWORD dwFormat,
+											__in ULONG cbBuffer,
+												__out_opt PVOID pBuffer,
+													__out PULONG pnFramesRead)
+	{
+		return m_pContainer->ReadMdatSampleFrames(m_idx, iFirstFrame, nFrames, dwFormat,
+													cbBuffer, pBuffer, pnFramesRead);
+	}
+};
+
+//*********************************************************************************************************************
+//	Template class to implement the methods of IOmfMediaDataContainer.
+//	Exposed by the audio subclasses and by COmfIdatData.
+//*********************************************************************************************************************
+template <class TMediaData>
+class __declspec(novtable) COmfMediaDataContainerT
+	: protected TMediaData
+	, protected IOmfMediaDataContainer
+{
+protected:
+	COmfMediaDataContainerT(BENTO_BLOP& rBlop, CContainerLayer97* pContainer, COmfObject* pParent, PVOID pNewReserved)
+		: TMediaData(rBlop, pContainer, pParent, pNewReserved)
+	{
+	}
+
+	//*****************************************************************************************************************
+	// IUnknown
+	//*****************************************************************************************************************
+	STDMETHODIMP QueryInterface(REFIID riid, PVOID *ppvOut)
+	{
+		return NonDelegatingQueryInterface(riid, ppvOut);
+	}
+	STDMETHODIMP_(ULONG) AddRef()
+	{
+		return NonDelegatingAddRef();
+	}
+	STDMETHODIMP_(ULONG) Release()
+	{
+		return NonDelegatingRelease();
+	}
+
+	//*****************************************************************************************************************
+	// Creates a stream on the payload wrapped in a synthesized WAVE, RF64, or AIFF header, or on its raw frames.
+	//*****************************************************************************************************************
+	STDMETHODIMP CreateStreamOnContainer(__in DWORD dwContainer, __in REFIID riid, __out PVOID *ppvOut)
+	{
+		return m_pContainer->CreateStreamOnMdatContainer(m_idx, dwContainer, riid, ppvOut);
+	}
+
+	//*****************************************************************************************************************
+	// Describes the raw frames as ffmpeg input options.
+	//*****************************************************************************************************************
+	STDMETHODIMP GetRawVideoSidecar(__in ULONG cchBuffer, __out_opt PWCHAR pBuffer, __out_opt PULONG pcchRequired)
+	{
+		return m_pContainer->GetMdatRawVideoSidecar(m_idx, cchBuffer, pBuffer, pcchRequired);
+	}
 };
@@ -23,7 +23,7 @@ COmfObject* COmfMobSlot::NewInstance(BENTO_BLOP& rBlop,
 													COmfObject* pParent,
 													PVOID pNewReserved)
 {
-	return new COmfMobSlot(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfMobSlot(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -105,6 +105,41 @@ private:
 
 		return hr;
 	}
+
+	//*****************************************************************************************************************
+	// Called from COmfooIterator::NextBatch().
+	HRESULT InternalNextBatch(REFIID riid, ULONG nMax, PVOID *ppvOut, ULONG& rnFetched)
+	{
+		HRESULT	hr			= S_OK;
+		ULONG	nFetched	= 0;
+
+		while ((nFetched < nMax) && (m_iPos < m_nElements))
+		{
+			hr = m_pContainer->Instantiate(m_pArray->a[m_iPos++], m_pParent, this, riid, &ppvOut[nFetched]);
+			if (SUCCEEDED(hr))
+			{
+				nFetched++;
+			}
+			else if (hr == OMF_E_NOINTERFACE)
+			{
+				// Same as Next(). Blow it off and move on.
+				hr = S_OK;
+			}
+			else
+			{
+				// Hard error. If we already have something to give back then back up one position so that the
+				// caller will see this error on the next call.
+				if (nFetched)
+				{
+					--m_iPos;
+				}
+				break;
+			}
+		}
+
+		rnFetched = nFetched;
+		return hr;
+	}
 };
 
 //*********************************************************************************************************************
@@ -195,6 +230,40 @@ private:
 
 		return hr;
 	}
+
+	//*****************************************************************************************************************
+	// Called from COmfooIterator::NextBatch().
+	HRESULT InternalNextBatch(REFIID riid, ULONG nMax, PVOID *ppvOut, ULONG& rnFetched)
+	{
+		HRESULT	hr			= S_OK;
+		ULONG	nFetched	= 0;
+
+		while ((nFetched < nMax) && (m_iPos < m_nElements))
+		{
+			hr = m_pContainer->Instantiate(m_pArray->a[m_iPos++].dwObject, m_pParent, this, riid, &ppvOut[nFetched]);
+			if (SUCCEEDED(hr))
+			{
+				nFetched++;
+			}
+			else if (hr == OMF_E_NOINTERFACE)
+			{
+				// Restore hr and loop again.
+				hr = S_OK;
+			}
+			else
+			{
+				// Hard error. Back up one position so the caller sees it on the next call.
+				if (nFetched)
+				{
+					--m_iPos;
+				}
+				break;
+			}
+		}
+
+		rnFetched = nFetched;
+		return hr;
+	}
 };
 
 //*********************************************************************************************************************
@@ -205,7 +274,7 @@ COmfObject* COmfObject::NewInstance(BENTO_BLOP& rBlop,
 										COmfObject* pParent,
 										PVOID pNewReserved)
 {
-	return new COmfObject(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfObject(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
@@ -246,6 +315,41 @@ COmfObject::~COmfObject(void)
 	// See COmfObject::NonDelegatingRelease().
 }
 
+//*********************************************************************************************************************
+//	Class-specific C++ operator new().
+//	Allocates our memory from our container's CSmallBlockHeap. The memory returned is always zeroed.
+//*********************************************************************************************************************
+PVOID COmfObject::operator new(size_t cb, CContainerLayer97* pContainer)
+{
+	return pContainer->m_oSmallBlockHeap.Alloc(cb);
+}
+
+//*********************************************************************************************************************
+//	Class-specific C++ operator new() for when we don't know the container.
+//	The memory returned is always zeroed.
+//*********************************************************************************************************************
+PVOID COmfObject::operator new(size_t cb)
+{
+	return CSmallBlockHeap::AllocUnowned(cb);
+}
+
+//*********************************************************************************************************************
+//	Class-specific C++ operator delete(). The compiler only calls this one if our constructor throws.
+//*********************************************************************************************************************
+void COmfObject::operator delete(PVOID pv, CContainerLayer97* /*pContainer*/)
+{
+	CSmallBlockHeap::Free(pv);
+}
+
+//*********************************************************************************************************************
+//	Class-specific C++ operator delete().
+//	The block knows which CSmallBlockHeap it came from (if any), so we don't need to.
+//*********************************************************************************************************************
+void COmfObject::operator delete(PVOID pv)
+{
+	CSmallBlockHeap::Free(pv);
+}
+
 //*********************************************************************************************************************
 //	INonDelegatingUnknown
 //*********************************************************************************************************************
@@ -353,7 +457,7 @@ HRESULT COmfObject::GetSelfCompareInfo(__out PSELF_COMPARE_INFO pInfo)
 //*********************************************************************************************************************
 //	Queries the object's Container for the interface specified by riid and returns it to the caller.
 //	Use this to get from an IOmfObject back to the IOmfooReader that owns it.
-//	Note that the current version of the Container only exposes IOmfooReader, but other interfaces may be added later.
+//	The Container exposes IOmfooReader, IOmfooFastReader, and IOmfooBulkExtractor.
 //*********************************************************************************************************************
 HRESULT COmfObject::GetContainer(__in REFIID riid, __out PVOID *ppvOut)
 {
@@ -905,7 +1009,7 @@ HRESULT COmfObject::IterateObjRefArray(__in LPCSTR pszPropertyName, __out IOmfoo
 	{
 		// CObjRefArray will free the array memory in its destructor.
 		const BOOL fFreeOnRelease = TRUE;
-		CObjRefArray* pObjRefArray = new CObjRefArray(this, pArray, fFreeOnRelease);
+		CObjRefArray* pObjRefArray = new (m_pContainer) CObjRefArray(this, pArray, fFreeOnRelease);
 		if (pObjRefArray)
 		{
 			*ppIterator = static_cast<IOmfooIterator*>(pObjRefArray);
@@ -941,7 +1045,7 @@ HRESULT COmfObject::IterateMobIndexArray(__in LPCSTR pszPropertyName, __out IOmf
 
 	// CMobIndexArray will free the array memory in its destructor.
 	const BOOL fFreeOnRelease = TRUE;
-	CMobIndexArray* pMobIndexArray = new CMobIndexArray(this, pArray, fFreeOnRelease);
+	CMobIndexArray* pMobIndexArray = new (m_pContainer) CMobIndexArray(this, pArray, fFreeOnRelease);
 	if (pMobIndexArray)
 	{
 		*ppIterator = static_cast<IOmfooIterator*>(pMobIndexArray);
@@ -957,6 +1061,15 @@ HRESULT COmfObject::IterateMobIndexArray(__in LPCSTR pszPropertyName, __out IOmf
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Batch version of ReadRawBytes(). Retrieves several properties from this object in one call.
+//	See CContainerLayer01::CoreReadProperties().
+//*********************************************************************************************************************
+HRESULT COmfObject::ReadProperties(__in ULONG nRequests, __inout POMFOO_PROPERTY_REQUEST aRequests)
+{
+	return m_pContainer->CoreReadProperties(*this, nRequests, aRequests);
+}
+
 //********************************************************************************************************************
 //	Protected helpers. These simply forward the call back to the container.
 //********************************************************************************************************************
@@ -1221,7 +1334,7 @@ HRESULT COmfObject::OrdIterateObjRefArray(PropOrdinal eProperty, IOmfooIterator
 	{
 		// CObjRefArray will free the array memory in its destructor.
 		const BOOL fFreeOnRelease = TRUE;
-		CObjRefArray* pObjRefArray = new CObjRefArray(this, pArray, fFreeOnRelease);
+		CObjRefArray* pObjRefArray = new (m_pContainer) CObjRefArray(this, pArray, fFreeOnRelease);
 		if (pObjRefArray)
 		{
 			*ppIterator = static_cast<IOmfooIterator*>(pObjRefArray);
@@ -1256,7 +1369,7 @@ HRESULT COmfObject::OrdIterateMobIndexArray(PropOrdinal eProperty, IOmfooIterato
 
 	// CMobIndexArray will free the array memory in its destructor.
 	const BOOL fFreeOnRelease = TRUE;
-	CMobIndexArray* pMobIndexArray = new CMobIndexArray(this, pArray, fFreeOnRelease);
+	CMobIndexArray* pMobIndexArray = new (m_pContainer) CMobIndexArray(this, pArray, fFreeOnRelease);
 	if (pMobIndexArray)
 	{
 		*ppIterator = static_cast<IOmfooIterator*>(pMobIndexArray);
@@ -1293,7 +1406,7 @@ HRESULT COmfObject::WrapObjRefArray(POMFOO_OBJREF_ARRAY pArray, IOmfooIterator *
 
 	// Tell CObjRefArray to NOT free the array in its destructor.
 	const BOOL fFreeOnRelease = FALSE;
-	CObjRefArray* pObjRefArray = new CObjRefArray(this, pArray, fFreeOnRelease);
+	CObjRefArray* pObjRefArray = new (m_pContainer) CObjRefArray(this, pArray, fFreeOnRelease);
 	if (NULL == pObjRefArray)
 	{
 		return E_OUTOFMEMORY;
@@ -1324,7 +1437,7 @@ HRESULT COmfObject::WrapMobIndexArray(POMFOO_MOB_INDEX_ARRAY pArray, IOmfooItera
 
 	// Tell CMobIndexArray to NOT free the OMF_MOB_INDEX_ARRAY memory in its destructor.
 	const BOOL fFreeOnRelease = FALSE;
-	CMobIndexArray* pMobIndexArray = new CMobIndexArray(this, pArray, fFreeOnRelease);
+	CMobIndexArray* pMobIndexArray = new (m_pContainer) CMobIndexArray(this, pArray, fFreeOnRelease);
 	if (NULL == pMobIndexArray)
 	{
 		return E_OUTOFMEMORY;
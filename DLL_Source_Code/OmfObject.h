@@ -70,6 +70,13 @@ protected:
 public:
     DECLARE_IUNKNOWN
 
+	// Class-specific C++ operators. Our wrappers are carved out of their container's CSmallBlockHeap.
+	// Use new (pContainer) CWhatever(...) whenever the container is known. See CSmallBlockHeap.
+	static PVOID	operator new(size_t cb, CContainerLayer97* pContainer);
+	static PVOID	operator new(size_t cb);
+	static void		operator delete(PVOID pv, CContainerLayer97* pContainer);
+	static void		operator delete(PVOID pv);
+
 private:
 	// IOobjBackDoor methods in V-table order.
 	STDMETHODIMP	GetSelfCompareInfo(__out PSELF_COMPARE_INFO pInfo);
@@ -159,6 +166,7 @@ protected:
 	STDMETHODIMP	InstantiateObjRef(__in LPCSTR pszPropertyName, __in REFIID riid, __out PVOID *ppvOut);
 	STDMETHODIMP	IterateObjRefArray(__in LPCSTR pszPropertyName, __out IOmfooIterator **ppIterator);
 	STDMETHODIMP	IterateMobIndexArray(__in LPCSTR pszPropertyName, __out IOmfooIterator **ppIterator);
+	STDMETHODIMP	ReadProperties(__in ULONG nRequests, __inout POMFOO_PROPERTY_REQUEST aRequests);
 
 //
 public:
@@ -22,7 +22,7 @@ COmfObject* COmfTrackDescription::NewInstance(BENTO_BLOP& rBlop,
 														COmfObject* pParent,
 														PVOID pNewReserved)
 {
-	return new COmfTrackDescription(rBlop, pContainer, pParent, pNewReserved);
+	return new (pContainer) COmfTrackDescription(rBlop, pContainer, pParent, pNewReserved);
 }
 
 //*********************************************************************************************************************
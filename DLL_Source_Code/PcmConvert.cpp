@@ -0,0 +1,568 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: PcmConvert.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "Omfoo_Alpha_Header.h"
+#include "PcmConvert.h"
+#include "DllMain.h"
+#include "CpuFeatures.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>		// SSE2
+#include <tmmintrin.h>		// SSSE3
+#include <immintrin.h>		// AVX
+#else
+#include <math.h>
+#endif
+
+// The starting points for a running minimum and a running maximum. Any real sample replaces them.
+#define PCM_PEAK_START_MIN	(3.402823466e+38f)
+#define PCM_PEAK_START_MAX	(-3.402823466e+38f)
+
+// Multiply a left-justified 32-bit sample by this to get a float in the range [-1.0, 1.0).
+#define PCM_INT32_TO_FLOAT	(1.0f / 2147483648.0f)
+
+// Multiply a float by this to get a left-justified 32-bit sample. The result must be clipped to this range.
+// (2147483520 is the largest float that is less than 2^31.)
+#define PCM_FLOAT_TO_INT32	(2147483648.0f)
+#define PCM_INT32_MIN_FLOAT	(-2147483648.0f)
+#define PCM_INT32_MAX_FLOAT	(2147483520.0f)
+
+//*********************************************************************************************************************
+//	Returns the number of bytes used to store each sample of the given PCM_SAMPLE_KIND, or zero if it's unknown.
+//*********************************************************************************************************************
+ULONG CPcmConvert::GetBytesPerSample(__in DWORD dwSampleKind)
+{
+	switch (dwSampleKind)
+	{
+	case PCM_KIND_U8:
+	case PCM_KIND_S8:
+		return 1;
+
+	case PCM_KIND_S16LE:
+	case PCM_KIND_S16BE:
+		return 2;
+
+	case PCM_KIND_S24LE:
+	case PCM_KIND_S24BE:
+		return 3;
+
+	case PCM_KIND_S32LE:
+	case PCM_KIND_S32BE:
+	case PCM_KIND_F32LE:
+	case PCM_KIND_F32BE:
+		return 4;
+
+	default:
+		return 0;
+	}
+}
+
+//*********************************************************************************************************************
+//	Returns the number of bytes in each converted sample of the given OMFOO_PCM_SAMPLE_FORMAT, or zero if it's unknown.
+//*********************************************************************************************************************
+ULONG CPcmConvert::GetBytesPerOutput(__in DWORD dwFormat)
+{
+	switch (dwFormat)
+	{
+	case PCM_FORMAT_INT16:
+		return sizeof(INT16);
+
+	case PCM_FORMAT_INT32:
+		return sizeof(INT32);
+
+	case PCM_FORMAT_FLOAT32:
+		return sizeof(FLOAT);
+
+	default:
+		return 0;
+	}
+}
+
+//*********************************************************************************************************************
+//	Converts nSamples stored samples of the given PCM_SAMPLE_KIND to nSamples samples of the given format.
+//	Our caller is responsible for validating dwSampleKind, dwFormat, and both buffers. The buffers must not overlap.
+//	There are no alignment requirements.
+//*********************************************************************************************************************
+void CPcmConvert::Convert(__in const BYTE* pSrc,
+							__in DWORD dwSampleKind,
+								__in SIZE_T nSamples,
+									__in DWORD dwFormat,
+										__out PVOID pDst)
+{
+	INT32	aInt32[PCM_BLOCK_SAMPLES];
+	FLOAT	aFloat[PCM_BLOCK_SAMPLES];
+	ULONG	cbSrcSample	= GetBytesPerSample(dwSampleKind);
+	ULONG	cbDstSample	= GetBytesPerOutput(dwFormat);
+	BOOL	fSrcFloat	= (dwSampleKind == PCM_KIND_F32LE) || (dwSampleKind == PCM_KIND_F32BE);
+	PBYTE	pOut		= PBYTE(pDst);
+
+	while (nSamples)
+	{
+		ULONG n = (nSamples > PCM_BLOCK_SAMPLES) ? ULONG(PCM_BLOCK_SAMPLES) : ULONG(nSamples);
+
+		if (fSrcFloat)
+		{
+			if (dwFormat == PCM_FORMAT_FLOAT32)
+			{
+				DecodeFloat(pSrc, dwSampleKind, n, PFLOAT(pOut));
+			}
+			else if (dwFormat == PCM_FORMAT_INT32)
+			{
+				DecodeFloat(pSrc, dwSampleKind, n, aFloat);
+				FloatToInt32(aFloat, n, PINT32(pOut));
+			}
+			else
+			{
+				DecodeFloat(pSrc, dwSampleKind, n, aFloat);
+				FloatToInt32(aFloat, n, aInt32);
+				Int32ToInt16(aInt32, n, PINT16(pOut));
+			}
+		}
+		else
+		{
+			if (dwFormat == PCM_FORMAT_INT32)
+			{
+				DecodeInt32(pSrc, dwSampleKind, n, PINT32(pOut));
+			}
+			else if (dwFormat == PCM_FORMAT_FLOAT32)
+			{
+				DecodeInt32(pSrc, dwSampleKind, n, aInt32);
+				Int32ToFloat(aInt32, n, PFLOAT(pOut));
+			}
+			else
+			{
+				DecodeInt32(pSrc, dwSampleKind, n, aInt32);
+				Int32ToInt16(aInt32, n, PINT16(pOut));
+			}
+		}
+
+		pSrc		+= n * cbSrcSample;
+		pOut		+= n * cbDstSample;
+		nSamples	-= n;
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper. Returns TRUE if the CPU supports SSSE3.
+//*********************************************************************************************************************
+BOOL CPcmConvert::HasSsse3(void)
+{
+	return CCpuFeatures::Has(CCpuFeatures::CPU_HAS_SSSE3);
+}
+
+//*********************************************************************************************************************
+//	Private helper. Returns TRUE if the CPU supports AVX, and the OS saves the upper halves of the YMM registers.
+//*********************************************************************************************************************
+BOOL CPcmConvert::HasAvx(void)
+{
+	return CCpuFeatures::Has(CCpuFeatures::CPU_HAS_AVX);
+}
+
+//*********************************************************************************************************************
+//	Private helper for Convert().
+//	Widens nSamples integer samples to left-justified 32-bit integers. In other words, the most significant bit of the
+//	stored sample becomes bit 31 of the result, and the unused low-order bits are zero.
+//
+//	The SSSE3 loops use one _mm_shuffle_epi8() per four output samples. Each lane of the shuffle mask picks the source
+//	bytes from least significant to most significant, and 0x80 makes a zero byte. The loops never read past the last
+//	source sample, so the 24-bit loop stops early and leaves the last few samples for the scalar loop.
+//*********************************************************************************************************************
+void CPcmConvert::DecodeInt32(__in const BYTE* pSrc, __in DWORD dwSampleKind, __in ULONG nSamples, __out PINT32 pDst)
+{
+	ULONG i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	if (HasSsse3())
+	{
+		switch (dwSampleKind)
+		{
+		case PCM_KIND_S16LE:
+		case PCM_KIND_S16BE:
+			{
+				__m128i	xLo = (dwSampleKind == PCM_KIND_S16LE)
+							? _mm_setr_epi8(-128,-128, 0, 1, -128,-128, 2, 3, -128,-128, 4, 5, -128,-128, 6, 7)
+							: _mm_setr_epi8(-128,-128, 1, 0, -128,-128, 3, 2, -128,-128, 5, 4, -128,-128, 7, 6);
+				__m128i	xHi = (dwSampleKind == PCM_KIND_S16LE)
+							? _mm_setr_epi8(-128,-128, 8, 9, -128,-128,10,11, -128,-128,12,13, -128,-128,14,15)
+							: _mm_setr_epi8(-128,-128, 9, 8, -128,-128,11,10, -128,-128,13,12, -128,-128,15,14);
+				for (; i + 8 <= nSamples; i += 8)
+				{
+					__m128i xSrc = _mm_loadu_si128((const __m128i*)(pSrc + (i * 2)));
+					_mm_storeu_si128((__m128i*)(pDst + i), _mm_shuffle_epi8(xSrc, xLo));
+					_mm_storeu_si128((__m128i*)(pDst + i + 4), _mm_shuffle_epi8(xSrc, xHi));
+				}
+			}
+			break;
+
+		case PCM_KIND_S24LE:
+		case PCM_KIND_S24BE:
+			{
+				// Each 16-byte load holds four 24-bit samples in its first 12 bytes.
+				__m128i	xMask = (dwSampleKind == PCM_KIND_S24LE)
+							? _mm_setr_epi8(-128, 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9,10,11)
+							: _mm_setr_epi8(-128, 2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128,11,10, 9);
+				for (; (i + 6) <= nSamples; i += 4)
+				{
+					__m128i xSrc = _mm_loadu_si128((const __m128i*)(pSrc + (i * 3)));
+					_mm_storeu_si128((__m128i*)(pDst + i), _mm_shuffle_epi8(xSrc, xMask));
+				}
+			}
+			break;
+
+		case PCM_KIND_S32BE:
+			{
+				__m128i	xMask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11,10, 9, 8, 15,14,13,12);
+				for (; i + 4 <= nSamples; i += 4)
+				{
+					__m128i xSrc = _mm_loadu_si128((const __m128i*)(pSrc + (i * 4)));
+					_mm_storeu_si128((__m128i*)(pDst + i), _mm_shuffle_epi8(xSrc, xMask));
+				}
+			}
+			break;
+		}
+	}
+#endif
+
+	// Plain C++ for whatever is left over.
+	switch (dwSampleKind)
+	{
+	case PCM_KIND_U8:
+		for (; i < nSamples; i++)
+		{
+			pDst[i] = INT32(UINT32(pSrc[i] ^ 0x80) << 24);
+		}
+		break;
+
+	case PCM_KIND_S8:
+		for (; i < nSamples; i++)
+		{
+			pDst[i] = INT32(UINT32(pSrc[i]) << 24);
+		}
+		break;
+
+	case PCM_KIND_S16LE:
+		for (; i < nSamples; i++)
+		{
+			const BYTE* p = pSrc + (i * 2);
+			pDst[i] = INT32((UINT32(p[0]) << 16) | (UINT32(p[1]) << 24));
+		}
+		break;
+
+	case PCM_KIND_S16BE:
+		for (; i < nSamples; i++)
+		{
+			const BYTE* p = pSrc + (i * 2);
+			pDst[i] = INT32((UINT32(p[1]) << 16) | (UINT32(p[0]) << 24));
+		}
+		break;
+
+	case PCM_KIND_S24LE:
+		for (; i < nSamples; i++)
+		{
+			const BYTE* p = pSrc + (i * 3);
+			pDst[i] = INT32((UINT32(p[0]) << 8) | (UINT32(p[1]) << 16) | (UINT32(p[2]) << 24));
+		}
+		break;
+
+	case PCM_KIND_S24BE:
+		for (; i < nSamples; i++)
+		{
+			const BYTE* p = pSrc + (i * 3);
+			pDst[i] = INT32((UINT32(p[2]) << 8) | (UINT32(p[1]) << 16) | (UINT32(p[0]) << 24));
+		}
+		break;
+
+	case PCM_KIND_S32LE:
+		if (i < nSamples)
+		{
+			CopyMemory(pDst + i, pSrc + (i * 4), (nSamples - i) * 4);
+		}
+		break;
+
+	case PCM_KIND_S32BE:
+		for (; i < nSamples; i++)
+		{
+			UINT32 dw;
+			CopyMemory(&dw, pSrc + (i * 4), 4);
+			pDst[i] = INT32(Endian32(dw));
+		}
+		break;
+
+	default:
+		BREAK_IF_DEBUG
+		ZeroMemory(pDst, nSamples * sizeof(INT32));
+		break;
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper for Convert().
+//	Copies nSamples 32-bit float samples to pDst, swapping their bytes if they are big-endian.
+//*********************************************************************************************************************
+void CPcmConvert::DecodeFloat(__in const BYTE* pSrc, __in DWORD dwSampleKind, __in ULONG nSamples, __out PFLOAT pDst)
+{
+	if (dwSampleKind == PCM_KIND_F32LE)
+	{
+		CopyMemory(pDst, pSrc, nSamples * 4);
+	}
+	else
+	{
+		// The bytes are the same as a PCM_KIND_S32BE sample, and so is the shuffle.
+		DecodeInt32(pSrc, PCM_KIND_S32BE, nSamples, PINT32(pDst));
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper for Convert().
+//	Narrows left-justified 32-bit samples to 16 bits by discarding the low-order bits.
+//*********************************************************************************************************************
+void CPcmConvert::Int32ToInt16(__in const INT32* pSrc, __in ULONG nSamples, __out PINT16 pDst)
+{
+	ULONG i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	for (; i + 8 <= nSamples; i += 8)
+	{
+		__m128i xLo = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)(pSrc + i)), 16);
+		__m128i xHi = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)(pSrc + i + 4)), 16);
+		_mm_storeu_si128((__m128i*)(pDst + i), _mm_packs_epi32(xLo, xHi));
+	}
+#endif
+
+	for (; i < nSamples; i++)
+	{
+		pDst[i] = INT16(pSrc[i] >> 16);
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper for Convert().
+//	Scales left-justified 32-bit samples to floats in the range [-1.0, 1.0).
+//*********************************************************************************************************************
+void CPcmConvert::Int32ToFloat(__in const INT32* pSrc, __in ULONG nSamples, __out PFLOAT pDst)
+{
+	ULONG i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	__m128 xScale = _mm_set1_ps(PCM_INT32_TO_FLOAT);
+	for (; i + 4 <= nSamples; i += 4)
+	{
+		__m128 xFloat = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(pSrc + i)));
+		_mm_storeu_ps(pDst + i, _mm_mul_ps(xFloat, xScale));
+	}
+#endif
+
+	for (; i < nSamples; i++)
+	{
+		pDst[i] = FLOAT(pSrc[i]) * PCM_INT32_TO_FLOAT;
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper for Convert().
+//	Scales float samples to left-justified 32-bit samples. Values outside of [-1.0, 1.0) are clipped, and so are NaNs.
+//	Both loops truncate toward zero, so they always agree with each other.
+//*********************************************************************************************************************
+void CPcmConvert::FloatToInt32(__in const FLOAT* pSrc, __in ULONG nSamples, __out PINT32 pDst)
+{
+	ULONG i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	__m128	xScale	= _mm_set1_ps(PCM_FLOAT_TO_INT32);
+	__m128	xMin	= _mm_set1_ps(PCM_INT32_MIN_FLOAT);
+	__m128	xMax	= _mm_set1_ps(PCM_INT32_MAX_FLOAT);
+	for (; i + 4 <= nSamples; i += 4)
+	{
+		// If either operand of _mm_min_ps() is a NaN then it returns the second operand. So NaNs become xMax.
+		__m128 xFloat = _mm_mul_ps(_mm_loadu_ps(pSrc + i), xScale);
+		xFloat = _mm_max_ps(_mm_min_ps(xFloat, xMax), xMin);
+		_mm_storeu_si128((__m128i*)(pDst + i), _mm_cvttps_epi32(xFloat));
+	}
+#endif
+
+	for (; i < nSamples; i++)
+	{
+		FLOAT f = pSrc[i] * PCM_FLOAT_TO_INT32;
+		if (!(f < PCM_INT32_MAX_FLOAT))
+		{
+			f = PCM_INT32_MAX_FLOAT;
+		}
+		else if (f < PCM_INT32_MIN_FLOAT)
+		{
+			f = PCM_INT32_MIN_FLOAT;
+		}
+		pDst[i] = INT32(f);
+	}
+}
+
+//*********************************************************************************************************************
+//	Folds nFrames interleaved float sample frames into running per-channel peaks: the smallest sample goes in aMin[],
+//	the largest sample goes in aMax[], and the sum of the squares is added to aSumSq[]. Each array has nChannels
+//	elements. Start with ResetPeaks(), and call this as many times as you like before FinishPeaks().
+//
+//	When nChannels divides the width of a vector then each lane of the vector always holds the same channel. So the
+//	vector loops keep a min, a max, and a sum of squares in every lane, and they fold the lanes into their channels at
+//	the end of each block. AVX does eight samples at a time and SSE2 does four. Everything else goes through the scalar
+//	loop. The lane sums are floats, so we fold them every PEAK_BLOCK_SAMPLES samples before they lose any precision.
+//	NaNs are ignored by the min and max (because _mm_min_ps() returns its second operand) but not by the sums.
+//*********************************************************************************************************************
+void CPcmConvert::AccumulatePeaks(__in const FLOAT* pSrc,
+									__in ULONG nFrames,
+										__in ULONG nChannels,
+											__inout PFLOAT aMin,
+												__inout PFLOAT aMax,
+													__inout PDOUBLE aSumSq)
+{
+	SIZE_T	nSamples	= SIZE_T(nFrames) * nChannels;
+	SIZE_T	i			= 0;
+	ULONG	iChannel	= 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	FLOAT	aLaneMin[8];
+	FLOAT	aLaneMax[8];
+	FLOAT	aLaneSum[8];
+
+	if ((0 == (8 % nChannels)) && HasAvx())
+	{
+		while (nSamples - i >= 8)
+		{
+			SIZE_T	nBlock	= (nSamples - i) & ~SIZE_T(7);
+			__m256	yMin	= _mm256_set1_ps(PCM_PEAK_START_MIN);
+			__m256	yMax	= _mm256_set1_ps(PCM_PEAK_START_MAX);
+			__m256	ySum	= _mm256_setzero_ps();
+
+			if (nBlock > PEAK_BLOCK_SAMPLES)
+			{
+				nBlock = PEAK_BLOCK_SAMPLES;
+			}
+
+			for (SIZE_T j = 0; j < nBlock; j += 8)
+			{
+				__m256 ySrc = _mm256_loadu_ps(pSrc + i + j);
+				yMin = _mm256_min_ps(ySrc, yMin);
+				yMax = _mm256_max_ps(ySrc, yMax);
+				ySum = _mm256_add_ps(ySum, _mm256_mul_ps(ySrc, ySrc));
+			}
+
+			_mm256_storeu_ps(aLaneMin, yMin);
+			_mm256_storeu_ps(aLaneMax, yMax);
+			_mm256_storeu_ps(aLaneSum, ySum);
+
+			for (ULONG k = 0; k < 8; k++)
+			{
+				ULONG c = k % nChannels;
+				aMin[c]		= (aLaneMin[k] < aMin[c]) ? aLaneMin[k] : aMin[c];
+				aMax[c]		= (aLaneMax[k] > aMax[c]) ? aLaneMax[k] : aMax[c];
+				aSumSq[c]	+= aLaneSum[k];
+			}
+
+			i += nBlock;
+		}
+
+		// Avoid the penalty for mixing AVX code with the SSE code that our caller is probably running.
+		_mm256_zeroupper();
+	}
+	else if (0 == (4 % nChannels))
+	{
+		while (nSamples - i >= 4)
+		{
+			SIZE_T	nBlock	= (nSamples - i) & ~SIZE_T(3);
+			__m128	xMin	= _mm_set1_ps(PCM_PEAK_START_MIN);
+			__m128	xMax	= _mm_set1_ps(PCM_PEAK_START_MAX);
+			__m128	xSum	= _mm_setzero_ps();
+
+			if (nBlock > PEAK_BLOCK_SAMPLES)
+			{
+				nBlock = PEAK_BLOCK_SAMPLES;
+			}
+
+			for (SIZE_T j = 0; j < nBlock; j += 4)
+			{
+				__m128 xSrc = _mm_loadu_ps(pSrc + i + j);
+				xMin = _mm_min_ps(xSrc, xMin);
+				xMax = _mm_max_ps(xSrc, xMax);
+				xSum = _mm_add_ps(xSum, _mm_mul_ps(xSrc, xSrc));
+			}
+
+			_mm_storeu_ps(aLaneMin, xMin);
+			_mm_storeu_ps(aLaneMax, xMax);
+			_mm_storeu_ps(aLaneSum, xSum);
+
+			for (ULONG k = 0; k < 4; k++)
+			{
+				ULONG c = k % nChannels;
+				aMin[c]		= (aLaneMin[k] < aMin[c]) ? aLaneMin[k] : aMin[c];
+				aMax[c]		= (aLaneMax[k] > aMax[c]) ? aLaneMax[k] : aMax[c];
+				aSumSq[c]	+= aLaneSum[k];
+			}
+
+			i += nBlock;
+		}
+	}
+#endif
+
+	// The vector loops always stop on a frame boundary, so the leftovers begin with channel zero.
+	for (; i < nSamples; i++)
+	{
+		FLOAT f = pSrc[i];
+		if (f < aMin[iChannel])
+		{
+			aMin[iChannel] = f;
+		}
+		if (f > aMax[iChannel])
+		{
+			aMax[iChannel] = f;
+		}
+		aSumSq[iChannel] += DOUBLE(f) * f;
+
+		if (++iChannel == nChannels)
+		{
+			iChannel = 0;
+		}
+	}
+}
+
+//*********************************************************************************************************************
+//	Turns the running peaks from AccumulatePeaks() into nChannels OMFOO_WAVEFORM_PEAKs, and then resets them for the
+//	next block. nFrames is the number of sample frames that went into them. It must not be zero.
+//*********************************************************************************************************************
+void CPcmConvert::FinishPeaks(__in ULONG nFrames,
+								__in ULONG nChannels,
+									__inout PFLOAT aMin,
+										__inout PFLOAT aMax,
+											__inout PDOUBLE aSumSq,
+												__out POMFOO_WAVEFORM_PEAK pDst)
+{
+	for (ULONG c = 0; c < nChannels; c++)
+	{
+		DOUBLE dMeanSquare = aSumSq[c] / nFrames;
+
+		pDst[c].fMin	= aMin[c];
+		pDst[c].fMax	= aMax[c];
+#if defined(_M_IX86) || defined(_M_X64)
+		pDst[c].fRms	= FLOAT(_mm_cvtsd_f64(_mm_sqrt_sd(_mm_setzero_pd(), _mm_set_sd(dMeanSquare))));
+#else
+		pDst[c].fRms	= FLOAT(sqrt(dMeanSquare));
+#endif
+	}
+
+	ResetPeaks(nChannels, aMin, aMax, aSumSq);
+}
+
+//*********************************************************************************************************************
+//	Prepares nChannels running peaks for AccumulatePeaks().
+//*********************************************************************************************************************
+void CPcmConvert::ResetPeaks(__in ULONG nChannels, __out PFLOAT aMin, __out PFLOAT aMax, __out PDOUBLE aSumSq)
+{
+	for (ULONG c = 0; c < nChannels; c++)
+	{
+		aMin[c]		= PCM_PEAK_START_MIN;
+		aMax[c]		= PCM_PEAK_START_MAX;
+		aSumSq[c]	= 0.0;
+	}
+}
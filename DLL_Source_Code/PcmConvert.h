@@ -0,0 +1,80 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: PcmConvert.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+
+//	Enumerated values that describe how each sample is stored in an audio payload.
+enum PCM_SAMPLE_KIND {
+	PCM_KIND_UNKNOWN	= 0,
+	PCM_KIND_U8			= 1,		// 8-bit unsigned, offset by 128. (WAVE)
+	PCM_KIND_S8			= 2,		// 8-bit two's complement. (AIFF, SD2)
+	PCM_KIND_S16LE		= 3,		// 16-bit two's complement, least significant byte first.
+	PCM_KIND_S16BE		= 4,		// 16-bit two's complement, most significant byte first.
+	PCM_KIND_S24LE		= 5,		// 24-bit two's complement packed into 3 bytes, least significant byte first.
+	PCM_KIND_S24BE		= 6,		// 24-bit two's complement packed into 3 bytes, most significant byte first.
+	PCM_KIND_S32LE		= 7,		// 32-bit two's complement, least significant byte first.
+	PCM_KIND_S32BE		= 8,		// 32-bit two's complement, most significant byte first.
+	PCM_KIND_F32LE		= 9,		// 32-bit IEEE float, least significant byte first.
+	PCM_KIND_F32BE		= 10,		// 32-bit IEEE float, most significant byte first.
+};
+
+//*********************************************************************************************************************
+//	CPcmConvert.
+//	Static routines that convert stored PCM samples to one of the OMFOO_PCM_SAMPLE_FORMAT types.
+//
+//	Integer samples are first widened to left-justified 32-bit integers. That's one SSSE3 byte shuffle for every
+//	source kind, because a shuffle can swap the bytes and move them to the top of each 32-bit lane at the same time.
+//	Then they are narrowed to 16 bits, or scaled to floats in the range [-1.0, 1.0). Float samples go the other way.
+//	Samples are converted in blocks of PCM_BLOCK_SAMPLES, so the intermediate values never leave the stack.
+//
+//	If the CPU doesn't have SSSE3 then we use plain C++ for the first step. The other steps only need SSE2, which is
+//	always available on x64, and we require it on x86.
+//
+//	AccumulatePeaks() and FinishPeaks() summarize float samples for waveform overviews. They use AVX when the CPU and
+//	the OS both support it, and SSE2 when they don't.
+//*********************************************************************************************************************
+class CPcmConvert
+{
+public:
+	enum {
+		PCM_BLOCK_SAMPLES	= 256,		// number of samples per trip through our intermediate buffers.
+		PEAK_BLOCK_SAMPLES	= 4096,		// number of samples that AccumulatePeaks() sums in floats before using doubles.
+	};
+
+	static ULONG	GetBytesPerSample(__in DWORD dwSampleKind);
+	static ULONG	GetBytesPerOutput(__in DWORD dwFormat);
+	static void		Convert(__in const BYTE* pSrc,
+								__in DWORD dwSampleKind,
+									__in SIZE_T nSamples,
+										__in DWORD dwFormat,
+											__out PVOID pDst);
+
+	static void		AccumulatePeaks(__in const FLOAT* pSrc,
+										__in ULONG nFrames,
+											__in ULONG nChannels,
+												__inout PFLOAT aMin,
+													__inout PFLOAT aMax,
+														__inout PDOUBLE aSumSq);
+
+	static void		FinishPeaks(__in ULONG nFrames,
+									__in ULONG nChannels,
+										__inout PFLOAT aMin,
+											__inout PFLOAT aMax,
+												__inout PDOUBLE aSumSq,
+													__out POMFOO_WAVEFORM_PEAK pDst);
+
+	static void		ResetPeaks(__in ULONG nChannels, __out PFLOAT aMin, __out PFLOAT aMax, __out PDOUBLE aSumSq);
+
+private:
+	static BOOL		HasSsse3(void);
+	static BOOL		HasAvx(void);
+	static void		DecodeInt32(__in const BYTE* pSrc, __in DWORD dwSampleKind, __in ULONG nSamples, __out PINT32 pDst);
+	static void		DecodeFloat(__in const BYTE* pSrc, __in DWORD dwSampleKind, __in ULONG nSamples, __out PFLOAT pDst);
+	static void		Int32ToInt16(__in const INT32* pSrc, __in ULONG nSamples, __out PINT16 pDst);
+	static void		Int32ToFloat(__in const INT32* pSrc, __in ULONG nSamples, __out PFLOAT pDst);
+	static void		FloatToInt32(__in const FLOAT* pSrc, __in ULONG nSamples, __out PINT32 pDst);
+};
@@ -1870,6 +1870,19 @@ HRESULT CReadBento::ReadItemBytes(__in ULONG iToc, __in ULONG cbBuffer, __out PV
 		return S_OK;
 	}
 
+	// Was it preloaded into the TOC by CContainerLayer00::PreloadSmallPayloads()?
+	if (m_aToc[iToc].bStorageMode == SM_PRELOADED)
+	{
+		if (m_aToc[iToc].cbLength64 > sizeof(m_aToc[iToc].aPreloadedBytes))
+		{
+			return OMF_E_STORAGE_SURPRISE;
+		}
+
+		// Copy it from RAM.
+		CopyMemory(pBuffer, &m_aToc[iToc].aPreloadedBytes, cbBuffer);
+		return S_OK;
+	}
+
 	if (m_aToc[iToc].bStorageMode == SM_OFFSET)
 	{
 		// Read it from disk.
@@ -158,6 +158,9 @@ enum
 	SM_CACHED		= 4, // The payload has been read/copied/retrieved from its original location, and is now cached.
 						 // The technique used to cache it depends on the TOCX_ITEM's OMF data type.
 						 // It is beyond the scope of CReadBento. Suffice to say it will make use ob the 
+	SM_PRELOADED	= 5, // The payload was SM_OFFSET, but it is eight bytes or less so we copied it into aPreloadedBytes[].
+						 // Unlike SM_CACHED the bytes are exactly as they were in the file (i.e. not byte-swapped),
+						 // and cbLength64 is still valid. So it can be read just like SM_IMMEDIATE.
 };
 };	// NsBentoTocStorageModes
 
@@ -289,10 +292,14 @@ typedef struct
 					UINT32	cbOffsetLo;		// lower 32 bits of cbOffset64
 					UINT32	cbOffsetHi;		// upper 32 bits of cbOffset64
 				};// struct
+
+				// When bStorageMode is SM_PRELOADED the payload has been copied from the file into this eight-byte area.
+				// It replaces cbOffset64, so we can no longer read the payload from the file. But we don't need to.
+				BYTE	aPreloadedBytes[8];
 			};// union
 
 			// This is the length of the payload including zero.
-			// It is valid with SM_REFLISTID, SM_IMMEDIATE, and SM_OFFSET.
+			// It is valid with SM_REFLISTID, SM_IMMEDIATE, SM_OFFSET, and SM_PRELOADED.
 			// However it is NOT valid when bStorageMode is SM_CACHED!
 			// Note that when bStorageMode is SM_IMMEDIATE this value can never be greater than four.
 			// Also note that Bento v1.0d4 doesn't support payloads larger than 2^32, however v1.0d5 does.
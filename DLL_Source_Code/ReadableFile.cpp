@@ -148,6 +148,74 @@ L_Exit:
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Public.
+//	Same as OpenReadableFile(), except that we open the same file that rSource has already opened - without going
+//	back to the file system. Our handle is a duplicate of rSource's handle, so they both refer to the same open file
+//	object. That's safe because SeekRead() always passes an explicit position and never uses the file pointer.
+//	We also inherit rSource's nested region. Like OpenReadableFile() this can only be called once per instance.
+//*********************************************************************************************************************
+HRESULT CReadableFile::ShareReadableFile(__in CReadableFile& rSource)
+{
+	ULONG	cbFullPath	= 0;
+	HRESULT	hr			= S_OK;
+
+	// Have we been here before? See OpenReadableFile().
+	if (m_hFileRead)
+	{
+		hr = E_ACCESSDENIED;
+		goto L_Exit;
+	}
+
+	// Temporarily invalidate m_hFileRead while we copy the filename.
+	m_hFileRead = INVALID_HANDLE_VALUE;
+
+	// Does rSource have a file to share?
+	if (IsBadHandle(rSource.m_hFileRead) || (NULL == rSource.m_pwzFullPath))
+	{
+		hr = E_HANDLE;
+		goto L_Exit;
+	}
+
+	// Copy the full path.
+	cbFullPath		= (lstrlenW(rSource.m_pwzFullPath) + 1) * sizeof(WCHAR);
+	m_pwzFullPath	= LPWSTR(MemAlloc(cbFullPath));
+	if (m_pwzFullPath == NULL)
+	{
+		hr = E_OUTOFMEMORY;
+		goto L_Exit;
+	}
+	CopyMemory(m_pwzFullPath, rSource.m_pwzFullPath, cbFullPath);
+
+	// Duplicate the handle. This is much cheaper than calling CreateFileW() again.
+	if (!DuplicateHandle(GetCurrentProcess(),
+							rSource.m_hFileRead,
+							GetCurrentProcess(),
+							&m_hFileRead,
+							0,
+							FALSE,
+							DUPLICATE_SAME_ACCESS))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		m_hFileRead = INVALID_HANDLE_VALUE;
+		goto L_Exit;
+	}
+
+	// Copy everything else.
+	m_cbPhysicalEndOfFile64		= rSource.m_cbPhysicalEndOfFile64;
+	m_cbVirtualStartOfFile64	= rSource.m_cbVirtualStartOfFile64;
+	m_cbVirtualEndOfFile64		= rSource.m_cbVirtualEndOfFile64;
+	m_qwFileCreationTime		= rSource.m_qwFileCreationTime;
+	m_qwFileLastAccessTime		= rSource.m_qwFileLastAccessTime;
+	m_qwFileLastWriteTime		= rSource.m_qwFileLastWriteTime;
+	m_dwFileIndexHigh			= rSource.m_dwFileIndexHigh;
+	m_dwFileIndexLow			= rSource.m_dwFileIndexLow;
+	m_dwVolumeSerialNumber		= rSource.m_dwVolumeSerialNumber;
+
+L_Exit:
+	return hr;
+}
+
 //*********************************************************************************************************************
 //	The seek position argument for SeekRead() is a virtual file positiom (not necessarily a physical file position).
 //	This allows this class to read nested files (a file within a file).
@@ -277,6 +345,54 @@ HRESULT CReadableFile::GetBytesPerSector(__in PCWSTR pwzPath, __out PUINT32 pcbB
 	return hr;
 }
 
+//*********************************************************************************************************************
+//	Public.
+//	Same as GetBytesPerSector() but it retrieves the cluster size (the allocation unit) instead.
+//*********************************************************************************************************************
+HRESULT CReadableFile::GetBytesPerCluster(__in PCWSTR pwzPath, __out PUINT32 pcbBytesPerCluster)
+{
+	HRESULT hr = E_FAIL;
+
+	// Validate caller's buffer pointer.
+	if (IsBadWritePointer(pcbBytesPerCluster, sizeof(UINT32)))
+	{
+		hr = E_POINTER;
+	}
+	else
+	{
+		*pcbBytesPerCluster = 0;
+
+		// Isolate the root information.
+		PCWSTR pwzAfterRoot = PathSkipRootW(pwzPath);
+		if (pwzAfterRoot > pwzPath)
+		{
+			ULONG cchRoot = 1+((ULONG(UINT_PTR(pwzAfterRoot)-UINT_PTR(pwzPath)))/sizeof(WCHAR));
+			if (cchRoot < 64)
+			{
+				WCHAR	wzPathRoot[64]		= {0};
+				DWORD	dwSectorsPerCluster	= 0;
+				DWORD	cbBytesPerSector	= 0;
+				lstrcpynW(wzPathRoot, pwzPath, cchRoot);
+				if (GetDiskFreeSpaceW(wzPathRoot,
+										&dwSectorsPerCluster,
+										&cbBytesPerSector,
+										LPDWORD(NULL),
+										LPDWORD(NULL)))
+				{
+					*pcbBytesPerCluster = dwSectorsPerCluster * cbBytesPerSector;
+					hr = S_OK;
+				}
+				else
+				{
+					hr = HRESULT_FROM_WIN32(GetLastError());
+				}
+			}
+		}
+	}
+
+	return hr;
+}
+
 //*********************************************************************************************************************
 //	Public.
 //*********************************************************************************************************************
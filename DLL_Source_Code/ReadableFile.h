@@ -29,10 +29,12 @@ protected:
 
 public:
 	HRESULT	OpenReadableFile(__in PCWSTR pwzFileName);
+	HRESULT	ShareReadableFile(__in CReadableFile& rSource);
 	HRESULT	SetRegion(__in UINT64 cbOffset, __in UINT64 cbLength);
 	HRESULT	SeekRead(__in UINT64 cbSeekPos, __out PVOID pDest, __in UINT32 cbRequest);
 
 	static HRESULT GetBytesPerSector(__in PCWSTR pwzPath, __out PUINT32 pcbBytesPerSector);
+	static HRESULT GetBytesPerCluster(__in PCWSTR pwzPath, __out PUINT32 pcbBytesPerCluster);
 	static HRESULT GetBytesAvailable(__in PCWSTR pwzPath, __out PUINT64 pcbBytesAvailable);
 
 protected:
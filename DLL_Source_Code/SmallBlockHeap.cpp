@@ -0,0 +1,274 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: SmallBlockHeap.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include "SmallBlockHeap.h"
+#include "DllMain.h"
+
+//*********************************************************************************************************************
+//	Constructor
+//	WARNING: This class is not meant to be instantiated on the stack.
+//	It assumes that the memory it lives in has already been zeroed.
+//*********************************************************************************************************************
+CSmallBlockHeap::CSmallBlockHeap(void)
+{
+	for (ULONG i = 0; i < SBH_STRIPES; i++)
+	{
+		for (ULONG j = 0; j < SBH_SIZE_CLASSES; j++)
+		{
+			InitializeSListHead(&m_aStripes[i].aFreeLists[j]);
+		}
+	}
+
+	InitializeSListHead(&m_oSlabList);
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//	All of our blocks live inside our slabs, so we don't need to walk the free lists. We just free the slabs.
+//*********************************************************************************************************************
+CSmallBlockHeap::~CSmallBlockHeap(void)
+{
+	// Every block that came from Alloc() should have been returned by now.
+	// If this fires then something in this container leaked a wrapper, an iterator, or an array.
+	ASSERT(0 == GetOutstandingBlocks());
+
+	PSLIST_ENTRY pSlab = NULL;
+	while (NULL != (pSlab = InterlockedPopEntrySList(&m_oSlabList)))
+	{
+		MemFree(pSlab);
+		--m_cSlabs;
+	}
+
+	ASSERT(0 == m_cSlabs);
+}
+
+//*********************************************************************************************************************
+//	Allocate a zeroed block of at least cb bytes. Returns NULL if we're out of memory.
+//	Use Free() to give it back.
+//*********************************************************************************************************************
+PVOID CSmallBlockHeap::Alloc(SIZE_T cb)
+{
+	PSBH_STRIPE			pStripe		= GetStripe();
+	PSBH_BLOCK_HEADER	pHeader		= NULL;
+	SIZE_T				cbTotal		= cb + SBH_HEADER_SIZE;
+	SIZE_T				cbBlock		= SBH_SMALLEST_BLOCK;
+	ULONG				iSizeClass	= 0;
+
+	// Find the smallest size class that can hold caller's request plus our header.
+	while (cbBlock < cbTotal)
+	{
+		cbBlock <<= 1;
+		if (++iSizeClass == SBH_SIZE_CLASSES)
+		{
+			break;
+		}
+	}
+
+	if (iSizeClass == SBH_SIZE_CLASSES)
+	{
+		// Too big for our slabs.
+		if (cbTotal > ULONG_MAX)
+		{
+			return NULL;
+		}
+
+		pHeader = PSBH_BLOCK_HEADER(MemAlloc(ULONG(cbTotal)));
+		if (NULL == pHeader)
+		{
+			return NULL;
+		}
+		pHeader->wSizeClass	= SBH_LARGE_CLASS;
+	}
+	else
+	{
+		// Pop a free block off of this thread's stripe, or carve up a new slab if the stripe is empty.
+		pHeader = PSBH_BLOCK_HEADER(InterlockedPopEntrySList(&pStripe->aFreeLists[iSizeClass]));
+		if (NULL == pHeader)
+		{
+			pHeader = PSBH_BLOCK_HEADER(CarveSlab(pStripe, iSizeClass));
+			if (NULL == pHeader)
+			{
+				return NULL;
+			}
+		}
+
+		// Recycled blocks are dirty, so wipe the whole thing - header and all.
+		ZeroMemory(pHeader, cbBlock);
+		pHeader->wSizeClass	= WORD(iSizeClass);
+	}
+
+	pHeader->pOwner			= this;
+	pHeader->dwSignature	= SBH_SIGNATURE;
+
+	// Increment the counter for this stripe (used for debugging and leak detection).
+	InterlockedIncrement(&pStripe->cOutstanding);
+
+	return PBYTE(pHeader) + SBH_HEADER_SIZE;
+}
+
+//*********************************************************************************************************************
+//	Allocate a zeroed block that does not belong to any CSmallBlockHeap.
+//	This is for objects that are created before we know which container they belong to.
+//	The block has the same header as all of our other blocks, so Free() can still handle it.
+//*********************************************************************************************************************
+PVOID CSmallBlockHeap::AllocUnowned(SIZE_T cb)
+{
+	SIZE_T cbTotal = cb + SBH_HEADER_SIZE;
+	if (cbTotal > ULONG_MAX)
+	{
+		return NULL;
+	}
+
+	PSBH_BLOCK_HEADER pHeader = PSBH_BLOCK_HEADER(MemAlloc(ULONG(cbTotal)));
+	if (NULL == pHeader)
+	{
+		return NULL;
+	}
+
+	pHeader->wSizeClass		= SBH_LARGE_CLASS;
+	pHeader->dwSignature	= SBH_SIGNATURE;
+
+	return PBYTE(pHeader) + SBH_HEADER_SIZE;
+}
+
+//*********************************************************************************************************************
+//	Free a block that was allocated with Alloc() or AllocUnowned().
+//	This is static because C++ operator delete() doesn't know who owns the block - but the block does.
+//	Returns TRUE on success, or FALSE if pv is not one of our live blocks. Freeing NULL is not an error.
+//*********************************************************************************************************************
+BOOL CSmallBlockHeap::Free(PVOID pv)
+{
+	if (NULL == pv)
+	{
+		return TRUE;
+	}
+
+	PSBH_BLOCK_HEADER pHeader = PSBH_BLOCK_HEADER(PBYTE(pv) - SBH_HEADER_SIZE);
+	if (IsBadWritePointer(pHeader, SBH_HEADER_SIZE) || (pHeader->dwSignature != SBH_SIGNATURE))
+	{
+		// Not ours, or freed twice.
+		BREAK_IF_DEBUG
+		return FALSE;
+	}
+
+	CSmallBlockHeap*	pOwner		= pHeader->pOwner;
+	ULONG				iSizeClass	= pHeader->wSizeClass;
+
+	// Wipe the signature first so that a second call to Free() on the same block will fail.
+	pHeader->dwSignature = 0;
+
+	if (iSizeClass == SBH_LARGE_CLASS)
+	{
+		if (!MemFree(pHeader))
+		{
+			return FALSE;
+		}
+	}
+	else if ((NULL == pOwner) || (iSizeClass >= SBH_SIZE_CLASSES))
+	{
+		BREAK_IF_DEBUG
+		return FALSE;
+	}
+
+	if (pOwner)
+	{
+		// Return the block to the freeing thread's stripe, which is not necessarily the stripe it came from.
+		// That's fine because the per-stripe counters are only meaningful when they are added together.
+		PSBH_STRIPE pStripe = pOwner->GetStripe();
+		if (iSizeClass != SBH_LARGE_CLASS)
+		{
+			InterlockedPushEntrySList(&pStripe->aFreeLists[iSizeClass], &pHeader->sListEntry);
+		}
+		InterlockedDecrement(&pStripe->cOutstanding);
+	}
+
+	return TRUE;
+}
+
+//*********************************************************************************************************************
+//	Block verifier. Returns TRUE if pv is a live block that was allocated by this heap.
+//*********************************************************************************************************************
+BOOL CSmallBlockHeap::Validate(PVOID pv)
+{
+	if (NULL == pv)
+	{
+		return FALSE;
+	}
+
+	PSBH_BLOCK_HEADER pHeader = PSBH_BLOCK_HEADER(PBYTE(pv) - SBH_HEADER_SIZE);
+	if (IsBadReadPointer(pHeader, SBH_HEADER_SIZE))
+	{
+		return FALSE;
+	}
+
+	if ((pHeader->dwSignature != SBH_SIGNATURE) || (pHeader->pOwner != this))
+	{
+		return FALSE;
+	}
+
+	if (pHeader->wSizeClass == SBH_LARGE_CLASS)
+	{
+		return MemValidate(pHeader);
+	}
+
+	return (pHeader->wSizeClass < SBH_SIZE_CLASSES);
+}
+
+//*********************************************************************************************************************
+//	Returns the number of blocks that have been allocated but not freed.
+//	This is our per-container replacement for g_cCppNewObjectRefs and g_cGenericHeapRefs.
+//*********************************************************************************************************************
+LONG CSmallBlockHeap::GetOutstandingBlocks(void)
+{
+	LONG cOutstanding = 0;
+	for (ULONG i = 0; i < SBH_STRIPES; i++)
+	{
+		cOutstanding += m_aStripes[i].cOutstanding;
+	}
+	return cOutstanding;
+}
+
+//*********************************************************************************************************************
+//	Private helper. Picks the stripe for the calling thread.
+//	Windows thread IDs are always multiples of four so we throw away the two low bits.
+//*********************************************************************************************************************
+CSmallBlockHeap::PSBH_STRIPE CSmallBlockHeap::GetStripe(void)
+{
+	return &m_aStripes[(GetCurrentThreadId() >> 2) & (SBH_STRIPES - 1)];
+}
+
+//*********************************************************************************************************************
+//	Private helper for Alloc().
+//	Allocates a new slab, carves it into blocks of the requested size class, keeps one block for our caller,
+//	and pushes the rest onto the caller's stripe. Returns the block, or NULL if we're out of memory.
+//	The first SBH_HEADER_SIZE bytes of each slab are the SLIST_ENTRY that links it into m_oSlabList.
+//*********************************************************************************************************************
+PBYTE CSmallBlockHeap::CarveSlab(PSBH_STRIPE pStripe, ULONG iSizeClass)
+{
+	ULONG	cbBlock	= SBH_SMALLEST_BLOCK << iSizeClass;
+	PBYTE	pSlab	= PBYTE(MemAlloc(SBH_SLAB_SIZE));
+	if (NULL == pSlab)
+	{
+		BREAK_IF_DEBUG
+		return NULL;
+	}
+
+	InterlockedPushEntrySList(&m_oSlabList, PSLIST_ENTRY(pSlab));
+	InterlockedIncrement(&m_cSlabs);
+
+	PBYTE	pFirst	= pSlab + SBH_HEADER_SIZE;
+	ULONG	nBlocks	= (SBH_SLAB_SIZE - SBH_HEADER_SIZE) / cbBlock;
+
+	// Keep the first block for our caller. Push the others.
+	for (ULONG i = 1; i < nBlocks; i++)
+	{
+		InterlockedPushEntrySList(&pStripe->aFreeLists[iSizeClass], PSLIST_ENTRY(pFirst + (i * cbBlock)));
+	}
+
+	return pFirst;
+}
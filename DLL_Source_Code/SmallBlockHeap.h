@@ -0,0 +1,79 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: SmallBlockHeap.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+
+//*********************************************************************************************************************
+//	CSmallBlockHeap.
+//	Per-container slab allocator for our COmfObject wrappers, our iterators, and the small arrays that are allocated
+//	by CoreAllocObjRefArray() and friends. Each container owns exactly one of these.
+//
+//	Memory is carved out of 64KB slabs into power-of-two size classes. Free blocks live on lock-free SLISTs, and
+//	those SLISTs are striped by thread ID so that threads that traverse the same file in parallel do not fight over
+//	the same list head, the same heap lock, or the same reference counter. Requests that are too large for our
+//	biggest size class fall through to MemAlloc().
+//
+//	Every block is prefixed with a SBH_BLOCK_HEADER, so Free() does not need to know who allocated it.
+//	The memory returned by Alloc() is always zeroed, just like our global C++ operator new().
+//
+//	WARNING: This class is not meant to be instantiated on the stack.
+//	It assumes that the memory it lives in has already been zeroed.
+//*********************************************************************************************************************
+class CSmallBlockHeap
+{
+public:
+	enum {
+		SBH_HEADER_SIZE		= 16,		// size of SBH_BLOCK_HEADER - keeps the caller's block 16-byte aligned
+		SBH_SMALLEST_BLOCK	= 32,		// size of the smallest size class (including the header)
+		SBH_SIZE_CLASSES	= 8,		// 32, 64, 128, 256, 512, 1024, 2048, and 4096 bytes
+		SBH_STRIPES			= 8,		// number of free list stripes (must be a power of two)
+		SBH_SLAB_SIZE		= 65536,	// size of each slab
+		SBH_LARGE_CLASS		= 0xFFFF,	// SBH_BLOCK_HEADER::wSizeClass for blocks that came from MemAlloc()
+		SBH_SIGNATURE		= 0x21484253,	// 'SBH!' - stamped into every live block, wiped when it is freed
+	};
+
+			CSmallBlockHeap(void);
+			~CSmallBlockHeap(void);
+
+	PVOID			Alloc(SIZE_T cb);
+	BOOL			Validate(PVOID pv);
+	LONG			GetOutstandingBlocks(void);
+
+	static PVOID	AllocUnowned(SIZE_T cb);
+	static BOOL		Free(PVOID pv);
+
+private:
+	// This prefixes every block. When the block is on a free list its first bytes are an SLIST_ENTRY.
+	typedef struct {
+		union {
+			SLIST_ENTRY	sListEntry;
+			struct {
+				CSmallBlockHeap*	pOwner;			// the heap that allocated this block, or NULL
+				#ifndef _WIN64
+				DWORD				dwPad;
+				#endif
+				WORD				wSizeClass;		// index into our size classes, or SBH_LARGE_CLASS
+				WORD				wReserved;
+				DWORD				dwSignature;	// SBH_SIGNATURE while the block is alive
+			};
+		};
+	} SBH_BLOCK_HEADER, *PSBH_BLOCK_HEADER;
+
+	// One of these per stripe. Padded so that no two stripes share a cache line.
+	typedef struct {
+		SLIST_HEADER	aFreeLists[SBH_SIZE_CLASSES];	// one LIFO of free blocks per size class
+		LONG			cOutstanding;					// allocations minus frees made by threads on this stripe
+		BYTE			aPadding[124];
+	} SBH_STRIPE, *PSBH_STRIPE;
+
+	PSBH_STRIPE		GetStripe(void);
+	PBYTE			CarveSlab(PSBH_STRIPE pStripe, ULONG iSizeClass);
+
+	SBH_STRIPE		m_aStripes[SBH_STRIPES];
+	SLIST_HEADER	m_oSlabList;						// every slab we ever allocated
+	LONG			m_cSlabs;							// number of slabs on m_oSlabList (used for debugging only)
+};
@@ -0,0 +1,36 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: SortByFilePos.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+
+//*********************************************************************************************************************
+//	SortByFilePos().
+//	Sorts aItems[] by file position, so that we can visit their payloads from the front of the file to the back.
+//	GetFilePos is a function object whose operator() takes one item and returns its UINT64 file position. That's
+//	usually a member of the item itself, or of the TOCX_ITEM or MDAT_CACHE_ENTRY that the item refers to.
+//	This is a plain old Shell sort. Our arrays are usually close to file order already, so it doesn't have much to do.
+//*********************************************************************************************************************
+template <class TItem, class TGetFilePos>
+void SortByFilePos(TItem* aItems, ULONG nItems, TGetFilePos GetFilePos)
+{
+	for (ULONG nGap = nItems / 2; nGap > 0; nGap = (nGap == 2) ? 1 : (nGap * 5) / 11)
+	{
+		for (ULONG i = nGap; i < nItems; i++)
+		{
+			TItem	oItem		= aItems[i];
+			UINT64	cbFilePos	= GetFilePos(oItem);
+			ULONG	j			= i;
+
+			while ((j >= nGap) && (GetFilePos(aItems[j - nGap]) > cbFilePos))
+			{
+				aItems[j] = aItems[j - nGap];
+				j -= nGap;
+			}
+			aItems[j] = oItem;
+		}
+	}
+}
@@ -21,6 +21,8 @@ CStreamOnRawBytes::CStreamOnRawBytes(LPUNKNOWN pUnkOwner)
 	, m_cbCurrentStreamPosition(0)
 	, m_cbVirtualEndOfFile64(0)
 	, m_qwCreationTime(0)
+	, m_pBytes(m_aRawBytes)
+	, m_pUnkHolder(NULL)
 	, m_cRefs(1)
 {
 	IUnknown_Set(&m_pUnkOwner, pUnkOwner);
@@ -34,6 +36,7 @@ CStreamOnRawBytes::CStreamOnRawBytes(LPUNKNOWN pUnkOwner)
 //*********************************************************************************************************************
 CStreamOnRawBytes::~CStreamOnRawBytes(void)
 {
+	IUnknown_AtomicRelease((void**)&m_pUnkHolder);
 }
 
 //*********************************************************************************************************************
@@ -51,8 +54,29 @@ HRESULT CStreamOnRawBytes::Initialize(__in const PBYTE pMem, __in const UINT64 c
 		return E_POINTER;
 	}
 
-	 CopyMemory(m_aRawBytes, pMem, UINT_PTR(cbMem));
-	m_cbVirtualEndOfFile64 = cbMem;
+	CopyMemory(m_aRawBytes, pMem, UINT_PTR(cbMem));
+	m_pBytes				= m_aRawBytes;
+	m_cbVirtualEndOfFile64	= cbMem;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Wraps caller's read-only block of memory without copying it. The block can be any size.
+//	pUnkHolder is whatever keeps that block alive - for example a CSharedBytes. We hold a reference on it until we are
+//	destroyed, so caller can release their own reference right away. The block must not change while we're alive.
+//*********************************************************************************************************************
+HRESULT CStreamOnRawBytes::InitializeShared(__in LPCVOID pMem, __in UINT64 cbMem, __in LPUNKNOWN pUnkHolder)
+{
+	// Don't call IsBadReadPointer() here. It would touch every page, and that's exactly what we're trying to avoid.
+	if ((NULL == pMem) || IsBadUnknown(pUnkHolder))
+	{
+		return E_POINTER;
+	}
+
+	IUnknown_Set(&m_pUnkHolder, pUnkHolder);
+	m_pBytes				= PBYTE(pMem);
+	m_cbVirtualEndOfFile64	= cbMem;
 	return S_OK;
 }
 
@@ -170,23 +194,33 @@ HRESULT CStreamOnRawBytes::Read(void *pv, ULONG cbRequest, PULONG pcbBytesRead)
 
 	if (SUCCEEDED(hr))
 	{
-		if (m_cbCurrentStreamPosition > sizeof(m_aRawBytes))
+		if (m_cbCurrentStreamPosition > m_cbVirtualEndOfFile64)
 		{
 			return E_UNEXPECTED;
 		}
 
-		if (cbRequest > sizeof(m_aRawBytes))
+		if (cbRequest > m_cbVirtualEndOfFile64)
 		{
 			return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
 		}
 
-		if ((m_cbCurrentStreamPosition + cbRequest) > sizeof(m_aRawBytes))
+		if ((m_cbCurrentStreamPosition + cbRequest) > m_cbVirtualEndOfFile64)
 		{
 			return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
 		}
 
-		PBYTE pSrc = &m_aRawBytes[m_cbCurrentStreamPosition];
-		CopyMemory(pv, pSrc, cbRequest);
+		// If m_pBytes points into a mapped file view then this is where the disk I/O actually happens.
+		// If that I/O fails the memory manager raises EXCEPTION_IN_PAGE_ERROR, so catch it.
+		PBYTE pSrc = &m_pBytes[m_cbCurrentStreamPosition];
+		__try
+		{
+			CopyMemory(pv, pSrc, cbRequest);
+		}
+		__except ((GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR) ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+		{
+			return STG_E_READFAULT;
+		}
+
 		m_cbCurrentStreamPosition += cbRequest;
 		cbBytesRead = cbRequest;
 
@@ -369,8 +403,39 @@ HRESULT CStreamOnRawBytes::Stat(STATSTG *pstatstg, DWORD dwStatFlag)
 //*********************************************************************************************************************
 HRESULT CStreamOnRawBytes::Clone(IStream **ppstm)
 {
-	UNREFERENCED_PARAMETER(ppstm);
-	return STG_E_UNIMPLEMENTEDFUNCTION;
+	if (IsBadWritePointer(ppstm, sizeof(IStream*)))
+	{
+		return STG_E_INVALIDPOINTER;
+	}
+
+	*ppstm = NULL;
+
+	// Note that CStreamOnRawBytes is created with an outstanding reference count of 1.
+	CStreamOnRawBytes* pClone = new CStreamOnRawBytes(m_pUnkOwner);
+	if (NULL == pClone)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	// If our bytes are shared then so are our clone's. Otherwise there are no more than 256 of them to copy.
+	HRESULT hr = m_pUnkHolder ? pClone->InitializeShared(m_pBytes, m_cbVirtualEndOfFile64, m_pUnkHolder)
+								: pClone->Initialize(m_aRawBytes, m_cbVirtualEndOfFile64);
+	if (SUCCEEDED(hr))
+	{
+		// "The new stream object has the same seek pointer as the original stream."
+		pClone->m_cbCurrentStreamPosition	= m_cbCurrentStreamPosition;
+		pClone->m_qwCreationTime			= m_qwCreationTime;
+		lstrcpynW(pClone->m_wzStatStgName, m_wzStatStgName, ELEMS(pClone->m_wzStatStgName));
+
+		// Hand our reference to caller.
+		*ppstm = static_cast<IStream*>(pClone);
+	}
+	else
+	{
+		pClone->Release();
+	}
+
+	return hr;
 }
 
 //*********************************************************************************************************************
@@ -399,7 +464,7 @@ HRESULT CStreamOnRawBytes::SeekSet(INT64 cbMove64)
 //*********************************************************************************************************************
 HRESULT CStreamOnRawBytes::SeekCur(INT64 cbMove64)
 {
-	// Math is safe because m_cbVirtualEndOfFile64 can never be greater than sizeof(m_aRawBytes).
+	// Math is safe because m_cbVirtualEndOfFile64 is the size of a block of memory.
 	INT64 cbMinimumNegativeSeek	= 0-INT64(m_cbVirtualEndOfFile64);
 
 	if ((cbMove64 < cbMinimumNegativeSeek) || (UINT64(cbMove64) > m_cbVirtualEndOfFile64))
@@ -445,3 +510,168 @@ HRESULT CStreamOnRawBytes::SeekEnd(INT64 cbMove64)
 	return S_OK;
 }
 
+//*********************************************************************************************************************
+//	CSharedBytes constructor.
+//*********************************************************************************************************************
+CSharedBytes::CSharedBytes(void)
+	: m_pView(NULL)
+	, m_pBytes(NULL)
+	, m_cbLength(0)
+	, m_cRefs(1)
+{
+}
+
+//*********************************************************************************************************************
+//	CSharedBytes destructor.
+//*********************************************************************************************************************
+CSharedBytes::~CSharedBytes(void)
+{
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = NULL;
+	}
+}
+
+//*********************************************************************************************************************
+//	Public static factory.
+//	Maps a read-only view of cbLength bytes at cbOffset in pwzFileName, and returns it in a new CSharedBytes with a
+//	reference count of 1. The file and the mapping object are closed before we return, because the view keeps them
+//	both alive. Fails with E_INVALIDARG if cbLength is zero or larger than SHARED_VIEW_MAX.
+//*********************************************************************************************************************
+HRESULT CSharedBytes::CreateOnFileView(__in PCWSTR pwzFileName,
+											__in UINT64 cbOffset,
+												__in UINT64 cbLength,
+													__out CSharedBytes** ppShared)
+{
+	SYSTEM_INFO		si			= {0};
+	CSharedBytes*	pShared		= NULL;
+	HANDLE			hFile		= INVALID_HANDLE_VALUE;
+	HANDLE			hMapping	= NULL;
+	PVOID			pView		= NULL;
+	UINT64			cbViewBase	= 0;
+	UINT64			cbSlop		= 0;
+	HRESULT			hr			= S_OK;
+
+	if (IsBadWritePointer(ppShared, sizeof(CSharedBytes*)))
+	{
+		return E_POINTER;
+	}
+	*ppShared = NULL;
+
+	if (IsBadReadPointer(pwzFileName, sizeof(WCHAR)))
+	{
+		return E_POINTER;
+	}
+
+	if ((0 == cbLength) || (cbLength > SHARED_VIEW_MAX))
+	{
+		return E_INVALIDARG;
+	}
+
+	// MapViewOfFile() insists that the file offset is a multiple of the allocation granularity (usually 64KB).
+	GetSystemInfo(&si);
+	cbSlop		= cbOffset % si.dwAllocationGranularity;
+	cbViewBase	= cbOffset - cbSlop;
+
+	hFile = CreateFileW(pwzFileName,
+						GENERIC_READ,
+						FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+						NULL,
+						OPEN_EXISTING,
+						FILE_ATTRIBUTE_NORMAL,
+						NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_Exit;
+	}
+
+	hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == hMapping)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_Exit;
+	}
+
+	pView = MapViewOfFile(hMapping,
+							FILE_MAP_READ,
+							DWORD(cbViewBase >> 32),
+							DWORD(cbViewBase),
+							SIZE_T(cbSlop + cbLength));
+	if (NULL == pView)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_Exit;
+	}
+
+	pShared = new CSharedBytes;
+	if (NULL == pShared)
+	{
+		UnmapViewOfFile(pView);
+		hr = E_OUTOFMEMORY;
+		goto L_Exit;
+	}
+
+	pShared->m_pView	= pView;
+	pShared->m_pBytes	= PBYTE(pView) + cbSlop;
+	pShared->m_cbLength	= cbLength;
+	*ppShared			= pShared;
+
+L_Exit:
+	if (hMapping)
+	{
+		CloseHandle(hMapping);
+	}
+
+	if (INVALID_HANDLE_VALUE != hFile)
+	{
+		CloseHandle(hFile);
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IUnknown.
+//*********************************************************************************************************************
+HRESULT CSharedBytes::QueryInterface(REFIID riid, PVOID *ppvOut)
+{
+	HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+	if (SUCCEEDED(hr))
+	{
+		if (riid == IID_IUnknown)
+		{
+			InterlockedIncrement(&m_cRefs);
+			*ppvOut = static_cast<IUnknown*>(this);
+			hr = S_OK;
+		}
+		else
+		{
+			hr = E_NOINTERFACE;
+		}
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IUnknown.
+//*********************************************************************************************************************
+ULONG CSharedBytes::AddRef(void)
+{
+	return InterlockedIncrement(&m_cRefs);
+}
+
+//*********************************************************************************************************************
+//	IUnknown.
+//*********************************************************************************************************************
+ULONG CSharedBytes::Release(void)
+{
+	ULONG cRefs = InterlockedDecrement(&m_cRefs);
+	if (0 == cRefs)
+	{
+		delete this;
+	}
+	return cRefs;
+}
@@ -6,6 +6,47 @@
 // Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
 //*********************************************************************************************************************
 #pragma once
+
+//*********************************************************************************************************************
+//	CSharedBytes.
+//	A refcounted read-only block of memory that can be shared by any number of CStreamOnRawBytes objects.
+//	Right now the only way to make one is to map a view of a file, so the bytes come straight out of the file cache.
+//*********************************************************************************************************************
+class CSharedBytes : public IUnknown
+{
+public:
+	enum {
+		SHARED_VIEW_MAX	= 0x04000000,	// largest file view that we are willing to map (64MB)
+	};
+
+	static HRESULT	CreateOnFileView(__in PCWSTR pwzFileName,
+										__in UINT64 cbOffset,
+											__in UINT64 cbLength,
+												__out CSharedBytes** ppShared);
+
+	PBYTE			GetBytes(void)	{return m_pBytes;}
+	UINT64			GetLength(void)	{return m_cbLength;}
+
+	// IUnknown methods in V-table order.
+	STDMETHODIMP	QueryInterface(REFIID riid, PVOID* ppv);
+	ULONG __stdcall	AddRef(void);
+	ULONG __stdcall	Release(void);
+
+private:
+			CSharedBytes(void);
+	virtual	~CSharedBytes(void);
+
+	PVOID		m_pView;		// what MapViewOfFile() returned
+	PBYTE		m_pBytes;		// the first byte that caller asked for (somewhere inside m_pView)
+	UINT64		m_cbLength;		// the number of bytes that caller asked for
+	LONG		m_cRefs;
+};
+
+//*********************************************************************************************************************
+//	CStreamOnRawBytes.
+//	A read-only IStream on a block of memory. Small blocks are copied into m_aRawBytes[] by Initialize().
+//	Blocks of any size can be wrapped without copying by InitializeShared().
+//*********************************************************************************************************************
 class CStreamOnRawBytes : protected IStream
 {
 public:
@@ -13,6 +54,7 @@ public:
 	virtual ~CStreamOnRawBytes(void);
 
 	STDMETHODIMP	Initialize(__in const PBYTE pMem, __in const UINT64 cbMem);
+	STDMETHODIMP	InitializeShared(__in LPCVOID pMem, __in UINT64 cbMem, __in LPUNKNOWN pUnkHolder);
 	STDMETHODIMP	SetStatStgNameW(__in PCWSTR pwzStatStgName);
 
 	// IUnknown methods in V-table order.
@@ -43,6 +85,8 @@ private:
 	STDMETHODIMP	SeekEnd(INT64 cbMove64);
 
 	BYTE		m_aRawBytes[256];
+	PBYTE		m_pBytes;			// points to m_aRawBytes[] or to a shared block
+	LPUNKNOWN	m_pUnkHolder;		// whatever keeps the shared block alive, or NULL
 	WCHAR		m_wzStatStgName[32];
 	UINT64		m_cbCurrentStreamPosition;
 	UINT64		m_cbVirtualEndOfFile64;
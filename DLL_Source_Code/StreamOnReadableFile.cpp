@@ -23,6 +23,7 @@ CStreamOnReadableFile::CStreamOnReadableFile(LPUNKNOWN pUnkOwner)
 	, m_pUnkOwner(0)
 	, m_cbCurrentStreamPosition(0)
 	, m_cRefs(1)
+	, m_cbReadAhead(READAHEAD_DEFAULT)
 {
 	IUnknown_Set(&m_pUnkOwner, pUnkOwner);
 	m_wzStatStgName[0] = 0;
@@ -33,6 +34,23 @@ CStreamOnReadableFile::CStreamOnReadableFile(LPUNKNOWN pUnkOwner)
 //*********************************************************************************************************************
 CStreamOnReadableFile::~CStreamOnReadableFile(void)
 {
+	// Make sure that no prefetch is still writing into our banks.
+	CancelPrefetch();
+
+	if (IsValidHandle(m_hFileAsync))
+	{
+		CloseHandle(m_hFileAsync);
+	}
+
+	if (m_hEventAsync)
+	{
+		CloseHandle(m_hEventAsync);
+	}
+
+	if (m_pBankMemory)
+	{
+		VirtualFree(m_pBankMemory, SIZE_T(0), MEM_RELEASE);
+	}
 }
 
 //*********************************************************************************************************************
@@ -66,6 +84,12 @@ HRESULT CStreamOnReadableFile::QueryInterface(REFIID riid, PVOID *ppvOut)
 			*ppvOut = static_cast<IStream*>(this);
 			hr = S_OK;
 		}
+		else if (riid == __uuidof(IOmfooStreamReadAhead))
+		{
+			InterlockedIncrement(&m_cRefs);
+			*ppvOut = static_cast<IOmfooStreamReadAhead*>(this);
+			hr = S_OK;
+		}
 		else
 		{
 			hr = E_NOINTERFACE;
@@ -124,6 +148,8 @@ HRESULT CStreamOnReadableFile::Write(const void *pv, ULONG cb, PULONG pcbWritten
 
 //*********************************************************************************************************************
 //	ISequentialStream.
+//	Read-ahead only kicks in after READAHEAD_THRESHOLD back-to-back sequential reads that are smaller than a bank,
+//	so random readers (and readers who ask for big blocks) go straight to SeekRead() just like before.
 //*********************************************************************************************************************
 HRESULT CStreamOnReadableFile::Read(void *pv, ULONG cbRequest, PULONG pcbBytesRead)
 {
@@ -150,11 +176,47 @@ HRESULT CStreamOnReadableFile::Read(void *pv, ULONG cbRequest, PULONG pcbBytesRe
 
 	if (SUCCEEDED(hr))
 	{
+		// Is this a small read that lies entirely inside our nested region?
+		BOOL fSmallRead = (m_cbReadAhead) &&
+							(cbRequest < m_cbReadAhead) &&
+							(m_cbCurrentStreamPosition + cbRequest <= m_cbVirtualEndOfFile64);
+
+		// If so, then is caller reading sequentially?
+		if (fSmallRead)
+		{
+			if ((m_cbCurrentStreamPosition == m_cbLastReadEnd) || IsInReadAheadWindow(m_cbCurrentStreamPosition))
+			{
+				if (m_nSequentialReads < READAHEAD_THRESHOLD)
+				{
+					m_nSequentialReads++;
+				}
+			}
+			else
+			{
+				DropReadAhead();
+			}
+		}
+
+		hr = E_FAIL;
+		if ((fSmallRead) && (m_nSequentialReads >= READAHEAD_THRESHOLD))
+		{
+			// If read-ahead fails for any reason then forget about it and try the old way.
+			if (FAILED(hr = ReadAhead(PBYTE(pv), cbRequest)))
+			{
+				DropReadAhead();
+			}
+		}
+
 		// SeekRead() will fail if it cannot read every byte.
-		hr = SeekRead(m_cbCurrentStreamPosition, pv, cbRequest);
+		if (FAILED(hr))
+		{
+			hr = SeekRead(m_cbCurrentStreamPosition, pv, cbRequest);
+		}
+
 		if (SUCCEEDED(hr))
 		{
 			m_cbCurrentStreamPosition += cbRequest;
+			m_cbLastReadEnd = m_cbCurrentStreamPosition;
 			cbBytesRead = cbRequest;
 		}
 	}
@@ -208,6 +270,15 @@ HRESULT CStreamOnReadableFile::Seek(LARGE_INTEGER liMove, DWORD dwOrigin, PULARG
 		break;
 	}
 
+	// If caller jumped somewhere that we haven't read ahead then our banks are useless.
+	// Seeking to where the last read ended (for example to ask for the current position) is not a jump.
+	if (SUCCEEDED(hr) &&
+		(m_cbCurrentStreamPosition != m_cbLastReadEnd) &&
+		(!IsInReadAheadWindow(m_cbCurrentStreamPosition)))
+	{
+		DropReadAhead();
+	}
+
 	// Did caller provide a place to save the new position?
 	if (pNewPosition)
 	{
@@ -231,18 +302,231 @@ HRESULT CStreamOnReadableFile::SetSize(ULARGE_INTEGER liNewSize)
 
 //*********************************************************************************************************************
 //	IStream.
+//	Copies cb bytes from our current seek position to the current seek position of the destination stream.
+//	This is double-buffered. We open our own handle for overlapped reading, and while pstm->Write() is consuming one
+//	memory bank the next read is already filling the other one. Our seek pointer moves by the number of bytes read.
 //*********************************************************************************************************************
-HRESULT CStreamOnReadableFile::CopyTo(IStream *punk,
+HRESULT CStreamOnReadableFile::CopyTo(IStream *pstm,
 								ULARGE_INTEGER uliRequested,
 								ULARGE_INTEGER *puliRead,
 								ULARGE_INTEGER *puliWritten)
 {
-	UNREFERENCED_PARAMETER(punk);
-	UNREFERENCED_PARAMETER(uliRequested);
-	UNREFERENCED_PARAMETER(puliRead);
-	UNREFERENCED_PARAMETER(puliWritten);
+	OVERLAPPED	ovlRead			= {0};
+	HANDLE		hFileRead		= NULL;
+	HANDLE		hEventRead		= NULL;
+	PBYTE		pMemBase		= NULL;
+	PBYTE		aMemBank[2]		= {NULL, NULL};
+	ULONG		nToggles		= 0;
+	ULONG		cbMemoryBank	= COPYTO_BANK_SIZE;
+
+	UINT64		cbReadPosition	= 0;
+	UINT64		cbReadRemaining	= 0;
+	UINT64		cbTotalRead		= 0;
+	UINT64		cbTotalWritten	= 0;
+
+	DWORD		cbReadRequest	= 0;
+	DWORD		cbReadResult	= 0;
+	ULONG		cbWriteRequest	= 0;
+	ULONG		cbWriteResult	= 0;
+	DWORD		dwError			= NOERROR;
+	HRESULT		hr				= S_OK;
+
+	// puliRead and puliWritten are optional, but if caller supplied them then make sure we can write to them.
+	if (puliRead)
+	{
+		if (IsBadWritePointer(puliRead, sizeof(ULARGE_INTEGER)))
+		{
+			return STG_E_INVALIDPOINTER;
+		}
+		puliRead->QuadPart = 0;
+	}
 
-	return STG_E_INVALIDFUNCTION;
+	if (puliWritten)
+	{
+		if (IsBadWritePointer(puliWritten, sizeof(ULARGE_INTEGER)))
+		{
+			return STG_E_INVALIDPOINTER;
+		}
+		puliWritten->QuadPart = 0;
+	}
+
+	if (IsBadUnknown(pstm))
+	{
+		return STG_E_INVALIDPOINTER;
+	}
+
+	// Never read past the end of our nested region.
+	cbReadRemaining = m_cbVirtualEndOfFile64 - m_cbCurrentStreamPosition;
+	if (uliRequested.QuadPart < cbReadRemaining)
+	{
+		cbReadRemaining = uliRequested.QuadPart;
+	}
+
+	// Nothing to do?
+	if (cbReadRemaining == 0)
+	{
+		return S_OK;
+	}
+
+	// If cbMemoryBank is larger than the number of bytes to copy then use the lesser.
+	if (cbReadRemaining < cbMemoryBank)
+	{
+		cbMemoryBank = ULONG(cbReadRemaining);
+	}
+
+	// Calculate the actual physical read start position.
+	cbReadPosition = m_cbVirtualStartOfFile64 + m_cbCurrentStreamPosition;
+
+	// Allocate memory for two adjacent equally-sized memory banks.
+	pMemBase = PBYTE(VirtualAlloc(NULL, SIZE_T(cbMemoryBank)*2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+	if (pMemBase == NULL)
+	{
+		hr = STG_E_INSUFFICIENTMEMORY;
+		goto L_CleanupExit;
+	}
+
+	aMemBank[0]	= pMemBase;
+	aMemBank[1]	= &pMemBase[cbMemoryBank];
+
+	// Create event handle for reading.
+	if (NULL == (hEventRead = CreateEventW(LPSECURITY_ATTRIBUTES(NULL), FALSE, FALSE, LPCWSTR(0))))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Open our own handle for asynchronous reading.
+	// We cannot use CReadableFile::m_hFileRead because it was not opened with FILE_FLAG_OVERLAPPED.
+	hFileRead = CreateFileW(m_pwzFullPath,
+							GENERIC_READ,
+							FILE_SHARE_READ,
+							NULL,
+							OPEN_EXISTING,
+							FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+							NULL);
+
+	if (IsBadHandle(hFileRead))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto L_CleanupExit;
+	}
+
+	// Main read/write loop.
+	do {
+		// Are there any bytes remaining to be read?
+		if (cbReadRemaining)
+		{
+			cbReadRequest = (cbReadRemaining >= cbMemoryBank) ? cbMemoryBank : DWORD(cbReadRemaining);
+
+			ovlRead.Internal		= 0;
+			ovlRead.InternalHigh	= 0;
+			ovlRead.Offset			= PUINT32(&cbReadPosition)[0];
+			ovlRead.OffsetHigh		= PUINT32(&cbReadPosition)[1];
+			ovlRead.hEvent			= hEventRead;
+
+			// Initiate the next async read into the bank that pstm is NOT using.
+			if (!ReadFile(hFileRead, aMemBank[nToggles & 0x00000001], cbReadRequest, LPDWORD(0), &ovlRead))
+			{
+				dwError = GetLastError();
+				if (dwError != ERROR_IO_PENDING)
+				{
+					cbReadRequest = 0;
+					hr = HRESULT_FROM_WIN32(dwError);
+					goto L_CleanupExit;
+				}
+			}
+		}
+
+		// Is there a bank from the previous read waiting to be written?
+		if (cbWriteRequest)
+		{
+			cbWriteResult = 0;
+			hr = pstm->Write(aMemBank[(nToggles + 1) & 0x00000001], cbWriteRequest, &cbWriteResult);
+			cbTotalWritten += cbWriteResult;
+			if (FAILED(hr))
+			{
+				goto L_CleanupExit;
+			}
+
+			// A short write means that the destination is full.
+			if (cbWriteResult != cbWriteRequest)
+			{
+				hr = STG_E_MEDIUMFULL;
+				goto L_CleanupExit;
+			}
+
+			cbWriteRequest = 0;
+		}
+
+		// Is there a pending read operation?
+		if (cbReadRequest)
+		{
+			BOOL	fResult		= GetOverlappedResult(hFileRead, &ovlRead, &cbReadResult, TRUE);
+			DWORD	cbExpected	= cbReadRequest;
+
+			// The read is no longer in flight, so our cleanup code must not wait for it.
+			cbReadRequest = 0;
+
+			if (!fResult)
+			{
+				hr = HRESULT_FROM_WIN32(GetLastError());
+				goto L_CleanupExit;
+			}
+
+			if (cbReadResult != cbExpected)
+			{
+				hr = STG_E_READFAULT;
+				goto L_CleanupExit;
+			}
+
+			// Hand the bank we just filled to pstm on the next iteration, and read into the other one.
+			cbWriteRequest	= cbReadResult;
+			cbTotalRead		+= cbReadResult;
+			cbReadPosition	+= cbReadResult;
+			cbReadRemaining	-= cbReadResult;
+			nToggles++;
+		}
+	} while (cbWriteRequest);
+
+	hr = S_OK;
+
+L_CleanupExit:
+	// If a read is still in flight then cancel it, and let it finish before we free its memory bank.
+	if (cbReadRequest)
+	{
+		CancelIo(hFileRead);
+		GetOverlappedResult(hFileRead, &ovlRead, &cbReadResult, TRUE);
+	}
+
+	if (IsValidHandle(hFileRead))
+	{
+		CloseHandle(hFileRead);
+	}
+
+	if (hEventRead)
+	{
+		CloseHandle(hEventRead);
+	}
+
+	if (pMemBase)
+	{
+		VirtualFree(pMemBase, SIZE_T(0), MEM_RELEASE);
+	}
+
+	// "The seek pointer in the source stream is advanced by the number of bytes read."
+	m_cbCurrentStreamPosition += cbTotalRead;
+
+	if (puliRead)
+	{
+		puliRead->QuadPart = cbTotalRead;
+	}
+
+	if (puliWritten)
+	{
+		puliWritten->QuadPart = cbTotalWritten;
+	}
+
+	return hr;
 }
 
 //*********************************************************************************************************************
@@ -332,11 +616,71 @@ HRESULT CStreamOnReadableFile::Stat(STATSTG *pstatstg, DWORD dwStatFlag)
 
 //*********************************************************************************************************************
 //	IStream.
+//	Creates a new stream object with its own seek pointer that reads the same bytes as this one.
+//	The clone shares our file via CReadableFile::ShareReadableFile(), so the file is not opened again.
+//	Each stream reads with explicit file positions, so any number of clones can be read on different threads.
 //*********************************************************************************************************************
 HRESULT CStreamOnReadableFile::Clone(IStream **ppstm)
 {
-	UNREFERENCED_PARAMETER(ppstm);
-	return STG_E_UNIMPLEMENTEDFUNCTION;
+	if (IsBadWritePointer(ppstm, sizeof(IStream*)))
+	{
+		return STG_E_INVALIDPOINTER;
+	}
+
+	*ppstm = NULL;
+
+	// Note that CStreamOnReadableFile is created with an outstanding reference count of 1.
+	// Our clone holds its own reference on our owner.
+	CStreamOnReadableFile* pClone = new CStreamOnReadableFile(m_pUnkOwner);
+	if (NULL == pClone)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	HRESULT hr = pClone->ShareReadableFile(*this);
+	if (SUCCEEDED(hr))
+	{
+		// "The new stream object has the same seek pointer as the original stream."
+		pClone->m_cbCurrentStreamPosition = m_cbCurrentStreamPosition;
+		lstrcpynW(pClone->m_wzStatStgName, m_wzStatStgName, ELEMS(pClone->m_wzStatStgName));
+		pClone->m_cbReadAhead = m_cbReadAhead;
+
+		// Hand our reference to caller.
+		*ppstm = static_cast<IStream*>(pClone);
+	}
+	else
+	{
+		pClone->Release();
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooStreamReadAhead.
+//	Sets the size of each read-ahead bank. Zero turns read-ahead off, and anything larger than READAHEAD_MAX is
+//	clamped to READAHEAD_MAX. We throw away our banks right now, and ReadAhead() allocates new ones on demand.
+//*********************************************************************************************************************
+HRESULT CStreamOnReadableFile::SetReadAheadSize(ULONG cbReadAhead)
+{
+	if (cbReadAhead > READAHEAD_MAX)
+	{
+		cbReadAhead = READAHEAD_MAX;
+	}
+
+	// Make sure that no prefetch is still writing into our banks.
+	DropReadAhead();
+
+	if (m_pBankMemory)
+	{
+		VirtualFree(m_pBankMemory, SIZE_T(0), MEM_RELEASE);
+		m_pBankMemory	= NULL;
+		m_aBank[0]		= NULL;
+		m_aBank[1]		= NULL;
+	}
+
+	m_cbReadAhead = cbReadAhead;
+	return S_OK;
 }
 
 //*********************************************************************************************************************
@@ -411,3 +755,224 @@ HRESULT CStreamOnReadableFile::SeekEnd(INT64 cbMove64)
 	return S_OK;
 }
 
+//*********************************************************************************************************************
+//	Private helper for Read().
+//	Copies cbRequest bytes from our current stream position into pDest using our read-ahead banks.
+//	Our caller has already made sure that the request lies entirely inside our nested region.
+//	Whenever we move on to a new bank we immediately start filling the other one with the window that follows it,
+//	so a sequential reader should almost never have to wait for the disk.
+//*********************************************************************************************************************
+HRESULT CStreamOnReadableFile::ReadAhead(__out PBYTE pDest, __in ULONG cbRequest)
+{
+	UINT64	cbStreamPos	= m_cbCurrentStreamPosition;
+	HRESULT	hr			= S_OK;
+
+	// Allocate both banks on first use.
+	if (NULL == m_pBankMemory)
+	{
+		m_pBankMemory = PBYTE(VirtualAlloc(NULL, SIZE_T(m_cbReadAhead)*2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+		if (NULL == m_pBankMemory)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		m_aBank[0]	= m_pBankMemory;
+		m_aBank[1]	= &m_pBankMemory[m_cbReadAhead];
+	}
+
+	// Create our event handle on first use.
+	if (NULL == m_hEventAsync)
+	{
+		if (NULL == (m_hEventAsync = CreateEventW(LPSECURITY_ATTRIBUTES(NULL), FALSE, FALSE, LPCWSTR(0))))
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+	}
+
+	// Open our own handle for asynchronous reading on first use.
+	// We cannot use CReadableFile::m_hFileRead because it was not opened with FILE_FLAG_OVERLAPPED.
+	if (NULL == m_hFileAsync)
+	{
+		m_hFileAsync = CreateFileW(m_pwzFullPath,
+									GENERIC_READ,
+									FILE_SHARE_READ,
+									NULL,
+									OPEN_EXISTING,
+									FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+									NULL);
+
+		if (IsBadHandle(m_hFileAsync))
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			m_hFileAsync = NULL;
+			return hr;
+		}
+	}
+
+	while (cbRequest)
+	{
+		ULONG i = m_iCurrentBank;
+
+		// Is the next byte in the current bank?
+		if ((m_aBankLen[i]) && (cbStreamPos >= m_aBankPos[i]) && (cbStreamPos < m_aBankPos[i] + m_aBankLen[i]))
+		{
+			ULONG cbOffset	= ULONG(cbStreamPos - m_aBankPos[i]);
+			ULONG cbCopy	= m_aBankLen[i] - cbOffset;
+			if (cbCopy > cbRequest)
+			{
+				cbCopy = cbRequest;
+			}
+
+			CopyMemory(pDest, &m_aBank[i][cbOffset], cbCopy);
+			pDest		+= cbCopy;
+			cbStreamPos	+= cbCopy;
+			cbRequest	-= cbCopy;
+			continue;
+		}
+
+		// No. Is the other bank already being filled with the window that we need?
+		if (!((m_fPrefetchPending) &&
+			(cbStreamPos >= m_aBankPos[i ^ 1]) &&
+			(cbStreamPos < m_aBankPos[i ^ 1] + m_cbPrefetchRequest)))
+		{
+			// No. This is the first time through, or the reader skipped ahead. Start over at cbStreamPos.
+			CancelPrefetch();
+			if (FAILED(hr = StartPrefetch(cbStreamPos, i ^ 1)))
+			{
+				return hr;
+			}
+		}
+
+		// Wait for it and make it the current bank.
+		if (FAILED(hr = FinishPrefetch()))
+		{
+			return hr;
+		}
+		m_iCurrentBank = i ^ 1;
+
+		// Now start filling the bank that we just finished with.
+		if (FAILED(hr = StartPrefetch(m_aBankPos[i ^ 1] + m_aBankLen[i ^ 1], i)))
+		{
+			return hr;
+		}
+	}
+
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for ReadAhead().
+//	Starts an overlapped read of the window that begins at cbStreamPos into m_aBank[iBank].
+//	Returns S_FALSE if cbStreamPos is at the end of our nested region, because there is nothing left to read.
+//*********************************************************************************************************************
+HRESULT CStreamOnReadableFile::StartPrefetch(__in UINT64 cbStreamPos, __in ULONG iBank)
+{
+	// Invalidate the bank, even if there's nothing to read.
+	m_aBankPos[iBank]	= cbStreamPos;
+	m_aBankLen[iBank]	= 0;
+
+	if (cbStreamPos >= m_cbVirtualEndOfFile64)
+	{
+		return S_FALSE;
+	}
+
+	// Never read past the end of our nested region.
+	UINT64	cbRemaining	= m_cbVirtualEndOfFile64 - cbStreamPos;
+	UINT64	cbPhysPos	= m_cbVirtualStartOfFile64 + cbStreamPos;
+	ULONG	cbPrefetch	= (cbRemaining < m_cbReadAhead) ? ULONG(cbRemaining) : m_cbReadAhead;
+
+	ZeroMemory(&m_ovlPrefetch, sizeof(m_ovlPrefetch));
+	m_ovlPrefetch.Offset		= PUINT32(&cbPhysPos)[0];
+	m_ovlPrefetch.OffsetHigh	= PUINT32(&cbPhysPos)[1];
+	m_ovlPrefetch.hEvent		= m_hEventAsync;
+
+	if (!ReadFile(m_hFileAsync, m_aBank[iBank], cbPrefetch, LPDWORD(0), &m_ovlPrefetch))
+	{
+		DWORD dwError = GetLastError();
+		if (dwError != ERROR_IO_PENDING)
+		{
+			return HRESULT_FROM_WIN32(dwError);
+		}
+	}
+
+	m_cbPrefetchRequest	= cbPrefetch;
+	m_fPrefetchPending	= TRUE;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for ReadAhead().
+//	Waits for the pending prefetch to finish. Our caller must make sure that there is one.
+//*********************************************************************************************************************
+HRESULT CStreamOnReadableFile::FinishPrefetch(void)
+{
+	ULONG	iBank		= m_iCurrentBank ^ 1;
+	DWORD	cbResult	= 0;
+	BOOL	fResult		= GetOverlappedResult(m_hFileAsync, &m_ovlPrefetch, &cbResult, TRUE);
+
+	m_fPrefetchPending = FALSE;
+
+	if (!fResult)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	// This should never happen because StartPrefetch() never reads past the end of our region.
+	if (cbResult != m_cbPrefetchRequest)
+	{
+		return __HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+	}
+
+	m_aBankLen[iBank] = cbResult;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper.
+//	Cancels the pending prefetch (if there is one) and waits for it, so that its bank can be reused or freed.
+//*********************************************************************************************************************
+void CStreamOnReadableFile::CancelPrefetch(void)
+{
+	if (m_fPrefetchPending)
+	{
+		DWORD cbResult = 0;
+		CancelIo(m_hFileAsync);
+		GetOverlappedResult(m_hFileAsync, &m_ovlPrefetch, &cbResult, TRUE);
+		m_fPrefetchPending = FALSE;
+	}
+}
+
+//*********************************************************************************************************************
+//	Private helper.
+//	Throws away everything in our read-ahead banks and starts counting sequential reads all over again.
+//	We keep the memory, the event, and the file handle so that we can start reading ahead again cheaply.
+//*********************************************************************************************************************
+void CStreamOnReadableFile::DropReadAhead(void)
+{
+	CancelPrefetch();
+	m_aBankLen[0]		= 0;
+	m_aBankLen[1]		= 0;
+	m_nSequentialReads	= 0;
+}
+
+//*********************************************************************************************************************
+//	Private helper.
+//	Returns TRUE if cbStreamPos is in the current bank, or in the window that is being prefetched.
+//*********************************************************************************************************************
+BOOL CStreamOnReadableFile::IsInReadAheadWindow(__in UINT64 cbStreamPos)
+{
+	ULONG i = m_iCurrentBank;
+
+	if ((m_aBankLen[i]) && (cbStreamPos >= m_aBankPos[i]) && (cbStreamPos < m_aBankPos[i] + m_aBankLen[i]))
+	{
+		return TRUE;
+	}
+
+	i ^= 1;
+	if ((m_fPrefetchPending) && (cbStreamPos >= m_aBankPos[i]) && (cbStreamPos < m_aBankPos[i] + m_cbPrefetchRequest))
+	{
+		return TRUE;
+	}
+
+	return FALSE;
+}
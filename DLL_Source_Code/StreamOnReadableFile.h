@@ -6,11 +6,13 @@
 // Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
 //*********************************************************************************************************************
 #pragma once
+#include "Omfoo_Alpha_Header.h"
 #include "ReadableFile.h"
 
 class CStreamOnReadableFile
 	: public CReadableFile
 	, protected IStream
+	, protected IOmfooStreamReadAhead
 {
 public:
 			CStreamOnReadableFile(LPUNKNOWN pUnkOwner);
@@ -39,15 +41,49 @@ private:
 	STDMETHODIMP	Stat(STATSTG *pstatstg, DWORD dwStatFlag);
 	STDMETHODIMP	Clone(IStream **ppstm);
 
+	// IOmfooStreamReadAhead methods in V-table order.
+	STDMETHODIMP	SetReadAheadSize(ULONG cbReadAhead);
+
 private:
+	enum {
+		COPYTO_BANK_SIZE	= 0x00100000,	// size of each of the two memory banks used by CopyTo()
+		READAHEAD_DEFAULT	= 0x00040000,	// size of each read-ahead bank (256KB)
+		READAHEAD_MAX		= 0x01000000,	// largest bank that SetReadAheadSize() will allow (16MB)
+		READAHEAD_THRESHOLD	= 4,			// number of back-to-back sequential reads before we start reading ahead
+	};
+
 	// Helpers for Seek().
 	STDMETHODIMP	SeekSet(INT64 cbMove64);
 	STDMETHODIMP	SeekCur(INT64 cbMove64);
 	STDMETHODIMP	SeekEnd(INT64 cbMove64);
 
+	// Helpers for Read().
+	HRESULT			ReadAhead(__out PBYTE pDest, __in ULONG cbRequest);
+	HRESULT			StartPrefetch(__in UINT64 cbStreamPos, __in ULONG iBank);
+	HRESULT			FinishPrefetch(void);
+	void			CancelPrefetch(void);
+	void			DropReadAhead(void);
+	BOOL			IsInReadAheadWindow(__in UINT64 cbStreamPos);
+
 	WCHAR		m_wzStatStgName[32];
 	UINT64		m_cbCurrentStreamPosition;
 	LPUNKNOWN	m_pUnkOwner;
 	LONG		m_cRefs;
+
+	// Read-ahead state. We have two banks. Read() copies from the current one while the other one is being filled
+	// by an overlapped read. The bank positions are stream positions (not physical file positions).
+	HANDLE		m_hFileAsync;			// our own FILE_FLAG_OVERLAPPED handle, opened on demand
+	HANDLE		m_hEventAsync;			// event for m_ovlPrefetch
+	OVERLAPPED	m_ovlPrefetch;			// the pending prefetch (if m_fPrefetchPending is TRUE)
+	PBYTE		m_pBankMemory;			// both banks, allocated on demand
+	PBYTE		m_aBank[2];				// pointers into m_pBankMemory
+	UINT64		m_aBankPos[2];			// stream position of the first byte in each bank
+	ULONG		m_aBankLen[2];			// number of valid bytes in each bank (zero = empty)
+	ULONG		m_iCurrentBank;			// the bank that Read() is copying from
+	ULONG		m_cbReadAhead;			// size of each bank (zero = no read-ahead)
+	ULONG		m_cbPrefetchRequest;	// size of the pending prefetch
+	BOOL		m_fPrefetchPending;		// TRUE if the other bank is being filled
+	ULONG		m_nSequentialReads;		// number of back-to-back sequential reads (up to READAHEAD_THRESHOLD)
+	UINT64		m_cbLastReadEnd;		// stream position just past the end of the previous read
 };
 
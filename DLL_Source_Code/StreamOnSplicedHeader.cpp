@@ -0,0 +1,740 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: StreamOnSplicedHeader.cpp
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#include "stdafx.h"
+#include <winbase.h>
+#include <shlwapi.h>
+#include "StreamOnSplicedHeader.h"
+
+#include "MiscStatic.h"
+using namespace NsMiscStatic;
+
+//*********************************************************************************************************************
+//	Constructor
+//*********************************************************************************************************************
+CStreamOnSplicedHeader::CStreamOnSplicedHeader(LPUNKNOWN pUnkOwner)
+	: m_pUnkOwner(NULL)
+	, m_cbHeader(0)
+	, m_pBody(NULL)
+	, m_cbBody(0)
+	, m_cbPadding(0)
+	, m_cbCurrentStreamPosition(0)
+	, m_cbVirtualEndOfFile64(0)
+	, m_cRefs(1)
+{
+	IUnknown_Set(&m_pUnkOwner, pUnkOwner);
+	ZeroMemory(m_wzStatStgName, sizeof(m_wzStatStgName));
+	ZeroMemory(m_aHeader, sizeof(m_aHeader));
+}
+
+//*********************************************************************************************************************
+//	Destructor
+//*********************************************************************************************************************
+CStreamOnSplicedHeader::~CStreamOnSplicedHeader(void)
+{
+	IUnknown_AtomicRelease((void**)&m_pBody);
+}
+
+//*********************************************************************************************************************
+//	Public static factory.
+//	Creates a CStreamOnSplicedHeader on caller's header, body, and padding, and then queries it for the interface
+//	specified by riid. The new stream holds its own reference on pBody, so caller can release theirs right away.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Create(__in LPUNKNOWN pUnkOwner,
+											__in LPCVOID pHeader,
+												__in ULONG cbHeader,
+													__in IStream* pBody,
+														__in ULONG cbPadding,
+															__in REFIID riid,
+																__out PVOID *ppvOut)
+{
+	HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+	if (SUCCEEDED(hr))
+	{
+		hr = E_OUTOFMEMORY;
+
+		// Note that CStreamOnSplicedHeader is created with an outstanding reference count of 1.
+		CStreamOnSplicedHeader* pStream = new CStreamOnSplicedHeader(pUnkOwner);
+		if (pStream)
+		{
+			if (SUCCEEDED(hr = pStream->Initialize(pHeader, cbHeader, pBody, cbPadding)))
+			{
+				hr = pStream->QueryInterface(riid, ppvOut);
+			}
+			pStream->Release();
+			pStream = NULL;
+		}
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Public.
+//	Copies caller's header into m_aHeader[] and holds a reference on pBody until we are destroyed.
+//	The header can be empty, but it cannot be larger than SPLICED_HEADER_MAX bytes. We ask pBody for its size right now,
+//	so it must not grow or shrink while we're alive. Caller should not use pBody's seek pointer after this, because
+//	we move it around whenever we like. The body is followed by cbPadding zero bytes (usually none).
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Initialize(__in LPCVOID pHeader,
+											__in ULONG cbHeader,
+												__in IStream* pBody,
+													__in ULONG cbPadding)
+{
+	STATSTG	sStat	= {0};
+	HRESULT	hr		= S_OK;
+
+	if ((cbHeader > sizeof(m_aHeader)) || (cbPadding > SPLICED_PADDING_MAX))
+	{
+		return E_INVALIDARG;
+	}
+
+	if (IsBadReadPointer(pHeader, cbHeader) || IsBadUnknown(pBody))
+	{
+		return E_POINTER;
+	}
+
+	if (FAILED(hr = pBody->Stat(&sStat, STATFLAG_NONAME)))
+	{
+		return hr;
+	}
+
+	if (sStat.cbSize.QuadPart > UINT64(MAXLONGLONG) - cbHeader - cbPadding)
+	{
+		return E_INVALIDARG;
+	}
+
+	IUnknown_AtomicRelease((void**)&m_pBody);
+	m_pBody = pBody;
+	m_pBody->AddRef();
+
+	CopyMemory(m_aHeader, pHeader, cbHeader);
+	m_cbHeader					= cbHeader;
+	m_cbBody					= sStat.cbSize.QuadPart;
+	m_cbPadding					= cbPadding;
+	m_cbVirtualEndOfFile64		= m_cbBody + cbHeader + cbPadding;
+	m_cbCurrentStreamPosition	= 0;
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Public.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::SetStatStgNameW(PCWSTR pwzStatStgName)
+{
+	if (IsBadStringPointerW(pwzStatStgName, ELEMS(m_wzStatStgName)))
+	{
+		return E_POINTER;
+	}
+
+	lstrcpynW(m_wzStatStgName, pwzStatStgName, ELEMS(m_wzStatStgName));
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	IUnknown.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::QueryInterface(REFIID riid, PVOID *ppvOut)
+{
+	// Validate caller's pointer and IID.
+	HRESULT hr = VerifyIID_PPV_ARGS(riid, ppvOut);
+	if (SUCCEEDED(hr))
+	{
+		// Compare...
+		if ((riid == IID_IUnknown) || (riid == IID_ISequentialStream) || (riid == IID_IStream))
+		{
+			InterlockedIncrement(&m_cRefs);
+			*ppvOut = static_cast<IStream*>(this);
+			hr = S_OK;
+		}
+		else if (riid == __uuidof(IOmfooStreamReadAhead))
+		{
+			InterlockedIncrement(&m_cRefs);
+			*ppvOut = static_cast<IOmfooStreamReadAhead*>(this);
+			hr = S_OK;
+		}
+		else
+		{
+			hr = E_NOINTERFACE;
+		}
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IUnknown.
+//*********************************************************************************************************************
+ULONG CStreamOnSplicedHeader::AddRef(void)
+{
+	return InterlockedIncrement(&m_cRefs);
+}
+
+//*********************************************************************************************************************
+//	IUnknown.
+//*********************************************************************************************************************
+ULONG CStreamOnSplicedHeader::Release(void)
+{
+	ULONG cRefs = InterlockedDecrement(&m_cRefs);
+	if (0 == cRefs)
+	{
+		// Get a local pointer to our owner, but don't AddRef() it.
+		// A NULL pointer is okay if we don't have an owner.
+		LPUNKNOWN	pUnkOwner	= m_pUnkOwner;
+
+		// Delete ourself.
+		// We do NOT release our owner in our destructor because our owner might own the allocator that allocated us.
+		delete this;
+
+		// Now release our owner (if it exists) using the local pointer.
+		IUnknown_AtomicRelease((void**)&pUnkOwner);
+	}
+	return cRefs;
+}
+
+//*********************************************************************************************************************
+//	ISequentialStream.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Write(const void *pv, ULONG cb, PULONG pcbWritten)
+{
+	UNREFERENCED_PARAMETER(pv);
+	UNREFERENCED_PARAMETER(cb);
+
+	if (!IsBadWritePointer(pcbWritten, sizeof(ULONG)))
+	{
+		*pcbWritten = 0;
+	}
+
+	// "The caller does not have the required permissions for writing to this stream object."
+	return STG_E_ACCESSDENIED;
+}
+
+//*********************************************************************************************************************
+//	ISequentialStream.
+//	Like CStreamOnReadableFile::Read() this is all or nothing. The part of caller's request that overlaps our header
+//	comes from m_aHeader[], the part that overlaps the body comes from the body, and the rest is padding (zeros).
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Read(void *pv, ULONG cbRequest, PULONG pcbBytesRead)
+{
+	HRESULT	hr			= S_OK;
+	ULONG	cbBytesRead	= 0;
+
+	// pcbBytesRead is optional, but if caller supplied one then make sure we can write to it, and wipe it. 
+	if (pcbBytesRead)
+	{
+		if (IsBadWritePointer(pcbBytesRead, sizeof(ULONG)))
+		{
+			hr = STG_E_INVALIDPOINTER;
+		}
+		else
+		{
+			*pcbBytesRead = 0;
+		}
+	}
+
+	if (IsBadWritePointer(pv, cbRequest))
+	{
+		hr = STG_E_INVALIDPOINTER;
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		if (m_cbCurrentStreamPosition > m_cbVirtualEndOfFile64)
+		{
+			return E_UNEXPECTED;
+		}
+
+		if (cbRequest > m_cbVirtualEndOfFile64 - m_cbCurrentStreamPosition)
+		{
+			return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+		}
+
+		PBYTE	pDest		= PBYTE(pv);
+		ULONG	cbRemaining	= cbRequest;
+
+		// Does caller's request begin inside our header?
+		if (m_cbCurrentStreamPosition < m_cbHeader)
+		{
+			ULONG cbPart = m_cbHeader - ULONG(m_cbCurrentStreamPosition);
+			if (cbPart > cbRemaining)
+			{
+				cbPart = cbRemaining;
+			}
+
+			CopyMemory(pDest, &m_aHeader[m_cbCurrentStreamPosition], cbPart);
+			pDest		+= cbPart;
+			cbRemaining	-= cbPart;
+		}
+
+		// Is there anything left for the body?
+		UINT64 cbBodyPos	= m_cbCurrentStreamPosition + (cbRequest - cbRemaining);
+		UINT64 cbBodyEnd	= m_cbHeader + m_cbBody;
+		if ((cbRemaining) && (cbBodyPos < cbBodyEnd))
+		{
+			ULONG cbPart	= cbRemaining;
+			ULONG cbResult	= 0;
+			if (cbPart > cbBodyEnd - cbBodyPos)
+			{
+				cbPart = ULONG(cbBodyEnd - cbBodyPos);
+			}
+
+			if (SUCCEEDED(hr = SeekBody(cbBodyPos)))
+			{
+				hr = m_pBody->Read(pDest, cbPart, &cbResult);
+				if (SUCCEEDED(hr) && (cbResult != cbPart))
+				{
+					hr = HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+				}
+			}
+			pDest		+= cbPart;
+			cbRemaining	-= cbPart;
+		}
+
+		// Anything after the body is padding.
+		if (SUCCEEDED(hr) && (cbRemaining))
+		{
+			ZeroMemory(pDest, cbRemaining);
+		}
+
+		if (SUCCEEDED(hr))
+		{
+			m_cbCurrentStreamPosition += cbRequest;
+			cbBytesRead = cbRequest;
+			hr = S_OK;
+		}
+	}
+
+	// pcbBytesRead is optional, but if caller supplied one then give them their own byte count.
+	if (pcbBytesRead)
+	{
+		*pcbBytesRead = cbBytesRead;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Seek(LARGE_INTEGER liMove, DWORD dwOrigin, PULARGE_INTEGER pNewPosition)
+{
+	HRESULT	hr = HRESULT_FROM_WIN32(INVALID_SET_FILE_POINTER);
+
+	// Did caller provide a place to save the new position?
+	if (pNewPosition)
+	{
+		if (IsBadWritePointer(pNewPosition, sizeof(ULARGE_INTEGER)))
+		{
+			return STG_E_INVALIDPOINTER;
+		}
+		else
+		{
+			// Set the 'new' position to the 'current' position in case we fail.
+			pNewPosition->QuadPart = m_cbCurrentStreamPosition;
+		}
+	}
+
+	switch (dwOrigin)
+	{
+	case STREAM_SEEK_SET:
+		hr = SeekSet(liMove.QuadPart);
+		break;
+
+	case STREAM_SEEK_CUR:
+		hr = SeekCur(liMove.QuadPart);
+		break;
+
+	case STREAM_SEEK_END:
+		hr = SeekEnd(liMove.QuadPart);
+		break;
+
+	default:
+		hr = STG_E_INVALIDFUNCTION;
+		break;
+	}
+
+	// Did caller provide a place to save the new position?
+	if (pNewPosition)
+	{
+		// Update the 'new' position with the new position.
+		pNewPosition->QuadPart = m_cbCurrentStreamPosition;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::SetSize(ULARGE_INTEGER liNewSize)
+{
+	UNREFERENCED_PARAMETER(liNewSize);
+
+	// "The caller does not have the required permissions for writing to this stream object."
+	return STG_E_ACCESSDENIED;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//	Copies cb bytes from our current seek position to the current seek position of the destination stream.
+//	We write the part of our header that caller asked for ourselves, and then we let the body's CopyTo() method do
+//	the heavy lifting. That way the body's double-buffered copy still works, and we never hold a copy of the payload.
+//	Any padding that caller asked for is written last.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::CopyTo(IStream *pstm,
+										ULARGE_INTEGER uliRequested,
+										ULARGE_INTEGER *puliRead,
+										ULARGE_INTEGER *puliWritten)
+{
+	static const BYTE aZeros[SPLICED_PADDING_MAX] = {0};
+
+	ULARGE_INTEGER	uliBodyRead		= {0};
+	ULARGE_INTEGER	uliBodyWritten	= {0};
+	ULARGE_INTEGER	uliBodyRequest	= {0};
+	UINT64			cbRemaining		= 0;
+	UINT64			cbTotalRead		= 0;
+	UINT64			cbTotalWritten	= 0;
+	HRESULT			hr				= S_OK;
+
+	// puliRead and puliWritten are optional, but if caller supplied them then make sure we can write to them.
+	if (puliRead)
+	{
+		if (IsBadWritePointer(puliRead, sizeof(ULARGE_INTEGER)))
+		{
+			return STG_E_INVALIDPOINTER;
+		}
+		puliRead->QuadPart = 0;
+	}
+
+	if (puliWritten)
+	{
+		if (IsBadWritePointer(puliWritten, sizeof(ULARGE_INTEGER)))
+		{
+			return STG_E_INVALIDPOINTER;
+		}
+		puliWritten->QuadPart = 0;
+	}
+
+	if (IsBadUnknown(pstm))
+	{
+		return STG_E_INVALIDPOINTER;
+	}
+
+	if (m_cbCurrentStreamPosition > m_cbVirtualEndOfFile64)
+	{
+		return E_UNEXPECTED;
+	}
+
+	// Never read past the end of the body.
+	cbRemaining = m_cbVirtualEndOfFile64 - m_cbCurrentStreamPosition;
+	if (uliRequested.QuadPart < cbRemaining)
+	{
+		cbRemaining = uliRequested.QuadPart;
+	}
+
+	// Does the copy begin inside our header?
+	if ((cbRemaining) && (m_cbCurrentStreamPosition < m_cbHeader))
+	{
+		ULONG cbPart	= m_cbHeader - ULONG(m_cbCurrentStreamPosition);
+		ULONG cbResult	= 0;
+		if (cbPart > cbRemaining)
+		{
+			cbPart = ULONG(cbRemaining);
+		}
+
+		hr = pstm->Write(&m_aHeader[m_cbCurrentStreamPosition], cbPart, &cbResult);
+		cbTotalRead		+= cbPart;
+		cbTotalWritten	+= cbResult;
+		cbRemaining		-= cbPart;
+
+		if (SUCCEEDED(hr) && (cbResult != cbPart))
+		{
+			hr = STG_E_MEDIUMFULL;
+		}
+	}
+
+	// Now hand the body's share to the body.
+	UINT64 cbBodyPos	= m_cbCurrentStreamPosition + cbTotalRead;
+	UINT64 cbBodyEnd	= m_cbHeader + m_cbBody;
+	if (SUCCEEDED(hr) && (cbRemaining) && (cbBodyPos < cbBodyEnd))
+	{
+		uliBodyRequest.QuadPart = cbRemaining;
+		if (uliBodyRequest.QuadPart > cbBodyEnd - cbBodyPos)
+		{
+			uliBodyRequest.QuadPart = cbBodyEnd - cbBodyPos;
+		}
+
+		if (SUCCEEDED(hr = SeekBody(cbBodyPos)))
+		{
+			hr = m_pBody->CopyTo(pstm, uliBodyRequest, &uliBodyRead, &uliBodyWritten);
+			cbTotalRead		+= uliBodyRead.QuadPart;
+			cbTotalWritten	+= uliBodyWritten.QuadPart;
+			cbRemaining		-= uliBodyRead.QuadPart;
+
+			if (SUCCEEDED(hr) && (uliBodyRead.QuadPart != uliBodyRequest.QuadPart))
+			{
+				hr = HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+			}
+		}
+	}
+
+	// Anything after the body is padding. There are never more than SPLICED_PADDING_MAX bytes of it.
+	if (SUCCEEDED(hr) && (cbRemaining))
+	{
+		ULONG cbPart	= ULONG(cbRemaining);
+		ULONG cbResult	= 0;
+
+		hr = pstm->Write(aZeros, cbPart, &cbResult);
+		cbTotalRead		+= cbPart;
+		cbTotalWritten	+= cbResult;
+
+		if (SUCCEEDED(hr) && (cbResult != cbPart))
+		{
+			hr = STG_E_MEDIUMFULL;
+		}
+	}
+
+	// Our seek pointer moves by the number of bytes read.
+	m_cbCurrentStreamPosition += cbTotalRead;
+
+	if (puliRead)
+	{
+		puliRead->QuadPart = cbTotalRead;
+	}
+
+	if (puliWritten)
+	{
+		puliWritten->QuadPart = cbTotalWritten;
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Commit(DWORD dwCommitFlags)
+{
+	UNREFERENCED_PARAMETER(dwCommitFlags);
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Revert(void)
+{
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::LockRegion(ULARGE_INTEGER liOffset, ULARGE_INTEGER cb, DWORD dwLockType)
+{
+	UNREFERENCED_PARAMETER(liOffset);
+	UNREFERENCED_PARAMETER(cb);
+	UNREFERENCED_PARAMETER(dwLockType);
+
+	// "Locking is not supported at all or the specific type of lock requested is not supported."
+	return STG_E_INVALIDFUNCTION;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::UnlockRegion(ULARGE_INTEGER liOffset, ULARGE_INTEGER cb, DWORD dwLockType)
+{
+	UNREFERENCED_PARAMETER(liOffset);
+	UNREFERENCED_PARAMETER(cb);
+	UNREFERENCED_PARAMETER(dwLockType);
+
+	// "Locking is not supported at all or the specific type of lock requested is not supported."
+	return STG_E_INVALIDFUNCTION;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//	We borrow the time stamps from the body, but the name (if any) and the size are our own.
+//	See CStreamOnRawBytes::Stat() for the storage object naming conventions.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Stat(STATSTG *pstatstg, DWORD dwStatFlag)
+{
+	HRESULT hr = S_OK;
+
+	if (IsBadWritePointer(pstatstg, sizeof(STATSTG)))
+		return STG_E_INVALIDPOINTER;
+
+	ZeroMemory(pstatstg, sizeof(STATSTG));
+	if (dwStatFlag > STATFLAG_NONAME)	return STG_E_INVALIDFLAG;
+
+	if (FAILED(hr = m_pBody->Stat(pstatstg, STATFLAG_NONAME)))
+	{
+		ZeroMemory(pstatstg, sizeof(STATSTG));
+		return hr;
+	}
+
+	// If our caller wants a name, and if we have one to give ...
+	if (((dwStatFlag & STATFLAG_NONAME) == 0) && (m_wzStatStgName[0]))
+	{
+		hr = SHStrDupW(m_wzStatStgName, &pstatstg->pwcsName);
+	}
+
+	pstatstg->type				= STGTY_STREAM;
+	pstatstg->cbSize.QuadPart	= m_cbVirtualEndOfFile64;
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IStream.
+//	Our clone gets its own copy of our header and its own clone of our body, so the two never fight over a seek pointer.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::Clone(IStream **ppstm)
+{
+	IStream*	pBodyClone	= NULL;
+	HRESULT		hr			= S_OK;
+
+	if (IsBadWritePointer(ppstm, sizeof(IStream*)))
+	{
+		return STG_E_INVALIDPOINTER;
+	}
+
+	*ppstm = NULL;
+
+	if (FAILED(hr = m_pBody->Clone(&pBodyClone)))
+	{
+		return hr;
+	}
+
+	// Note that CStreamOnSplicedHeader is created with an outstanding reference count of 1.
+	CStreamOnSplicedHeader* pClone = new CStreamOnSplicedHeader(m_pUnkOwner);
+	if (NULL == pClone)
+	{
+		pBodyClone->Release();
+		return E_OUTOFMEMORY;
+	}
+
+	if (SUCCEEDED(hr = pClone->Initialize(m_aHeader, m_cbHeader, pBodyClone, m_cbPadding)))
+	{
+		// "The new stream object has the same seek pointer as the original stream."
+		pClone->m_cbCurrentStreamPosition = m_cbCurrentStreamPosition;
+		lstrcpynW(pClone->m_wzStatStgName, m_wzStatStgName, ELEMS(pClone->m_wzStatStgName));
+
+		// Hand our reference to caller.
+		*ppstm = static_cast<IStream*>(pClone);
+	}
+	else
+	{
+		pClone->Release();
+	}
+
+	// pClone holds its own reference on pBodyClone (if it succeeded).
+	pBodyClone->Release();
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	IOmfooStreamReadAhead.
+//	Our header is in memory, so there's nothing to read ahead. Pass it on to the body.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::SetReadAheadSize(ULONG cbReadAhead)
+{
+	IOmfooStreamReadAhead* pReadAhead = NULL;
+
+	HRESULT hr = m_pBody->QueryInterface(__uuidof(IOmfooStreamReadAhead), (PVOID*)&pReadAhead);
+	if (SUCCEEDED(hr))
+	{
+		hr = pReadAhead->SetReadAheadSize(cbReadAhead);
+		pReadAhead->Release();
+	}
+
+	return hr;
+}
+
+//*********************************************************************************************************************
+//	Private helper for IStream::Seek().
+//	Come here when the dwOrigin argument is STREAM_SEEK_SET.
+//	The new seek pointer is an offset relative to the beginning of the stream.
+//	Our job is to translate cbMove64 into a new value for m_cbCurrentStreamPosition.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::SeekSet(INT64 cbMove64)
+{
+	if ((cbMove64 < 0) || (UINT64(cbMove64) > m_cbVirtualEndOfFile64))
+	{
+		return HRESULT_FROM_WIN32(INVALID_SET_FILE_POINTER);
+	}
+
+	// Easy
+	m_cbCurrentStreamPosition = UINT64(cbMove64);
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for IStream::Seek().
+//	Come here when the dwOrigin argument is STREAM_SEEK_CUR.
+//	The new seek pointer is an offset relative to the current seek pointer location.
+//	Our job is to translate cbMove64 into a new value for m_cbCurrentStreamPosition.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::SeekCur(INT64 cbMove64)
+{
+	// Math is safe because Initialize() made sure that m_cbVirtualEndOfFile64 is not larger than MAXLONGLONG.
+	INT64 cbMinimumNegativeSeek	= 0-INT64(m_cbVirtualEndOfFile64);
+
+	if ((cbMove64 < cbMinimumNegativeSeek) || (cbMove64 > INT64(m_cbVirtualEndOfFile64)))
+	{
+		return HRESULT_FROM_WIN32(INVALID_SET_FILE_POINTER);	// STG_E_SEEKERROR
+	}
+
+	INT64 cbTargetPosition64 = INT64(m_cbCurrentStreamPosition) + cbMove64;
+
+	if ((cbTargetPosition64 < 0) || (cbTargetPosition64 > INT64(m_cbVirtualEndOfFile64)))
+	{
+		return HRESULT_FROM_WIN32(INVALID_SET_FILE_POINTER);	// STG_E_SEEKERROR
+	}
+
+	m_cbCurrentStreamPosition = UINT64(cbTargetPosition64);
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for IStream::Seek().
+//	Come here when the dwOrigin argument is STREAM_SEEK_END.
+//	The new seek pointer is an offset relative to the end of the stream.
+//	Our job is to translate cbMove64 into a new value for m_cbCurrentStreamPosition.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::SeekEnd(INT64 cbMove64)
+{
+	INT64 cbMinimumNegativeSeek	= 0-INT64(m_cbVirtualEndOfFile64);
+
+	if ((cbMove64 < cbMinimumNegativeSeek) || (cbMove64 > 0))
+	{
+		return HRESULT_FROM_WIN32(INVALID_SET_FILE_POINTER);
+	}
+
+	m_cbCurrentStreamPosition = UINT64(INT64(m_cbVirtualEndOfFile64) + cbMove64);
+	return S_OK;
+}
+
+//*********************************************************************************************************************
+//	Private helper for Read() and CopyTo().
+//	Moves the body's seek pointer to the body position that corresponds to our stream position cbStreamPos.
+//	cbStreamPos must not be inside our header or our padding.
+//*********************************************************************************************************************
+HRESULT CStreamOnSplicedHeader::SeekBody(__in UINT64 cbStreamPos)
+{
+	LARGE_INTEGER liMove = {0};
+
+	if ((cbStreamPos < m_cbHeader) || (cbStreamPos > m_cbHeader + m_cbBody))
+	{
+		BREAK_IF_DEBUG
+		return E_UNEXPECTED;
+	}
+
+	liMove.QuadPart = INT64(cbStreamPos - m_cbHeader);
+	return m_pBody->Seek(liMove, STREAM_SEEK_SET, NULL);
+}
@@ -0,0 +1,88 @@
+// Indent=4, tab=4, column width=120, CR/LF, codepage=ASCII
+// Original filename: StreamOnSplicedHeader.h
+// Copyright (C) 2022 David Miller
+// This file is part of the Omfoo Source Code Project.
+// You should have received a copy of the source code license with this file.
+// Please see OMFOO_SOURCECODE_LICENSE.TXT or send inquiries to OmfooGuy@gmail.com.
+//*********************************************************************************************************************
+#pragma once
+#include "Omfoo_Alpha_Header.h"
+
+//*********************************************************************************************************************
+//	CStreamOnSplicedHeader.
+//	A read-only IStream that splices a small header (up to 256 bytes, copied into m_aHeader[]) in front of another
+//	read-only IStream (the body). Stream position zero is the first byte of the header, and the body begins right
+//	after it. The body is never copied. We only seek it and read it (or ask it to CopyTo()) on behalf of our caller.
+//	Optionally the body can be followed by a few zero bytes of padding, for containers whose chunks must be even-sized.
+//
+//	We use this to hand out a corrected file header in front of a region of the OMF file, so that caller sees a valid
+//	WAV or AIF file without us having to touch the bytes on disk. See CContainerLayer15::CreateStreamOnMdatRange().
+//*********************************************************************************************************************
+class CStreamOnSplicedHeader
+	: protected IStream
+	, protected IOmfooStreamReadAhead
+{
+public:
+	enum {
+		SPLICED_HEADER_MAX	= 256,		// largest header that Initialize() will accept
+		SPLICED_PADDING_MAX	= 16,		// largest trailing padding that Initialize() will accept
+	};
+
+			CStreamOnSplicedHeader(LPUNKNOWN pUnkOwner);
+	virtual ~CStreamOnSplicedHeader(void);
+
+	static HRESULT	Create(__in LPUNKNOWN pUnkOwner,
+								__in LPCVOID pHeader,
+									__in ULONG cbHeader,
+										__in IStream* pBody,
+											__in ULONG cbPadding,
+												__in REFIID riid,
+													__out PVOID *ppvOut);
+
+	STDMETHODIMP	Initialize(__in LPCVOID pHeader, __in ULONG cbHeader, __in IStream* pBody, __in ULONG cbPadding);
+	STDMETHODIMP	SetStatStgNameW(__in PCWSTR pwzStatStgName);
+
+	// IUnknown methods in V-table order.
+	STDMETHODIMP	QueryInterface(REFIID riid, PVOID* ppv);
+	ULONG __stdcall	AddRef(void);
+	ULONG __stdcall	Release(void);
+
+private:
+	// ISequentialStream methods in V-table order.
+	STDMETHODIMP	Read(void *pv, ULONG cbRequest, PULONG pcbBytesRead);
+	STDMETHODIMP	Write(const void *pv, ULONG cb, PULONG pcbWritten);
+
+	// IStream methods in V-table order.
+	STDMETHODIMP	Seek(LARGE_INTEGER liMove, DWORD dwOrigin, ULARGE_INTEGER *pNewPosition);
+	STDMETHODIMP	SetSize(ULARGE_INTEGER liNewSize);
+	STDMETHODIMP	CopyTo(IStream *pstm, ULARGE_INTEGER cb, PULARGE_INTEGER pcbBytesRead, PULARGE_INTEGER pcbWritten);
+	STDMETHODIMP	Commit(DWORD dwCommitFlags);
+	STDMETHODIMP	Revert(void);
+	STDMETHODIMP	LockRegion(ULARGE_INTEGER liOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+	STDMETHODIMP	UnlockRegion(ULARGE_INTEGER liOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+	STDMETHODIMP	Stat(STATSTG *pstatstg, DWORD dwStatFlag);
+	STDMETHODIMP	Clone(IStream **ppstm);
+
+	// IOmfooStreamReadAhead methods in V-table order.
+	STDMETHODIMP	SetReadAheadSize(ULONG cbReadAhead);
+
+private:
+	// Helpers for Seek().
+	STDMETHODIMP	SeekSet(INT64 cbMove64);
+	STDMETHODIMP	SeekCur(INT64 cbMove64);
+	STDMETHODIMP	SeekEnd(INT64 cbMove64);
+
+	// Helper for Read() and CopyTo().
+	HRESULT			SeekBody(__in UINT64 cbStreamPos);
+
+	BYTE		m_aHeader[SPLICED_HEADER_MAX];
+	ULONG		m_cbHeader;
+	IStream*	m_pBody;					// the stream that follows our header
+	UINT64		m_cbBody;					// the size of m_pBody (according to its Stat() method)
+	ULONG		m_cbPadding;				// number of zero bytes that follow the body
+	WCHAR		m_wzStatStgName[32];
+	UINT64		m_cbCurrentStreamPosition;
+	UINT64		m_cbVirtualEndOfFile64;		// m_cbHeader + m_cbBody + m_cbPadding
+	LPUNKNOWN	m_pUnkOwner;
+	LONG		m_cRefs;
+};
@@ -170,4 +170,49 @@ enum READER_INFO_BIT_FLAGS {
 	RIB_TOUCHED_BY_MAC		= 0x00020000,	// set if the file was created or modified by a Macintosh-based program
 };
 
+// Bit flags for IOmfooBulkExtractor2::ExtractUniqueMdats().
+enum BULK_EXTRACT_DEDUP_FLAGS {
+	BXF_LINK_CLONES			= 0x00000001,	// write each cloned payload once, and make hard links for the other names
+	BXF_REPORT_CLONES		= 0x00000002,	// write each cloned payload once, and report the other names as aliases
+	BXF_REPORT_NESTED		= 0x00000004,	// don't write nested payloads, report them as ranges of their parents
+};
+
+// Bit flags for IOmfooDigestCallback::GetDigestKinds() and OMFOO_EXTRACT_DIGESTS::dwDigestKinds.
+enum OMFOO_DIGEST_KIND_FLAGS {
+	DK_CRC32C				= 0x00000001,	// CRC-32C (Castagnoli polynomial), the same one used by iSCSI and ext4
+	DK_XXH64				= 0x00000002,	// xxHash64 with a seed of zero
+	DK_SHA256				= 0x00000004,	// SHA-256 as defined by FIPS 180-4
+};
+
+// Bit flags for OMFOO_MPEG_PICTURE_INFO::dwFlags and OMFOO_MPEG_GOP_INFO::dwFlags.
+enum OMFOO_MPEG_INDEX_FLAGS {
+	MPX_SEQUENCE_HEADER		= 0x00000001,	// a sequence header comes right before the picture (or the GOP's first one)
+	MPX_GOP_HEADER			= 0x00000002,	// a GOP header comes right before the picture (or the GOP's first one)
+	MPX_CLOSED_GOP			= 0x00000004,	// the GOP header's closed_gop flag is set
+	MPX_BROKEN_LINK			= 0x00000008,	// the GOP header's broken_link flag is set
+};
+
+// Enumerated values for the dwFormat argument of IOmfMediaDataSamples::GetSampleFrames().
+enum OMFOO_PCM_SAMPLE_FORMAT {
+	PCM_FORMAT_INT16		= 1,			// signed 16-bit integers
+	PCM_FORMAT_INT32		= 2,			// signed 32-bit integers, left-justified (the stored MSB becomes bit 31)
+	PCM_FORMAT_FLOAT32		= 3,			// 32-bit IEEE floats in the range [-1.0, 1.0)
+};
+
+// Bit flags for OMFOO_PCM_FORMAT::dwFlags.
+enum OMFOO_PCM_FORMAT_FLAGS {
+	PCMF_BIG_ENDIAN			= 0x00000001,	// the stored samples are big-endian
+	PCMF_FLOAT				= 0x00000002,	// the stored samples are IEEE floats
+	PCMF_UNSIGNED			= 0x00000004,	// the stored samples are unsigned (8-bit WAVE, and AIFF-C 'raw ')
+};
+
+// Enumerated values for the dwContainer argument of IOmfMediaDataContainer::CreateStreamOnContainer().
+enum OMFOO_SYNTH_CONTAINER {
+	SYNTH_CONTAINER_AUTO		= 0,		// WAVE, RF64, or AIFF for audio - RAW_VIDEO for everything else
+	SYNTH_CONTAINER_WAVE		= 1,		// RIFF/WAVE (little-endian samples, less than 4GB)
+	SYNTH_CONTAINER_RF64		= 2,		// RF64/WAVE as defined by EBU Tech 3306 (little-endian samples, any size)
+	SYNTH_CONTAINER_AIFF		= 3,		// AIFF, or AIFF-C for floats (big-endian samples, less than 4GB)
+	SYNTH_CONTAINER_RAW_VIDEO	= 4,		// whole frames with no header (uncompressed video or DV)
+};
+
 #endif	// __OMFOO_ENUMERATED_TYPES_H__
@@ -12,10 +12,11 @@
 //	IOmfooIterator
 //	Available in OMF1 and OMF2.
 //	This is Omfoo's iterator/enumerator object.
-//	It is similar to Microsoft's IObjectArray or IEnumObjects interface, but it retrieves just one object at a time.
+//	It is similar to Microsoft's IObjectArray or IEnumObjects interface. Next() retrieves just one object at a time,
+//	and NextBatch() retrieves many.
 //	We use this to iterate the members of the OMF data type omfi:ObjRefArray and omfi:MobIndex.
 //*********************************************************************************************************************
-struct __declspec(uuid("105F84F9-E160-4f97-9F86-4F0B39AD195A")) IOmfooIterator;
+struct __declspec(uuid("D9D79F00-4303-45b0-ABF3-75CFFFCE753A")) IOmfooIterator;
 interface IOmfooIterator : public IUnknown
 {
 //	Retrieves the number of objects in the set.
@@ -30,6 +31,13 @@ interface IOmfooIterator : public IUnknown
 //	or until the end of the set is reached. It returns OMF_E_NO_MORE_ITEMS when the end is reached.
 //	You can always retrieve every object in the set by setting riid to IID_IUnknown.
 	OMFOOAPI Next(__in REFIID riid, __out PVOID *ppvOut)= 0;
+
+//	Same as Next() but it retrieves up to nMax objects in a single call, like the celt form of IEnumUnknown::Next().
+//	The ppvOut argument points to an array of nMax pointers. Unused entries are set to NULL. Objects that do not
+//	expose the requested interface are skipped, exactly as they are in Next().
+//	Returns S_OK if it retrieved nMax objects, S_FALSE if it retrieved fewer than nMax objects because it reached the
+//	end of the set, or OMF_E_NO_MORE_ITEMS if there was nothing left to retrieve. The pnFetched argument is optional.
+	OMFOOAPI NextBatch(__in REFIID riid, __in ULONG nMax, __out PVOID *ppvOut, __out_opt PULONG pnFetched)= 0;
 };
 
 //*********************************************************************************************************************
@@ -100,6 +108,238 @@ interface IOmfooReader : public IUnknown
 	OMFOOAPI IterateObjects(__in_opt DWORD dwClassFourCC, __in BOOL fStrict, __out IOmfooIterator **ppIterator)= 0;
 };
 
+//*********************************************************************************************************************
+//	IOmfooFastReader
+//	Available in OMF1 and OMF2.
+//	This is a lightweight alternative to IOmfObject for bulk traversal and analytics. It is exposed by the Container,
+//	so you get it by calling QueryInterface() on your IOmfooReader. Objects are identified by their 32-bit Bento object
+//	IDs and properties are identified by 32-bit property IDs. No wrappers are instantiated, so there are no memory
+//	allocations, no QueryInterface() calls, and no AddRef()/Release() traffic per object.
+//	Object IDs and property IDs are only meaningful within the IOmfooReader that produced them.
+//	Resolve each property name once with GetPropertyID() and then reuse the ID for every object.
+//	All other methods return E_HANDLE if IOmfooReader::Load() has not been called.
+//*********************************************************************************************************************
+struct __declspec(uuid("53DB2870-DB55-43da-A305-15B1CB0F37C3")) IOmfooFastReader;
+interface IOmfooFastReader : public IUnknown
+{
+//	Translates a property name such as "OMFI:CPNT:Length" into a property ID.
+//	Returns OMF_E_PROP_NOT_DEFINED if no object in the file uses that property.
+	OMFOOAPI GetPropertyID(__in LPCSTR pszPropertyName, __out PDWORD pdwProperty)= 0;
+
+//	Retrieves the object ID of the OMF Header Object (HEAD).
+	OMFOOAPI GetHeadObjectID(__out PDWORD pdwObject)= 0;
+
+//	Retrieves the object ID of an IOmfObject that was instantiated by this same IOmfooReader.
+//	Use this to switch from the IOmfObject world to the IOmfooFastReader world.
+	OMFOOAPI GetObjectID(__in IUnknown *punk, __out PDWORD pdwObject)= 0;
+
+//	Instantiates the object specified by dwObject and queries it for the interface specified by riid.
+//	Use this to switch from the IOmfooFastReader world back to the IOmfObject world.
+	OMFOOAPI Instantiate(__in DWORD dwObject, __in REFIID riid, __out PVOID *ppvOut)= 0;
+
+//	Wrapper-free version of IOmfooReader::IterateObjects(). Set *piPos to zero before the first call.
+//	Each call retrieves the next matching object ID and advances *piPos.
+//	Returns OMF_E_NO_MORE_ITEMS when there are no more objects.
+	OMFOOAPI FindNextObject(__in_opt DWORD dwClassFourCC, __in BOOL fStrict, __inout PULONG piPos,
+																				__out PDWORD pdwObject)= 0;
+
+//	Same as IOmfObject::GetClassFourCC(). The fourCC is returned in the HRESULT.
+	OMFOOAPI GetClassFourCC(__in DWORD dwObject)= 0;
+
+//	Same as IOmfObject::IsATypeOf(). Returns S_OK if it is, or S_FALSE if it isn't.
+	OMFOOAPI IsATypeOf(__in DWORD dwObject, __in DWORD dwClassFourCC)= 0;
+
+//	Same as IOmfObject::IsPropertyPresent().
+	OMFOOAPI IsPropertyPresent(__in DWORD dwObject, __in DWORD dwProperty)= 0;
+
+//	These are the same as their IOmfObject counterparts, except that they take an object ID and a property ID.
+	OMFOOAPI ReadRawBytes(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cbBuffer,
+												__out_opt PVOID pBuffer, __out_opt PULONG pcbRequired)= 0;
+	OMFOOAPI ReadStringA(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cchBuffer,
+												__out_opt PCHAR pBuffer, __out_opt PULONG pcchRequired)= 0;
+	OMFOOAPI ReadStringW(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG cchBuffer,
+												__out_opt PWCHAR pBuffer, __out_opt PULONG pcchRequired)= 0;
+	OMFOOAPI ReadBoolean(__in DWORD dwObject, __in DWORD dwProperty, __out PBOOLEAN pBoolean)= 0;
+	OMFOOAPI ReadInt8(__in DWORD dwObject, __in DWORD dwProperty, __out PINT8 pn8)= 0;
+	OMFOOAPI ReadInt16(__in DWORD dwObject, __in DWORD dwProperty, __out PINT16 pn16)= 0;
+	OMFOOAPI ReadInt32(__in DWORD dwObject, __in DWORD dwProperty, __out PINT32 pn32)= 0;
+	OMFOOAPI ReadInt64(__in DWORD dwObject, __in DWORD dwProperty, __out PINT64 pn64)= 0;
+	OMFOOAPI ReadUInt8(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT8 pu8)= 0;
+	OMFOOAPI ReadUInt16(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT16 pu16)= 0;
+	OMFOOAPI ReadUInt32(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT32 pu32)= 0;
+	OMFOOAPI ReadUInt64(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT64 pu64)= 0;
+	OMFOOAPI ReadFourCC(__in DWORD dwObject, __in DWORD dwProperty, __out PDWORD pdwFourCC)= 0;
+	OMFOOAPI ReadLength64(__in DWORD dwObject, __in DWORD dwProperty, __out PUINT64 pLength)= 0;
+	OMFOOAPI ReadPosition64(__in DWORD dwObject, __in DWORD dwProperty, __out PINT64 pPosition)= 0;
+	OMFOOAPI ReadMobID(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_MOB_ID pMobID)= 0;
+	OMFOOAPI ReadRational(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_RATIONAL pRational)= 0;
+	OMFOOAPI ReadTimeStamp(__in DWORD dwObject, __in DWORD dwProperty, __out POMF_TIMESTAMP pTimeStamp)= 0;
+	OMFOOAPI ReadInt32Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT32 pDest, __out PULONG pnActualElements)= 0;
+	OMFOOAPI ReadInt64Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT64 pDest, __out PULONG pnActualElements)= 0;
+	OMFOOAPI ReadPosition64Array(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PUINT64 pDest, __out PULONG pnActualElements)= 0;
+
+//	Retrieves the object ID stored in a property whose data type is omfi:ObjRef.
+	OMFOOAPI ReadObjRef(__in DWORD dwObject, __in DWORD dwProperty, __out PDWORD pdwObjRef)= 0;
+
+//	Retrieves the object IDs stored in a property whose data type is omfi:ObjRefArray.
+//	This method has optional call-twice semantics. Make the first call with pDest set to NULL to get the required
+//	buffer size (measured in elements), and then call again with an appropriately sized buffer to retrieve the IDs.
+	OMFOOAPI ReadObjRefArray(__in DWORD dwObject, __in DWORD dwProperty, __in ULONG nMaxElements,
+												__out_opt PDWORD pDest, __out PULONG pnActualElements)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooBulkExtractCallback
+//	This is the bulk counterpart of IOmfooExtractCallback. It enables your application to get callback notifications
+//	during your calls to IOmfooBulkExtractor::ExtractAllMdats(), and it allows you to cancel the operation in progress.
+//	This object is optional. Omfoo does not provide this. If you want to use this feature you must implement this
+//	interface yourself - and pass it to ExtractAllMdats().
+//*********************************************************************************************************************
+struct __declspec(uuid("BC4F80EF-F0D8-45fc-87B6-DCBBB1F58A04")) IOmfooBulkExtractCallback;
+interface IOmfooBulkExtractCallback : public IUnknown
+{
+//	Called periodically so your application can update its GUI (or whatever).
+//	The byte counts are the totals for all MDATs, not for any one file. The file counts tell you how many files have
+//	been completely written and closed so far, and how many files there will be when everything is done.
+//	Your implementation should return S_OK to continue extracting, or return E_ABORT to cancel all pending read/write
+//	operations and to delete the incomplete files. Files that were already completed are not deleted.
+	OMFOOAPI UpdateProgress(__in UINT64 cbCompleted,
+								__in UINT64 cbTotal,
+									__in ULONG nFilesCompleted,
+										__in ULONG nFilesTotal)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooBulkExtractor
+//	Available in OMF1 and OMF2.
+//	This interface extracts the embedded payloads of every Media Data object (MDAT) in the file in a single call.
+//	It is exposed by the Container, so you get it by calling QueryInterface() on your IOmfooReader.
+//	It's much faster than calling IOmfMediaData::ExtractDataToFile() on each MDAT because the payloads are read in
+//	file order through one file handle and one small pool of buffers, and several output files are written at once.
+//	All methods return E_HANDLE if IOmfooReader::Load() has not been called.
+//*********************************************************************************************************************
+struct __declspec(uuid("78852D90-43D5-41d0-A205-EE0F61E93020")) IOmfooBulkExtractor;
+interface IOmfooBulkExtractor : public IUnknown
+{
+//	Retrieves the number of MDATs in the file. This is the number of files that ExtractAllMdats() will create.
+	OMFOOAPI GetMdatCount(__out PULONG pnMdats)= 0;
+
+//	Extracts the embedded payload of every MDAT in the file into the folder specified by pwzDestFolder.
+//	The folder must already exist. Each file is named according to dwSyntax, which is the same as the dwSyntax
+//	argument of IOmfMediaData::CreateFileNameForExport() except that syntax #0 (extension only) is not allowed.
+//	If a file with the same name already exists and fOverwrite is TRUE then that file will be overwritten.
+//	Otherwise this fails with HRESULT_FROM_WIN32(ERROR_FILE_EXISTS), and files that were already completed are kept.
+//	The pCallback argument is optional. See IOmfooBulkExtractCallback (above) for details.
+//	The nPagesPerBuffer argument is optional. It's the size of each buffer in the pool measured in 4096-byte pages.
+//	It must be in the range of 0~7200 inclusive, or this will return E_INVALIDARG. Zero means use the default.
+	OMFOOAPI ExtractAllMdats(__in PCWSTR pwzDestFolder,
+								__in DWORD dwSyntax,
+									__in BOOL fOverwrite,
+										__in_opt IOmfooBulkExtractCallback *pCallback,
+											__in_opt ULONG nPagesPerBuffer)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooBulkAliasCallback
+//	If you call IOmfooBulkExtractor2::ExtractUniqueMdats() with BXF_REPORT_CLONES or BXF_REPORT_NESTED then your
+//	IOmfooBulkExtractCallback object must also expose this interface. Omfoo does not provide this.
+//*********************************************************************************************************************
+struct __declspec(uuid("D2E85B3F-4A61-47c9-8B0D-3E7F19C6A5B4")) IOmfooBulkAliasCallback;
+interface IOmfooBulkAliasCallback : public IUnknown
+{
+//	Called once for each MDAT that was not written because its payload is already in another file.
+//	pwzAliasPath is the path that the MDAT's file would have had. pwzTargetPath is the file that holds its payload,
+//	and the payload is the cbLength bytes that begin cbOffset bytes into that file. For a clone cbOffset is always
+//	zero and cbLength is the length of the whole target file. Both strings belong to Omfoo and are only valid until
+//	this method returns. This is called after all of the target files have been completely written and closed.
+//	Your implementation should return S_OK to continue, or return E_ABORT to stop. Files are not deleted.
+	OMFOOAPI AliasFound(__in PCWSTR pwzAliasPath,
+							__in PCWSTR pwzTargetPath,
+								__in UINT64 cbOffset,
+									__in UINT64 cbLength)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooBulkExtractor2
+//	Inherits IOmfooBulkExtractor
+//	Available in OMF1 and OMF2.
+//	Some OMF files (mostly OMF1) have several MDATs that point to the very same payload - we call them clones - or
+//	MDATs whose payloads live entirely inside another MDAT's payload - we call them nested MDATs. ExtractAllMdats()
+//	writes every one of them out in full. This interface adds a method that writes each unique payload just once.
+//	All methods return E_HANDLE if IOmfooReader::Load() has not been called.
+//*********************************************************************************************************************
+struct __declspec(uuid("6B1F4C8A-E357-4d02-9A6E-0C2D84F7B193")) IOmfooBulkExtractor2;
+interface IOmfooBulkExtractor2 : public IOmfooBulkExtractor
+{
+//	Same as ExtractAllMdats() except for the dwDedupFlags argument, which is any combination of the BXF_ flags in
+//	Omfoo_Enumerated_Types.h. If it's zero then this behaves exactly like ExtractAllMdats().
+//	BXF_LINK_CLONES - Each set of clones is read and written once. The other names are created as hard links to the
+//		first file. If the destination volume can't do hard links then they are copied from the first file instead,
+//		which at least does not read the OMF file again.
+//	BXF_REPORT_CLONES - Each set of clones is read and written once. The other names are not created. Instead they
+//		are reported to your IOmfooBulkAliasCallback. This can't be combined with BXF_LINK_CLONES.
+//	BXF_REPORT_NESTED - Nested MDATs are not created. Instead they are reported to your IOmfooBulkAliasCallback as
+//		ranges of the file that holds their parent's payload.
+//	A clone or nested MDAT is only treated this way if its new file would be byte-for-byte identical to the bytes
+//	that it refers to. For example a nested AIFC or WAVE payload whose FORM/RIFF ckSize needs patching is always
+//	written in full.
+//	Returns E_INVALIDARG if dwDedupFlags is not valid, or if it has BXF_REPORT_CLONES or BXF_REPORT_NESTED but
+//	pCallback does not expose IOmfooBulkAliasCallback.
+	OMFOOAPI ExtractUniqueMdats(__in PCWSTR pwzDestFolder,
+									__in DWORD dwSyntax,
+										__in DWORD dwDedupFlags,
+											__in BOOL fOverwrite,
+												__in_opt IOmfooBulkExtractCallback *pCallback,
+													__in_opt ULONG nPagesPerBuffer)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooWaveformCallback
+//	This object receives the waveform overviews from IOmfooWaveformBuilder::BuildWaveforms().
+//	Omfoo does not provide this. You must implement this interface yourself - and pass it to BuildWaveforms().
+//*********************************************************************************************************************
+struct __declspec(uuid("3C9E51D7-8A24-4f6b-B0E3-92D6F1A4C85E")) IOmfooWaveformCallback;
+interface IOmfooWaveformCallback : public IUnknown
+{
+//	Called once for each MDAT that holds uncompressed PCM audio, in the order that their payloads appear in the file.
+//	It's always called on the thread that called BuildWaveforms(), so your implementation does not need to be
+//	thread-safe. dwMdatObject is the MDAT's object ID (see IOmfooFastReader) and pFormat describes its samples.
+//	aPeaks[] holds nPeaks blocks of pFormat->wChannels elements - the channels of each block are interleaved just
+//	like the samples. The last block may have fewer frames than the others. pFormat and aPeaks[] belong to Omfoo and
+//	are only valid until this method returns.
+//	Your implementation should return S_OK to continue, or return E_ABORT to cancel the rest of the waveforms.
+	OMFOOAPI WaveformReady(__in DWORD dwMdatObject,
+							__in POMFOO_PCM_FORMAT pFormat,
+								__in ULONG nPeaks,
+									__in POMFOO_WAVEFORM_PEAK aPeaks)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooWaveformBuilder
+//	Available in OMF1 and OMF2.
+//	This interface computes the waveform overviews of every audio MDAT in the file in a single call.
+//	It is exposed by the Container, so you get it by calling QueryInterface() on your IOmfooReader.
+//	All methods return E_HANDLE if IOmfooReader::Load() has not been called.
+//*********************************************************************************************************************
+struct __declspec(uuid("A7F2D846-1B5C-4e39-9D70-6E8B3C0F21A4")) IOmfooWaveformBuilder;
+interface IOmfooWaveformBuilder : public IUnknown
+{
+//	Summarizes every nSamplesPerPeak sample frames of each channel of each MDAT that holds uncompressed PCM audio (see
+//	IOmfMediaDataSamples) with their minimum, maximum, and RMS, and reports them to pCallback. MDATs that don't hold
+//	uncompressed PCM audio are skipped. The nSamplesPerPeak argument must be in the range of 16~1048576 inclusive,
+//	or this will return E_INVALIDARG.
+//	The payloads are decoded by worker threads from the Windows thread pool. Each thread claims the next payload in
+//	file order, and reads it from front to back. The nThreads argument is the maximum number of worker threads. Zero
+//	means one for each processor (up to eight), and one means do everything on the calling thread.
+//	Returns E_ABORT if your callback does.
+	OMFOOAPI BuildWaveforms(__in ULONG nSamplesPerPeak,
+								__in ULONG nThreads,
+									__in IOmfooWaveformCallback *pCallback)= 0;
+};
+
 //*********************************************************************************************************************
 //	IOmfObject
 //	Available in OMF1 and OMF2.
@@ -109,11 +349,12 @@ interface IOmfooReader : public IUnknown
 //	of the object that it represents or the data that it retrieves.
 //	All OMF objects int the Omfoo DLL expose this interface.
 //*********************************************************************************************************************
-struct __declspec(uuid("3F069D94-DBBB-422a-94CC-73AE0FE4C5DD")) IOmfObject;
+struct __declspec(uuid("A6F0D3A1-2C7E-4b59-9E0B-5D4F81C2E7B6")) IOmfObject;
 interface IOmfObject : public IUnknown
 {
 //	Retrieves the object's container, queries it for the interface specified by riid, and then returns the result.
-//	The current implementation of the Container only exposes IOmfooReader but other interfaces may be added later.
+//	The current implementation of the Container exposes IOmfooReader, IOmfooFastReader, IOmfooBulkExtractor,
+//	IOmfooBulkExtractor2, and IOmfooWaveformBuilder.
 //	Use this routine to navigate from an IOmfObject back to the IOmfooReader that owns it.
 	OMFOOAPI GetContainer(__in REFIID riid, __out PVOID *ppvOut)= 0;
 
@@ -343,6 +584,13 @@ interface IOmfObject : public IUnknown
 //	OMF1 only - Creates an iterator to instantiate the objects in the specified mob index array.
 //	The OMF data type must be omfi:MobIndex or this method will fail with the return code OMF_E_TYPE_SURPRISE.
 	OMFOOAPI IterateMobIndexArray(__in LPCSTR pszPropertyName, __out IOmfooIterator **ppIterator)= 0;
+
+//	Batch version of ReadRawBytes(). Retrieves several properties from this object in one call.
+//	The aRequests argument points to an array of nRequests OMFOO_PROPERTY_REQUEST structures (see Omfoo_Structures.h).
+//	All requests are resolved in one pass, and the payloads that live in the file are read in as few disk reads as
+//	possible. Each request gets its own HRESULT, so one missing property does not spoil the rest.
+//	Returns S_OK if every request succeeded, or S_FALSE if at least one of them failed.
+	OMFOOAPI ReadProperties(__in ULONG nRequests, __inout POMFOO_PROPERTY_REQUEST aRequests)= 0;
 };
 
 //*********************************************************************************************************************
@@ -2079,6 +2327,55 @@ interface IOmfooExtractCallback : public IUnknown
 	OMFOOAPI UpdateProgress(__in UINT64 cbCompleted, __in UINT64 cbTotal)= 0;
 };
 
+//*********************************************************************************************************************
+//	IOmfooExtractSink
+//	This is the push-style counterpart of ExtractDataToFile(). It lets your application receive an MDAT's payload in
+//	a series of buffers during your calls to IOmfMediaDataStreamer::ExtractDataToSink(), without a temporary file.
+//	You can use it to feed a ring buffer, a pipe, a socket, a decoder, or whatever. Omfoo does not provide this.
+//	If you want to use this feature you must implement this interface yourself - and pass it to ExtractDataToSink().
+//	Both methods are called from your calling thread.
+//*********************************************************************************************************************
+struct __declspec(uuid("5C2B7A4E-9D16-4f03-B8E1-7A3D60C94F52")) IOmfooExtractSink;
+interface IOmfooExtractSink : public IUnknown
+{
+//	Called once for each buffer, in payload order. Every buffer is exactly as long as the cbChunkSize argument that
+//	you passed to ExtractDataToSink() except for the last one, which may be shorter. The IFF ckSize kludge has already
+//	been applied, so the bytes you receive are exactly the same as the bytes that ExtractDataToFile() would write.
+//	The buffer belongs to Omfoo and it is only valid until this method returns. So copy what you need.
+//	Your implementation should return S_OK to continue, or return any failure code to stop the extraction.
+	OMFOOAPI WriteData(__in_bcount(cbData) LPCVOID pData, __in ULONG cbData)= 0;
+
+//	Called exactly once when the extraction is over - whether it succeeded or not - so you can flush or close
+//	whatever you were writing to. The hrStatus argument is the same HRESULT that ExtractDataToSink() will return.
+//	If your WriteData() method stopped the extraction then hrStatus will be E_ABORT. Your return value is ignored.
+	OMFOOAPI Complete(__in HRESULT hrStatus)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooDigestCallback
+//	This lets your application get checksums of the files that Omfoo extracts without reading those files again.
+//	Omfoo does not provide this. If you want to use this feature then the callback object that you pass to
+//	IOmfMediaData::ExtractDataToFile(), IOmfMediaDataRange::ExtractRangeToFile(), or
+//	IOmfooBulkExtractor::ExtractAllMdats() must also expose this interface. Those methods query their callback for it,
+//	and if they find it then they hash each buffer on its way to the destination file. So every payload is read from
+//	the OMF file exactly once. The hashed bytes are exactly the bytes in the new file, including the patched IFF ckSize.
+//	Asking for digests turns off the block cloning in ExtractDataToFile(), because a clone never reads the payload.
+//	Both methods are called from your calling thread.
+//*********************************************************************************************************************
+struct __declspec(uuid("9A4E6C21-7D3B-4f58-B0E9-C15F82A7D34E")) IOmfooDigestCallback;
+interface IOmfooDigestCallback : public IUnknown
+{
+//	Called once at the start of each extraction. Set *pdwDigestKinds to any combination of the DK_ flags declared in
+//	Omfoo_Enumerated_Types.h. If you set it to zero (or return a failure code) then nothing is hashed and
+//	DigestsReady() is never called.
+	OMFOOAPI GetDigestKinds(__out PDWORD pdwDigestKinds)= 0;
+
+//	Called once for each new file after it has been completely written, truncated, and closed. pwzFullPath is the
+//	path of that file. The path and the structure both belong to Omfoo and they are only valid until this method
+//	returns. It is not called for files that were not completed. Your return value is ignored.
+	OMFOOAPI DigestsReady(__in PCWSTR pwzFullPath, __in const OMFOO_EXTRACT_DIGESTS *pDigests)= 0;
+};
+
 //*********************************************************************************************************************
 //	IOmfMediaData
 //	Available in OMF1 and OMF2.
@@ -2113,6 +2410,9 @@ interface IOmfMediaData : public IUnknown
 //	It's made possible because IOmfooReader::Load() opens the OMF file with read-only/share access rights.
 //	The handle this method returns also has read-only/share access rights.
 //	You MUST call CloseHandle() when you are done using the handle.
+//	These are the raw bytes, exactly as they appear in the OMF file. Some AIFC and WAVE payloads have a FORM/RIFF
+//	ckSize that describes the entire OMF file instead of the payload. ExtractDataToFile() and CreateStreamOnData()
+//	correct it for you, but if you read the payload yourself then you'll have to deal with it yourself.
 	OMFOOAPI GetRawFileParams(__out PUINT64 pOffset, __out PUINT64 pLength, __out_opt PHANDLE pHandle)= 0;
 
 //	Extracts the embedded data to a file.
@@ -2158,7 +2458,10 @@ interface IOmfMediaData : public IUnknown
 													__out_opt PULONG pcchRequired)= 0;
 
 //	Creates a Windows Stream object on the MDAT's embedded payload and queries it for the interface specified by riid.
-//	This implementation exposes IStream and ISequentialStream.
+//	This implementation exposes IStream, ISequentialStream, and IOmfooStreamReadAhead.
+//	The stream returns the same bytes that ExtractDataToFile() would write, so if the payload is an AIFC or WAVE file
+//	with a broken FORM/RIFF ckSize then the stream shows the corrected value. The rest of the payload is read directly
+//	from the OMF file. Nothing is copied.
 	OMFOOAPI CreateStreamOnData(__in REFIID riid, __out PVOID *ppvOut)= 0;
 
 //	Creates a DirectShow source filter on the subclass's payload that can be used with the DirectShow API.
@@ -2166,6 +2469,266 @@ interface IOmfMediaData : public IUnknown
 	OMFOOAPI CreateDShowSourceFilterOnData(__in REFIID riid, __out PVOID *ppvOut)= 0;
 };
 
+//*********************************************************************************************************************
+//	IOmfMediaDataStreamer
+//	Available in OMF1 and OMF2.
+//	Every object that exposes IOmfMediaData (or any interface that inherits it) also exposes this interface.
+//	It pushes the MDAT's payload to an object that you provide. See IOmfooExtractSink (above) for details.
+//*********************************************************************************************************************
+struct __declspec(uuid("E1A94D37-6B20-4c8e-9F57-2D08C3B6A1F9")) IOmfMediaDataStreamer;
+interface IOmfMediaDataStreamer : public IUnknown
+{
+//	Reads the embedded payload and passes it to pSink->WriteData() in buffers of cbChunkSize bytes each.
+//	The reads are double-buffered, so the next buffer is already being read while your WriteData() is running.
+//	The cbChunkSize argument is optional. It must be in the range of 0~29491200 inclusive, or this will return
+//	E_INVALIDARG. Zero means use the default (1MB). It does not need to be a multiple of anything.
+//	Returns E_ABORT if pSink->WriteData() stopped the extraction.
+	OMFOOAPI ExtractDataToSink(__in IOmfooExtractSink *pSink, __in_opt ULONG cbChunkSize)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfMediaDataRange
+//	Available in OMF1 and OMF2.
+//	Every object that exposes IOmfMediaData (or any interface that inherits it) also exposes this interface.
+//	These are the same as their IOmfMediaData counterparts, except that they only cover part of the MDAT's payload.
+//	The range begins cbOffset bytes into the payload and is cbLength bytes long. Only the bytes in that range are
+//	read from the OMF file. If the range does not lie entirely inside the payload these return E_INVALIDARG.
+//	Use IOmfMediaData::GetRawFileParams() to get the length of the payload.
+//*********************************************************************************************************************
+struct __declspec(uuid("3F7C9B12-08A4-4d6e-A1C5-96E2B04D7F38")) IOmfMediaDataRange;
+interface IOmfMediaDataRange : public IUnknown
+{
+//	Same as IOmfMediaData::ExtractDataToFile(). The new file is cbLength bytes long, and cbLength can't be zero.
+//	If the range includes the FORM/RIFF ckSize member of an AIFC or WAVE payload then it's patched just as it would be
+//	by ExtractDataToFile(). The callback's cbTotal argument is cbLength.
+	OMFOOAPI ExtractRangeToFile(__in UINT64 cbOffset,
+									__in UINT64 cbLength,
+										__in PCWSTR pwzFullPathNewFile,
+											__in_opt IOmfooExtractCallback *pCallback,
+												__in_opt ULONG nPagesPerCallback,
+													__in BOOL fOverwrite)= 0;
+
+//	Same as IOmfMediaData::CreateStreamOnData(). Stream position zero is the first byte of the range, and the stream
+//	reports its size as cbLength. This implementation exposes IStream, ISequentialStream, and IOmfooStreamReadAhead.
+//	The FORM/RIFF ckSize member is patched just as it is by ExtractRangeToFile().
+	OMFOOAPI CreateStreamOnDataRange(__in UINT64 cbOffset,
+										__in UINT64 cbLength,
+											__in REFIID riid,
+												__out PVOID *ppvOut)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfooStreamReadAhead
+//	Available in OMF1 and OMF2.
+//	This is exposed by the streams that IOmfMediaData::CreateStreamOnData() and
+//	IOmfMediaDataRange::CreateStreamOnDataRange() create. Query the stream for it.
+//	When you read the stream sequentially in small pieces, the stream reads ahead of you into two memory banks with
+//	overlapped I/O, so that your next Read() is usually satisfied from memory. Read-ahead only starts after a few
+//	back-to-back sequential reads, and reads that are as large as a bank always go straight to the OMF file.
+//*********************************************************************************************************************
+struct __declspec(uuid("140E105A-E2D7-4f50-AC27-6B384283CAD8")) IOmfooStreamReadAhead;
+interface IOmfooStreamReadAhead : public IUnknown
+{
+//	Sets the size of each read-ahead bank in bytes. The default is 262144 (256KB). Zero turns read-ahead off.
+//	Values larger than 16777216 (16MB) are clamped to 16MB. The stream uses two banks, so it can allocate up to
+//	twice this much memory. Anything that has already been read ahead is discarded. Clones of the stream (see
+//	IStream::Clone()) inherit the size that is in effect when they are created.
+	OMFOOAPI SetReadAheadSize(__in ULONG cbReadAhead)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfMediaDataFrames
+//	Available in OMF1 and OMF2.
+//	This is exposed by the objects that expose IOmfIdatData (including IOmfJpegData, IOmfMpegData, and IOmfRleiData),
+//	and by the objects that expose IOmfTiffData. It provides random access to individual frames without any decoding,
+//	and without making the caller read the frame index and call GetRawFileParams(). The MDAT's frame index is read and
+//	validated once, the first time any of these methods are called, and then it's cached for the life of the
+//	container - even if this object is released.
+//	If the MDAT doesn't have a frame index then these return OMF_E_PROP_NOT_FOUND. If the frame index is malformed
+//	then they return OMF_E_BAD_ARRAY.
+//
+//	JFIF payloads (a JPEG MDAT with a JPED media descriptor) are the exception. If the frame index is missing or
+//	malformed, or if the first and last frames don't begin with an SOI marker, then the payload is scanned for
+//	SOI and EOI markers instead, and the frames are wherever the scan found them. The scan reads the whole payload,
+//	so the first call can take a while. After that it's cached just like a frame index.
+//
+//	DV and uncompressed video (a JPEG MDAT with a CDCI media descriptor and DV/C compression, or an IDAT MDAT with an
+//	uncompressed CDCI or RGBA media descriptor) don't use a frame index at all. Every frame is the same size, so the
+//	frame size is computed from the media descriptor, and every answer is simple arithmetic.
+//
+//	TIFF payloads (a TIFF MDAT with a TIFD media descriptor) are mapped from the TIFF file's own strip offsets. See
+//	IOmfTiffImageIndex. If the TIFF file has one image then each strip is a frame, which is how OMF stores TIFF video.
+//	Otherwise each image is a frame, and it begins with the image's first strip. Either way a frame can include the
+//	padding (or the IFD) that follows it. If the strips aren't in ascending order then these return OMF_E_BAD_ARRAY.
+//
+//	Frame offsets are measured from the first byte of the payload, so they can be passed to IOmfMediaDataRange.
+//	Frames are always back to back - each frame ends where the next one begins. The last frame ends at the end of
+//	the payload, except for fixed-size frames - any leftover bytes after the last whole frame aren't in any frame.
+//*********************************************************************************************************************
+struct __declspec(uuid("8A2623F4-0194-43f0-B6AE-B7E62D3FEB30")) IOmfMediaDataFrames;
+interface IOmfMediaDataFrames : public IUnknown
+{
+//	Retrieves the number of frames.
+	OMFOOAPI GetFrameCount(__out PULONG pnFrames)= 0;
+
+//	Retrieves the offset and size of frame iFrame. Returns E_INVALIDARG if iFrame is out of range.
+	OMFOOAPI GetFrameExtent(__in ULONG iFrame,
+								__out PUINT64 pcbOffset,
+									__out PULONG pcbLength)= 0;
+
+//	Reads frame iFrame into caller's buffer. On exit pcbRequired holds the size of the frame.
+//	If pBuffer is NULL or cbBuffer is too small this returns OMF_E_INSUFFICIENT_BUFFER.
+	OMFOOAPI ReadFrame(__in ULONG iFrame,
+							__in ULONG cbBuffer,
+								__out_opt PVOID pBuffer,
+									__out PULONG pcbRequired)= 0;
+
+//	Reads nFrames consecutive frames beginning with iFirstFrame into caller's buffer, back to back, with one read.
+//	On exit pcbRequired holds the total size of the frames. The aFrameLengths argument is optional. If it's not NULL
+//	then it must point to an array of nFrames ULONGs, which receives the size of each frame.
+//	If pBuffer is NULL or cbBuffer is too small this returns OMF_E_INSUFFICIENT_BUFFER.
+	OMFOOAPI ReadFrames(__in ULONG iFirstFrame,
+							__in ULONG nFrames,
+								__in ULONG cbBuffer,
+									__out_opt PVOID pBuffer,
+										__out_opt PULONG aFrameLengths,
+											__out PULONG pcbRequired)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfMpegPictureIndex
+//	Available in OMF2 only.
+//	This is exposed by the objects that expose IOmfMpegData.
+//	It describes every picture and every group of pictures (GOP) in an MPEG video elementary stream, so that the
+//	stream can be cut at GOP boundaries without a demuxer or a decoder. The index is built the first time any of
+//	these methods are called, by scanning the whole payload for sequence headers, GOP headers, and picture headers.
+//	So the first call can take a while. After that it's cached for the life of the container. If the media descriptor
+//	is not an MPGI, or if the payload doesn't contain any pictures, then these return OMF_E_CANT_COMPLETE.
+//
+//	Pictures are listed in the order that they are stored (decode order). Each picture begins with the headers in
+//	front of it, so pictures and GOPs are always back to back. If the stream has no GOP headers then every I picture
+//	begins a new GOP. The first picture always begins the first GOP.
+//*********************************************************************************************************************
+struct __declspec(uuid("5E0C3B71-A9D2-4c86-8F14-27D6B0E95A4C")) IOmfMpegPictureIndex;
+interface IOmfMpegPictureIndex : public IUnknown
+{
+//	Retrieves the number of pictures.
+	OMFOOAPI GetPictureCount(__out PULONG pnPictures)= 0;
+
+//	Retrieves the position, size, and type of picture iPicture. Returns E_INVALIDARG if iPicture is out of range.
+	OMFOOAPI GetPictureInfo(__in ULONG iPicture,
+								__out POMFOO_MPEG_PICTURE_INFO pInfo)= 0;
+
+//	Retrieves the number of GOPs.
+	OMFOOAPI GetGopCount(__out PULONG pnGops)= 0;
+
+//	Retrieves the position and size of GOP iGop, and the sequence header that applies to it.
+//	Returns E_INVALIDARG if iGop is out of range.
+	OMFOOAPI GetGopInfo(__in ULONG iGop,
+							__out POMFOO_MPEG_GOP_INFO pInfo)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfTiffImageIndex
+//	Available in OMF1 and OMF2.
+//	This is exposed by the objects that expose IOmfTiffData.
+//	It describes every image in an embedded TIFF file, and provides random access to each image's strips (or tiles)
+//	without reading the whole payload. The TIFF header and its chain of image file directories (IFDs) are parsed in
+//	either byte order the first time any of these methods are called, and then the index is cached for the life of
+//	the container. Only classic TIFF is supported, not BigTIFF. If the media descriptor is not a TIFD, or if the
+//	payload is not a TIFF file, then these return OMF_E_CANT_COMPLETE. If an IFD is malformed, or if a strip doesn't
+//	lie entirely inside the payload, then they return OMF_E_BAD_ARRAY.
+//
+//	Images are numbered in the order of the IFD chain. Strips are numbered in the order that their IFD lists them.
+//	Offsets are measured from the first byte of the payload (which is the TIFF header), so they can be passed to
+//	IOmfMediaDataRange.
+//*********************************************************************************************************************
+struct __declspec(uuid("5896F0F5-ECAA-470b-9037-1FC36EAC8787")) IOmfTiffImageIndex;
+interface IOmfTiffImageIndex : public IUnknown
+{
+//	Retrieves the number of images.
+	OMFOOAPI GetImageCount(__out PULONG pnImages)= 0;
+
+//	Retrieves the dimensions, format, and number of strips of image iImage.
+//	Returns E_INVALIDARG if iImage is out of range.
+	OMFOOAPI GetImageInfo(__in ULONG iImage,
+							__out POMFOO_TIFF_IMAGE_INFO pInfo)= 0;
+
+//	Retrieves the offset and size of strip (or tile) iStrip of image iImage.
+//	Returns E_INVALIDARG if iImage or iStrip is out of range.
+	OMFOOAPI GetStripExtent(__in ULONG iImage,
+								__in ULONG iStrip,
+									__out PUINT64 pcbOffset,
+										__out PULONG pcbLength)= 0;
+
+//	Reads nStrips consecutive strips of image iImage beginning with iFirstStrip into caller's buffer, back to back.
+//	Strips that are adjacent in the payload are read together. On exit pcbRequired holds the total size of the strips.
+//	The aStripLengths argument is optional. If it's not NULL then it must point to an array of nStrips ULONGs, which
+//	receives the size of each strip. If pBuffer is NULL or cbBuffer is too small this returns OMF_E_INSUFFICIENT_BUFFER.
+	OMFOOAPI ReadStrips(__in ULONG iImage,
+							__in ULONG iFirstStrip,
+								__in ULONG nStrips,
+									__in ULONG cbBuffer,
+										__out_opt PVOID pBuffer,
+											__out_opt PULONG aStripLengths,
+												__out PULONG pcbRequired)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfMediaDataSamples
+//	Available in OMF1 and OMF2.
+//	This is exposed by the objects that expose IOmfAifcData, IOmfWaveData, and IOmfSd2fData.
+//	It reads any range of sample frames from an uncompressed audio payload, and converts the samples to 16-bit
+//	integers, 32-bit integers, or 32-bit floats - so the caller doesn't have to parse the embedded file's header or
+//	care about its byte order. The header is parsed once, the first time any of these methods are called, and then
+//	it's cached for the life of the container. Only the bytes that hold the requested frames are read.
+//	If the payload is compressed, or if its header is malformed, then these return OMF_E_CANT_COMPLETE.
+//*********************************************************************************************************************
+struct __declspec(uuid("B4D1E6A8-2C7F-4e93-9A05-61F3C8D2B7E4")) IOmfMediaDataSamples;
+interface IOmfMediaDataSamples : public IUnknown
+{
+//	Describes the stored samples.
+	OMFOOAPI GetSampleFormat(__out POMFOO_PCM_FORMAT pFormat)= 0;
+
+//	Reads nFrames sample frames, starting with iFirstFrame, into caller's buffer. The samples are converted to dwFormat
+//	(PCM_FORMAT_INT16, etc.) and the channels are interleaved. Returns E_INVALIDARG if iFirstFrame is out of range.
+//	If the run goes past the last frame then it's clipped, and *pnFramesRead says how many frames were read.
+//	If pBuffer is NULL or cbBuffer is too small then this returns OMF_E_INSUFFICIENT_BUFFER.
+	OMFOOAPI GetSampleFrames(__in UINT64 iFirstFrame,
+								__in ULONG nFrames,
+									__in DWORD dwFormat,
+										__in ULONG cbBuffer,
+											__out_opt PVOID pBuffer,
+												__out PULONG pnFramesRead)= 0;
+};
+
+//*********************************************************************************************************************
+//	IOmfMediaDataContainer
+//	Available in OMF1 and OMF2.
+//	This is exposed by the objects that expose IOmfAifcData, IOmfWaveData, IOmfSd2fData, and IOmfIdatData.
+//	Some payloads are just samples or frames with no usable header - an SD2 file's header is in its resource fork, and
+//	an IDAT's header is in its MDES. These methods wrap the payload in a container that other tools can open.
+//	Nothing is copied or converted. The header is generated in memory and read in front of the stored bytes.
+//*********************************************************************************************************************
+struct __declspec(uuid("5E2A9C71-D4B3-4f08-8C6E-07A1B9F3D25C")) IOmfMediaDataContainer;
+interface IOmfMediaDataContainer : public IUnknown
+{
+//	Creates a read-only stream on the payload wrapped in dwContainer (SYNTH_CONTAINER_AUTO, etc.), and then queries it
+//	for riid. Because the samples are never byte-swapped, WAVE and RF64 need little-endian samples and AIFF needs
+//	big-endian samples. SYNTH_CONTAINER_AUTO picks one that fits. If the payload won't fit in dwContainer, or if
+//	there's no sample layout or fixed frame size, then this returns OMF_E_CANT_COMPLETE.
+	OMFOOAPI CreateStreamOnContainer(__in DWORD dwContainer,
+										__in REFIID riid,
+											__out PVOID *ppvOut)= 0;
+
+//	Describes the frames in the SYNTH_CONTAINER_RAW_VIDEO stream as ffmpeg input options. For example:
+//	"-f rawvideo -pixel_format uyvy422 -video_size 720x486 -framerate 30000/1001"
+//	Returns OMF_E_CANT_COMPLETE if the pixel format has no name, or if the frames are padded or stored as two fields.
+	OMFOOAPI GetRawVideoSidecar(__in ULONG cchBuffer,
+									__out_opt PWCHAR pBuffer,
+										__out_opt PULONG pcchRequired)= 0;
+};
+
 //*********************************************************************************************************************
 //	IOmfAifcData
 //	Inherits IOmfMediaData
@@ -2205,6 +2768,7 @@ struct __declspec(uuid("727A4AA5-CF6E-4124-A365-54C4D25244E1")) IOmfTiffData;
 interface IOmfTiffData : public IOmfMediaData
 {
 //	Note that the OMFI:TIFF:ImageData property is accessible from IOmfMediaData (see above).
+//	The embedded TIFF file's images and strips are accessible from IOmfTiffImageIndex and IOmfMediaDataFrames.
 //	There are no additional methods.
 };
 
@@ -2257,6 +2821,8 @@ interface IOmfJpegData : public IOmfIdatData
 //	Retrieves the OMFI:JPEG:FrameIndexExt or OMFI:JPEG:FrameIndex property as an array of UINT64s.
 //	The data type can be omfi:Position32Array or omfi:Position64Array.
 //	If the data type is omfi:Position32Array then the 32-bit values are zero-padded to 64 bits.
+//	If neither property exists (or is malformed) and the payload is JFIF then this returns the offset of each frame
+//	as found by scanning the payload for SOI markers. See IOmfMediaDataFrames.
 	OMFOOAPI ReadFrameIndexArray64(__in ULONG nMaxElements,
 										__out_opt PUINT64 pArrayBase,
 											__out PULONG pnActualElements)= 0;
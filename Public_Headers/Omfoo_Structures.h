@@ -72,4 +72,92 @@ typedef BYTE OMF_COMP_SIZE_ARRAY[8], *POMF_COMP_SIZE_ARRAY;
 
 #pragma pack(pop)		// restore compiler's previous structure alignment settings
 
+//	OMFOO STRUCTURES
+//	These are not OMF data types. They are used to pass arguments to (and results from) the Omfoo API.
+
+//	IOmfObject::ReadProperties() takes an array of these.
+//	The [in] members are never modified. The [out] members are always overwritten.
+typedef struct {
+	LPCSTR	pszPropertyName;	// [in] the property name, for example "OMFI:CPNT:Length".
+	LPCSTR	pszDataType;		// [in] the required OMF data type, for example "omfi:Length32", or NULL for any type.
+	PVOID	pBuffer;			// [in] caller's buffer. Receives the raw payload (not byte-swapped). Can be NULL.
+	ULONG	cbBuffer;			// [in] the size of caller's buffer, as measured in bytes.
+	ULONG	cbRequired;			// [out] the size of the payload, as measured in bytes.
+	HRESULT	hr;					// [out] the result for this property. Same error codes as IOmfObject::ReadRawBytes().
+} OMFOO_PROPERTY_REQUEST, *POMFOO_PROPERTY_REQUEST;
+
+//	IOmfooDigestCallback::DigestsReady() receives one of these for each extracted file.
+//	Only the members whose DK_ flags are set in dwDigestKinds are valid. The others are zero.
+typedef struct {
+	DWORD	dwDigestKinds;		// the DK_ flags that were computed. See Omfoo_Enumerated_Types.h.
+	DWORD	dwCrc32c;			// valid if DK_CRC32C is set.
+	UINT64	qwXxh64;			// valid if DK_XXH64 is set.
+	BYTE	aSha256[32];		// valid if DK_SHA256 is set. Most significant byte first, just like sha256sum prints it.
+	UINT64	cbHashed;			// the number of bytes that were hashed. This is always the length of the file.
+} OMFOO_EXTRACT_DIGESTS, *POMFOO_EXTRACT_DIGESTS;
+
+//	IOmfMpegPictureIndex::GetPictureInfo() fills in one of these.
+//	Offsets are measured from the first byte of the payload, so they can be passed to IOmfMediaDataRange.
+typedef struct {
+	UINT64	cbOffset;			// where the picture begins, including any sequence header or GOP header in front of it.
+	UINT64	cbLength;			// the size of the picture. It ends where the next picture begins.
+	ULONG	iGop;				// index of the GOP that the picture belongs to.
+	DWORD	dwFlags;			// MPX_SEQUENCE_HEADER and/or MPX_GOP_HEADER. See Omfoo_Enumerated_Types.h.
+	WORD	wTemporalReference;	// the picture header's temporal_reference (its display order within the GOP).
+	BYTE	bPictureType;		// the picture header's picture_coding_type: 1 = I, 2 = P, 3 = B, 4 = D.
+	BYTE	bReserved;			// always zero.
+} OMFOO_MPEG_PICTURE_INFO, *POMFOO_MPEG_PICTURE_INFO;
+
+//	IOmfMpegPictureIndex::GetGopInfo() fills in one of these.
+//	Offsets are measured from the first byte of the payload, so they can be passed to IOmfMediaDataRange.
+typedef struct {
+	UINT64	cbOffset;				// where the GOP's first picture begins.
+	UINT64	cbLength;				// the size of the GOP. It ends where the next GOP begins.
+	UINT64	cbSequenceHeaderOffset;	// the most recent sequence header at or before the GOP's first picture.
+	ULONG	cbSequenceHeaderLength;	// the size of that sequence header and its extensions, or zero if there isn't one.
+	ULONG	iFirstPicture;			// index of the GOP's first picture.
+	ULONG	nPictures;				// number of pictures in the GOP.
+	DWORD	dwFlags;				// MPX_GOP_HEADER, MPX_CLOSED_GOP, etc. See Omfoo_Enumerated_Types.h.
+} OMFOO_MPEG_GOP_INFO, *POMFOO_MPEG_GOP_INFO;
+
+//	IOmfTiffImageIndex::GetImageInfo() fills in one of these.
+//	The members are copied from the image's IFD. If the IFD doesn't have an optional field then its member holds the
+//	default value from the TIFF 6.0 specification. The image is tiled if nTileWidth is not zero.
+typedef struct {
+	UINT64	cbIfdOffset;		// where the image file directory begins, measured from the first byte of the payload.
+	ULONG	nWidth;				// ImageWidth.
+	ULONG	nLength;			// ImageLength.
+	ULONG	nStrips;			// the number of strips - or tiles, if the image is tiled.
+	ULONG	nRowsPerStrip;		// RowsPerStrip, or zero if the image is tiled.
+	ULONG	nTileWidth;			// TileWidth, or zero if the image is stored in strips.
+	ULONG	nTileLength;		// TileLength, or zero if the image is stored in strips.
+	WORD	wCompression;		// Compression: 1 = none, 5 = LZW, 6 = old-style JPEG, 7 = JPEG, 32773 = PackBits, etc.
+	WORD	wPhotometric;		// PhotometricInterpretation: 1 = BlackIsZero, 2 = RGB, 6 = YCbCr, etc.
+	WORD	wBitsPerSample;		// the first element of BitsPerSample.
+	WORD	wSamplesPerPixel;	// SamplesPerPixel.
+	WORD	wPlanarConfig;		// PlanarConfiguration: 1 = chunky, 2 = planar.
+	WORD	wReserved;			// always zero.
+} OMFOO_TIFF_IMAGE_INFO, *POMFOO_TIFF_IMAGE_INFO;
+
+//	IOmfMediaDataSamples::GetSampleFormat() fills in one of these.
+//	A sample frame holds one sample for each channel. The samples in a frame are stored back to back.
+typedef struct {
+	UINT64	nSampleFrames;		// number of sample frames in the payload.
+	UINT64	cbDataOffset;		// where the first sample frame begins, measured from the first byte of the payload.
+	ULONG	nSamplesPerSec;		// the sample rate, rounded to the nearest whole number.
+	WORD	wChannels;			// number of channels.
+	WORD	wBitsPerSample;		// number of significant bits in each stored sample.
+	WORD	wBytesPerSample;	// number of bytes used to store each sample.
+	WORD	wBlockAlign;		// number of bytes used to store each sample frame (wChannels * wBytesPerSample).
+	DWORD	dwFlags;			// PCMF_BIG_ENDIAN, PCMF_FLOAT, etc. See Omfoo_Enumerated_Types.h.
+} OMFOO_PCM_FORMAT, *POMFOO_PCM_FORMAT;
+
+//	IOmfooWaveformBuilder::BuildWaveforms() reports an array of these for each audio MDAT - one for each channel of
+//	each block of sample frames. The samples are scaled to the range [-1.0, 1.0), just like PCM_FORMAT_FLOAT32.
+typedef struct {
+	FLOAT	fMin;				// the smallest sample in the block.
+	FLOAT	fMax;				// the largest sample in the block.
+	FLOAT	fRms;				// the square root of the mean of the squares of the samples in the block.
+} OMFOO_WAVEFORM_PEAK, *POMFOO_WAVEFORM_PEAK;
+
 #endif	//  __OMFOO_STRUCTURES_H__